@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Microbenchmarks for the engine hot paths.
+#
+#-------------------------------------------------
+
+QT += core
+QT -= gui
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = sngpbench
+TEMPLATE = app
+
+include(../engine.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,535 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "problem.h"
+#include "scounters.h"
+#include "sevalengine.h"
+#include "sortedarray.h"
+#include "sperfcounters.h"
+#include "sprogram.h"
+#include "sprogramjit.h"
+#include "sprogramvm.h"
+
+/*
+ * Microbenchmarks for the engine hot paths.
+ *
+ * Each benchmark is seeded with a fixed value before it is set up, so
+ * the work done is the same from run to run.  Results are written as
+ * JSON (to stdout or the file given with -o) to diff between commits,
+ * a summary is printed to stderr.
+ *
+ * With -perf the hardware counters are read around the run loop, and
+ * in each phase of a generation when built with CONFIG+=counters.
+ *
+ * Usage: sngpbench [-o file] [-filter text] [-seed n] [-repeat n] [-perf]
+ */
+
+// The sample problems, between them covering 10 to 128 fitness cases
+static const char* Problems[] = {
+    "multiplexer6",
+    "parity4",
+    "parity7",
+    "parity12",
+    "regression",
+    "regression-constants"
+};
+static const int NumProblems = sizeof(Problems) / sizeof(Problems[0]);
+
+static const int PopulationSizes[] = { 100, 1000, 10000 };
+static const int NumPopulationSizes =
+    sizeof(PopulationSizes) / sizeof(PopulationSizes[0]);
+
+/*
+ * Engine and problem set up the same way SNGPWorker does.
+ */
+class BenchSetup
+{
+public:
+    BenchSetup(const char* problemName, int size)
+      : _problem(Problem::create(problemName)),
+        _fitness(size)
+    {
+        _engine.setNumInputs(_problem->getNumInputs());
+        _engine.setAvailableOps(_problem->getOps());
+        _engine.setSize(size);
+        _problem->initTestCaseResults(size);
+        _engine.init();
+        _problem->evaluate(_engine, _fitness);
+    }
+
+    ~BenchSetup() { delete _problem; }
+
+    Problem* _problem;
+    SEvalEngine _engine;
+    std::vector<int> _fitness;
+};
+
+/*
+ * Runs the benchmarks and collects the results.
+ */
+class Bench
+{
+public:
+    Bench() : _seed(1), _repeat(5), _perfCounters(NULL) {}
+
+    void benchMutate();
+    void benchMutateRestore();
+    void benchEvaluateAll();
+    void benchEvaluateChanged();
+    void benchSortedArrayAdd();
+    void benchGenerations();
+    enum ProgramEngine {
+        ProgramInterpreter,
+        ProgramBytecode,
+        ProgramNative
+    };
+    void benchProgram(ProgramEngine engine);
+
+    QJsonObject getResults();
+
+    uint _seed;
+    int _repeat;
+    std::string _filter;
+    // Hardware counters of the main thread, NULL to not read them
+    SPerfCounters* _perfCounters;
+
+private:
+    bool isEnabled(const char* name) {
+        return _filter.empty() || strstr(name, _filter.c_str());
+    }
+
+    /*
+     * Run 'func' _repeat times and return the min and median time
+     * per iteration.  'func' runs 'iterations' iterations and
+     * returns the nanoseconds taken by the part being measured.
+     */
+    template<class Func>
+    QJsonObject run(const char* name, const char* problem, int size,
+                    int iterations, Func func);
+
+    void addResult(const QJsonObject& result);
+
+    QJsonArray _results;
+};
+
+template<class Func>
+QJsonObject Bench::run(const char* name, const char* problem, int size,
+                       int iterations, Func func)
+{
+    std::vector<double> times;
+    for (int i = 0; i < _repeat; ++i) {
+        times.push_back(double(func(iterations)) / iterations);
+    }
+    std::sort(times.begin(), times.end());
+
+    fprintf(stderr, "%-28s %-22s %6d %12.1f ns\n",
+            name, problem, size, times[0]);
+
+    QJsonObject result;
+    result["name"] = QString(name);
+    result["problem"] = QString(problem);
+    result["size"] = size;
+    result["iterations"] = iterations;
+    result["nsPerOpMin"] = times[0];
+    result["nsPerOpMedian"] = times[times.size() / 2];
+    return result;
+}
+
+void Bench::addResult(const QJsonObject& result)
+{
+    _results.append(result);
+}
+
+void Bench::benchMutate()
+{
+    // Mutations accumulate, includes marking the changed nodes
+    const char* name = "engine.mutate";
+    if (!isEnabled(name)) {
+        return;
+    }
+    for (int p = 0; p < NumProblems; ++p) {
+        for (int s = 0; s < NumPopulationSizes; ++s) {
+            qsrand(_seed);
+            BenchSetup setup(Problems[p], PopulationSizes[s]);
+            SEvalEngine& engine = setup._engine;
+            int64_t numChanged = 0;
+            int iterations = 2000000 / PopulationSizes[s];
+            QJsonObject result = run(name, Problems[p],
+                                     PopulationSizes[s], iterations,
+                                     [&](int n) {
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < n; ++i) {
+                    engine.mutate();
+                    numChanged += engine.getChangedNodes().size();
+                    engine.clearChanged();
+                }
+                return timer.nsecsElapsed();
+            });
+            result["avgChanged"] =
+                double(numChanged) / (iterations * _repeat);
+            addResult(result);
+        }
+    }
+}
+
+void Bench::benchMutateRestore()
+{
+    // A mutation followed by restoring it, the population stays the
+    // same for every iteration
+    const char* name = "engine.mutate+restore";
+    if (!isEnabled(name)) {
+        return;
+    }
+    for (int p = 0; p < NumProblems; ++p) {
+        for (int s = 0; s < NumPopulationSizes; ++s) {
+            qsrand(_seed);
+            BenchSetup setup(Problems[p], PopulationSizes[s]);
+            SEvalEngine& engine = setup._engine;
+            addResult(run(name, Problems[p], PopulationSizes[s],
+                          2000000 / PopulationSizes[s], [&](int n) {
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < n; ++i) {
+                    engine.mutate();
+                    engine.clearChanged();
+                    engine.restore();
+                    engine.clearChanged();
+                }
+                return timer.nsecsElapsed();
+            }));
+        }
+    }
+}
+
+void Bench::benchEvaluateAll()
+{
+    const char* name = "problem.evaluate.all";
+    if (!isEnabled(name)) {
+        return;
+    }
+    for (int p = 0; p < NumProblems; ++p) {
+        for (int s = 0; s < NumPopulationSizes; ++s) {
+            qsrand(_seed);
+            BenchSetup setup(Problems[p], PopulationSizes[s]);
+            Problem* problem = setup._problem;
+            int64_t nodeCases =
+                int64_t(PopulationSizes[s]) * problem->getNumFitnessCases();
+            int iterations = std::max(1, int(20000000 / nodeCases));
+            QJsonObject result = run(name, Problems[p],
+                                     PopulationSizes[s], iterations,
+                                     [&](int n) {
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < n; ++i) {
+                    problem->evaluate(setup._engine, setup._fitness);
+                }
+                return timer.nsecsElapsed();
+            });
+            result["fitnessCases"] = problem->getNumFitnessCases();
+            result["nsPerNodeCase"] =
+                result["nsPerOpMin"].toDouble() / nodeCases;
+            addResult(result);
+        }
+    }
+}
+
+void Bench::benchEvaluateChanged()
+{
+    // Evaluate the nodes changed by a mutation and by restoring it,
+    // the mutation and restore are not timed
+    const char* name = "problem.evaluate.changed";
+    if (!isEnabled(name)) {
+        return;
+    }
+    for (int p = 0; p < NumProblems; ++p) {
+        for (int s = 0; s < NumPopulationSizes; ++s) {
+            qsrand(_seed);
+            BenchSetup setup(Problems[p], PopulationSizes[s]);
+            Problem* problem = setup._problem;
+            SEvalEngine& engine = setup._engine;
+            std::vector<int>& fitness = setup._fitness;
+            int64_t numChanged = 0;
+            int iterations = 1000000 / PopulationSizes[s];
+            QJsonObject result = run(name, Problems[p],
+                                     PopulationSizes[s], iterations,
+                                     [&](int n) {
+                QElapsedTimer timer;
+                timer.start();
+                qint64 total = 0;
+                for (int i = 0; i < n; ++i) {
+                    engine.mutate();
+                    numChanged += engine.getChangedNodes().size();
+                    qint64 start = timer.nsecsElapsed();
+                    problem->evaluate(engine, engine.getChangedNodes(),
+                                      fitness);
+                    total += timer.nsecsElapsed() - start;
+                    engine.clearChanged();
+
+                    engine.restore();
+                    numChanged += engine.getChangedNodes().size();
+                    start = timer.nsecsElapsed();
+                    problem->evaluate(engine, engine.getChangedNodes(),
+                                      fitness);
+                    total += timer.nsecsElapsed() - start;
+                    engine.clearChanged();
+                }
+                // Time per evaluate() call
+                return total / 2;
+            });
+            double avgChanged =
+                double(numChanged) / (2.0 * iterations * _repeat);
+            result["avgChanged"] = avgChanged;
+            result["fitnessCases"] = problem->getNumFitnessCases();
+            if (avgChanged > 0) {
+                result["nsPerNodeCase"] = result["nsPerOpMin"].toDouble() /
+                    (avgChanged * problem->getNumFitnessCases());
+            }
+            addResult(result);
+        }
+    }
+}
+
+void Bench::benchSortedArrayAdd()
+{
+    const char* name = "sortedarray.add";
+    if (!isEnabled(name)) {
+        return;
+    }
+    static const int Sizes[] = { 16, 128, 1024 };
+    for (size_t s = 0; s < sizeof(Sizes) / sizeof(Sizes[0]); ++s) {
+        int size = Sizes[s];
+        qsrand(_seed);
+        // Values from a range twice the size, so some are duplicates
+        std::vector<int> values(size);
+        for (int i = 0; i < size; ++i) {
+            values[i] = qrand() % (size * 2);
+        }
+        SortedArray<int> array(size);
+        int rounds = std::max(1, 1000000 / (size * size));
+        addResult(run(name, "", size, rounds * size, [&](int n) {
+            QElapsedTimer timer;
+            timer.start();
+            for (int r = 0; r < n / size; ++r) {
+                array.clear();
+                for (int i = 0; i < size; ++i) {
+                    array.add(values[i]);
+                }
+            }
+            return timer.nsecsElapsed();
+        }));
+    }
+}
+
+void Bench::benchGenerations()
+{
+    // End to end, the run loop as used by SNGPWorker
+    const char* name = "run.generations";
+    if (!isEnabled(name)) {
+        return;
+    }
+    static const int Sizes[] = { 100, 1000 };
+    for (int p = 0; p < NumProblems; ++p) {
+        for (size_t s = 0; s < sizeof(Sizes) / sizeof(Sizes[0]); ++s) {
+            qsrand(_seed);
+            BenchSetup setup(Problems[p], Sizes[s]);
+            SNodeStats stats;
+            stats.counters.perfCounters = _perfCounters;
+            int hits = 0;
+            int64_t totalEvents[SPerfCounters::NumEvents] = { 0 };
+            int64_t totalGenerations = 0;
+            QJsonObject result = run(name, Problems[p],
+                                     Sizes[s], 50000, [&](int n) {
+                int64_t startEvents[SPerfCounters::NumEvents];
+                if (_perfCounters) {
+                    _perfCounters->read(startEvents);
+                }
+                QElapsedTimer timer;
+                timer.start();
+                int generations = 0;
+                while (generations < n) {
+                    int start = stats.generation;
+                    SRunResult runResult = setup._problem->runGenerations(
+                        setup._engine, setup._fitness, stats, 0, 25000,
+                        std::min(64, n - generations), 0);
+                    generations += stats.generation - start;
+                    if (runResult != SRunContinue) {
+                        if (runResult == SRunHit) {
+                            hits++;
+                        }
+                        stats.runs++;
+                        stats.generation = 0;
+                    }
+                }
+                qint64 nsecs = timer.nsecsElapsed();
+                if (_perfCounters) {
+                    int64_t endEvents[SPerfCounters::NumEvents];
+                    _perfCounters->read(endEvents);
+                    for (int i = 0; i < SPerfCounters::NumEvents; ++i) {
+                        totalEvents[i] += endEvents[i] - startEvents[i];
+                    }
+                }
+                totalGenerations += generations;
+                return nsecs;
+            });
+            result["generationsPerSecond"] =
+                1e9 / result["nsPerOpMin"].toDouble();
+            result["runs"] = stats.runs;
+            result["hits"] = hits;
+            if (_perfCounters) {
+                // Totals over all the repeats, per generation
+                QJsonObject perf;
+                for (int i = 0; i < SPerfCounters::NumEvents; ++i) {
+                    perf[SPerfCounters::getEventName(
+                        SPerfCounters::Event(i))] =
+                        double(totalEvents[i]) / totalGenerations;
+                }
+                int64_t cycles = totalEvents[SPerfCounters::Cycles];
+                perf["ipc"] = cycles ? double(totalEvents[
+                    SPerfCounters::Instructions]) / cycles : 0.0;
+                result["perfPerGeneration"] = perf;
+            }
+            if (SCounters::isEnabled()) {
+                result["counters"] = stats.counters.toJson();
+            }
+            addResult(result);
+        }
+    }
+}
+
+void Bench::benchProgram(ProgramEngine engine)
+{
+    // Batch evaluation of an exported program, by each of the ways
+    // a program can be run.  The program is the last node's, the
+    // deepest.
+    const char* names[] = {
+        "program.interpret", "program.bytecode", "program.native"
+    };
+    const char* name = names[engine];
+    if (!isEnabled(name)) {
+        return;
+    }
+    if (engine == ProgramNative && !SProgramJit::isSupported()) {
+        fprintf(stderr, "%s isn't supported\n", name);
+        return;
+    }
+    const int NumRows = 65536;
+    for (int p = 0; p < NumProblems; ++p) {
+        qsrand(_seed);
+        BenchSetup setup(Problems[p], 1000);
+        Problem* problem = setup._problem;
+        SProgram program = SProgram::extract(setup._engine, *problem,
+                                             setup._engine.getSize() - 1);
+        SProgramVM vm;
+        SProgramJit jit;
+        if ((engine == ProgramBytecode && !vm.compile(program, *problem)) ||
+            (engine == ProgramNative && !jit.compile(program, *problem))) {
+            continue;
+        }
+
+        // The fitness cases, repeated
+        int numInputs = problem->getNumInputs();
+        std::vector<int> inputs(NumRows * numInputs);
+        for (int i = 0; i < NumRows; ++i) {
+            const int* caseInputs =
+                problem->getInputs(i % problem->getNumFitnessCases());
+            std::copy(caseInputs, caseInputs + numInputs,
+                      &inputs[i * numInputs]);
+        }
+        std::vector<int> results(NumRows);
+        int size = program.getInstructions().size();
+        QJsonObject result = run(name, Problems[p], size, NumRows,
+                                 [&](int n) {
+            QElapsedTimer timer;
+            timer.start();
+            if (engine == ProgramNative) {
+                jit.evaluate(&inputs[0], n, &results[0]);
+            } else if (engine == ProgramBytecode) {
+                vm.evaluate(&inputs[0], n, &results[0]);
+            } else {
+                problem->evaluateProgram(program, &inputs[0], n,
+                                         &results[0]);
+            }
+            return timer.nsecsElapsed();
+        });
+        if (engine == ProgramNative) {
+            result["codeSize"] = int(jit.getCodeSize());
+        } else if (engine == ProgramBytecode) {
+            result["registers"] = vm.getNumRegisters();
+        }
+        addResult(result);
+    }
+}
+
+QJsonObject Bench::getResults()
+{
+    QJsonObject results;
+    results["seed"] = int(_seed);
+    results["repeat"] = _repeat;
+    results["benchmarks"] = _results;
+    return results;
+}
+
+int main(int argc, char *argv[])
+{
+    Bench bench;
+    SPerfCounters perfCounters;
+    const char* outputFile = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (!strcmp(argv[i], "-filter") && i + 1 < argc) {
+            bench._filter = argv[++i];
+        } else if (!strcmp(argv[i], "-seed") && i + 1 < argc) {
+            bench._seed = strtoul(argv[++i], 0, 10);
+        } else if (!strcmp(argv[i], "-repeat") && i + 1 < argc) {
+            bench._repeat = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "-perf")) {
+            if (!perfCounters.open()) {
+                fprintf(stderr, "Can't open the hardware counters, "
+                        "check /proc/sys/kernel/perf_event_paranoid\n");
+                return 1;
+            }
+            bench._perfCounters = &perfCounters;
+        } else {
+            fprintf(stderr, "Usage: %s [-o file] [-filter text] "
+                    "[-seed n] [-repeat n] [-perf]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench.benchMutate();
+    bench.benchMutateRestore();
+    bench.benchEvaluateAll();
+    bench.benchEvaluateChanged();
+    bench.benchSortedArrayAdd();
+    bench.benchGenerations();
+    bench.benchProgram(Bench::ProgramInterpreter);
+    bench.benchProgram(Bench::ProgramBytecode);
+    bench.benchProgram(Bench::ProgramNative);
+
+    QFile file;
+    bool opened;
+    if (outputFile) {
+        file.setFileName(outputFile);
+        opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = file.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        fprintf(stderr, "Can't open %s\n", outputFile);
+        return 1;
+    }
+    file.write(QJsonDocument(bench.getResults()).toJson());
+    return 0;
+}
@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Command line tools for running the GP engine
+# without the UI.
+#
+#-------------------------------------------------
+
+QT += core network
+QT -= gui
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = sngpcli
+TEMPLATE = app
+
+include(../engine.pri)
+
+SOURCES += main.cpp \
+    coordinator.cpp \
+    daemon.cpp \
+    effort.cpp \
+    eval.cpp \
+    race.cpp \
+    run.cpp \
+    scheduler.cpp \
+    selfcheck.cpp \
+    submit.cpp \
+    worker.cpp
+
+HEADERS += coordinator.h \
+    daemon.h \
+    effort.h \
+    eval.h \
+    race.h \
+    run.h \
+    scheduler.h \
+    selfcheck.h \
+    submit.h \
+    worker.h
@@ -0,0 +1,472 @@
+#include "coordinator.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTcpSocket>
+
+#include <stdio.h>
+#include <algorithm>
+#include <limits>
+
+#include "problem.h"
+#include "scheckpoint.h"
+#include "sprogram.h"
+
+CoordinatorServer::CoordinatorServer(const QJsonObject& setup, int runs,
+                                     int batchSize, int islands,
+                                     QObject *parent)
+  : QObject(parent),
+    _setup(setup),
+    _runs(islands > 0 ? 0 : runs),
+    _batchSize(batchSize),
+    _numIslands(islands),
+    _outcomes(_runs),
+    _finishedRuns(0),
+    _islandWorkers(islands, 0),
+    _finishedIslands(islands, 0),
+    _numFinishedIslands(0),
+    _bestFitness(std::numeric_limits<int>::min()),
+    _finished(false)
+{
+    _setup["type"] = QString("setup");
+    for (int first = 0; first < _runs; first += _batchSize) {
+        _pendingBatches.push_back(first);
+    }
+    for (int i = 0; i < _numIslands; ++i) {
+        _pendingIslands.push_back(i);
+    }
+    connect(&_server, SIGNAL(newConnection()),
+            this, SLOT(acceptConnection()));
+}
+
+bool CoordinatorServer::listen(const QString& address, int port,
+                               QString* outError)
+{
+    if (!_server.listen(QHostAddress(address), port)) {
+        if (outError) {
+            *outError = _server.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void CoordinatorServer::acceptConnection()
+{
+    while (_server.hasPendingConnections()) {
+        QTcpSocket* socket = _server.nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+        connect(socket, SIGNAL(disconnected()),
+                this, SLOT(dropConnection()));
+    }
+}
+
+void CoordinatorServer::readMessages()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+    while (socket->canReadLine()) {
+        QJsonParseError error;
+        QJsonDocument document =
+            QJsonDocument::fromJson(socket->readLine(), &error);
+        if (error.error != QJsonParseError::NoError || !document.isObject()) {
+            fprintf(stderr, "Bad message from %s: %s\n",
+                    qPrintable(socket->peerAddress().toString()),
+                    qPrintable(error.errorString()));
+            socket->abort();
+            return;
+        }
+        handleMessage(socket, document.object());
+    }
+    if (socket->bytesAvailable() > MaxMessageSize) {
+        fprintf(stderr, "Message from %s is too long\n",
+                qPrintable(socket->peerAddress().toString()));
+        socket->abort();
+    }
+}
+
+void CoordinatorServer::dropConnection()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    // Hand the worker's batches and islands to the others
+    std::map<QTcpSocket*, Worker>::iterator it = _workers.find(socket);
+    if (it != _workers.end()) {
+        const Worker& worker = it->second;
+        for (size_t i = 0; i < worker.batches.size(); ++i) {
+            _pendingBatches.push_front(worker.batches[i]);
+        }
+        for (size_t i = 0; i < worker.islands.size(); ++i) {
+            _islandWorkers[worker.islands[i]] = 0;
+            _pendingIslands.push_front(worker.islands[i]);
+        }
+        if (!_finished) {
+            fprintf(stderr, "Lost worker %s, %d batches and %d islands "
+                    "requeued\n",
+                    qPrintable(socket->peerAddress().toString()),
+                    int(worker.batches.size()), int(worker.islands.size()));
+        }
+        _workers.erase(it);
+        assignWork();
+    }
+    socket->deleteLater();
+}
+
+void CoordinatorServer::handleMessage(QTcpSocket* socket,
+                                      const QJsonObject& message)
+{
+    QString type = message["type"].toString();
+    if (type == "hello") {
+        Worker& worker = _workers[socket];
+        worker.threads = std::max(1, message["threads"].toInt(1));
+        fprintf(stderr, "Worker %s with %d threads\n",
+                qPrintable(socket->peerAddress().toString()),
+                worker.threads);
+        send(socket, _setup);
+        assignWork();
+    } else if (_workers.find(socket) == _workers.end()) {
+        socket->abort();
+    } else if (type == "outcomes") {
+        handleOutcomes(socket, message);
+    } else if (type == "migrant") {
+        handleMigrant(message);
+    } else if (type == "island") {
+        handleIsland(socket, message);
+    }
+}
+
+void CoordinatorServer::handleOutcomes(QTcpSocket* socket,
+                                       const QJsonObject& message)
+{
+    Worker& worker = _workers[socket];
+    int first = message["first"].toInt(-1);
+    std::vector<int>::iterator batch =
+        std::find(worker.batches.begin(), worker.batches.end(), first);
+    QJsonArray outcomes = message["outcomes"].toArray();
+    int count = std::min(_batchSize, _runs - first);
+    if (batch == worker.batches.end() || outcomes.size() != count) {
+        fprintf(stderr, "Unexpected outcomes from %s\n",
+                qPrintable(socket->peerAddress().toString()));
+        return;
+    }
+    worker.batches.erase(batch);
+    for (int k = 0; k < count; ++k) {
+        QJsonObject result = outcomes[k].toObject();
+        EffortCommand::RunOutcome& outcome = _outcomes[first + k];
+        outcome.hit = result["hit"].toBool();
+        outcome.generations = result["generations"].toInt();
+        outcome.nsecs = qint64(result["nsecs"].toDouble());
+        _bestFitness = std::max(_bestFitness, result["best"].toInt());
+    }
+    _finishedRuns += count;
+    fprintf(stderr, "\r%d/%d runs", _finishedRuns, _runs);
+    if (_finishedRuns == _runs) {
+        fprintf(stderr, "\n");
+        finish();
+    } else {
+        assignWork();
+    }
+}
+
+void CoordinatorServer::handleMigrant(const QJsonObject& message)
+{
+    // Islands form a ring, each sending to the next
+    int from = message["island"].toInt(-1);
+    if (from < 0 || from >= _numIslands) {
+        return;
+    }
+    _bestFitness = std::max(_bestFitness, message["fitness"].toInt());
+    int to = (from + 1) % _numIslands;
+    if (to == from || _finishedIslands[to]) {
+        return;
+    }
+    QJsonObject migrant;
+    migrant["type"] = QString("migrant");
+    migrant["island"] = to;
+    migrant["program"] = message["program"];
+    if (_islandWorkers[to]) {
+        send(_islandWorkers[to], migrant);
+    } else {
+        _pendingMigrants[to] = migrant;
+    }
+}
+
+void CoordinatorServer::handleIsland(QTcpSocket* socket,
+                                     const QJsonObject& message)
+{
+    Worker& worker = _workers[socket];
+    int island = message["island"].toInt(-1);
+    std::vector<int>::iterator it =
+        std::find(worker.islands.begin(), worker.islands.end(), island);
+    if (it == worker.islands.end()) {
+        return;
+    }
+    worker.islands.erase(it);
+    _islandWorkers[island] = 0;
+    _finishedIslands[island] = 1;
+    _numFinishedIslands++;
+
+    int fitness = message["fitness"].toInt();
+    _bestFitness = std::max(_bestFitness, fitness);
+    bool hit = message["hit"].toBool();
+    fprintf(stderr, "Island %d: %s after %d generations, best individual "
+            "%d\n", island, hit ? "hit" : "no hit",
+            message["generations"].toInt(), fitness);
+    if (hit || _islandResult.isEmpty() ||
+        fitness > _islandResult["fitness"].toInt()) {
+        _islandResult = message;
+    }
+    if (hit || _numFinishedIslands == _numIslands) {
+        finish();
+    } else {
+        assignWork();
+    }
+}
+
+void CoordinatorServer::assignWork()
+{
+    if (_finished) {
+        return;
+    }
+    for (std::map<QTcpSocket*, Worker>::iterator it = _workers.begin();
+         it != _workers.end(); ++it) {
+        Worker& worker = it->second;
+        while (!_pendingBatches.empty() &&
+               int(worker.batches.size()) < worker.threads) {
+            int first = _pendingBatches.front();
+            _pendingBatches.pop_front();
+            worker.batches.push_back(first);
+            QJsonObject message;
+            message["type"] = QString("runs");
+            message["first"] = first;
+            message["count"] = std::min(_batchSize, _runs - first);
+            send(it->first, message);
+        }
+        // An island needs a thread of its own, or it stalls the ring
+        while (!_pendingIslands.empty() &&
+               int(worker.islands.size()) < worker.threads) {
+            int island = _pendingIslands.front();
+            _pendingIslands.pop_front();
+            worker.islands.push_back(island);
+            _islandWorkers[island] = it->first;
+            QJsonObject message;
+            message["type"] = QString("island");
+            message["island"] = island;
+            send(it->first, message);
+            std::map<int, QJsonObject>::iterator migrant =
+                _pendingMigrants.find(island);
+            if (migrant != _pendingMigrants.end()) {
+                send(it->first, migrant->second);
+                _pendingMigrants.erase(migrant);
+            }
+        }
+    }
+}
+
+void CoordinatorServer::finish()
+{
+    _finished = true;
+    QJsonObject stop;
+    stop["type"] = QString("stop");
+    for (std::map<QTcpSocket*, Worker>::iterator it = _workers.begin();
+         it != _workers.end(); ++it) {
+        send(it->first, stop);
+        it->first->flush();
+    }
+    QCoreApplication::quit();
+}
+
+void CoordinatorServer::send(QTcpSocket* socket, const QJsonObject& message)
+{
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+CoordinatorCommand::CoordinatorCommand()
+  : _address("127.0.0.1"),
+    _port(DefaultPort),
+    _problem("parity7"),
+    _populationSize(100),
+    _maxGenerations(25000),
+    _seed(1),
+    _runs(100),
+    _batchSize(16),
+    _islands(0),
+    _interval(1000)
+{
+}
+
+void CoordinatorCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli coordinator [options]\n"
+            "  -listen address  address to listen on, 0.0.0.0 for\n"
+            "                   workers on other machines (127.0.0.1)\n"
+            "  -port n          port to listen on (%d)\n"
+            "  -problem name    problem to run (parity7)\n"
+            "  -population n    nodes in the population (100)\n"
+            "  -generations n   max generations per run (25000)\n"
+            "  -seed n          seed of the first run (1)\n"
+            "  -runs n          number of runs (100)\n"
+            "  -batch n         runs handed to a worker thread at a\n"
+            "                   time (16)\n"
+            "  -islands n       instead run one problem on n islands\n"
+            "                   exchanging migrants (0)\n"
+            "  -interval n      generations between migrations (1000)\n"
+            "  -o file          write the result as JSON\n"
+            "  -program file    export the program of the best island\n"
+            "Problems: %s, table:file\n"
+            "Benchmarks: %s\n",
+            int(DefaultPort),
+            qPrintable(Problem::getProblemNames().join(", ")),
+            qPrintable(Problem::getBenchmarkNames().join(", ")));
+}
+
+bool CoordinatorCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-listen") {
+            _address = value;
+            ok = !QHostAddress(value).isNull();
+        } else if (arg == "-port") {
+            _port = value.toInt(&ok);
+            ok = ok && _port > 0 && _port < 65536;
+        } else if (arg == "-problem") {
+            _problem = value;
+            QString error;
+            ok = Problem::isProblemName(value, &error);
+            if (!ok) {
+                fprintf(stderr, "%s\n", qPrintable(error));
+            }
+        } else if (arg == "-population") {
+            _populationSize = value.toInt(&ok);
+            ok = ok && _populationSize > 0;
+        } else if (arg == "-generations") {
+            _maxGenerations = value.toInt(&ok);
+            ok = ok && _maxGenerations > 0;
+        } else if (arg == "-seed") {
+            _seed = value.toUInt(&ok);
+        } else if (arg == "-runs") {
+            _runs = value.toInt(&ok);
+            ok = ok && _runs > 0;
+        } else if (arg == "-batch") {
+            _batchSize = value.toInt(&ok);
+            ok = ok && _batchSize > 0;
+        } else if (arg == "-islands") {
+            _islands = value.toInt(&ok);
+            ok = ok && _islands >= 0;
+        } else if (arg == "-interval") {
+            _interval = value.toInt(&ok);
+            ok = ok && _interval > 0;
+        } else if (arg == "-o") {
+            _outputFile = value;
+        } else if (arg == "-program") {
+            _programFile = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int CoordinatorCommand::exec()
+{
+    QJsonObject setup;
+    setup["problem"] = _problem;
+    setup["population"] = _populationSize;
+    setup["generations"] = _maxGenerations;
+    setup["seed"] = double(_seed);
+    setup["interval"] = _interval;
+    CoordinatorServer server(setup, _runs, _batchSize, _islands);
+    QString error;
+    if (!server.listen(_address, _port, &error)) {
+        fprintf(stderr, "Can't listen on %s:%d: %s\n", qPrintable(_address),
+                _port, qPrintable(error));
+        return 1;
+    }
+    if (_islands > 0) {
+        fprintf(stderr, "Waiting for workers on %s:%d to run %s on %d "
+                "islands\n", qPrintable(_address), _port,
+                qPrintable(_problem), _islands);
+    } else {
+        fprintf(stderr, "Waiting for workers on %s:%d to make %d runs of "
+                "%s\n", qPrintable(_address), _port, _runs,
+                qPrintable(_problem));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int exitCode = QCoreApplication::exec();
+    if (exitCode != 0) {
+        return exitCode;
+    }
+
+    QJsonObject result;
+    if (_islands > 0) {
+        result = server.getIslandResult();
+        result.remove("type");
+        result["problem"] = _problem;
+        result["islands"] = _islands;
+        result["wallSeconds"] = timer.nsecsElapsed() / 1e9;
+        printf("%s: %s on island %d after %d generations, best individual "
+               "%d (%.2f s)\n", qPrintable(_problem),
+               result["hit"].toBool() ? "hit" : "no hit",
+               result["island"].toInt(), result["generations"].toInt(),
+               result["fitness"].toInt(), result["wallSeconds"].toDouble());
+
+        SProgram program;
+        QByteArray data = QByteArray::fromBase64(
+            result["program"].toString().toLatin1());
+        if (!_programFile.isEmpty()) {
+            if (!program.load(data, &error)) {
+                fprintf(stderr, "Bad program from island %d: %s\n",
+                        result["island"].toInt(), qPrintable(error));
+                return 1;
+            }
+            if (!SCheckpointFileWriter::writeFile(_programFile, data)) {
+                fprintf(stderr, "Can't write %s\n",
+                        qPrintable(_programFile));
+                return 1;
+            }
+        }
+    } else {
+        result = summariseRuns(_problem, _populationSize, _maxGenerations,
+                               _seed, server.getOutcomes(),
+                               timer.nsecsElapsed());
+        result["bestFitness"] = server.getBestFitness();
+        printf("%s: %d runs, %d hits, success rate %.1f%% (%.2f s)\n",
+               qPrintable(_problem), result["runs"].toInt(),
+               result["hits"].toInt(), 100 * result["successRate"].toDouble(),
+               result["wallSeconds"].toDouble());
+    }
+    if (!_outputFile.isEmpty()) {
+        QFile file(_outputFile);
+        if (!file.open(QIODevice::WriteOnly) ||
+            file.write(QJsonDocument(result).toJson()) < 0) {
+            fprintf(stderr, "Can't write %s\n", qPrintable(_outputFile));
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTcpServer>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "effort.h"
+
+class QTcpSocket;
+
+/*
+ * Coordinator of runs spread over worker processes (see
+ * WorkerCommand), on this machine or others, for batches of runs too
+ * big for one machine's threads.
+ *
+ * Either the runs of an experiment are handed out in batches and
+ * their outcomes summarised as by EffortCommand, or a run is split
+ * into islands: one population per worker thread, each sending its
+ * best program to the next island in a ring every few generations.
+ *
+ * Workers connect over TCP and the messages are lines of JSON.  The
+ * coordinator sends:
+ *
+ *   {"type": "setup", "problem": "parity7", "population": 100,
+ *    "generations": 25000, "seed": 1, "interval": 1000}
+ *   {"type": "runs", "first": 32, "count": 16}
+ *   {"type": "island", "island": 3}
+ *   {"type": "migrant", "island": 3, "program": "<base64>"}
+ *   {"type": "stop"}
+ *
+ * and the workers:
+ *
+ *   {"type": "hello", "threads": 8}
+ *   {"type": "outcomes", "first": 32, "outcomes": [{"hit": true,
+ *    "generations": 1234, "nsecs": 5678, "best": 128}, ...]}
+ *   {"type": "migrant", "island": 2, "generation": 3000,
+ *    "fitness": 120, "program": "<base64>"}
+ *   {"type": "island", "island": 2, "hit": true, "generations": 4000,
+ *    "fitness": 128, "program": "<base64>"}
+ *
+ * Run k (or island k) is seeded with seed + k, so the outcomes don't
+ * depend on which worker made them.  The batches or islands of a
+ * worker that disconnects are handed to another; an island restarts
+ * from scratch.
+ */
+class CoordinatorCommand
+{
+public:
+    CoordinatorCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Hand out the runs or islands and wait for them to finish.
+     * Returns the process exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+    // Default port of the coordinator
+    enum { DefaultPort = 7878 };
+
+private:
+    QString _address;
+    int _port;
+    QString _problem;
+    int _populationSize;
+    int _maxGenerations;
+    uint _seed;
+    int _runs;
+    int _batchSize;
+    int _islands;
+    int _interval;
+    QString _outputFile;
+    QString _programFile;
+};
+
+/*
+ * Hands out the work to the workers, on the main thread.
+ */
+class CoordinatorServer : public QObject
+{
+    Q_OBJECT
+public:
+    CoordinatorServer(const QJsonObject& setup, int runs, int batchSize,
+                      int islands, QObject *parent = 0);
+
+    /*
+     * Listen for workers.  Returns false and sets 'outError' if that
+     * fails.
+     */
+    bool listen(const QString& address, int port, QString* outError = 0);
+
+    /*
+     * Get the outcomes of the runs, valid once finished.
+     */
+    const std::vector<EffortCommand::RunOutcome>& getOutcomes() const {
+        return _outcomes;
+    }
+
+    /*
+     * Get the result of the island run, valid once finished: the
+     * island that finished first, with a hit if any did, else the
+     * fittest.
+     */
+    const QJsonObject& getIslandResult() const { return _islandResult; }
+
+    // Best fitness of any run or island
+    int getBestFitness() const { return _bestFitness; }
+
+private slots:
+    void acceptConnection();
+    void readMessages();
+    void dropConnection();
+
+private:
+    struct Worker {
+        int threads;
+        // First run of each batch handed to the worker
+        std::vector<int> batches;
+        std::vector<int> islands;
+    };
+
+    void handleMessage(QTcpSocket* socket, const QJsonObject& message);
+    void handleOutcomes(QTcpSocket* socket, const QJsonObject& message);
+    void handleMigrant(const QJsonObject& message);
+    void handleIsland(QTcpSocket* socket, const QJsonObject& message);
+
+    /*
+     * Hand out batches or islands to the workers with free threads.
+     */
+    void assignWork();
+
+    /*
+     * Tell the workers to stop and quit the event loop.
+     */
+    void finish();
+
+    void send(QTcpSocket* socket, const QJsonObject& message);
+
+    // Longest message line accepted, migrants are a few kB at most
+    enum { MaxMessageSize = 1024 * 1024 };
+
+    QTcpServer _server;
+    QJsonObject _setup;
+    int _runs;
+    int _batchSize;
+    int _numIslands;
+    std::map<QTcpSocket*, Worker> _workers;
+
+    // First runs of the batches not handed out yet
+    std::deque<int> _pendingBatches;
+    std::vector<EffortCommand::RunOutcome> _outcomes;
+    int _finishedRuns;
+
+    // Islands not handed out yet, and the worker running each
+    std::deque<int> _pendingIslands;
+    std::vector<QTcpSocket*> _islandWorkers;
+    // Last migrant for each island that has no worker yet
+    std::map<int, QJsonObject> _pendingMigrants;
+    std::vector<char> _finishedIslands;
+    int _numFinishedIslands;
+    QJsonObject _islandResult;
+
+    int _bestFitness;
+    bool _finished;
+};
+
+#endif // COORDINATOR_H
@@ -0,0 +1,416 @@
+#include "daemon.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QLockFile>
+#include <QThread>
+
+#include <stdio.h>
+#include <vector>
+
+#include "problem.h"
+#include "scheduler.h"
+#include "srun.h"
+
+const char* DaemonCommand::DefaultSocketName = "sngpd";
+
+/*
+ * Runs the jobs' runs until the scheduler is stopped.
+ */
+class DaemonThread : public QThread
+{
+public:
+    explicit DaemonThread(JobScheduler& scheduler)
+      : _scheduler(scheduler)
+    {
+    }
+
+    virtual ~DaemonThread();
+
+protected:
+    virtual void run();
+
+private:
+    /*
+     * Get a run of the problem, reusing a cached one if there is
+     * one.
+     */
+    SRun* getRun(const QString& problem, int populationSize);
+
+    /*
+     * Drop 'run' from the cached runs without deleting it, if it is
+     * one of them.
+     */
+    void releaseRun(SRun* run);
+
+    // Number of problems and population sizes kept warm
+    enum { MaxCachedRuns = 4 };
+
+    struct CachedRun {
+        QString problem;
+        int populationSize;
+        SRun* run;
+    };
+
+    JobScheduler& _scheduler;
+    // Most recently used first
+    std::vector<CachedRun> _cachedRuns;
+};
+
+DaemonThread::~DaemonThread()
+{
+    for (size_t i = 0; i < _cachedRuns.size(); ++i) {
+        delete _cachedRuns[i].run;
+    }
+}
+
+SRun* DaemonThread::getRun(const QString& problem, int populationSize)
+{
+    for (size_t i = 0; i < _cachedRuns.size(); ++i) {
+        if (_cachedRuns[i].problem == problem &&
+            _cachedRuns[i].populationSize == populationSize) {
+            CachedRun cached = _cachedRuns[i];
+            _cachedRuns.erase(_cachedRuns.begin() + i);
+            _cachedRuns.insert(_cachedRuns.begin(), cached);
+            return cached.run;
+        }
+    }
+    CachedRun cached;
+    cached.problem = problem;
+    cached.populationSize = populationSize;
+    cached.run = new SRun();
+    cached.run->setPopulationSize(populationSize);
+    cached.run->setProblem(Problem::create(problem));
+    _cachedRuns.insert(_cachedRuns.begin(), cached);
+    if (_cachedRuns.size() > MaxCachedRuns) {
+        delete _cachedRuns.back().run;
+        _cachedRuns.pop_back();
+    }
+    return cached.run;
+}
+
+void DaemonThread::releaseRun(SRun* run)
+{
+    for (size_t i = 0; i < _cachedRuns.size(); ++i) {
+        if (_cachedRuns[i].run == run) {
+            _cachedRuns.erase(_cachedRuns.begin() + i);
+            return;
+        }
+    }
+}
+
+void DaemonThread::run()
+{
+    DaemonTask task;
+    while (_scheduler.takeTask(task)) {
+        // A suspended run carries on from its own random number state
+        SRun* run = task.suspendedRun;
+        if (!run) {
+            run = getRun(task.job.problem, task.job.populationSize);
+            run->setNumMaxGenerations(task.job.maxGenerations);
+            // The seed is per thread
+            qsrand(task.job.seed + task.run);
+            run->restart();
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        SRunResult result;
+        bool cancelled;
+        bool yielded;
+        do {
+            result = run->run(1000);
+            cancelled = _scheduler.isCancelled(task.jobId);
+            yielded = result == SRunContinue && !cancelled &&
+                      _scheduler.shouldYield(task);
+        } while (result == SRunContinue && !cancelled && !yielded);
+        qint64 nsecs = task.nsecs + timer.nsecsElapsed();
+
+        if (yielded) {
+            // The scheduler keeps the run until a worker carries it on
+            releaseRun(run);
+            _scheduler.suspendTask(task, run, nsecs);
+            continue;
+        }
+        EffortCommand::RunOutcome outcome;
+        outcome.hit = (result == SRunHit);
+        outcome.generations = run->getStats().generation;
+        outcome.nsecs = nsecs;
+        if (task.suspendedRun) {
+            delete run;
+        }
+        _scheduler.finishTask(task, cancelled ? 0 : &outcome);
+    }
+}
+
+DaemonServer::DaemonServer(JobScheduler& scheduler, QObject *parent)
+  : QObject(parent),
+    _scheduler(scheduler),
+    _lockFile(0)
+{
+    connect(&_server, SIGNAL(newConnection()),
+            this, SLOT(acceptConnection()));
+    // Events are queued from the worker threads
+    connect(&_scheduler, SIGNAL(eventsReady()),
+            this, SLOT(sendEvents()), Qt::QueuedConnection);
+}
+
+DaemonServer::~DaemonServer()
+{
+    delete _lockFile;
+}
+
+bool DaemonServer::listen(const QString& name, QString* outError)
+{
+    // Held while the daemon runs, so that two daemons starting at
+    // once can't both find the socket unanswered and replace it.
+    // The lock of a daemon that died is taken over.
+    QString lockName = name + ".lock";
+    if (!name.contains('/')) {
+        lockName = QDir(QDir::tempPath()).filePath(lockName);
+    }
+    delete _lockFile;
+    _lockFile = new QLockFile(lockName);
+    _lockFile->setStaleLockTime(0);
+    if (!_lockFile->tryLock(0)) {
+        if (outError) {
+            *outError = _lockFile->error() == QLockFile::LockFailedError ?
+                QString("another daemon is already running") :
+                QString("can't create %1").arg(lockName);
+        }
+        return false;
+    }
+
+    // Only replace the socket if no daemon answers on it, such as
+    // one that doesn't take the lock
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(1000)) {
+        probe.disconnectFromServer();
+        if (outError) {
+            *outError = "another daemon is already running";
+        }
+        return false;
+    }
+    QLocalServer::removeServer(name);
+    if (!_server.listen(name)) {
+        if (outError) {
+            *outError = _server.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void DaemonServer::acceptConnection()
+{
+    while (_server.hasPendingConnections()) {
+        QLocalSocket* client = _server.nextPendingConnection();
+        connect(client, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(client, SIGNAL(disconnected()),
+                this, SLOT(dropConnection()));
+    }
+}
+
+void DaemonServer::readRequests()
+{
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client) {
+        return;
+    }
+    while (client->canReadLine()) {
+        QByteArray line = client->readLine();
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError || !document.isObject()) {
+            sendError(client, QString("Bad request: %1").
+                      arg(error.errorString()));
+            continue;
+        }
+        handleRequest(client, document.object());
+    }
+    if (client->bytesAvailable() > MaxRequestSize) {
+        sendError(client, "Request is too long");
+        client->disconnectFromServer();
+    }
+}
+
+void DaemonServer::dropConnection()
+{
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client) {
+        return;
+    }
+
+    // Nobody is waiting for the client's jobs
+    std::map<int, QLocalSocket*>::iterator it = _jobClients.begin();
+    while (it != _jobClients.end()) {
+        if (it->second == client) {
+            _scheduler.cancel(it->first);
+            _jobClients.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    client->deleteLater();
+}
+
+void DaemonServer::sendEvents()
+{
+    std::vector<QJsonObject> events = _scheduler.takeEvents();
+    for (size_t i = 0; i < events.size(); ++i) {
+        const QJsonObject& event = events[i];
+        int jobId = event["job"].toInt();
+        QString type = event["type"].toString();
+        std::map<int, QLocalSocket*>::iterator it = _jobClients.find(jobId);
+        if (it == _jobClients.end()) {
+            continue;
+        }
+        send(it->second, event);
+        if (type == "result" || type == "cancelled") {
+            fprintf(stderr, "Job %d %s\n", jobId,
+                    type == "result" ? "finished" : "cancelled");
+            _jobClients.erase(it);
+        }
+    }
+}
+
+void DaemonServer::handleRequest(QLocalSocket* client,
+                                 const QJsonObject& request)
+{
+    QString type = request["type"].toString();
+    if (type == "submit") {
+        DaemonJob job;
+        job.problem = request["problem"].toString(job.problem);
+        job.populationSize = request["population"].toInt(job.populationSize);
+        job.maxGenerations = request["generations"].toInt(job.maxGenerations);
+        job.runs = request["runs"].toInt(job.runs);
+        job.seed = uint(request["seed"].toDouble(job.seed));
+        job.priority = request["priority"].toInt(job.priority);
+        QString error;
+        if (!Problem::isProblemName(job.problem, &error)) {
+            sendError(client, error);
+        } else if (job.populationSize <= 0 || job.maxGenerations <= 0 ||
+                   job.runs <= 0) {
+            sendError(client, "The population, generations and runs "
+                      "must be positive");
+        } else {
+            int jobId = _scheduler.submit(job);
+            _jobClients[jobId] = client;
+            QJsonObject reply;
+            reply["type"] = QString("accepted");
+            reply["job"] = jobId;
+            send(client, reply);
+            fprintf(stderr, "Job %d: %d runs of %s, priority %d\n", jobId,
+                    job.runs, qPrintable(job.problem), job.priority);
+        }
+    } else if (type == "cancel") {
+        if (_scheduler.cancel(request["job"].toInt())) {
+            QJsonObject reply;
+            reply["type"] = QString("ok");
+            send(client, reply);
+        } else {
+            sendError(client, "No such job");
+        }
+    } else if (type == "status") {
+        send(client, _scheduler.getStatus());
+    } else if (type == "shutdown") {
+        QJsonObject reply;
+        reply["type"] = QString("ok");
+        send(client, reply);
+        client->flush();
+        _scheduler.stop();
+        QCoreApplication::quit();
+    } else {
+        sendError(client, QString("Unknown request %1").arg(type));
+    }
+}
+
+void DaemonServer::send(QLocalSocket* client, const QJsonObject& message)
+{
+    client->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    client->write("\n");
+}
+
+void DaemonServer::sendError(QLocalSocket* client, const QString& error)
+{
+    QJsonObject reply;
+    reply["type"] = QString("error");
+    reply["error"] = error;
+    send(client, reply);
+}
+
+DaemonCommand::DaemonCommand()
+  : _socketName(DefaultSocketName),
+    _threads(QThread::idealThreadCount())
+{
+}
+
+void DaemonCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli daemon [options]\n"
+            "  -socket name     local socket to listen on (%s)\n"
+            "  -threads n       number of runs in parallel\n",
+            DefaultSocketName);
+}
+
+bool DaemonCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-socket") {
+            _socketName = value;
+            ok = !value.isEmpty();
+        } else if (arg == "-threads") {
+            _threads = value.toInt(&ok);
+            ok = ok && _threads > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int DaemonCommand::exec()
+{
+    JobScheduler scheduler;
+    DaemonServer server(scheduler);
+    QString error;
+    if (!server.listen(_socketName, &error)) {
+        fprintf(stderr, "Can't listen on %s: %s\n", qPrintable(_socketName),
+                qPrintable(error));
+        return 1;
+    }
+
+    std::vector<DaemonThread*> threads;
+    for (int i = 0; i < _threads; ++i) {
+        threads.push_back(new DaemonThread(scheduler));
+        threads.back()->start();
+    }
+    fprintf(stderr, "Listening on %s with %d threads\n",
+            qPrintable(_socketName), _threads);
+    int result = QCoreApplication::exec();
+
+    scheduler.stop();
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    return result;
+}
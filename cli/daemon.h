@@ -0,0 +1,105 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+
+class QLocalSocket;
+class QLockFile;
+class JobScheduler;
+
+/*
+ * Long running daemon that runs jobs for local clients, so scripts
+ * running many experiments share one pool of worker threads.
+ *
+ * Clients connect to a local socket (a Unix domain socket, or a
+ * named pipe on Windows) and send requests as lines of JSON:
+ *
+ *   {"type": "submit", "problem": "parity5", "population": 100,
+ *    "generations": 25000, "runs": 50, "seed": 1, "priority": 0}
+ *   {"type": "cancel", "job": 3}
+ *   {"type": "status"}
+ *   {"type": "shutdown"}
+ *
+ * A submitted job is "accepted" with its id, then "progress" is sent
+ * after each of its runs and a "result" when it's done, see
+ * JobScheduler.  A job is cancelled if its client disconnects.
+ *
+ * Each worker keeps the runs of the last few problems it ran, so
+ * their test cases and arenas are reused by the next job rather than
+ * set up again.
+ */
+class DaemonCommand
+{
+public:
+    DaemonCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Serve clients until shut down.  Returns the process exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+    // Default socket name of the daemon
+    static const char* DefaultSocketName;
+
+private:
+    QString _socketName;
+    int _threads;
+};
+
+/*
+ * Serves the daemon's clients, on the main thread.
+ */
+class DaemonServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DaemonServer(JobScheduler& scheduler, QObject *parent = 0);
+    ~DaemonServer();
+
+    /*
+     * Listen on 'name', replacing a socket left by a daemon that
+     * didn't exit cleanly.  The daemon holds a lock file next to the
+     * socket, "<name>.lock" in the temporary directory unless the
+     * name is a path, while it runs.  Returns false and sets
+     * 'outError' if that fails or another daemon holds the lock or
+     * is still listening on the socket.
+     */
+    bool listen(const QString& name, QString* outError = 0);
+
+private slots:
+    void acceptConnection();
+    void readRequests();
+    void dropConnection();
+    void sendEvents();
+
+private:
+    void handleRequest(QLocalSocket* client, const QJsonObject& request);
+    void send(QLocalSocket* client, const QJsonObject& message);
+    void sendError(QLocalSocket* client, const QString& error);
+
+    // Longest request line accepted
+    enum { MaxRequestSize = 64 * 1024 };
+
+    JobScheduler& _scheduler;
+    QLocalServer _server;
+    // Held while listening, see listen()
+    QLockFile* _lockFile;
+    // The client that submitted each job
+    std::map<int, QLocalSocket*> _jobClients;
+};
+
+#endif // DAEMON_H
@@ -0,0 +1,634 @@
+#include "effort.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "problem.h"
+#include "scounters.h"
+#include "slanerun.h"
+#include "sperfcounters.h"
+#include "srun.h"
+#include "strace.h"
+
+/*
+ * Runs the next run of the experiment until none are left.
+ */
+class EffortThread : public QThread
+{
+public:
+    EffortThread(const QString& problemName, int populationSize,
+                 int maxGenerations, int lanes,
+                 const QString& acceptance, uint seed, bool perf,
+                 std::vector<EffortCommand::RunOutcome>& outcomes,
+                 SCounters& counters, int& nextRun, QMutex& mutex)
+      : _problemName(problemName),
+        _populationSize(populationSize),
+        _maxGenerations(maxGenerations),
+        _lanes(lanes),
+        _acceptance(acceptance),
+        _seed(seed),
+        _perf(perf),
+        _outcomes(outcomes),
+        _counters(counters),
+        _nextRun(nextRun),
+        _mutex(mutex)
+    {
+    }
+
+protected:
+    virtual void run();
+
+private:
+    // Make the runs in the lanes of an SLaneRun
+    void runLanes(Problem* problem);
+
+    // Take the next run, returns false when none are left
+    bool takeRun(int& outRun);
+
+    QString _problemName;
+    int _populationSize;
+    int _maxGenerations;
+    int _lanes;
+    QString _acceptance;
+    uint _seed;
+    bool _perf;
+    std::vector<EffortCommand::RunOutcome>& _outcomes;
+    SCounters& _counters;
+    int& _nextRun;
+    QMutex& _mutex;
+};
+
+void EffortThread::run()
+{
+    if (STrace::isEnabled()) {
+        STrace::setThreadName(QString("effort %1").arg(_problemName));
+    }
+
+    // The lanes don't keep the hot path counters, and only use the
+    // greedy rule
+    if (_lanes > 0 && !SCounters::isEnabled() && _acceptance == "greedy") {
+        Problem* problem = Problem::create(_problemName);
+        if (SLaneRun::isSupported(*problem)) {
+            runLanes(problem);
+            return;
+        }
+        delete problem;
+    }
+
+    // Hardware counters are per thread, opened by the thread itself
+    SPerfCounters perfCounters;
+    SRun run;
+    if (_perf) {
+        if (perfCounters.open()) {
+            run.getStats().counters.perfCounters = &perfCounters;
+        } else {
+            QMutexLocker lock(&_mutex);
+            fprintf(stderr, "Can't open the hardware counters, "
+                    "check /proc/sys/kernel/perf_event_paranoid\n");
+        }
+    }
+    run.setPopulationSize(_populationSize);
+    run.setNumMaxGenerations(_maxGenerations);
+    run.setProblem(Problem::create(_problemName));
+    if (_acceptance != "greedy") {
+        run.setAcceptance(SAcceptance::create(_acceptance));
+    }
+
+    int k;
+    while (takeRun(k)) {
+        // The seed is per thread
+        qsrand(_seed + k);
+        run.restart();
+
+        STraceSpan runSpan("run");
+        QElapsedTimer timer;
+        timer.start();
+        SRunResult result;
+        do {
+            result = run.run(1000);
+        } while (result == SRunContinue);
+        runSpan.end();
+
+        EffortCommand::RunOutcome& outcome = _outcomes[k];
+        outcome.hit = (result == SRunHit);
+        outcome.generations = run.getStats().generation;
+        outcome.nsecs = timer.nsecsElapsed();
+
+        QMutexLocker lock(&_mutex);
+        fprintf(stderr, "\r%s: run %d/%d", qPrintable(_problemName),
+                _nextRun, int(_outcomes.size()));
+    }
+
+    // The counters total every run of this thread
+    QMutexLocker lock(&_mutex);
+    _counters.add(run.getStats().counters);
+}
+
+void EffortThread::runLanes(Problem* problem)
+{
+    SLaneRun lanes;
+    lanes.setNumLanes(_lanes);
+    lanes.setPopulationSize(_populationSize);
+    lanes.setNumMaxGenerations(_maxGenerations);
+    lanes.setProblem(problem);
+
+    // Each run's time is its share of the time of the batches of
+    // generations it was in
+    std::vector<qint64> laneNsecs(lanes.getNumLanes(), 0);
+    std::vector<SLaneRun::Outcome> finished;
+    bool runsLeft = true;
+    for (;;) {
+        int k;
+        while (runsLeft && lanes.getNumActiveLanes() < lanes.getNumLanes()) {
+            runsLeft = takeRun(k);
+            if (runsLeft) {
+                // Seeded as a run of SRun with the same number
+                laneNsecs[lanes.startRun(k, _seed + k)] = 0;
+            }
+        }
+        int numActive = lanes.getNumActiveLanes();
+        if (numActive == 0) {
+            break;
+        }
+
+        STraceSpan runSpan("lanes");
+        QElapsedTimer timer;
+        timer.start();
+        lanes.run(100);
+        qint64 nsecs = timer.nsecsElapsed() / numActive;
+        runSpan.end();
+        for (int lane = 0; lane < lanes.getNumLanes(); ++lane) {
+            laneNsecs[lane] += nsecs;
+        }
+
+        lanes.takeOutcomes(finished);
+        if (finished.empty()) {
+            continue;
+        }
+        for (size_t i = 0; i < finished.size(); ++i) {
+            EffortCommand::RunOutcome& outcome = _outcomes[finished[i].id];
+            outcome.hit = finished[i].hit;
+            outcome.generations = finished[i].generations;
+            outcome.nsecs = laneNsecs[finished[i].lane];
+        }
+        QMutexLocker lock(&_mutex);
+        fprintf(stderr, "\r%s: run %d/%d", qPrintable(_problemName),
+                _nextRun, int(_outcomes.size()));
+    }
+}
+
+bool EffortThread::takeRun(int& outRun)
+{
+    STraceSpan waitSpan("effort.lockWait");
+    QMutexLocker lock(&_mutex);
+    waitSpan.end();
+    if (_nextRun >= int(_outcomes.size())) {
+        return false;
+    }
+    outRun = _nextRun++;
+    return true;
+}
+
+void wilsonInterval(int successes, int trials,
+                    double& outLow, double& outHigh)
+{
+    if (trials == 0) {
+        outLow = 0;
+        outHigh = 1;
+        return;
+    }
+    const double z = 1.96;
+    double n = trials;
+    double p = successes / n;
+    double denominator = 1 + z * z / n;
+    double centre = p + z * z / (2 * n);
+    double spread = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n));
+    outLow = std::max(0.0, (centre - spread) / denominator);
+    outHigh = std::min(1.0, (centre + spread) / denominator);
+}
+
+// Number of runs needed to succeed with probability 'z', when each
+// succeeds with probability 'p', 0 if 'p' is 0
+static int runsRequired(double p, double z)
+{
+    if (p <= 0) {
+        return 0;
+    }
+    if (p >= 1) {
+        return 1;
+    }
+    return std::max(1, int(ceil(log(1 - z) / log(1 - p))));
+}
+
+bool computeEffort(const std::vector<EffortCommand::RunOutcome>& outcomes,
+                   int populationSize, double z,
+                   ComputationalEffort& outEffort)
+{
+    std::vector<int> hitGenerations;
+    for (size_t i = 0; i < outcomes.size(); ++i) {
+        if (outcomes[i].hit) {
+            hitGenerations.push_back(outcomes[i].generations);
+        }
+    }
+    if (hitGenerations.empty()) {
+        return false;
+    }
+    std::sort(hitGenerations.begin(), hitGenerations.end());
+
+    // The cumulative probability of success only changes at a hit,
+    // and the effort grows with the generation in between, so only
+    // the generations with a hit need to be checked.  A hit after
+    // g generations was found by generation index i = g - 1.
+    int numRuns = outcomes.size();
+    bool found = false;
+    for (size_t k = 0; k < hitGenerations.size(); ++k) {
+        if (k + 1 < hitGenerations.size() &&
+            hitGenerations[k + 1] == hitGenerations[k]) {
+            continue;
+        }
+        int generation = hitGenerations[k];
+        int successes = k + 1;
+        int r = runsRequired(double(successes) / numRuns, z);
+        double effort = double(populationSize) * generation * r;
+        if (!found || effort < outEffort.effort) {
+            found = true;
+            outEffort.effort = effort;
+            outEffort.generation = generation;
+            outEffort.runsRequired = r;
+
+            double low, high;
+            wilsonInterval(successes, numRuns, low, high);
+            outEffort.effortLow = double(populationSize) * generation *
+                runsRequired(high, z);
+            outEffort.effortHigh = double(populationSize) * generation *
+                runsRequired(low, z);
+        }
+    }
+    return true;
+}
+
+// Value at 'fraction' of the way through the sorted 'values'
+static int percentile(const std::vector<int>& values, double fraction)
+{
+    int i = int(fraction * (values.size() - 1) + 0.5);
+    return values[i];
+}
+
+QJsonObject summariseRuns(const QString& problem, int populationSize,
+                          int maxGenerations, uint seed,
+                          const std::vector<EffortCommand::RunOutcome>& outcomes,
+                          qint64 wallNsecs, double z)
+{
+    std::vector<int> hitGenerations;
+    qint64 runNsecs = 0;
+    QJsonArray runs;
+    for (size_t i = 0; i < outcomes.size(); ++i) {
+        const EffortCommand::RunOutcome& outcome = outcomes[i];
+        runNsecs += outcome.nsecs;
+        if (outcome.hit) {
+            hitGenerations.push_back(outcome.generations);
+        }
+        QJsonObject o;
+        o["hit"] = outcome.hit;
+        o["generations"] = outcome.generations;
+        runs.append(o);
+    }
+    int numRuns = outcomes.size();
+    int hits = hitGenerations.size();
+
+    QJsonObject result;
+    result["problem"] = problem;
+    result["runs"] = numRuns;
+    result["hits"] = hits;
+    result["populationSize"] = populationSize;
+    result["maxGenerations"] = maxGenerations;
+    result["seed"] = int(seed);
+    result["wallSeconds"] = wallNsecs / 1e9;
+    result["runSeconds"] = runNsecs / 1e9;
+
+    double low, high;
+    wilsonInterval(hits, numRuns, low, high);
+    result["successRate"] = numRuns ? double(hits) / numRuns : 0.0;
+    result["successRateLow"] = low;
+    result["successRateHigh"] = high;
+    if (hits) {
+        std::sort(hitGenerations.begin(), hitGenerations.end());
+        result["medianGenerationsToHit"] = percentile(hitGenerations, 0.5);
+        result["secondsPerHit"] = runNsecs / 1e9 / hits;
+    }
+
+    ComputationalEffort effort;
+    if (computeEffort(outcomes, populationSize, z, effort)) {
+        QJsonObject e;
+        e["effort"] = effort.effort;
+        e["effortLow"] = effort.effortLow;
+        e["effortHigh"] = effort.effortHigh;
+        e["generation"] = effort.generation;
+        e["runsRequired"] = effort.runsRequired;
+        e["z"] = z;
+        result["computationalEffort"] = e;
+    }
+    result["outcomes"] = runs;
+    return result;
+}
+
+static void printCounters(const SCounters& counters)
+{
+    int64_t generations = std::max<int64_t>(counters.generations, 1);
+    int64_t mutations = std::max<int64_t>(
+        counters.accepted + counters.rejected, 1);
+    int64_t totalNsecs = 0;
+    for (int i = 0; i < SCounters::NumPhases; ++i) {
+        totalNsecs += counters.phaseNsecs[i];
+    }
+    printf("  nodes evaluated per generation: mean %.1f, accepted %.1f%%, "
+           "%lld restores\n",
+           double(counters.nodesEvaluated) / generations,
+           100.0 * counters.accepted / mutations,
+           (long long)counters.restores);
+    printf("  cone sizes: %s\n",
+           qPrintable(counters.coneSizes.toString()));
+    printf("  generation time: %s\n",
+           qPrintable(counters.generationNsecs.toString(1000, " us")));
+    printf("  case evaluations per second: %.4g, phase time:",
+           totalNsecs ? counters.caseEvaluations * 1e9 / totalNsecs : 0.0);
+    for (int i = 0; i < SCounters::NumPhases; ++i) {
+        printf(" %s %.1f%%", SCounters::getPhaseName(SCounters::Phase(i)),
+               100.0 * counters.phaseNsecs[i] /
+               std::max<int64_t>(totalNsecs, 1));
+    }
+    printf("\n");
+
+    if (!counters.hasPerfCounts()) {
+        return;
+    }
+    double nodeCases = std::max<int64_t>(counters.caseEvaluations, 1);
+    for (int i = 0; i < SCounters::NumPhases; ++i) {
+        const int64_t* events = counters.phaseEvents[i];
+        int64_t cycles = std::max<int64_t>(events[SPerfCounters::Cycles], 1);
+        printf("  %-8s IPC %.2f, per node-case: %.3f cycles, "
+               "%.4f L1D misses, %.4f LLC misses, %.4f branch misses\n",
+               SCounters::getPhaseName(SCounters::Phase(i)),
+               double(events[SPerfCounters::Instructions]) / cycles,
+               events[SPerfCounters::Cycles] / nodeCases,
+               events[SPerfCounters::L1DMisses] / nodeCases,
+               events[SPerfCounters::LLCMisses] / nodeCases,
+               events[SPerfCounters::BranchMisses] / nodeCases);
+    }
+}
+
+EffortCommand::EffortCommand()
+  : _runs(50),
+    _populationSize(100),
+    _maxGenerations(25000),
+    _threads(QThread::idealThreadCount()),
+    _lanes(0),
+    _acceptance("greedy"),
+    _seed(1),
+    _z(0.99),
+    _perf(false),
+    _traceSampleInterval(64)
+{
+}
+
+void EffortCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli effort [options]\n"
+            "  -problem name   problem to run, or 'all' (default)\n"
+            "  -runs n         number of runs of each problem (50)\n"
+            "  -population n   nodes in the population (100)\n"
+            "  -generations n  max generations per run (25000)\n"
+            "  -threads n      number of runs in parallel\n"
+            "  -lanes n        runs each thread makes in lockstep,\n"
+            "                  up to 32, for small problems (0)\n"
+            "  -acceptance name\n"
+            "                  rule for keeping mutations (greedy)\n"
+            "  -seed n         seed of the first run (1)\n"
+            "  -z p            success probability for the\n"
+            "                  computational effort (0.99)\n"
+            "  -o file         write the results as JSON\n"
+            "  -perf 1         read the hardware counters in each\n"
+            "                  phase (needs CONFIG+=counters)\n"
+            "  -trace file     write a Chrome trace of the runs\n"
+            "  -trace-sample n record one in n batches of\n"
+            "                  generations in the trace (64)\n"
+            "Problems: %s, table:file\n"
+            "Benchmarks: %s\n"
+            "Acceptance rules: %s\n",
+            qPrintable(Problem::getProblemNames().join(", ")),
+            qPrintable(Problem::getBenchmarkNames().join(", ")),
+            qPrintable(SAcceptance::getAcceptanceNames().join(", ")));
+}
+
+bool EffortCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-problem") {
+            if (value == "all") {
+                _problems = Problem::getProblemNames();
+            } else {
+                QString error;
+                ok = Problem::isProblemName(value, &error);
+                if (ok) {
+                    _problems.append(value);
+                } else {
+                    fprintf(stderr, "%s\n", qPrintable(error));
+                }
+            }
+        } else if (arg == "-runs") {
+            _runs = value.toInt(&ok);
+            ok = ok && _runs > 0;
+        } else if (arg == "-population") {
+            _populationSize = value.toInt(&ok);
+            ok = ok && _populationSize > 0;
+        } else if (arg == "-generations") {
+            _maxGenerations = value.toInt(&ok);
+            ok = ok && _maxGenerations > 0;
+        } else if (arg == "-threads") {
+            _threads = value.toInt(&ok);
+            ok = ok && _threads > 0;
+        } else if (arg == "-lanes") {
+            _lanes = value.toInt(&ok);
+            ok = ok && _lanes >= 0 && _lanes <= SLaneRun::MaxLanes;
+        } else if (arg == "-acceptance") {
+            _acceptance = value;
+            ok = SAcceptance::getAcceptanceNames().contains(value);
+        } else if (arg == "-seed") {
+            _seed = value.toUInt(&ok);
+        } else if (arg == "-z") {
+            _z = value.toDouble(&ok);
+            ok = ok && _z > 0 && _z < 1;
+        } else if (arg == "-o") {
+            _outputFile = value;
+        } else if (arg == "-trace") {
+            _traceFile = value;
+        } else if (arg == "-trace-sample") {
+            _traceSampleInterval = value.toInt(&ok);
+            ok = ok && _traceSampleInterval > 0;
+        } else if (arg == "-perf") {
+            _perf = value.toInt(&ok) != 0;
+            if (_perf && !SCounters::isEnabled()) {
+                fprintf(stderr, "-perf needs a build with CONFIG+=counters\n");
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    if (_problems.isEmpty()) {
+        _problems = Problem::getProblemNames();
+    }
+    return true;
+}
+
+QJsonObject EffortCommand::runProblem(const QString& problemName)
+{
+    std::vector<RunOutcome> outcomes(_runs);
+    SCounters counters;
+    int nextRun = 0;
+    QMutex mutex;
+
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+    int numThreads = std::min(_threads, _runs);
+    std::vector<EffortThread*> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.push_back(new EffortThread(problemName, _populationSize,
+                                           _maxGenerations, _lanes,
+                                           _acceptance, _seed,
+                                           _perf,
+                                           outcomes, counters, nextRun,
+                                           mutex));
+        threads.back()->start();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    qint64 wallNsecs = wallTimer.nsecsElapsed();
+    fprintf(stderr, "\n");
+
+    QJsonObject result = summariseRuns(problemName, _populationSize,
+                                       _maxGenerations, _seed, outcomes,
+                                       wallNsecs, _z);
+    int hits = result["hits"].toInt();
+    double runSeconds = result["runSeconds"].toDouble();
+    printf("%s: %d runs, %d hits, success rate %.1f%% "
+           "(95%% CI %.1f%% - %.1f%%)\n",
+           qPrintable(problemName), _runs, hits,
+           100 * result["successRate"].toDouble(),
+           100 * result["successRateLow"].toDouble(),
+           100 * result["successRateHigh"].toDouble());
+
+    if (hits) {
+        std::vector<int> hitGenerations;
+        for (int i = 0; i < _runs; ++i) {
+            if (outcomes[i].hit) {
+                hitGenerations.push_back(outcomes[i].generations);
+            }
+        }
+        std::sort(hitGenerations.begin(), hitGenerations.end());
+        double mean = 0;
+        for (int i = 0; i < hits; ++i) {
+            mean += hitGenerations[i];
+        }
+        mean /= hits;
+        QJsonObject generations;
+        generations["min"] = hitGenerations.front();
+        generations["p25"] = percentile(hitGenerations, 0.25);
+        generations["median"] = percentile(hitGenerations, 0.5);
+        generations["p75"] = percentile(hitGenerations, 0.75);
+        generations["p90"] = percentile(hitGenerations, 0.9);
+        generations["max"] = hitGenerations.back();
+        generations["mean"] = mean;
+        result["generationsToHit"] = generations;
+        printf("  generations to hit: min %d, median %d, mean %.0f, "
+               "p90 %d, max %d\n",
+               hitGenerations.front(), percentile(hitGenerations, 0.5),
+               mean, percentile(hitGenerations, 0.9),
+               hitGenerations.back());
+
+        // The time of every run counts, not just the successful ones
+        result["wallSecondsPerHit"] = wallNsecs / 1e9 / hits;
+        printf("  time per hit: %.4f s (wall %.4f s with %d threads)\n",
+               result["secondsPerHit"].toDouble(), wallNsecs / 1e9 / hits,
+               numThreads);
+    } else {
+        printf("  no hits in %.2f s\n", runSeconds);
+    }
+
+    if (result.contains("computationalEffort")) {
+        QJsonObject e = result["computationalEffort"].toObject();
+        printf("  computational effort: %.0f (generation %d, R %d), "
+               "95%% CI %.0f - ", e["effort"].toDouble(),
+               e["generation"].toInt(), e["runsRequired"].toInt(),
+               e["effortLow"].toDouble());
+        if (e["effortHigh"].toDouble() > 0) {
+            printf("%.0f\n", e["effortHigh"].toDouble());
+        } else {
+            printf("unbounded\n");
+        }
+    }
+    if (SCounters::isEnabled()) {
+        result["counters"] = counters.toJson();
+        printCounters(counters);
+    }
+    fflush(stdout);
+    return result;
+}
+
+int EffortCommand::exec()
+{
+    if (!_traceFile.isEmpty()) {
+        STrace::setSampleInterval(_traceSampleInterval);
+        STrace::setEnabled(true);
+    }
+
+    QJsonArray results;
+    for (int i = 0; i < _problems.size(); ++i) {
+        results.append(runProblem(_problems.at(i)));
+    }
+
+    if (!_traceFile.isEmpty()) {
+        STrace::setEnabled(false);
+        if (!STrace::write(_traceFile)) {
+            fprintf(stderr, "Can't write %s\n", qPrintable(_traceFile));
+            return 1;
+        }
+    }
+
+    if (!_outputFile.isEmpty()) {
+        QFile file(_outputFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fprintf(stderr, "Can't open %s\n", qPrintable(_outputFile));
+            return 1;
+        }
+        QJsonObject output;
+        output["results"] = results;
+        file.write(QJsonDocument(output).toJson());
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#ifndef EFFORT_H
+#define EFFORT_H
+
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+
+#include <vector>
+
+/*
+ * Time-to-solution experiment.
+ *
+ * Runs a problem a number of times, in parallel, with a fixed seed for
+ * each run and reports the success rate, the distribution of
+ * generations to a hit, the time per hit and Koza's computational
+ * effort, with 95% confidence intervals.
+ *
+ * Run k is seeded with (seed + k), so an experiment gives the same
+ * results however many threads are used.
+ */
+class EffortCommand
+{
+public:
+    EffortCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Run the experiment for each problem and print the report.
+     * Returns the process exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+    // Outcome of one run
+    struct RunOutcome {
+        bool hit;
+        // Generations taken, including the initial generation
+        int generations;
+        qint64 nsecs;
+    };
+
+private:
+    QJsonObject runProblem(const QString& problemName);
+
+    QStringList _problems;
+    int _runs;
+    int _populationSize;
+    int _maxGenerations;
+    int _threads;
+    // Runs each thread makes in lockstep, 0 for one at a time, see
+    // SLaneRun
+    int _lanes;
+    // Rule for keeping mutations, see SAcceptance
+    QString _acceptance;
+    uint _seed;
+    // Probability of success used for the computational effort
+    double _z;
+    QString _outputFile;
+    // Read the hardware counters, see SPerfCounters
+    bool _perf;
+    // Chrome trace output, see STrace
+    QString _traceFile;
+    int _traceSampleInterval;
+};
+
+/*
+ * Koza's computational effort, the minimum over i of
+ * M * (i + 1) * R(z), where R(z) is the number of independent runs
+ * needed to find a solution by generation i with probability 'z'.
+ * Returns false if there were no hits.
+ */
+struct ComputationalEffort {
+    double effort;
+    // Bounds from the 95% confidence interval of the success
+    // probability at 'generation', the upper bound is zero when
+    // it is unbounded
+    double effortLow;
+    double effortHigh;
+    int generation;
+    int runsRequired;
+};
+
+bool computeEffort(const std::vector<EffortCommand::RunOutcome>& outcomes,
+                   int populationSize, double z,
+                   ComputationalEffort& outEffort);
+
+/*
+ * Summarise the outcomes of the runs of a problem, run k seeded with
+ * (seed + k): the success rate with its 95% confidence interval, the
+ * median generations and time to a hit, the computational effort
+ * and each run's outcome.  For reporting runs made outside
+ * EffortCommand, see JobScheduler and CoordinatorCommand.
+ */
+QJsonObject summariseRuns(const QString& problem, int populationSize,
+                          int maxGenerations, uint seed,
+                          const std::vector<EffortCommand::RunOutcome>& outcomes,
+                          qint64 wallNsecs, double z = 0.99);
+
+/*
+ * Wilson score interval for 'successes' out of 'trials', at 95%
+ * confidence.
+ */
+void wilsonInterval(int successes, int trials,
+                    double& outLow, double& outHigh);
+
+#endif // EFFORT_H
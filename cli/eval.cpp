@@ -0,0 +1,295 @@
+#include "eval.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "problem.h"
+#include "sprogram.h"
+#include "sprogramjit.h"
+#include "sprogramvm.h"
+
+/*
+ * Evaluates a range of the rows, with the native code or bytecode if
+ * the program was compiled to either.
+ */
+class EvalThread : public QThread
+{
+public:
+    EvalThread(const Problem& problem, const SProgram& program,
+               const SProgramJit& jit, const SProgramVM& vm,
+               const int* inputs, int numRows, int* outResults)
+      : _problem(problem),
+        _program(program),
+        _jit(jit),
+        _vm(vm),
+        _inputs(inputs),
+        _numRows(numRows),
+        _outResults(outResults)
+    {
+    }
+
+protected:
+    virtual void run() {
+        if (_jit.isCompiled()) {
+            _jit.evaluate(_inputs, _numRows, _outResults);
+        } else if (_vm.isCompiled()) {
+            _vm.evaluate(_inputs, _numRows, _outResults);
+        } else {
+            _problem.evaluateProgram(_program, _inputs, _numRows,
+                                     _outResults);
+        }
+    }
+
+private:
+    const Problem& _problem;
+    const SProgram& _program;
+    const SProgramJit& _jit;
+    const SProgramVM& _vm;
+    const int* _inputs;
+    int _numRows;
+    int* _outResults;
+};
+
+EvalCommand::EvalCommand()
+  : _binary(false),
+    _jit(true),
+    _vm(true),
+    _threads(QThread::idealThreadCount())
+{
+}
+
+void EvalCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli eval [options]\n"
+            "  -program file    program exported from a run\n"
+            "  -input file      rows of inputs\n"
+            "  -o file          write the results to file (stdout)\n"
+            "  -binary 0|1      rows and results are native int32\n"
+            "                   values rather than text (0)\n"
+            "  -jit 0|1         compile the program to native code,\n"
+            "                   where supported (1)\n"
+            "  -vm 0|1          otherwise compile it to bytecode (1)\n"
+            "  -threads n       number of threads\n");
+}
+
+bool EvalCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-program") {
+            _programFile = value;
+        } else if (arg == "-input") {
+            _inputFile = value;
+        } else if (arg == "-o") {
+            _outputFile = value;
+        } else if (arg == "-binary") {
+            _binary = value.toInt(&ok) != 0;
+        } else if (arg == "-jit") {
+            _jit = value.toInt(&ok) != 0;
+        } else if (arg == "-vm") {
+            _vm = value.toInt(&ok) != 0;
+        } else if (arg == "-threads") {
+            _threads = value.toInt(&ok);
+            ok = ok && _threads > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    if (_programFile.isEmpty() || _inputFile.isEmpty()) {
+        printUsage();
+        return false;
+    }
+    return true;
+}
+
+bool EvalCommand::parseRows(const char* text, size_t size, int numInputs,
+                            std::vector<int>& outInputs, QString* outError)
+{
+    const char* p = text;
+    const char* end = text + size;
+    int line = 0;
+    while (p < end) {
+        const char* eol = std::find(p, end, '\n');
+        line++;
+        int values = 0;
+        while (p < eol) {
+            if (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r') {
+                p++;
+                continue;
+            }
+            if (*p == '#' && values == 0) {
+                p = eol;
+                break;
+            }
+            // strtol() stops at the newline at the latest
+            char* next = 0;
+            long value = strtol(p, &next, 10);
+            if (next == p || next > eol) {
+                if (outError) {
+                    *outError = QString("Bad value on line %1").arg(line);
+                }
+                return false;
+            }
+            outInputs.push_back(int(value));
+            values++;
+            p = next;
+        }
+        if (values != 0 && values != numInputs) {
+            if (outError) {
+                *outError = QString("Line %1 has %2 values, expected %3").
+                    arg(line).arg(values).arg(numInputs);
+            }
+            return false;
+        }
+        p = eol + 1;
+    }
+    return true;
+}
+
+int EvalCommand::exec()
+{
+    QFile programFile(_programFile);
+    if (!programFile.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Can't open %s\n", qPrintable(_programFile));
+        return 1;
+    }
+    SProgram program;
+    QString error;
+    if (!program.load(programFile.readAll(), &error)) {
+        fprintf(stderr, "Can't load %s: %s\n", qPrintable(_programFile),
+                qPrintable(error));
+        return 1;
+    }
+    Problem* problem = Problem::create(program.getProblemName());
+    if (!problem || problem->getNumInputs() != program.getNumInputs()) {
+        fprintf(stderr, "Unknown problem %s\n",
+                qPrintable(program.getProblemName()));
+        delete problem;
+        return 1;
+    }
+    int numInputs = program.getNumInputs();
+
+    // Binary rows are evaluated straight from the mapped file
+    QFile inputFile(_inputFile);
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Can't open %s\n", qPrintable(_inputFile));
+        delete problem;
+        return 1;
+    }
+    std::vector<int> parsedInputs;
+    const int* inputs = 0;
+    qint64 numRows = 0;
+    if (_binary) {
+        qint64 size = inputFile.size();
+        qint64 rowSize = qint64(sizeof(int32_t)) * std::max(numInputs, 1);
+        const uchar* data = size ? inputFile.map(0, size) : 0;
+        if (size % rowSize || (size && !data)) {
+            fprintf(stderr, "%s isn't a whole number of rows of %d inputs\n",
+                    qPrintable(_inputFile), numInputs);
+            delete problem;
+            return 1;
+        }
+        inputs = reinterpret_cast<const int*>(data);
+        numRows = size / rowSize;
+    } else {
+        // Read rather than mapped, strtol() needs the terminating NUL
+        QByteArray text = inputFile.readAll();
+        if (!parseRows(text.constData(), text.size(), numInputs,
+                       parsedInputs, &error)) {
+            fprintf(stderr, "Can't read %s: %s\n", qPrintable(_inputFile),
+                    qPrintable(error));
+            delete problem;
+            return 1;
+        }
+        inputs = parsedInputs.data();
+        numRows = numInputs ? parsedInputs.size() / numInputs : 0;
+    }
+    if (numRows > 0x7fffffff) {
+        fprintf(stderr, "Too many rows in %s\n", qPrintable(_inputFile));
+        delete problem;
+        return 1;
+    }
+
+    // Falls back to bytecode, then to the interpreter, if it can't
+    // be compiled
+    SProgramJit jit;
+    SProgramVM vm;
+    if (_jit && !jit.compile(program, *problem, &error)) {
+        fprintf(stderr, "No native code: %s\n", qPrintable(error));
+    }
+    if (!jit.isCompiled() && _vm && !vm.compile(program, *problem, &error)) {
+        fprintf(stderr, "No bytecode: %s\n", qPrintable(error));
+    }
+
+    // Split the rows evenly between the threads
+    std::vector<int> results(numRows);
+    QElapsedTimer timer;
+    timer.start();
+    int numThreads = int(std::max<qint64>(1, std::min<qint64>(
+        _threads, numRows / 4096)));
+    std::vector<EvalThread*> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        int begin = int(numRows * i / numThreads);
+        int end = int(numRows * (i + 1) / numThreads);
+        threads.push_back(new EvalThread(*problem, program, jit, vm,
+                                         inputs + qint64(begin) * numInputs,
+                                         end - begin, results.data() + begin));
+        threads.back()->start();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    double seconds = timer.nsecsElapsed() / 1e9;
+    fprintf(stderr, "Evaluated %lld rows in %.3f s (%.3g rows/s, %s)\n",
+            (long long)numRows, seconds, seconds > 0 ? numRows / seconds : 0,
+            jit.isCompiled() ? "native" :
+            vm.isCompiled() ? "bytecode" : "interpreted");
+    delete problem;
+
+    FILE* out = stdout;
+    if (!_outputFile.isEmpty()) {
+        out = fopen(qPrintable(_outputFile), _binary ? "wb" : "w");
+        if (!out) {
+            fprintf(stderr, "Can't write %s\n", qPrintable(_outputFile));
+            return 1;
+        }
+    }
+    bool ok = true;
+    if (_binary) {
+        ok = fwrite(results.data(), sizeof(int32_t), numRows, out) ==
+             size_t(numRows);
+    } else {
+        for (qint64 i = 0; i < numRows && ok; ++i) {
+            ok = fprintf(out, "%d\n", results[i]) > 0;
+        }
+    }
+    if (out != stdout) {
+        ok = fclose(out) == 0 && ok;
+    } else {
+        ok = fflush(out) == 0 && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Can't write the results\n");
+        return 1;
+    }
+    return 0;
+}
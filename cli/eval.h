@@ -0,0 +1,61 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+/*
+ * Batch inference, evaluates a program exported from a run (see
+ * SProgram) over a file of input rows and writes one result per
+ * row.
+ *
+ * Rows are text, the inputs of a row separated by spaces or commas,
+ * or raw native int32 values with -binary 1.  The program is
+ * compiled to native code where supported (see SProgramJit), else to
+ * bytecode (see SProgramVM), else interpreted (see
+ * Problem::evaluateProgram()), with the rows split between threads.
+ */
+class EvalCommand
+{
+public:
+    EvalCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Evaluate the program and write the results.  Returns the
+     * process exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+    /*
+     * Parse text rows of 'numInputs' values into 'outInputs'.
+     * Blank lines and lines starting with '#' are skipped.  Returns
+     * false and sets 'outError' if a row doesn't have 'numInputs'
+     * values.
+     */
+    static bool parseRows(const char* text, size_t size, int numInputs,
+                          std::vector<int>& outInputs, QString* outError);
+
+private:
+    QString _programFile;
+    QString _inputFile;
+    QString _outputFile;
+    bool _binary;
+    // Compile the program, see SProgramJit
+    bool _jit;
+    // Compile the program to bytecode if not native code, see
+    // SProgramVM
+    bool _vm;
+    int _threads;
+};
+
+#endif // EVAL_H
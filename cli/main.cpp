@@ -0,0 +1,115 @@
+#include <QCoreApplication>
+#include <QStringList>
+
+#include <stdio.h>
+
+#include "coordinator.h"
+#include "daemon.h"
+#include "effort.h"
+#include "eval.h"
+#include "race.h"
+#include "run.h"
+#include "selfcheck.h"
+#include "submit.h"
+#include "worker.h"
+
+/*
+ * Command line tools for running the GP engine without the UI.
+ *
+ * Usage: sngpcli command [options]
+ */
+
+static void printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli command [options]\n"
+            "Commands:\n"
+            "  effort   time to solution and computational effort of\n"
+            "           the sample problems\n"
+            "  run      a single run, with checkpoints to resume it\n"
+            "  race     runs raced against each other, stopping the\n"
+            "           ones that fall behind\n"
+            "  eval     evaluate a program exported from a run over\n"
+            "           rows of inputs\n"
+            "  daemon   run jobs submitted by local clients on a\n"
+            "           shared pool of threads\n"
+            "  submit   submit a job to the daemon and wait for its\n"
+            "           result\n"
+            "  coordinator\n"
+            "           hand out runs or islands to worker processes\n"
+            "  worker   run the work of a coordinator\n"
+            "  selfcheck\n"
+            "           check the compiled programs, checkpoints and\n"
+            "           truth table parser against the engine\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    QString command = args.at(1);
+    QStringList commandArgs = args.mid(2);
+    if (command == "effort") {
+        EffortCommand effort;
+        if (!effort.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return effort.exec();
+    } else if (command == "run") {
+        RunCommand run;
+        if (!run.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return run.exec();
+    } else if (command == "race") {
+        RaceCommand race;
+        if (!race.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return race.exec();
+    } else if (command == "eval") {
+        EvalCommand eval;
+        if (!eval.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return eval.exec();
+    } else if (command == "daemon") {
+        DaemonCommand daemon;
+        if (!daemon.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return daemon.exec();
+    } else if (command == "submit") {
+        SubmitCommand submit;
+        if (!submit.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return submit.exec();
+    } else if (command == "coordinator") {
+        CoordinatorCommand coordinator;
+        if (!coordinator.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return coordinator.exec();
+    } else if (command == "worker") {
+        WorkerCommand worker;
+        if (!worker.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return worker.exec();
+    } else if (command == "selfcheck") {
+        SelfCheckCommand selfCheck;
+        if (!selfCheck.parseArgs(commandArgs)) {
+            return 1;
+        }
+        return selfCheck.exec();
+    }
+
+    printUsage();
+    return 1;
+}
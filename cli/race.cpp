@@ -0,0 +1,297 @@
+#include "race.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "effort.h"
+#include "problem.h"
+#include "srun.h"
+#include "strace.h"
+
+/*
+ * Makes the next run of the race until none are left.
+ */
+class RaceThread : public QThread
+{
+public:
+    RaceThread(const QString& problemName, int populationSize,
+               int maxGenerations, uint seed, SRace& race,
+               std::vector<RaceCommand::RunOutcome>& outcomes,
+               int& nextRun, QMutex& mutex)
+      : _problemName(problemName),
+        _populationSize(populationSize),
+        _maxGenerations(maxGenerations),
+        _seed(seed),
+        _race(race),
+        _outcomes(outcomes),
+        _nextRun(nextRun),
+        _mutex(mutex)
+    {
+    }
+
+protected:
+    virtual void run();
+
+private:
+    QString _problemName;
+    int _populationSize;
+    int _maxGenerations;
+    uint _seed;
+    SRace& _race;
+    std::vector<RaceCommand::RunOutcome>& _outcomes;
+    int& _nextRun;
+    QMutex& _mutex;
+};
+
+void RaceThread::run()
+{
+    SRun run;
+    run.setPopulationSize(_populationSize);
+    run.setNumMaxGenerations(_maxGenerations);
+    run.setProblem(Problem::create(_problemName));
+
+    for (;;) {
+        int k;
+        {
+            QMutexLocker lock(&_mutex);
+            k = _nextRun;
+            if (k >= int(_outcomes.size())) {
+                break;
+            }
+            _nextRun++;
+        }
+
+        // The seed is per run
+        qsrand(_seed + k);
+        run.restart();
+
+        STraceSpan runSpan("run");
+        QElapsedTimer timer;
+        timer.start();
+        SRace::Progress progress;
+        _race.startRun(progress);
+        SRunResult result;
+        bool stopped = false;
+        do {
+            result = run.run(_race.getGenerationsToCheck(
+                progress, run.getStats(), 1000));
+            stopped = result == SRunContinue &&
+                !_race.check(progress, run.getStats());
+        } while (result == SRunContinue && !stopped);
+        runSpan.end();
+
+        RaceCommand::RunOutcome& outcome = _outcomes[k];
+        outcome.hit = result == SRunHit;
+        outcome.stopped = stopped;
+        outcome.generations = run.getStats().generation;
+        outcome.nsecs = timer.nsecsElapsed();
+
+        QMutexLocker lock(&_mutex);
+        fprintf(stderr, "\r%s: run %d/%d", qPrintable(_problemName),
+                _nextRun, int(_outcomes.size()));
+    }
+}
+
+RaceCommand::RaceCommand()
+  : _problem("parity5"),
+    _runs(200),
+    _populationSize(100),
+    _maxGenerations(25000),
+    _threads(QThread::idealThreadCount()),
+    _seed(1),
+    _firstRung(1000),
+    _eta(3),
+    _patience(0)
+{
+}
+
+void RaceCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli race [options]\n"
+            "  -problem name   problem to run (parity5)\n"
+            "  -runs n         number of runs to start (200)\n"
+            "  -population n   nodes in the population (100)\n"
+            "  -generations n  max generations per run (25000)\n"
+            "  -threads n      number of runs in parallel\n"
+            "  -seed n         seed of the first run (1)\n"
+            "  -rung n         generation of the first rung (1000)\n"
+            "  -eta n          keep the top 1/n of the runs at each\n"
+            "                  rung, the next rung is n times later,\n"
+            "                  0 for no rungs (3)\n"
+            "  -patience n     stop a run when its best individual\n"
+            "                  hasn't improved for n generations,\n"
+            "                  0 for never (0)\n"
+            "  -o file         write the results as JSON\n"
+            "Problems: %s, table:file\n"
+            "Benchmarks: %s\n",
+            qPrintable(Problem::getProblemNames().join(", ")),
+            qPrintable(Problem::getBenchmarkNames().join(", ")));
+}
+
+bool RaceCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-problem") {
+            _problem = value;
+            QString error;
+            ok = Problem::isProblemName(value, &error);
+            if (!ok) {
+                fprintf(stderr, "%s\n", qPrintable(error));
+            }
+        } else if (arg == "-runs") {
+            _runs = value.toInt(&ok);
+            ok = ok && _runs > 0;
+        } else if (arg == "-population") {
+            _populationSize = value.toInt(&ok);
+            ok = ok && _populationSize > 0;
+        } else if (arg == "-generations") {
+            _maxGenerations = value.toInt(&ok);
+            ok = ok && _maxGenerations > 0;
+        } else if (arg == "-threads") {
+            _threads = value.toInt(&ok);
+            ok = ok && _threads > 0;
+        } else if (arg == "-seed") {
+            _seed = value.toUInt(&ok);
+        } else if (arg == "-rung") {
+            _firstRung = value.toInt(&ok);
+            ok = ok && _firstRung > 0;
+        } else if (arg == "-eta") {
+            _eta = value.toInt(&ok);
+            ok = ok && (_eta == 0 || _eta >= 2);
+        } else if (arg == "-patience") {
+            _patience = value.toInt(&ok);
+            ok = ok && _patience >= 0;
+        } else if (arg == "-o") {
+            _outputFile = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int RaceCommand::exec()
+{
+    SRace race;
+    race.setRungs(_firstRung, _eta);
+    race.setPatience(_patience);
+
+    std::vector<RunOutcome> outcomes(_runs);
+    int nextRun = 0;
+    QMutex mutex;
+
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+    int numThreads = std::min(_threads, _runs);
+    std::vector<RaceThread*> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.push_back(new RaceThread(_problem, _populationSize,
+                                         _maxGenerations, _seed, race,
+                                         outcomes, nextRun, mutex));
+        threads.back()->start();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    qint64 wallNsecs = wallTimer.nsecsElapsed();
+    fprintf(stderr, "\n");
+
+    int hits = 0;
+    int stopped = 0;
+    int64_t generations = 0;
+    qint64 runNsecs = 0;
+    QJsonArray runs;
+    for (int i = 0; i < _runs; ++i) {
+        const RunOutcome& outcome = outcomes[i];
+        hits += outcome.hit;
+        stopped += outcome.stopped;
+        generations += outcome.generations;
+        runNsecs += outcome.nsecs;
+        QJsonObject o;
+        o["hit"] = outcome.hit;
+        o["stopped"] = outcome.stopped;
+        o["generations"] = outcome.generations;
+        runs.append(o);
+    }
+    double cpuHours = runNsecs / 1e9 / 3600;
+
+    QJsonObject result;
+    result["problem"] = _problem;
+    result["runs"] = _runs;
+    result["hits"] = hits;
+    result["stopped"] = stopped;
+    result["populationSize"] = _populationSize;
+    result["maxGenerations"] = _maxGenerations;
+    result["seed"] = int(_seed);
+    result["firstRung"] = _firstRung;
+    result["eta"] = _eta;
+    result["patience"] = _patience;
+    result["generations"] = double(generations);
+    result["wallSeconds"] = wallNsecs / 1e9;
+    result["runSeconds"] = runNsecs / 1e9;
+    result["hitsPerCpuHour"] = cpuHours > 0 ? hits / cpuHours : 0.0;
+
+    double low, high;
+    wilsonInterval(hits, _runs, low, high);
+    printf("%s: %d runs, %d hits (95%% CI %.1f%% - %.1f%%), "
+           "%d stopped early\n",
+           qPrintable(_problem), _runs, hits, 100 * low, 100 * high,
+           stopped);
+    printf("  %.4g generations in %.2f s of run time, "
+           "%.1f hits per CPU hour\n",
+           double(generations), runNsecs / 1e9,
+           cpuHours > 0 ? hits / cpuHours : 0.0);
+
+    std::vector<int> rungCounts = race.getRungCounts();
+    if (!rungCounts.empty()) {
+        QJsonArray rungs;
+        printf("  runs reaching each rung:");
+        int64_t rungGeneration = _firstRung;
+        for (size_t i = 0; i < rungCounts.size(); ++i) {
+            QJsonObject rung;
+            rung["generation"] = double(rungGeneration);
+            rung["runs"] = rungCounts[i];
+            rungs.append(rung);
+            printf(" %lld: %d", (long long)rungGeneration, rungCounts[i]);
+            rungGeneration *= _eta;
+        }
+        printf("\n");
+        result["rungs"] = rungs;
+    }
+    result["outcomes"] = runs;
+
+    if (!_outputFile.isEmpty()) {
+        QFile file(_outputFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fprintf(stderr, "Can't open %s\n", qPrintable(_outputFile));
+            return 1;
+        }
+        file.write(QJsonDocument(result).toJson());
+    }
+    return 0;
+}
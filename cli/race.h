@@ -0,0 +1,59 @@
+#ifndef RACE_H
+#define RACE_H
+
+#include <QString>
+#include <QStringList>
+
+#include "srace.h"
+
+/*
+ * Runs of a problem raced against each other: runs that fall behind
+ * at a rung, or stop improving, are stopped and a new run started
+ * in their place, see SRace.  Reports the hits per CPU hour, to
+ * compare with the same runs made to the end (-eta 0).
+ *
+ * Run k is seeded with (seed + k), as by EffortCommand, so the runs
+ * that aren't stopped are the same as its runs.
+ */
+class RaceCommand
+{
+public:
+    RaceCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Make the runs and print the report.  Returns the process exit
+     * code.
+     */
+    int exec();
+
+    static void printUsage();
+
+    // Outcome of one run
+    struct RunOutcome {
+        bool hit;
+        // Stopped by the race
+        bool stopped;
+        int generations;
+        qint64 nsecs;
+    };
+
+private:
+    QString _problem;
+    int _runs;
+    int _populationSize;
+    int _maxGenerations;
+    int _threads;
+    uint _seed;
+    int _firstRung;
+    int _eta;
+    int _patience;
+    QString _outputFile;
+};
+
+#endif // RACE_H
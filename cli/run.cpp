@@ -0,0 +1,221 @@
+#include "run.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <stdio.h>
+
+#include "problem.h"
+#include "scheckpoint.h"
+#include "sprogramlibrary.h"
+#include "sprogramvm.h"
+#include "srun.h"
+
+RunCommand::RunCommand()
+  : _problem("parity7"),
+    _populationSize(100),
+    _maxGenerations(25000),
+    _deadline(0),
+    _acceptance("greedy"),
+    _seed(1),
+    _checkpointInterval(60),
+    _resume(true)
+{
+}
+
+void RunCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli run [options]\n"
+            "  -problem name    problem to run (parity7)\n"
+            "  -population n    nodes in the population (100)\n"
+            "  -generations n   max generations (25000)\n"
+            "  -deadline ms     stop the run after ms milliseconds\n"
+            "                   and keep its best individual so far\n"
+            "  -acceptance name rule for keeping mutations (greedy)\n"
+            "  -seed n          random number seed (1)\n"
+            "  -checkpoint file save a checkpoint of the run to file\n"
+            "  -interval s      seconds between checkpoints (60)\n"
+            "  -resume 0|1      resume from the checkpoint if it\n"
+            "                   exists (1)\n"
+            "  -program file    export the program of the best\n"
+            "                   individual to file\n"
+            "  -library dir     warm start from the programs found\n"
+            "                   by earlier runs of the problem, and\n"
+            "                   add the program of a hit\n"
+            "Problems: %s, table:file\n"
+            "Benchmarks: %s\n"
+            "Acceptance rules: %s\n",
+            qPrintable(Problem::getProblemNames().join(", ")),
+            qPrintable(Problem::getBenchmarkNames().join(", ")),
+            qPrintable(SAcceptance::getAcceptanceNames().join(", ")));
+}
+
+bool RunCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-problem") {
+            _problem = value;
+            QString error;
+            ok = Problem::isProblemName(value, &error);
+            if (!ok) {
+                fprintf(stderr, "%s\n", qPrintable(error));
+            }
+        } else if (arg == "-population") {
+            _populationSize = value.toInt(&ok);
+            ok = ok && _populationSize > 0;
+        } else if (arg == "-generations") {
+            _maxGenerations = value.toInt(&ok);
+            ok = ok && _maxGenerations > 0;
+        } else if (arg == "-deadline") {
+            _deadline = value.toInt(&ok);
+            ok = ok && _deadline >= 0;
+        } else if (arg == "-acceptance") {
+            _acceptance = value;
+            ok = SAcceptance::getAcceptanceNames().contains(value);
+        } else if (arg == "-seed") {
+            _seed = value.toUInt(&ok);
+        } else if (arg == "-checkpoint") {
+            _checkpointFile = value;
+        } else if (arg == "-interval") {
+            _checkpointInterval = value.toInt(&ok);
+            ok = ok && _checkpointInterval >= 0;
+        } else if (arg == "-resume") {
+            _resume = value.toInt(&ok) != 0;
+        } else if (arg == "-program") {
+            _programFile = value;
+        } else if (arg == "-library") {
+            _libraryPath = value;
+            ok = !value.isEmpty();
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int RunCommand::exec()
+{
+    SRun run;
+    run.setPopulationSize(_populationSize);
+    run.setNumMaxGenerations(_maxGenerations);
+    run.setProblem(Problem::create(_problem));
+    if (_acceptance != "greedy") {
+        run.setAcceptance(SAcceptance::create(_acceptance));
+    }
+    qsrand(_seed);
+
+    SProgramLibrary library;
+    library.setPath(_libraryPath);
+    if (!_libraryPath.isEmpty()) {
+        std::vector<SProgram> programs;
+        library.load(_problem, programs);
+        run.setWarmStart(programs);
+        fprintf(stderr, "Warm start from %d programs\n", int(programs.size()));
+    }
+
+    bool checkpoints = !_checkpointFile.isEmpty();
+    if (checkpoints && _resume && QFile::exists(_checkpointFile)) {
+        QString error;
+        if (!run.loadCheckpoint(_checkpointFile, &error)) {
+            fprintf(stderr, "Can't resume from %s: %s\n",
+                    qPrintable(_checkpointFile), qPrintable(error));
+            return 1;
+        }
+        fprintf(stderr, "Resumed %s at generation %d\n",
+                qPrintable(run.getProblem()->getName()),
+                run.getStats().generation);
+    }
+
+    SCheckpointFileWriter writer;
+    QElapsedTimer timer;
+    timer.start();
+    run.setDeadline(qint64(_deadline) * 1000000);
+    qint64 lastCheckpoint = 0;
+    qint64 lastProgress = 0;
+    SRunResult result = SRunContinue;
+    const SNodeStats& stats = run.getStats();
+    if (run.isFinished()) {
+        result = stats.hits ? SRunHit : SRunMaxGenerations;
+    }
+    while (result == SRunContinue) {
+        result = run.run(1000);
+
+        qint64 elapsed = timer.elapsed();
+        if (checkpoints && result == SRunContinue &&
+            elapsed - lastCheckpoint >= _checkpointInterval * 1000) {
+            writer.post(_checkpointFile, run.saveCheckpoint());
+            lastCheckpoint = elapsed;
+        }
+        if (elapsed - lastProgress >= 1000) {
+            fprintf(stderr, "\rgeneration %d, best %lld", stats.generation,
+                    (long long)stats.bestIndividualScoreEver);
+            lastProgress = elapsed;
+        }
+    }
+    fprintf(stderr, "\n");
+
+    // The finished run is saved too, so resuming it reports the
+    // result rather than running again
+    if (checkpoints) {
+        writer.post(_checkpointFile, run.saveCheckpoint());
+        if (!writer.flush()) {
+            fprintf(stderr, "Can't write %s\n", qPrintable(_checkpointFile));
+            return 1;
+        }
+    }
+
+    // The best individual of the run may have been lost from the
+    // population since it was found
+    const SProgram& program = run.getBestProgram();
+    if (!_programFile.isEmpty() && !program.isEmpty()) {
+        // Check the program still hits on its own, evaluated over
+        // the test cases apart from the population's results
+        Problem* problem = run.getProblem();
+        SProgramVM vm;
+        if (result == SRunHit && vm.compile(program, *problem)) {
+            std::vector<int> values(problem->getNumFitnessCases());
+            vm.evaluate(problem->getInputs(0), values.size(), values.data());
+            bool hit = false;
+            problem->getResultsFitness(values, &hit);
+            if (!hit) {
+                fprintf(stderr, "The exported program doesn't hit\n");
+            }
+        }
+        if (!SCheckpointFileWriter::writeFile(_programFile, program.save())) {
+            fprintf(stderr, "Can't write %s\n", qPrintable(_programFile));
+            return 1;
+        }
+    }
+
+    if (!_libraryPath.isEmpty() && result == SRunHit) {
+        QString error;
+        if (!library.add(program, &error)) {
+            fprintf(stderr, "Can't add the program to the library: %s\n",
+                    qPrintable(error));
+            return 1;
+        }
+    }
+
+    printf("%s: %s after %d generations, best individual %lld "
+           "(%.2f s)\n", qPrintable(run.getProblem()->getName()),
+           result == SRunHit ? "hit" :
+           result == SRunDeadline ? "deadline" : "no hit",
+           stats.generation,
+           (long long)stats.bestIndividualScoreEver,
+           timer.nsecsElapsed() / 1e9);
+    return 0;
+}
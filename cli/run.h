@@ -0,0 +1,53 @@
+#ifndef RUN_H
+#define RUN_H
+
+#include <QString>
+#include <QStringList>
+
+/*
+ * A single run of a problem, with periodic checkpoints so a long
+ * run can be resumed after being interrupted.
+ *
+ * The run is seeded so it can be reproduced, and a resumed run
+ * carries on exactly as the interrupted run would have.
+ */
+class RunCommand
+{
+public:
+    RunCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Run (or resume) the run and print the result.  Returns the
+     * process exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+private:
+    QString _problem;
+    int _populationSize;
+    int _maxGenerations;
+    // Milliseconds to stop the run after, 0 for no deadline
+    int _deadline;
+    // Rule for keeping mutations, see SAcceptance
+    QString _acceptance;
+    uint _seed;
+    QString _checkpointFile;
+    // Seconds between checkpoints
+    int _checkpointInterval;
+    // Resume from the checkpoint file if it exists
+    bool _resume;
+    // Export the best program at the end, see SProgram
+    QString _programFile;
+    // Warm start from and add hits to, see SProgramLibrary
+    QString _libraryPath;
+};
+
+#endif // RUN_H
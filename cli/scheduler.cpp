@@ -0,0 +1,269 @@
+#include "scheduler.h"
+
+#include <QJsonArray>
+#include <QMutexLocker>
+
+#include "srun.h"
+
+DaemonJob::DaemonJob()
+  : problem("parity7"),
+    populationSize(100),
+    maxGenerations(25000),
+    runs(1),
+    seed(1),
+    priority(0)
+{
+}
+
+DaemonTask::DaemonTask()
+  : jobId(0),
+    run(0),
+    suspendedRun(0),
+    nsecs(0)
+{
+}
+
+JobScheduler::JobScheduler()
+  : _nextJobId(1),
+    _stopped(false),
+    _idleWorkers(0)
+{
+}
+
+JobScheduler::~JobScheduler()
+{
+    for (std::map<int, JobState>::iterator it = _jobs.begin();
+         it != _jobs.end(); ++it) {
+        deleteSuspended(it->second);
+    }
+}
+
+int JobScheduler::submit(const DaemonJob& job)
+{
+    QMutexLocker lock(&_mutex);
+    int jobId = _nextJobId++;
+    JobState& state = _jobs[jobId];
+    state.job = job;
+    state.nextRun = 0;
+    state.running = 0;
+    state.finished = 0;
+    state.hits = 0;
+    state.cancelled = false;
+    state.outcomes.resize(job.runs);
+    state.timer.start();
+    _taskReady.wakeAll();
+    return jobId;
+}
+
+bool JobScheduler::cancel(int jobId)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        std::map<int, JobState>::iterator it = _jobs.find(jobId);
+        if (it == _jobs.end()) {
+            return false;
+        }
+        it->second.cancelled = true;
+        deleteSuspended(it->second);
+        if (it->second.running > 0) {
+            // The last run to stop reports it
+            return true;
+        }
+        QJsonObject event;
+        event["type"] = QString("cancelled");
+        event["job"] = jobId;
+        _events.push_back(event);
+        _jobs.erase(it);
+    }
+    emit eventsReady();
+    return true;
+}
+
+bool JobScheduler::isCancelled(int jobId)
+{
+    QMutexLocker lock(&_mutex);
+    std::map<int, JobState>::iterator it = _jobs.find(jobId);
+    return _stopped || it == _jobs.end() || it->second.cancelled;
+}
+
+bool JobScheduler::takeTask(DaemonTask& outTask)
+{
+    QMutexLocker lock(&_mutex);
+    for (;;) {
+        if (_stopped) {
+            return false;
+        }
+        std::map<int, JobState>::iterator best = _jobs.end();
+        for (std::map<int, JobState>::iterator it = _jobs.begin();
+             it != _jobs.end(); ++it) {
+            const JobState& state = it->second;
+            if (!hasPendingRuns(state)) {
+                continue;
+            }
+            if (best == _jobs.end() ||
+                state.job.priority > best->second.job.priority ||
+                (state.job.priority == best->second.job.priority &&
+                 state.running < best->second.running)) {
+                best = it;
+            }
+        }
+        if (best != _jobs.end()) {
+            JobState& state = best->second;
+            if (!state.suspended.empty()) {
+                outTask = state.suspended.front();
+                state.suspended.erase(state.suspended.begin());
+            } else {
+                outTask = DaemonTask();
+                outTask.jobId = best->first;
+                outTask.run = state.nextRun++;
+                outTask.job = state.job;
+            }
+            state.running++;
+            return true;
+        }
+        _idleWorkers++;
+        _taskReady.wait(&_mutex);
+        _idleWorkers--;
+    }
+}
+
+bool JobScheduler::shouldYield(const DaemonTask& task)
+{
+    QMutexLocker lock(&_mutex);
+    if (_stopped || _idleWorkers > 0) {
+        return false;
+    }
+    for (std::map<int, JobState>::iterator it = _jobs.begin();
+         it != _jobs.end(); ++it) {
+        const JobState& state = it->second;
+        if (state.job.priority > task.job.priority &&
+            hasPendingRuns(state)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobScheduler::suspendTask(const DaemonTask& task, SRun* run,
+                               qint64 nsecs)
+{
+    QMutexLocker lock(&_mutex);
+    std::map<int, JobState>::iterator it = _jobs.find(task.jobId);
+    if (it == _jobs.end() || it->second.cancelled) {
+        // Cancelled since the last check, report it as stopped
+        delete run;
+        lock.unlock();
+        finishTask(task, 0);
+        return;
+    }
+    JobState& state = it->second;
+    state.running--;
+    DaemonTask suspended = task;
+    suspended.suspendedRun = run;
+    suspended.nsecs = nsecs;
+    state.suspended.push_back(suspended);
+    _taskReady.wakeAll();
+}
+
+void JobScheduler::finishTask(const DaemonTask& task,
+                              const EffortCommand::RunOutcome* outcome)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        std::map<int, JobState>::iterator it = _jobs.find(task.jobId);
+        if (it == _jobs.end()) {
+            return;
+        }
+        JobState& state = it->second;
+        state.running--;
+        if (outcome && !state.cancelled) {
+            state.outcomes[task.run] = *outcome;
+            state.finished++;
+            state.hits += outcome->hit ? 1 : 0;
+            QJsonObject event;
+            event["type"] = QString("progress");
+            event["job"] = task.jobId;
+            event["finished"] = state.finished;
+            event["runs"] = state.job.runs;
+            event["hits"] = state.hits;
+            _events.push_back(event);
+        }
+        if (state.finished == state.job.runs) {
+            _events.push_back(getResult(task.jobId, state));
+            _jobs.erase(it);
+        } else if (state.cancelled && state.running == 0) {
+            QJsonObject event;
+            event["type"] = QString("cancelled");
+            event["job"] = task.jobId;
+            _events.push_back(event);
+            _jobs.erase(it);
+        }
+    }
+    emit eventsReady();
+}
+
+std::vector<QJsonObject> JobScheduler::takeEvents()
+{
+    QMutexLocker lock(&_mutex);
+    std::vector<QJsonObject> events;
+    events.swap(_events);
+    return events;
+}
+
+QJsonObject JobScheduler::getStatus()
+{
+    QMutexLocker lock(&_mutex);
+    QJsonArray jobs;
+    for (std::map<int, JobState>::iterator it = _jobs.begin();
+         it != _jobs.end(); ++it) {
+        const JobState& state = it->second;
+        QJsonObject job;
+        job["job"] = it->first;
+        job["problem"] = state.job.problem;
+        job["priority"] = state.job.priority;
+        job["runs"] = state.job.runs;
+        job["running"] = state.running;
+        job["suspended"] = int(state.suspended.size());
+        job["finished"] = state.finished;
+        job["hits"] = state.hits;
+        job["cancelled"] = state.cancelled;
+        jobs.append(job);
+    }
+    QJsonObject status;
+    status["type"] = QString("status");
+    status["jobs"] = jobs;
+    return status;
+}
+
+void JobScheduler::stop()
+{
+    QMutexLocker lock(&_mutex);
+    _stopped = true;
+    _taskReady.wakeAll();
+}
+
+bool JobScheduler::hasPendingRuns(const JobState& state)
+{
+    return !state.cancelled &&
+           (state.nextRun < state.job.runs || !state.suspended.empty());
+}
+
+void JobScheduler::deleteSuspended(JobState& state)
+{
+    for (size_t i = 0; i < state.suspended.size(); ++i) {
+        delete state.suspended[i].suspendedRun;
+    }
+    state.suspended.clear();
+}
+
+QJsonObject JobScheduler::getResult(int jobId, const JobState& state)
+{
+    const DaemonJob& job = state.job;
+    QJsonObject result = summariseRuns(job.problem, job.populationSize,
+                                       job.maxGenerations, job.seed,
+                                       state.outcomes,
+                                       state.timer.nsecsElapsed());
+    result["type"] = QString("result");
+    result["job"] = jobId;
+    return result;
+}
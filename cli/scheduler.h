@@ -0,0 +1,177 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QWaitCondition>
+
+#include <map>
+#include <vector>
+
+#include "effort.h"
+
+class SRun;
+
+/*
+ * A job submitted to the daemon: a number of runs of a problem, run
+ * k seeded with (seed + k) as in EffortCommand.
+ */
+struct DaemonJob
+{
+    DaemonJob();
+
+    QString problem;
+    int populationSize;
+    int maxGenerations;
+    int runs;
+    uint seed;
+    // Jobs with a higher priority are run first
+    int priority;
+};
+
+/*
+ * One run of a job, handed to a worker thread.
+ */
+struct DaemonTask
+{
+    DaemonTask();
+
+    int jobId;
+    int run;
+    DaemonJob job;
+    // The run to carry on if it was suspended, see
+    // JobScheduler::suspendTask(), else NULL
+    SRun* suspendedRun;
+    // Time spent on the run before it was suspended
+    qint64 nsecs;
+};
+
+/*
+ * The daemon's queue of jobs, shared by the thread serving the
+ * clients and the worker threads.
+ *
+ * Jobs are split into their runs, and a free worker takes the next
+ * run of the job with the highest priority.  Jobs of the same
+ * priority share the workers: the job with the fewest runs in
+ * progress goes next, the oldest on a tie, so a large job doesn't
+ * hold up a small one submitted after it.
+ *
+ * A run is preempted when a job with a higher priority is waiting
+ * and no worker is free: its worker suspends it between batches (see
+ * shouldYield()) and takes the higher priority run instead.  A
+ * suspended run is carried on later by whichever worker is free,
+ * before the job's runs that haven't started, and goes on exactly as
+ * it would have.
+ *
+ * Progress and results are queued as messages for the clients, see
+ * takeEvents(), and eventsReady() is emitted when there are some.
+ */
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    JobScheduler();
+    ~JobScheduler();
+
+    /*
+     * Queue a job, returns its id.
+     */
+    int submit(const DaemonJob& job);
+
+    /*
+     * Cancel a job, runs in progress are stopped at their next
+     * batch of generations and suspended runs are deleted.  Returns
+     * false if there is no such job.
+     */
+    bool cancel(int jobId);
+
+    /*
+     * Return true if the job has been cancelled, or the scheduler
+     * stopped.  Checked by the workers between batches.
+     */
+    bool isCancelled(int jobId);
+
+    /*
+     * Wait for the next run to do.  Returns false once the
+     * scheduler is stopped.
+     */
+    bool takeTask(DaemonTask& outTask);
+
+    /*
+     * Return true if the task's run should be suspended for a job
+     * with a higher priority, because no worker is free to run it.
+     * Checked by the workers between batches.
+     */
+    bool shouldYield(const DaemonTask& task);
+
+    /*
+     * Hand back the run of a task to be carried on later, taking
+     * ownership of 'run'.  'nsecs' is the time spent on it so far.
+     */
+    void suspendTask(const DaemonTask& task, SRun* run, qint64 nsecs);
+
+    /*
+     * Record the outcome of a run, NULL if it was cancelled.
+     */
+    void finishTask(const DaemonTask& task,
+                    const EffortCommand::RunOutcome* outcome);
+
+    /*
+     * Get the messages for the clients since the last call: a
+     * "progress" message after each run, then a "result" message
+     * with the summary (as EffortCommand reports) or a "cancelled"
+     * message.  Each has the "job" it's about.
+     */
+    std::vector<QJsonObject> takeEvents();
+
+    /*
+     * Get the queued and running jobs, as a "status" message.
+     */
+    QJsonObject getStatus();
+
+    /*
+     * Stop the workers, cancelling every job.
+     */
+    void stop();
+
+signals:
+    void eventsReady();
+
+private:
+    struct JobState {
+        DaemonJob job;
+        // Runs handed out, in progress and finished
+        int nextRun;
+        int running;
+        int finished;
+        int hits;
+        bool cancelled;
+        std::vector<EffortCommand::RunOutcome> outcomes;
+        // Preempted runs, the oldest first
+        std::vector<DaemonTask> suspended;
+        QElapsedTimer timer;
+    };
+
+    QJsonObject getResult(int jobId, const JobState& state);
+
+    // Return true if the job has runs waiting for a worker
+    static bool hasPendingRuns(const JobState& state);
+
+    // Delete the job's suspended runs
+    static void deleteSuspended(JobState& state);
+
+    QMutex _mutex;
+    QWaitCondition _taskReady;
+    // By id, so the oldest come first
+    std::map<int, JobState> _jobs;
+    int _nextJobId;
+    bool _stopped;
+    // Workers waiting in takeTask()
+    int _idleWorkers;
+    std::vector<QJsonObject> _events;
+};
+
+#endif // SCHEDULER_H
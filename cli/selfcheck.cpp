@@ -0,0 +1,307 @@
+#include "selfcheck.h"
+
+#include <QDir>
+#include <QTemporaryDir>
+
+#include <stdio.h>
+#include <vector>
+
+#include "problem.h"
+#include "sacceptance.h"
+#include "scheckpoint.h"
+#include "sprogram.h"
+#include "sprogramjit.h"
+#include "sprogramvm.h"
+#include "srun.h"
+
+SelfCheckCommand::SelfCheckCommand()
+  : _generations(2000),
+    _seed(1),
+    _benchmarks(false),
+    _numChecks(0),
+    _numFailures(0)
+{
+}
+
+void SelfCheckCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli selfcheck [options]\n"
+            "  -generations n   generations of each run (2000)\n"
+            "  -seed n          random number seed (1)\n"
+            "  -benchmarks 0|1  check the programs of the benchmarks\n"
+            "                   too, parity24 takes a while (0)\n");
+}
+
+bool SelfCheckCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-generations") {
+            _generations = value.toInt(&ok);
+            ok = ok && _generations > 1;
+        } else if (arg == "-seed") {
+            _seed = value.toUInt(&ok);
+        } else if (arg == "-benchmarks") {
+            _benchmarks = value.toInt(&ok) != 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int SelfCheckCommand::exec()
+{
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        fprintf(stderr, "Can't create a temporary directory\n");
+        return 1;
+    }
+    _tempPath = dir.path();
+
+    QStringList names = Problem::getProblemNames();
+    if (_benchmarks) {
+        names << Problem::getBenchmarkNames();
+    }
+    for (int i = 0; i < names.size(); ++i) {
+        checkPrograms(names.at(i));
+    }
+
+    // Every sample problem with the rule of the paper, and every
+    // other rule, whose state and journal are saved too
+    QStringList problemNames = Problem::getProblemNames();
+    for (int i = 0; i < problemNames.size(); ++i) {
+        checkCheckpoint(problemNames.at(i), "greedy");
+    }
+    QStringList acceptanceNames = SAcceptance::getAcceptanceNames();
+    for (int i = 0; i < acceptanceNames.size(); ++i) {
+        if (acceptanceNames.at(i) != "greedy") {
+            checkCheckpoint("parity5", acceptanceNames.at(i));
+        }
+    }
+
+    checkTables();
+
+    printf("%d checks, %d failed\n", _numChecks, _numFailures);
+    return _numFailures ? 1 : 0;
+}
+
+void SelfCheckCommand::check(bool ok, const QString& what)
+{
+    _numChecks++;
+    if (!ok) {
+        _numFailures++;
+        fprintf(stderr, "FAILED: %s\n", qPrintable(what));
+    }
+}
+
+void SelfCheckCommand::checkPrograms(const QString& problemName)
+{
+    SRun run;
+    run.setNumMaxGenerations(_generations);
+    run.setProblem(Problem::create(problemName));
+    qsrand(_seed);
+    run.run(_generations);
+
+    // The programs are evaluated over the test cases.  Those of a
+    // truth table pack 32 of its cases into each input, its programs
+    // take a case per row, so a row is the case in the lowest bits.
+    Problem* problem = run.getProblem();
+    int numRows = problem->getNumFitnessCases();
+    std::vector<int> rows(problem->getInputs(0),
+                          problem->getInputs(0) +
+                          numRows * problem->getNumInputs());
+    if (problemName.startsWith("table:") ||
+        ProblemTruthTable::isBenchmarkName(problemName)) {
+        for (size_t k = 0; k < rows.size(); ++k) {
+            rows[k] &= 1;
+        }
+    }
+    const int* inputs = rows.data();
+    std::vector<int> expected(numRows);
+    std::vector<int> results(numRows);
+    int numNodes = run.getFitness().size();
+    int numVM = 0;
+    int numJit = 0;
+    for (int i = 0; i < numNodes; ++i) {
+        QString what = QString("%1 node %2").arg(problemName).arg(i);
+        SProgram program = run.getProgram(i);
+        problem->evaluateProgram(program, inputs, numRows, expected.data());
+
+        SProgram loaded;
+        QByteArray data = program.save();
+        QString error;
+        bool ok = loaded.load(data, &error);
+        check(ok, what + ": can't load the saved program: " + error);
+        if (ok) {
+            check(loaded.save() == data,
+                  what + ": the loaded program saves differently");
+            problem->evaluateProgram(loaded, inputs, numRows,
+                                     results.data());
+            check(results == expected,
+                  what + ": the loaded program's results differ");
+        }
+
+        // Not every problem's ops can be compiled
+        SProgramVM vm;
+        if (vm.compile(program, *problem)) {
+            vm.evaluate(inputs, numRows, results.data());
+            check(results == expected,
+                  what + ": the bytecode results differ");
+            numVM++;
+        }
+        SProgramJit jit;
+        if (SProgramJit::isSupported() && jit.compile(program, *problem)) {
+            jit.evaluate(inputs, numRows, results.data());
+            check(results == expected,
+                  what + ": the native code results differ");
+            numJit++;
+        }
+    }
+    printf("%s: %d programs, %d as bytecode, %d as native code\n",
+           qPrintable(problemName), numNodes, numVM, numJit);
+}
+
+void SelfCheckCommand::checkCheckpoint(const QString& problemName,
+                                       const QString& acceptance)
+{
+    QString what = QString("%1 checkpoint with %2").arg(problemName)
+                   .arg(acceptance);
+    QString fileName = QDir(_tempPath).filePath("run.sngp");
+    int half = _generations / 2;
+
+    SRun saved;
+    saved.setNumMaxGenerations(_generations);
+    saved.setProblem(Problem::create(problemName));
+    if (acceptance != "greedy") {
+        saved.setAcceptance(SAcceptance::create(acceptance));
+    }
+    qsrand(_seed);
+    saved.run(half);
+    if (!SCheckpointFileWriter::writeFile(fileName, saved.saveCheckpoint())) {
+        check(false, what + ": can't write " + fileName);
+        return;
+    }
+    std::vector<int> fitness = saved.getFitness();
+
+    SRun resumed;
+    resumed.setNumMaxGenerations(_generations);
+    resumed.setProblem(Problem::create(problemName));
+    if (acceptance != "greedy") {
+        resumed.setAcceptance(SAcceptance::create(acceptance));
+    }
+    QString error;
+    if (!resumed.loadCheckpoint(fileName, &error)) {
+        check(false, what + ": can't load: " + error);
+        return;
+    }
+    check(resumed.getFitness() == fitness,
+          what + ": the loaded fitness differs");
+
+    // A finished run starts a new one, seeded from qrand() rather
+    // than the checkpoint, so only compare runs still going
+    bool finished = saved.isFinished();
+    if (!finished) {
+        SRunResult savedResult = saved.run(_generations - half);
+        SRunResult resumedResult = resumed.run(_generations - half);
+        check(resumedResult == savedResult &&
+              resumed.getStats().generation == saved.getStats().generation &&
+              resumed.getFitness() == saved.getFitness() &&
+              resumed.getBestProgram().save() ==
+              saved.getBestProgram().save(),
+              what + ": the resumed run differs");
+    }
+    printf("%s: resumed at generation %d%s\n", qPrintable(what), half,
+           finished ? ", hit before it" : "");
+}
+
+void SelfCheckCommand::checkTable(const QString& what, const char* text,
+                                  int numInputs, int numTableCases,
+                                  const char* error)
+{
+    QString fileName = QDir(_tempPath).filePath("table.pla");
+    if (!SCheckpointFileWriter::writeFile(fileName, QByteArray(text))) {
+        check(false, what + ": can't write " + fileName);
+        return;
+    }
+    ProblemTruthTable table;
+    QString loadError;
+    bool loaded = table.load(fileName, &loadError);
+    if (error) {
+        check(!loaded && loadError.contains(error),
+              QString("%1: expected '%2', got '%3'").arg(what).arg(error)
+              .arg(loaded ? QString("loaded") : loadError));
+    } else {
+        check(loaded, what + ": " + loadError);
+        check(!loaded || (table.getNumInputs() == numInputs &&
+                          table.getNumTableCases() == numTableCases),
+              QString("%1: expected %2 inputs and %3 cases").arg(what)
+              .arg(numInputs).arg(numTableCases));
+    }
+}
+
+void SelfCheckCommand::checkTables()
+{
+    checkTable("full table",
+               "# Two input xor\n"
+               ".i 2\n"
+               ".o 1\n"
+               ".ops and or not\n"
+               "00 0\n"
+               "01 1\n"
+               "10 1\n"
+               "11 0\n"
+               ".e\n", 2, 4, 0);
+    checkTable("don't care inputs",
+               "1-- 1\n"
+               "01- 0\r\n", 3, 6, 0);
+    checkTable("ignored lines",
+               ".p 3\n"
+               ".ilb a b\n"
+               ".ob f\n"
+               "11 1 # and\n"
+               "00 0\n"
+               "01 -\n"
+               ".e\n"
+               "10 1\n", 2, 2, 0);
+    checkTable("two outputs", ".i 2\n.o 2\n00 0\n", 0, 0, "Line 2:");
+    checkTable("input count", "101 1\n10 1\n", 0, 0, "Line 2:");
+    checkTable("too many inputs", ".i 25\n", 0, 0, "Line 1:");
+    checkTable("late .i", "11 1\n.i 2\n", 0, 0, "Line 2:");
+    checkTable("unknown op", ".ops and xor\n00 0\n", 0, 0, "Line 1:");
+    checkTable("conflicting rows", "1- 1\n11 0\n", 0, 0, "Line 2:");
+    checkTable("bad output", "11 2\n", 0, 0, "Line 1:");
+    checkTable("bad input", "11 1\n1x 0\n", 0, 0, "Line 2:");
+    checkTable("bad input before good rows", "-x 1\n11 1\n00 0\n", 0, 0,
+               "Line 1:");
+    checkTable("missing output", "11\n", 0, 0, "Line 1:");
+    checkTable("no rows", "# nothing\n.i 2\n", 0, 0, "There are no rows");
+
+    // The programs of a run of a table, a comparator a1 a0 > b1 b0
+    QByteArray text(".ops and or nand nor not\n");
+    for (int i = 0; i < 16; ++i) {
+        for (int j = 3; j >= 0; --j) {
+            text += (i >> j) & 1 ? '1' : '0';
+        }
+        text += (i >> 2) > (i & 3) ? " 1\n" : " 0\n";
+    }
+    QString fileName = QDir(_tempPath).filePath("comparator.pla");
+    if (!SCheckpointFileWriter::writeFile(fileName, text)) {
+        check(false, "can't write " + fileName);
+        return;
+    }
+    checkPrograms("table:" + fileName);
+}
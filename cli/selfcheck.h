@@ -0,0 +1,70 @@
+#ifndef SELFCHECK_H
+#define SELFCHECK_H
+
+#include <QString>
+#include <QStringList>
+
+/*
+ * Checks that the parts of the engine that must agree do: the
+ * bytecode (see SProgramVM) and native code (see SProgramJit) of
+ * every program a run finds against Problem::evaluateProgram(), for
+ * every sample problem, the serialised form of the programs, resumed
+ * checkpoints against the runs they were saved from, and the truth
+ * table parser (see ProblemTruthTable) on good and bad tables.
+ *
+ * Prints each failed check and a summary, the exit code is 1 if any
+ * check failed.
+ */
+class SelfCheckCommand
+{
+public:
+    SelfCheckCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Run the checks and print the summary.  Returns the process
+     * exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+private:
+    /*
+     * Check the program of every node of a run of 'problemName'
+     * after the given number of generations.
+     */
+    void checkPrograms(const QString& problemName);
+
+    /*
+     * Check that a run resumed from a checkpoint half way carries
+     * on as the run it was saved from.
+     */
+    void checkCheckpoint(const QString& problemName,
+                         const QString& acceptance);
+
+    // Check the truth table parser on 'text', see checkTables()
+    void checkTable(const QString& what, const char* text, int numInputs,
+                    int numTableCases, const char* error);
+    void checkTables();
+
+    // Count a check, printing it if it failed
+    void check(bool ok, const QString& what);
+
+    int _generations;
+    uint _seed;
+    // Check the programs of the benchmarks too, see
+    // Problem::getBenchmarkNames()
+    bool _benchmarks;
+    // Directory for the checkpoints and tables
+    QString _tempPath;
+    int _numChecks;
+    int _numFailures;
+};
+
+#endif // SELFCHECK_H
@@ -0,0 +1,155 @@
+#include "submit.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QLocalSocket>
+
+#include <stdio.h>
+
+#include "daemon.h"
+#include "problem.h"
+
+SubmitCommand::SubmitCommand()
+  : _socketName(DaemonCommand::DefaultSocketName)
+{
+    _request["type"] = QString("submit");
+}
+
+void SubmitCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli submit [options]\n"
+            "  -socket name     local socket of the daemon (%s)\n"
+            "  -problem name    problem to run (parity7)\n"
+            "  -population n    nodes in the population (100)\n"
+            "  -generations n   max generations per run (25000)\n"
+            "  -runs n          number of runs (1)\n"
+            "  -seed n          seed of the first run (1)\n"
+            "  -priority n      higher priority jobs run first (0)\n"
+            "  -o file          write the result as JSON\n"
+            "  -status 1        print the daemon's jobs instead\n"
+            "  -cancel id       cancel a job instead\n"
+            "  -shutdown 1      stop the daemon instead\n"
+            "Problems: %s, table:file\n"
+            "Benchmarks: %s\n",
+            DaemonCommand::DefaultSocketName,
+            qPrintable(Problem::getProblemNames().join(", ")),
+            qPrintable(Problem::getBenchmarkNames().join(", ")));
+}
+
+bool SubmitCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-socket") {
+            _socketName = value;
+        } else if (arg == "-problem") {
+            _request["problem"] = value;
+            QString error;
+            ok = Problem::isProblemName(value, &error);
+            if (!ok) {
+                fprintf(stderr, "%s\n", qPrintable(error));
+            }
+        } else if (arg == "-population" || arg == "-generations" ||
+                   arg == "-runs") {
+            int n = value.toInt(&ok);
+            _request[arg.mid(1)] = n;
+            ok = ok && n > 0;
+        } else if (arg == "-seed") {
+            _request["seed"] = double(value.toUInt(&ok));
+        } else if (arg == "-priority") {
+            _request["priority"] = value.toInt(&ok);
+        } else if (arg == "-o") {
+            _outputFile = value;
+        } else if (arg == "-status" || arg == "-shutdown") {
+            if (value.toInt(&ok) != 0) {
+                QJsonObject request;
+                request["type"] = arg.mid(1);
+                _request = request;
+            }
+        } else if (arg == "-cancel") {
+            QJsonObject request;
+            request["type"] = QString("cancel");
+            request["job"] = value.toInt(&ok);
+            _request = request;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int SubmitCommand::exec()
+{
+    QLocalSocket socket;
+    socket.connectToServer(_socketName);
+    if (!socket.waitForConnected(5000)) {
+        fprintf(stderr, "Can't connect to the daemon at %s: %s\n",
+                qPrintable(_socketName), qPrintable(socket.errorString()));
+        return 1;
+    }
+    socket.write(QJsonDocument(_request).toJson(QJsonDocument::Compact));
+    socket.write("\n");
+
+    for (;;) {
+        while (!socket.canReadLine()) {
+            if (!socket.waitForReadyRead(-1)) {
+                fprintf(stderr, "\nLost the daemon: %s\n",
+                        qPrintable(socket.errorString()));
+                return 1;
+            }
+        }
+        QByteArray line = socket.readLine();
+        QJsonObject message = QJsonDocument::fromJson(line).object();
+        QString type = message["type"].toString();
+        if (type == "accepted") {
+            fprintf(stderr, "Job %d queued\n", message["job"].toInt());
+        } else if (type == "progress") {
+            fprintf(stderr, "\rjob %d: run %d/%d, %d hits",
+                    message["job"].toInt(), message["finished"].toInt(),
+                    message["runs"].toInt(), message["hits"].toInt());
+        } else if (type == "result") {
+            fprintf(stderr, "\n");
+            printf("%s: %d runs, %d hits, success rate %.1f%% "
+                   "(%.2f s)\n", qPrintable(message["problem"].toString()),
+                   message["runs"].toInt(), message["hits"].toInt(),
+                   100 * message["successRate"].toDouble(),
+                   message["wallSeconds"].toDouble());
+            if (!_outputFile.isEmpty()) {
+                QFile file(_outputFile);
+                if (!file.open(QIODevice::WriteOnly) ||
+                    file.write(QJsonDocument(message).toJson()) < 0) {
+                    fprintf(stderr, "Can't write %s\n",
+                            qPrintable(_outputFile));
+                    return 1;
+                }
+            }
+            return 0;
+        } else if (type == "status") {
+            printf("%s", QJsonDocument(message).toJson().constData());
+            return 0;
+        } else if (type == "ok") {
+            return 0;
+        } else if (type == "cancelled") {
+            fprintf(stderr, "\nJob %d was cancelled\n",
+                    message["job"].toInt());
+            return 1;
+        } else {
+            fprintf(stderr, "%s\n",
+                    qPrintable(message["error"].toString()));
+            return 1;
+        }
+    }
+}
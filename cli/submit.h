@@ -0,0 +1,38 @@
+#ifndef SUBMIT_H
+#define SUBMIT_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Client of the daemon (see DaemonCommand): submits a job and waits
+ * for its result, printing its progress, or asks for the queue or
+ * cancels a job.
+ */
+class SubmitCommand
+{
+public:
+    SubmitCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Send the request and print the reply.  Returns the process
+     * exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+private:
+    QString _socketName;
+    QJsonObject _request;
+    QString _outputFile;
+};
+
+#endif // SUBMIT_H
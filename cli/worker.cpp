@@ -0,0 +1,386 @@
+#include "worker.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMetaObject>
+#include <QThread>
+
+#include <stdio.h>
+
+#include "coordinator.h"
+#include "problem.h"
+#include "sprogram.h"
+#include "srun.h"
+#include "strace.h"
+
+/*
+ * Runs the batches and islands handed to the worker.
+ */
+class WorkerThread : public QThread
+{
+public:
+    explicit WorkerThread(WorkerClient& client)
+      : _client(client),
+        _run(0)
+    {
+    }
+
+    virtual ~WorkerThread() { delete _run; }
+
+protected:
+    virtual void run();
+
+private:
+    void runBatch(const WorkerClient::Setup& setup,
+                  const WorkerClient::Item& item);
+    void runIsland(const WorkerClient::Setup& setup, int island);
+
+    // Post the program of the best node of the run
+    void postProgram(QJsonObject& message);
+
+    WorkerClient& _client;
+    // Reused between items, the setup is the same for all of them
+    SRun* _run;
+};
+
+void WorkerThread::run()
+{
+    WorkerClient::Setup setup;
+    WorkerClient::Item item;
+    while (_client.takeItem(setup, item)) {
+        if (!_run) {
+            _run = new SRun();
+            _run->setPopulationSize(setup.populationSize);
+            _run->setProblem(Problem::create(setup.problem));
+        }
+        _run->setNumMaxGenerations(setup.maxGenerations);
+        if (item.count > 0) {
+            runBatch(setup, item);
+        } else {
+            runIsland(setup, item.first);
+        }
+    }
+}
+
+void WorkerThread::runBatch(const WorkerClient::Setup& setup,
+                            const WorkerClient::Item& item)
+{
+    QJsonArray outcomes;
+    for (int k = item.first; k < item.first + item.count; ++k) {
+        // The seed is per thread
+        qsrand(setup.seed + k);
+        _run->restart();
+
+        QElapsedTimer timer;
+        timer.start();
+        SRunResult result;
+        do {
+            result = _run->run(1000);
+        } while (result == SRunContinue && !_client.isStopped());
+        if (_client.isStopped()) {
+            return;
+        }
+
+        const SNodeStats& stats = _run->getStats();
+        QJsonObject outcome;
+        outcome["hit"] = result == SRunHit;
+        outcome["generations"] = stats.generation;
+        outcome["nsecs"] = double(timer.nsecsElapsed());
+        outcome["best"] = int(stats.bestIndividualScore);
+        outcomes.append(outcome);
+    }
+    QJsonObject message;
+    message["type"] = QString("outcomes");
+    message["first"] = item.first;
+    message["outcomes"] = outcomes;
+    _client.post(message);
+}
+
+void WorkerThread::runIsland(const WorkerClient::Setup& setup, int island)
+{
+    if (STrace::isEnabled()) {
+        STrace::setThreadName(QString("island %1").arg(island));
+    }
+    qsrand(setup.seed + island);
+    _run->restart();
+
+    SRunResult result;
+    std::vector<SProgram> migrants;
+    for (;;) {
+        result = _run->run(setup.interval);
+        if (!_client.takeMigrants(island, migrants)) {
+            return;
+        }
+        if (result != SRunContinue) {
+            break;
+        }
+        for (size_t i = 0; i < migrants.size(); ++i) {
+            _run->addMigrant(migrants[i]);
+        }
+
+        QJsonObject message;
+        message["type"] = QString("migrant");
+        message["island"] = island;
+        message["generation"] = _run->getStats().generation;
+        postProgram(message);
+    }
+
+    QJsonObject message;
+    message["type"] = QString("island");
+    message["island"] = island;
+    message["hit"] = result == SRunHit;
+    message["generations"] = _run->getStats().generation;
+    postProgram(message);
+}
+
+void WorkerThread::postProgram(QJsonObject& message)
+{
+    STraceSpan span("migration.send");
+    int best = _run->getBestNode();
+    message["fitness"] = _run->getFitness()[best];
+    message["program"] =
+        QString::fromLatin1(_run->getProgram(best).save().toBase64());
+    _client.post(message);
+}
+
+WorkerClient::WorkerClient(int threads, QObject *parent)
+  : QObject(parent),
+    _hasSetup(false),
+    _stopped(false)
+{
+    connect(&_socket, SIGNAL(connected()), this, SLOT(sendHello()));
+    connect(&_socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+    connect(&_socket, SIGNAL(disconnected()), this, SLOT(lostConnection()));
+    connect(&_socket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(lostConnection()));
+    for (int i = 0; i < threads; ++i) {
+        _threads.push_back(new WorkerThread(*this));
+        _threads.back()->start();
+    }
+}
+
+WorkerClient::~WorkerClient()
+{
+    stop();
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        _threads[i]->wait();
+        delete _threads[i];
+    }
+}
+
+void WorkerClient::connectToCoordinator(const QString& host, int port)
+{
+    _socket.connectToHost(host, port);
+}
+
+bool WorkerClient::takeItem(Setup& outSetup, Item& outItem)
+{
+    QMutexLocker lock(&_mutex);
+    while (!_stopped && (!_hasSetup || _items.empty())) {
+        _itemReady.wait(&_mutex);
+    }
+    if (_stopped) {
+        return false;
+    }
+    outSetup = _setup;
+    outItem = _items.front();
+    _items.pop_front();
+    return true;
+}
+
+void WorkerClient::post(const QJsonObject& message)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        _outgoing.push_back(message);
+    }
+    QMetaObject::invokeMethod(this, "sendPending", Qt::QueuedConnection);
+}
+
+bool WorkerClient::takeMigrants(int island, std::vector<SProgram>& outMigrants)
+{
+    std::vector<QByteArray> data;
+    {
+        QMutexLocker lock(&_mutex);
+        if (_stopped) {
+            return false;
+        }
+        std::map<int, std::vector<QByteArray> >::iterator it =
+            _migrants.find(island);
+        if (it != _migrants.end()) {
+            data.swap(it->second);
+            _migrants.erase(it);
+        }
+    }
+    outMigrants.clear();
+    for (size_t i = 0; i < data.size(); ++i) {
+        SProgram program;
+        if (program.load(data[i])) {
+            outMigrants.push_back(program);
+        }
+    }
+    return true;
+}
+
+bool WorkerClient::isStopped()
+{
+    QMutexLocker lock(&_mutex);
+    return _stopped;
+}
+
+void WorkerClient::sendPending()
+{
+    std::vector<QJsonObject> messages;
+    {
+        QMutexLocker lock(&_mutex);
+        messages.swap(_outgoing);
+    }
+    for (size_t i = 0; i < messages.size(); ++i) {
+        _socket.write(QJsonDocument(messages[i]).toJson(QJsonDocument::Compact));
+        _socket.write("\n");
+    }
+}
+
+void WorkerClient::sendHello()
+{
+    QJsonObject hello;
+    hello["type"] = QString("hello");
+    hello["threads"] = int(_threads.size());
+    post(hello);
+}
+
+void WorkerClient::readMessages()
+{
+    while (_socket.canReadLine()) {
+        QJsonParseError error;
+        QJsonDocument document =
+            QJsonDocument::fromJson(_socket.readLine(), &error);
+        if (error.error != QJsonParseError::NoError || !document.isObject()) {
+            fprintf(stderr, "Bad message from the coordinator: %s\n",
+                    qPrintable(error.errorString()));
+            _socket.abort();
+            return;
+        }
+        handleMessage(document.object());
+    }
+    if (_socket.bytesAvailable() > MaxMessageSize) {
+        fprintf(stderr, "Message from the coordinator is too long\n");
+        _socket.abort();
+    }
+}
+
+void WorkerClient::lostConnection()
+{
+    if (isStopped()) {
+        return;
+    }
+    fprintf(stderr, "Lost the coordinator: %s\n",
+            qPrintable(_socket.errorString()));
+    stop();
+    QCoreApplication::exit(1);
+}
+
+void WorkerClient::handleMessage(const QJsonObject& message)
+{
+    QString type = message["type"].toString();
+    QMutexLocker lock(&_mutex);
+    if (type == "setup") {
+        _setup.problem = message["problem"].toString();
+        _setup.populationSize = message["population"].toInt();
+        _setup.maxGenerations = message["generations"].toInt();
+        _setup.seed = uint(message["seed"].toDouble());
+        _setup.interval = message["interval"].toInt();
+        if (!Problem::isProblemName(_setup.problem) ||
+            _setup.populationSize <= 0 || _setup.maxGenerations <= 0 ||
+            _setup.interval <= 0) {
+            fprintf(stderr, "Bad setup from the coordinator\n");
+            lock.unlock();
+            stop();
+            QCoreApplication::exit(1);
+            return;
+        }
+        _hasSetup = true;
+        fprintf(stderr, "Running %s\n", qPrintable(_setup.problem));
+    } else if (type == "runs" || type == "island") {
+        Item item;
+        item.first = message[type == "runs" ? "first" : "island"].toInt();
+        item.count = message["count"].toInt();
+        _items.push_back(item);
+    } else if (type == "migrant") {
+        _migrants[message["island"].toInt()].push_back(
+            QByteArray::fromBase64(message["program"].toString().toLatin1()));
+    } else if (type == "stop") {
+        lock.unlock();
+        stop();
+        QCoreApplication::quit();
+        return;
+    }
+    _itemReady.wakeAll();
+}
+
+void WorkerClient::stop()
+{
+    QMutexLocker lock(&_mutex);
+    _stopped = true;
+    _itemReady.wakeAll();
+}
+
+WorkerCommand::WorkerCommand()
+  : _host("127.0.0.1"),
+    _port(CoordinatorCommand::DefaultPort),
+    _threads(QThread::idealThreadCount())
+{
+}
+
+void WorkerCommand::printUsage()
+{
+    fprintf(stderr,
+            "Usage: sngpcli worker [options]\n"
+            "  -host address    address of the coordinator (127.0.0.1)\n"
+            "  -port n          port of the coordinator (%d)\n"
+            "  -threads n       number of runs or islands in parallel\n",
+            int(CoordinatorCommand::DefaultPort));
+}
+
+bool WorkerCommand::parseArgs(const QStringList& args)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const QString& arg = args.at(i);
+        if (i + 1 >= args.size()) {
+            printUsage();
+            return false;
+        }
+        const QString& value = args.at(++i);
+        bool ok = true;
+        if (arg == "-host") {
+            _host = value;
+            ok = !value.isEmpty();
+        } else if (arg == "-port") {
+            _port = value.toInt(&ok);
+            ok = ok && _port > 0 && _port < 65536;
+        } else if (arg == "-threads") {
+            _threads = value.toInt(&ok);
+            ok = ok && _threads > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n",
+                    qPrintable(arg), qPrintable(value));
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+int WorkerCommand::exec()
+{
+    WorkerClient client(_threads);
+    client.connectToCoordinator(_host, _port);
+    fprintf(stderr, "Connecting to %s:%d with %d threads\n",
+            qPrintable(_host), _port, _threads);
+    return QCoreApplication::exec();
+}
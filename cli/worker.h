@@ -0,0 +1,129 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTcpSocket>
+#include <QWaitCondition>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+class QThread;
+class SProgram;
+
+/*
+ * Worker process of a distributed experiment, runs the batches of
+ * runs or the islands handed out by a coordinator (see
+ * CoordinatorCommand) on its threads until told to stop.
+ */
+class WorkerCommand
+{
+public:
+    WorkerCommand();
+
+    /*
+     * Parse the command line options, returns false and prints
+     * usage on error.
+     */
+    bool parseArgs(const QStringList& args);
+
+    /*
+     * Work for the coordinator until it's done.  Returns the process
+     * exit code.
+     */
+    int exec();
+
+    static void printUsage();
+
+private:
+    QString _host;
+    int _port;
+    int _threads;
+};
+
+/*
+ * Connection to the coordinator, on the main thread, and the queue
+ * of work for the threads.
+ */
+class WorkerClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WorkerClient(int threads, QObject *parent = 0);
+    virtual ~WorkerClient();
+
+    void connectToCoordinator(const QString& host, int port);
+
+    // Work item handed out by the coordinator
+    struct Item {
+        // First run of a batch, or an island
+        int first;
+        // Number of runs in the batch, 0 for an island
+        int count;
+    };
+
+    // Settings of the runs, from the coordinator's "setup"
+    struct Setup {
+        QString problem;
+        int populationSize;
+        int maxGenerations;
+        uint seed;
+        int interval;
+    };
+
+    /*
+     * Wait for the next item, returns false once stopped.  Called
+     * from the threads.
+     */
+    bool takeItem(Setup& outSetup, Item& outItem);
+
+    /*
+     * Queue a message for the coordinator.  Called from the threads.
+     */
+    void post(const QJsonObject& message);
+
+    /*
+     * Take the migrants that arrived for 'island', returns false
+     * once stopped.  Called from the threads.
+     */
+    bool takeMigrants(int island, std::vector<SProgram>& outMigrants);
+
+    /*
+     * Return true once the coordinator said to stop, or was lost.
+     */
+    bool isStopped();
+
+public slots:
+    void sendPending();
+
+private slots:
+    void sendHello();
+    void readMessages();
+    void lostConnection();
+
+private:
+    void handleMessage(const QJsonObject& message);
+    void stop();
+
+    // Longest message line accepted
+    enum { MaxMessageSize = 1024 * 1024 };
+
+    QTcpSocket _socket;
+    std::vector<QThread*> _threads;
+
+    QMutex _mutex;
+    QWaitCondition _itemReady;
+    bool _hasSetup;
+    Setup _setup;
+    std::deque<Item> _items;
+    std::map<int, std::vector<QByteArray> > _migrants;
+    std::vector<QJsonObject> _outgoing;
+    bool _stopped;
+};
+
+#endif // WORKER_H
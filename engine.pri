@@ -0,0 +1,53 @@
+# The GP engine and sample problems, shared by the GUI and the
+# command line tools.
+
+CONFIG += c++11
+
+# Collect the hot path counters (see SCounters), qmake CONFIG+=counters
+counters {
+    DEFINES += SNGP_COUNTERS
+}
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/problem.cpp \
+    $$PWD/snode.cpp \
+    $$PWD/sevalengine.cpp \
+    $$PWD/sresultcache.cpp \
+    $$PWD/sarena.cpp \
+    $$PWD/srun.cpp \
+    $$PWD/scounters.cpp \
+    $$PWD/sperfcounters.cpp \
+    $$PWD/strace.cpp \
+    $$PWD/shistogram.cpp \
+    $$PWD/scheckpoint.cpp \
+    $$PWD/sprogram.cpp \
+    $$PWD/sprogramjit.cpp \
+    $$PWD/sprogramvm.cpp \
+    $$PWD/slanerun.cpp \
+    $$PWD/srace.cpp \
+    $$PWD/sprogramlibrary.cpp \
+    $$PWD/sacceptance.cpp
+
+HEADERS += $$PWD/problem.h \
+    $$PWD/snode.h \
+    $$PWD/sevalengine.h \
+    $$PWD/sortedarray.h \
+    $$PWD/sresultcache.h \
+    $$PWD/sarena.h \
+    $$PWD/srunloop.h \
+    $$PWD/srun.h \
+    $$PWD/scounters.h \
+    $$PWD/sperfcounters.h \
+    $$PWD/strace.h \
+    $$PWD/shistogram.h \
+    $$PWD/scheckpoint.h \
+    $$PWD/sprogram.h \
+    $$PWD/sprogramjit.h \
+    $$PWD/sprogramvm.h \
+    $$PWD/slanerun.h \
+    $$PWD/slanerunloop.h \
+    $$PWD/srace.h \
+    $$PWD/sprogramlibrary.h \
+    $$PWD/sacceptance.h
@@ -1,18 +1,13 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "nodelistmodel.h"
 
 #include <QTimer>
-#include <QStringListModel>
 #include <QDateTime>
+#include <QFileDialog>
+#include <QMessageBox>
 
-enum PROBLEM {
-    PROBLEM_Multiplexer,
-    PROBLEM_EvenParity4,
-    PROBLEM_EvenParity5,
-    PROBLEM_EvenParity6,
-    PROBLEM_EvenParity7,
-    PROBLEM_SymbolRegression
-};
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent),
@@ -20,6 +15,12 @@ MainWindow::MainWindow(QWidget *parent)
 {
     _ui->setupUi(this);
 
+    // Uniform rows let the view lay out large populations without
+    // asking for every row
+    _nodeListModel = new NodeListModel(this);
+    _ui->nodeListView->setUniformItemSizes(true);
+    _ui->nodeListView->setModel(_nodeListModel);
+
     _sngpWorker.setProblem(new ProblemMultiplexer());
     _sngpWorker.reset();
 
@@ -31,15 +32,30 @@ MainWindow::MainWindow(QWidget *parent)
     connect(_ui->goTimes100Button, SIGNAL(clicked()), this, SLOT(goTimes100()));
     connect(_ui->resetButton, SIGNAL(clicked()), this, SLOT(reset()));
     connect(_ui->stepButton, SIGNAL(clicked()), this, SLOT(step()));
+    connect(_ui->saveButton, SIGNAL(clicked()), this, SLOT(saveCheckpoint()));
+    connect(_ui->loadButton, SIGNAL(clicked()), this, SLOT(loadCheckpoint()));
+    connect(_ui->exportButton, SIGNAL(clicked()), this, SLOT(exportProgram()));
+    connect(_ui->maxResidentRowsSpinBox, SIGNAL(valueChanged(int)),
+            this, SLOT(setMaxResidentRows(int)));
+    connect(_ui->semanticHashingCheckBox, SIGNAL(toggled(bool)),
+            this, SLOT(setSemanticHashing(bool)));
     connect(_ui->nodeListView, SIGNAL(clicked(const QModelIndex&)),
             this, SLOT(programSelected(const QModelIndex&)));
 
-    _ui->problemComboBox->addItem("Multiplexer 6", PROBLEM_Multiplexer);
-    _ui->problemComboBox->addItem("Even Parity 4", PROBLEM_EvenParity4);
-    _ui->problemComboBox->addItem("Even Parity 5", PROBLEM_EvenParity5);
-    _ui->problemComboBox->addItem("Even Parity 6", PROBLEM_EvenParity6);
-    _ui->problemComboBox->addItem("Even Parity 7", PROBLEM_EvenParity7);
-    _ui->problemComboBox->addItem("Symbolic Regression", PROBLEM_SymbolRegression);
+    // Each item holds the name of its problem, see Problem::create()
+    _ui->problemComboBox->addItem("Multiplexer 6", "multiplexer6");
+    _ui->problemComboBox->addItem("Even Parity 4", "parity4");
+    _ui->problemComboBox->addItem("Even Parity 5", "parity5");
+    _ui->problemComboBox->addItem("Even Parity 6", "parity6");
+    _ui->problemComboBox->addItem("Even Parity 7", "parity7");
+    _ui->problemComboBox->addItem("Symbolic Regression", "regression");
+    _ui->problemComboBox->addItem("Symbolic Regression (constants)",
+                                  "regression-constants");
+    _ui->problemComboBox->insertSeparator(_ui->problemComboBox->count());
+    QStringList benchmarks = Problem::getBenchmarkNames();
+    for (int i = 0; i < benchmarks.size(); ++i) {
+        _ui->problemComboBox->addItem(benchmarks.at(i), benchmarks.at(i));
+    }
 
     connect(_ui->problemComboBox, SIGNAL(activated(int)),
             this, SLOT(changeProblem(int)));
@@ -103,6 +119,73 @@ void MainWindow::step()
     }
 }
 
+void MainWindow::saveCheckpoint()
+{
+    if (_sngpWorker.isRunning()) {
+        pauseResume();
+    }
+    QString fileName = QFileDialog::getSaveFileName(
+        this, "Save Checkpoint", QString(), "Checkpoints (*.sngp)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (!_sngpWorker.saveCheckpoint(fileName)) {
+        QMessageBox::warning(this, "Save Checkpoint",
+                             QString("Can't write %1").arg(fileName));
+    }
+}
+
+void MainWindow::loadCheckpoint()
+{
+    if (_sngpWorker.isRunning()) {
+        pauseResume();
+    }
+    QString fileName = QFileDialog::getOpenFileName(
+        this, "Load Checkpoint", QString(), "Checkpoints (*.sngp)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QString error;
+    if (!_sngpWorker.loadCheckpoint(fileName, &error)) {
+        QMessageBox::warning(this, "Load Checkpoint", error);
+    }
+
+    int index = _ui->problemComboBox->findData(_sngpWorker.getProblemName());
+    if (index >= 0) {
+        _ui->problemComboBox->setCurrentIndex(index);
+    }
+    // The checkpoint has its own setting, show it without a reset
+    bool blocked = _ui->semanticHashingCheckBox->blockSignals(true);
+    _ui->semanticHashingCheckBox->setChecked(
+        _sngpWorker.getSemanticHashing());
+    _ui->semanticHashingCheckBox->blockSignals(blocked);
+    updateStats();
+    updateNodeList();
+}
+
+void MainWindow::exportProgram()
+{
+    if (_sngpWorker.isRunning()) {
+        pauseResume();
+    }
+    SProgram program =
+        _sngpWorker.getProgram(_ui->nodeListView->currentIndex().row());
+    if (program.isEmpty()) {
+        QMessageBox::warning(this, "Export Program",
+                             "Select a node to export its program");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(
+        this, "Export Program", QString(), "Programs (*.sngpprog)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (!SCheckpointFileWriter::writeFile(fileName, program.save())) {
+        QMessageBox::warning(this, "Export Program",
+                             QString("Can't write %1").arg(fileName));
+    }
+}
+
 void MainWindow::updateStats()
 {
     const SNodeStats& stats = _sngpWorker.getStats();
@@ -115,6 +198,14 @@ void MainWindow::updateStats()
         QString::number(stats.bestIndividualScoreEver));
     _ui->hitsLabel->setText(QString("%1/%2").
         arg(stats.hits).arg(stats.runs));
+    _ui->distinctNodesLabel->setText(
+        QString::number(stats.distinctNodes));
+    if (_ui->semanticHashingCheckBox->isChecked()) {
+        _ui->distinctOutputsLabel->setText(
+            QString::number(stats.distinctOutputs));
+    } else {
+        _ui->distinctOutputsLabel->setText("-");
+    }
     int64_t timeTakenMilliseconds = 0;
     if (stats.timeTakenMilliseconds == 0) {
         if (stats.startTimeMilliseconds > 0) {
@@ -126,7 +217,7 @@ void MainWindow::updateStats()
     }
     _ui->timeTakenLabel->setText(QString("%1").
         arg(timeTakenMilliseconds / 1000.0, 0, 'f', 4));
-
+    updateCounters(stats.counters);
 
     if (_sngpWorker.isRunning()) {
         _ui->stopGoButton->setText("Stop");
@@ -137,29 +228,54 @@ void MainWindow::updateStats()
     }
 }
 
+void MainWindow::updateCounters(const SCounters& counters)
+{
+    if (!SCounters::isEnabled()) {
+        QString disabled("Disabled (build with CONFIG+=counters)");
+        _ui->evaluatedLabel->setText(disabled);
+        _ui->acceptRateLabel->setText(disabled);
+        _ui->caseEvalsLabel->setText(disabled);
+        _ui->phaseTimeLabel->setText(disabled);
+        _ui->coneSizesLabel->setText(disabled);
+        _ui->generationLatencyLabel->setText(disabled);
+        return;
+    }
+
+    int64_t generations = std::max<int64_t>(counters.generations, 1);
+    _ui->evaluatedLabel->setText(QString("%1").
+        arg(double(counters.nodesEvaluated) / generations, 0, 'f', 1));
+    int64_t mutations = std::max<int64_t>(
+        counters.accepted + counters.rejected, 1);
+    _ui->acceptRateLabel->setText(QString("%1% (%2 restored)").
+        arg(100.0 * counters.accepted / mutations, 0, 'f', 1).
+        arg(counters.restores));
+
+    int64_t totalNsecs = 0;
+    QStringList phases;
+    for (int i = 0; i < SCounters::NumPhases; ++i) {
+        totalNsecs += counters.phaseNsecs[i];
+    }
+    for (int i = 0; i < SCounters::NumPhases; ++i) {
+        phases.append(QString("%1 %2%").
+            arg(SCounters::getPhaseName(SCounters::Phase(i))).
+            arg(100.0 * counters.phaseNsecs[i] /
+                std::max<int64_t>(totalNsecs, 1), 0, 'f', 0));
+    }
+    _ui->phaseTimeLabel->setText(phases.join(", "));
+    _ui->caseEvalsLabel->setText(QString("%1").
+        arg(totalNsecs ? counters.caseEvaluations * 1e9 / totalNsecs : 0.0,
+            0, 'g', 4));
+
+    _ui->coneSizesLabel->setText(counters.coneSizes.toString());
+    _ui->generationLatencyLabel->setText(
+        counters.generationNsecs.toString(1000, " us"));
+}
+
 void MainWindow::updateNodeList()
 {
-    QStringList nodeList;
-    const std::vector<SNode>& nodes = _sngpWorker.getNodes();
-    const std::vector<int>& values = _sngpWorker.getFitness();
-    if (nodes.size() > 0) {
-        for (int i = 0; i < (int)nodes.size(); ++i) {
-          const SNode& node = nodes[i];
-          QString nodeDetails;
-          int val = 0;
-          if ((int)values.size() > i) {
-              val = values[i];
-          }
-          nodeDetails = QString("%1: %2 score: %3").arg(i).
-                            arg(node.asString()).
-                            arg(val);
-          nodeList << nodeDetails;
-        }
-        QAbstractItemModel *model =
-                new QStringListModel(nodeList, _ui->nodeListView);
-        _ui->nodeListView->setModel(model);
-    } else {
-        _ui->nodeListView->reset();
+    SNodeDelta delta;
+    if (_sngpWorker.getNodeDelta(delta)) {
+        _nodeListModel->applyDelta(delta);
     }
 }
 
@@ -170,27 +286,10 @@ void MainWindow::programSelected(const QModelIndex& index)
 
 void MainWindow::changeProblem(int index)
 {
-    Problem* p = NULL;
-    switch((PROBLEM)_ui->problemComboBox->itemData(index).toInt()) {
-    case PROBLEM_EvenParity4:
-        p = new ProblemEvenParity(4);
-        break;
-    case PROBLEM_EvenParity5:
-        p = new ProblemEvenParity(5);
-        break;
-    case PROBLEM_EvenParity6:
-        p = new ProblemEvenParity(6);
-        break;
-    case PROBLEM_EvenParity7:
-        p = new ProblemEvenParity(7);
-        break;
-    case PROBLEM_SymbolRegression:
-        p = new ProblemSymbolicRegression();
-        break;
-    case PROBLEM_Multiplexer:
-        p = new ProblemMultiplexer();
-    default:
-        break;
+    Problem* p = Problem::create(
+        _ui->problemComboBox->itemData(index).toString());
+    if (!p) {
+        return;
     }
     if (_sngpWorker.isRunning()) {
         _sngpWorker.pause();
@@ -201,6 +300,25 @@ void MainWindow::changeProblem(int index)
     updateNodeList();
 }
 
+void MainWindow::setMaxResidentRows(int maxRows)
+{
+    // Takes effect when the problem is set up again
+    _sngpWorker.setMaxResidentRows(maxRows);
+    changeProblem(_ui->problemComboBox->currentIndex());
+}
+
+void MainWindow::setSemanticHashing(bool enable)
+{
+    // Takes effect from the start of a run
+    if (_sngpWorker.isRunning()) {
+        _sngpWorker.pause();
+    }
+    _sngpWorker.setSemanticHashing(enable);
+    _sngpWorker.reset();
+    updateStats();
+    updateNodeList();
+}
+
 void MainWindow::showProgram(int index)
 {
     QString text = _sngpWorker.getProgramAsText(index);
@@ -9,6 +9,7 @@ class MainWindow;
 }
 
 class QModelIndex;
+class NodeListModel;
 
 class MainWindow : public QMainWindow
 {
@@ -24,17 +25,24 @@ private slots:
     void goTimes10();
     void goTimes100();
     void step();
+    void saveCheckpoint();
+    void loadCheckpoint();
+    void exportProgram();
     void updateStats();
     void programSelected(const QModelIndex &index);
     void changeProblem(int index);
+    void setMaxResidentRows(int maxRows);
+    void setSemanticHashing(bool enable);
 
 private:
     void goTimes(int times);
     void updateNodeList();
+    void updateCounters(const SCounters& counters);
     void showProgram(int index);
 
     QTimer* _timer;
     Ui::MainWindow* _ui;
+    NodeListModel* _nodeListModel;
     SNGPWorker _sngpWorker;
 };
 
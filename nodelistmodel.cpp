@@ -0,0 +1,48 @@
+#include "nodelistmodel.h"
+
+NodeListModel::NodeListModel(QObject *parent)
+  : QAbstractListModel(parent)
+{
+}
+
+void NodeListModel::applyDelta(const SNodeDelta& delta)
+{
+    if (delta.reset) {
+        beginResetModel();
+        _nodes = delta.nodes;
+        _fitness = delta.fitness;
+        _fitness.resize(_nodes.size(), 0);
+        endResetModel();
+        return;
+    }
+    if (delta.indices.empty()) {
+        return;
+    }
+    for (size_t k = 0; k < delta.indices.size(); ++k) {
+        int i = delta.indices[k];
+        _nodes[i] = delta.nodes[k];
+        _fitness[i] = delta.fitness[k];
+    }
+
+    // One signal for the lot, the view only repaints the visible
+    // rows in the range
+    emit dataChanged(index(delta.indices.front()),
+                     index(delta.indices.back()));
+}
+
+int NodeListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : (int)_nodes.size();
+}
+
+QVariant NodeListModel::data(const QModelIndex& index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() ||
+        index.row() >= (int)_nodes.size()) {
+        return QVariant();
+    }
+    int i = index.row();
+    return QString("%1: %2 score: %3").arg(i).
+        arg(_nodes[i].asString()).
+        arg(_fitness[i]);
+}
@@ -0,0 +1,37 @@
+#ifndef NODELISTMODEL_H
+#define NODELISTMODEL_H
+
+#include <QAbstractListModel>
+#include <vector>
+
+#include "sngpworker.h"
+
+/*
+ * List of the nodes in the population and their fitness, for the
+ * node list view.
+ *
+ * Rows are formatted when the view asks for them, so only the
+ * visible ones are, and the model is updated from the nodes that
+ * changed (see SNGPWorker::getNodeDelta()) rather than rebuilt.
+ */
+class NodeListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit NodeListModel(QObject *parent = 0);
+
+    /*
+     * Update the nodes, the view is told which rows changed.
+     */
+    void applyDelta(const SNodeDelta& delta);
+
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex& index,
+                          int role = Qt::DisplayRole) const;
+
+private:
+    std::vector<SNode> _nodes;
+    std::vector<int> _fitness;
+};
+
+#endif // NODELISTMODEL_H
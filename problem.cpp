@@ -1,62 +1,719 @@
 #include "problem.h"
+#include "slanerunloop.h"
+#include "sprogram.h"
+
+#include <QFile>
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Prefix of the names of problems loaded from a table file
+static const char TablePrefix[] = "table:";
+
+// Generations between refreshes of the hot flags.  A node's flag is
+// set when it's evaluated, but its fan-out also changes when the
+// nodes linking to it mutate.
+static const int HotRefreshInterval = 1024;
+
+// Regression benchmarks of Koza and of Uy et al. (the Nguyen suite),
+// those that only need the four arithmetic ops, over the integers
+// from RegressionMinX to RegressionMaxX rather than reals in [-1, 1]
+static int koza1(int x) { return x * x * x * x + x * x * x + x * x + x; }
+static int koza2(int x) { return x * x * x * x * x - 2 * x * x * x + x; }
+static int koza3(int x)
+{
+    return x * x * x * x * x * x - 2 * x * x * x * x + x * x;
+}
+static int nguyen1(int x) { return x * x * x + x * x + x; }
+static int nguyen3(int x) { return x * koza1(x) + x; }
+static int nguyen4(int x) { return x * nguyen3(x) + x; }
+
+static const int RegressionMinX = -8;
+static const int RegressionMaxX = 8;
+
+static const struct {
+    const char* name;
+    ProblemSymbolicRegression::TargetFunc target;
+} RegressionBenchmarks[] = {
+    { "regression-koza1", koza1 },
+    { "regression-koza2", koza2 },
+    { "regression-koza3", koza3 },
+    { "regression-nguyen1", nguyen1 },
+    { "regression-nguyen2", koza1 },
+    { "regression-nguyen3", nguyen3 },
+    { "regression-nguyen4", nguyen4 }
+};
+static const int NumRegressionBenchmarks =
+    sizeof(RegressionBenchmarks) / sizeof(RegressionBenchmarks[0]);
+
+// Number of bits set in 'value'
+static inline int popCount(uint32_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(value);
+#elif defined(_MSC_VER)
+    return int(__popcnt(value));
+#else
+    value = value - ((value >> 1) & 0x55555555u);
+    value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+    return int((((value + (value >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24);
+#endif
+}
 
 Problem::Problem()
-  : _numInputs(0)
+  : _numInputs(0),
+    _maxResidentRows(0),
+    _numRecomputedRows(0),
+    _numEvaluatedRows(0),
+    _hotFanOut(8),
+    _hotRefreshCountdown(HotRefreshInterval),
+    _unlinkedValue(0),
+    _semanticHashing(false),
+    _numDistinctOutputs(0)
 {
 }
 
 Problem::~Problem()
 {
-    for (size_t i = 0; i < _testCases.size(); ++i) {
-        delete [] _testCases[i].inputs;
+}
+
+QStringList Problem::getProblemNames()
+{
+    QStringList names;
+    names << "multiplexer6"
+          << "parity4" << "parity5" << "parity6" << "parity7"
+          << "regression" << "regression-constants";
+    return names;
+}
+
+QStringList Problem::getBenchmarkNames()
+{
+    QStringList names;
+    names << "multiplexer11" << "multiplexer20" << "multiplexer37";
+    for (int i = 8; i <= ProblemTruthTable::MaxInputs; ++i) {
+        names << QString("parity%1").arg(i);
+    }
+    for (int i = 0; i < NumRegressionBenchmarks; ++i) {
+        names << RegressionBenchmarks[i].name;
+    }
+    return names;
+}
+
+Problem* Problem::create(const QString& name)
+{
+    if (name == "multiplexer6") {
+        return new ProblemMultiplexer();
+    } else if (name == "parity4") {
+        return new ProblemEvenParity(4);
+    } else if (name == "parity5") {
+        return new ProblemEvenParity(5);
+    } else if (name == "parity6") {
+        return new ProblemEvenParity(6);
+    } else if (name == "parity7") {
+        return new ProblemEvenParity(7);
+    } else if (name == "regression") {
+        return new ProblemSymbolicRegression();
+    } else if (name == "regression-constants") {
+        return new ProblemSymbolicRegression(true);
+    } else if (ProblemTruthTable::isBenchmarkName(name)) {
+        ProblemTruthTable* problem = new ProblemTruthTable();
+        problem->generate(name);
+        return problem;
+    } else if (name.startsWith(TablePrefix)) {
+        ProblemTruthTable* problem = new ProblemTruthTable();
+        if (problem->load(name.mid(strlen(TablePrefix)))) {
+            return problem;
+        }
+        delete problem;
+    }
+    for (int i = 0; i < NumRegressionBenchmarks; ++i) {
+        if (name == RegressionBenchmarks[i].name) {
+            return new ProblemSymbolicRegression(
+                name, RegressionBenchmarks[i].target,
+                RegressionMinX, RegressionMaxX);
+        }
+    }
+    return NULL;
+}
+
+bool Problem::isProblemName(const QString& name, QString* outError)
+{
+    if (getProblemNames().contains(name) ||
+        getBenchmarkNames().contains(name) ||
+        ProblemTruthTable::isBenchmarkName(name)) {
+        return true;
+    }
+    if (name.startsWith(TablePrefix)) {
+        ProblemTruthTable problem;
+        return problem.load(name.mid(strlen(TablePrefix)), outError);
     }
+    if (outError) {
+        *outError = QString("Unknown problem %1").arg(name);
+    }
+    return false;
 }
 
 int* Problem::getInputs(int fitnessCase)
 {
-    return _testCases[fitnessCase].inputs;
+    return &_inputs[fitnessCase * _numInputs];
+}
+
+int* Problem::addTestCase()
+{
+    _inputs.resize(_inputs.size() + _numInputs);
+    return &_inputs[_inputs.size() - _numInputs];
+}
+
+size_t Problem::getArenaSize(int numNodes)
+{
+    return SResultCache::getArenaSize(numNodes, getNumFitnessCases(),
+                                      _maxResidentRows);
+}
+
+void Problem::initTestCaseResults(int numNodes, SArena* arena)
+{
+    // Initialize the result rows for each node.  Input rows can't
+    // be recomputed so they are always kept.
+    _results.init(numNodes, getNumFitnessCases(), _maxResidentRows, arena);
+    for (int i = 0; i < getNumInputs(); ++i) {
+        int* results = _results.allocate(i);
+        _results.pin(i);
+        for (int j = 0; j < getNumFitnessCases(); ++j) {
+            results[j] = getInputs(j)[i];
+        }
+    }
+    _numRecomputedRows = 0;
+    _numEvaluatedRows = 0;
+    _hotRefreshCountdown = HotRefreshInterval;
+    _recomputeVisited.assign(numNodes, 0);
+    _constValues.assign(numNodes, 0);
+    _outputHashes.assign(numNodes, 0);
+    _outputCounts.clear();
+    _numDistinctOutputs = 0;
+    _rowNodes.resize(numNodes);
+    for (int i = 0; i < numNodes; ++i) {
+        _rowNodes[i] = i;
+    }
+    _sharedHeads.assign(numNodes, -1);
+    _sharedNext.assign(numNodes, -1);
+    _sharedPrev.assign(numNodes, -1);
+    _hashRows.clear();
+}
+
+int* Problem::restoreNodeResults(const SEvalEngine &engine, int i)
+{
+    int* results = _results.allocate(i);
+    if (_results.isBounded()) {
+        _results.setHot(i, engine.getFanOut(i) >= _hotFanOut);
+    }
+    return results;
+}
+
+void Problem::shareRestoredRows(const SEvalEngine &engine)
+{
+    if (!_semanticHashing) {
+        return;
+    }
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    int numNodes = engine.getNodes().size();
+    for (int i = _numInputs; i < numNodes; ++i) {
+        if (canonNodes[i] == i && !constNodes[i]) {
+            shareRow(engine, i);
+        }
+    }
+}
+
+void Problem::refreshHotNodes(const SEvalEngine &engine)
+{
+    _hotRefreshCountdown = HotRefreshInterval;
+    // Clear the stale flags first to make room for the new ones
+    int numNodes = engine.getNodes().size();
+    for (int i = _numInputs; i < numNodes; ++i) {
+        if (_results.isHot(i) && engine.getFanOut(i) < _hotFanOut) {
+            _results.setHot(i, false);
+        }
+    }
+    for (int i = _numInputs; i < numNodes; ++i) {
+        if (!_results.isHot(i) && engine.getFanOut(i) >= _hotFanOut &&
+                _results.isResident(i)) {
+            _results.setHot(i, true);
+        }
+    }
+}
+
+void Problem::restoreOutputHash(int i, uint64_t hash)
+{
+    _outputHashes[i] = hash;
+    if (_outputCounts[hash]++ == 0) {
+        _numDistinctOutputs++;
+    }
+}
+
+void Problem::updateOutputHash(const SEvalEngine &engine, int i, bool replace)
+{
+    if (replace) {
+        std::unordered_map<uint64_t, int>::iterator it =
+                _outputCounts.find(_outputHashes[i]);
+        if (it != _outputCounts.end() && --it->second == 0) {
+            _outputCounts.erase(it);
+            _numDistinctOutputs--;
+        }
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    int canon = engine.getCanonicalNodes()[i];
+    if (canon != i) {
+        hash = _outputHashes[canon];
+    } else {
+        int numTestCases = _outputs.size();
+        bool constant = engine.getConstantNodes()[i];
+        const int* results = constant ? &_constValues[i] : _results.find(i);
+        for (int j = 0; j < numTestCases; ++j) {
+            hash ^= (uint32_t) results[constant ? 0 : j];
+            hash *= 1099511628211ull;
+        }
+    }
+    _outputHashes[i] = hash;
+    if (_outputCounts[hash]++ == 0) {
+        _numDistinctOutputs++;
+    }
 }
 
-void Problem::initTestCaseResults(int numNodes)
+void Problem::shareRow(const SEvalEngine &engine, int i)
 {
-    // Initialize the result sets for each test case.
-    _testCaseResults.resize(getNumFitnessCases());
-    for (int i = 0; i < getNumFitnessCases(); ++i) {
-        std::vector<int>& results = getTestCaseResults(i);
-        results.resize(numNodes);
-        int* inputs = getInputs(i);
-        for (int j = 0; j < getNumInputs(); ++j) {
-            results[j] = inputs[j];
+    const int* results = _results.find(i);
+    if (!results) {
+        return;
+    }
+    uint64_t hash = _outputHashes[i];
+    std::unordered_map<uint64_t, int>::iterator it = _hashRows.find(hash);
+    if (it == _hashRows.end()) {
+        _hashRows[hash] = i;
+        return;
+    }
+
+    // The entry may be stale, the node may since have changed, lost
+    // its row or been evicted
+    int holder = it->second;
+    const int* shared = holder != i ? _results.find(holder) : 0;
+    if (!shared || _rowNodes[holder] != holder ||
+            _outputHashes[holder] != hash ||
+            engine.getConstantNodes()[holder]) {
+        it->second = i;
+        return;
+    }
+    if (memcmp(results, shared, sizeof(int) * _outputs.size()) != 0) {
+        // Hash collision
+        return;
+    }
+    if (holder < i) {
+        moveSharedRow(i, holder);
+    } else {
+        moveSharedRow(holder, i);
+        it->second = i;
+    }
+}
+
+void Problem::unshareRow(const SEvalEngine &engine, int i)
+{
+    if (_rowNodes[i] != i) {
+        removeSharedRow(i);
+        return;
+    }
+    int head = _sharedHeads[i];
+    if (head < 0) {
+        return;
+    }
+
+    // Hand the row on to the lowest of the nodes sharing it
+    int holder = head;
+    for (int s = _sharedNext[head]; s >= 0; s = _sharedNext[s]) {
+        holder = std::min(holder, s);
+    }
+    removeSharedRow(holder);
+    const int* results = _results.find(i);
+    if (results) {
+        _results.pin(i);
+        int* row = _results.allocate(holder);
+        if (_results.isBounded()) {
+            _results.setHot(holder, engine.getFanOut(holder) >= _hotFanOut);
         }
-        for (size_t j = getNumInputs(); j < results.size(); ++j) {
-            results[j] = 0;
+        memcpy(row, results, sizeof(int) * _outputs.size());
+        _results.unpin(i);
+    }
+    // else the row was evicted and the new holder recomputes it
+    int next;
+    for (int s = _sharedHeads[i]; s >= 0; s = next) {
+        next = _sharedNext[s];
+        addSharedRow(s, holder);
+    }
+    _sharedHeads[i] = -1;
+
+    std::unordered_map<uint64_t, int>::iterator it =
+            _hashRows.find(_outputHashes[i]);
+    if (it != _hashRows.end() && it->second == i) {
+        it->second = holder;
+    }
+}
+
+void Problem::addSharedRow(int i, int holder)
+{
+    _rowNodes[i] = holder;
+    int head = _sharedHeads[holder];
+    _sharedNext[i] = head;
+    _sharedPrev[i] = -1;
+    if (head >= 0) {
+        _sharedPrev[head] = i;
+    }
+    _sharedHeads[holder] = i;
+}
+
+void Problem::removeSharedRow(int i)
+{
+    int next = _sharedNext[i];
+    int prev = _sharedPrev[i];
+    if (prev >= 0) {
+        _sharedNext[prev] = next;
+    } else {
+        _sharedHeads[_rowNodes[i]] = next;
+    }
+    if (next >= 0) {
+        _sharedPrev[next] = prev;
+    }
+    _rowNodes[i] = i;
+}
+
+void Problem::moveSharedRow(int from, int to)
+{
+    int next;
+    for (int s = _sharedHeads[from]; s >= 0; s = next) {
+        next = _sharedNext[s];
+        addSharedRow(s, to);
+    }
+    _sharedHeads[from] = -1;
+    _results.release(from);
+    addSharedRow(from, to);
+}
+
+template<Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness,
+         int constMask>
+int Problem::_evaluateRows(SNode::Op op,
+                           const int* values0, const int* values1,
+                           const int* values2, const int* outputs,
+                           int* outResults, int begin, int end)
+{
+    int const0 = values0[0];
+    int const1 = values1[0];
+    int const2 = values2[0];
+    int fitness = 0;
+
+    for (int i = begin; i < end; ++i) {
+        int val0 = (constMask & 1) ? const0 : values0[i];
+        int val1 = (constMask & 2) ? const1 : values1[i];
+        int val2 = (constMask & 4) ? const2 : values2[i];
+        int result = evalNode(op, val0, val1, val2);
+        if (calcFitness != _noFitness) {
+            fitness += calcFitness(result, outputs[i]);
         }
+        outResults[i] = result;
     }
+    return fitness;
 }
 
 template<Problem::EvalNodeFunc evalNode,
          Problem::CalcFitnessFunc calcFitness>
-void Problem::_evaluateAll(const std::vector<SNode>& nodes,
-                           std::vector<int>& outFitness)
+int Problem::_evaluateOp(SNode::Op op, const int* const values[3],
+                         int constMask, const int* outputs,
+                         int* outResults, int begin, int end)
+{
+    switch (constMask) {
+    case 0:
+        return _evaluateRows<evalNode, calcFitness, 0>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 1:
+        return _evaluateRows<evalNode, calcFitness, 1>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 2:
+        return _evaluateRows<evalNode, calcFitness, 2>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 3:
+        return _evaluateRows<evalNode, calcFitness, 3>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 4:
+        return _evaluateRows<evalNode, calcFitness, 4>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 5:
+        return _evaluateRows<evalNode, calcFitness, 5>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    case 6:
+        return _evaluateRows<evalNode, calcFitness, 6>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    default:
+        return _evaluateRows<evalNode, calcFitness, 7>(op, values[0],
+                values[1], values[2], outputs, outResults, begin, end);
+    }
+}
+
+template<Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+int Problem::_evaluateNode(const SEvalEngine &engine, int i)
 {
-    int numTestCases = _testCases.size();
-    int result = 0;
+    const SNode& node = engine.getNodes()[i];
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    int numTestCases = _outputs.size();
+
+    // Gather the param rows, constant params only have one value
+    const int* values[3];
+    int rowNodes[3];
+    int constMask = 0;
+    for (int k = 0; k < 3; ++k) {
+        if (k < node.getNumLinks()) {
+            int p = canonNodes[node.param[k]];
+            if (constNodes[p]) {
+                values[k] = &_constValues[p];
+                constMask |= 1 << k;
+            } else {
+                p = _rowNodes[p];
+                values[k] = _getResults<evalNode, calcFitness>(engine, p);
+                _results.pin(p);
+                rowNodes[k] = p;
+            }
+        } else {
+            values[k] = &_unlinkedValue;
+            constMask |= 1 << k;
+        }
+    }
 
-    for (size_t i = _numInputs; i < nodes.size(); ++i) {
+    if (constNodes[i]) {
+        // Same value for every test case, so evaluate it once
+        int result = 0;
+        if (node.op == SNode::ValOp) {
+            result = node.param[0];
+        } else {
+            result = evalNode(node.op, values[0][0],
+                              values[1][0], values[2][0]);
+        }
+        _constValues[i] = result;
+        _results.release(i);
         int fitness = 0;
-        const SNode& node = nodes[i];
-        SNode::Op op = node.op;
-        int p1 = node.param[0];
-        int p2 = node.param[1];
-        int p3 = node.param[2];
         for (int j = 0; j < numTestCases; ++j) {
-            std::vector<int>& results = _testCaseResults[j];
-            int expectedOutput = getOutput(j);
-            result = evalNode(op, p1, p2, p3, results);
-            fitness += calcFitness(result, expectedOutput);
-            results[i] = result;
+            fitness += calcFitness(result, getOutput(j));
+        }
+        return fitness;
+    }
+
+    int* results = _results.allocate(i);
+    if (_results.isBounded()) {
+        _results.setHot(i, engine.getFanOut(i) >= _hotFanOut);
+    }
+    _numEvaluatedRows++;
+
+    int fitness = 0;
+    if (node.op == SNode::ValOp) {
+        // Only without deduplication, otherwise values are constant
+        for (int j = 0; j < numTestCases; ++j) {
+            results[j] = node.param[0];
+            fitness += calcFitness(results[j], getOutput(j));
+        }
+        return fitness;
+    }
+    fitness = _evaluateOp<evalNode, calcFitness>(node.op, values,
+            constMask, &_outputs[0], results, 0, numTestCases);
+
+    for (int k = 0; k < 3; ++k) {
+        if (!(constMask & (1 << k))) {
+            _results.unpin(rowNodes[k]);
+        }
+    }
+    return fitness;
+}
+
+template<Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+int* Problem::_getResults(const SEvalEngine &engine, int i)
+{
+    int* results = _results.find(i);
+    if (results) {
+        return results;
+    }
+
+    // Find every evicted row needed to recompute this one
+    const std::vector<SNode>& nodes = engine.getNodes();
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    _recomputeStack.push_back(i);
+    while (!_recomputeStack.empty()) {
+        int j = _recomputeStack.back();
+        _recomputeStack.pop_back();
+        if (_recomputeVisited[j]) {
+            continue;
+        }
+        _recomputeVisited[j] = 1;
+        _recomputeNodes.push_back(j);
+        const SNode& node = nodes[j];
+        for (int k = 0; k < node.getNumLinks(); ++k) {
+            int p = canonNodes[node.param[k]];
+            if (constNodes[p]) {
+                continue;
+            }
+            p = _rowNodes[p];
+            if (_recomputeVisited[p]) {
+                continue;
+            }
+            if (_results.find(p)) {
+                // Keep it until the recompute is done
+                _results.pin(p);
+                _recomputePinned.push_back(p);
+            } else {
+                _recomputeStack.push_back(p);
+            }
+        }
+    }
+
+    // Params have lower indices, so recompute in index order.
+    // Recomputed rows stay pinned until all are done.
+    std::sort(_recomputeNodes.begin(), _recomputeNodes.end());
+    for (size_t k = 0; k < _recomputeNodes.size(); ++k) {
+        int j = _recomputeNodes[k];
+        _evaluateNode<evalNode, calcFitness>(engine, j);
+        _results.pin(j);
+        _recomputeVisited[j] = 0;
+    }
+    for (size_t k = 0; k < _recomputeNodes.size(); ++k) {
+        _results.unpin(_recomputeNodes[k]);
+    }
+    for (size_t k = 0; k < _recomputePinned.size(); ++k) {
+        _results.unpin(_recomputePinned[k]);
+    }
+    _numRecomputedRows += _recomputeNodes.size();
+    _recomputeNodes.clear();
+    _recomputePinned.clear();
+
+    return _results.find(i);
+}
+
+template<Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+void Problem::_evaluateAll(const SEvalEngine &engine,
+                           std::vector<int>& outFitness)
+{
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    int numNodes = engine.getNodes().size();
+    _outputCounts.clear();
+    _numDistinctOutputs = 0;
+    for (int i = 0; i < numNodes; ++i) {
+        _rowNodes[i] = i;
+        _sharedHeads[i] = -1;
+    }
+    _hashRows.clear();
+    for (int i = _numInputs; i < numNodes; ++i) {
+        if (canonNodes[i] != i) {
+            outFitness[i] = outFitness[canonNodes[i]];
+            _results.release(i);
+        } else {
+            outFitness[i] = _evaluateNode<evalNode, calcFitness>(engine, i);
+        }
+        if (_semanticHashing) {
+            updateOutputHash(engine, i, false);
+            if (canonNodes[i] == i && !constNodes[i]) {
+                shareRow(engine, i);
+            }
         }
-        outFitness[i] = fitness;
+    }
+    _results.trim();
+}
+
+template<Problem::EvalNodeFunc evalNode>
+void Problem::_evaluateProgram(const SProgram& program, const int* inputs,
+                               int numRows, int* outResults) const
+{
+    const std::vector<SNode>& instructions = program.getInstructions();
+    int numInputs = program.getNumInputs();
+    int numSlots = numInputs + instructions.size();
+    int outputSlot = program.getOutputSlot();
+
+    // Instructions whose params are all constant have the same
+    // value for every row, evaluate them once up front
+    std::vector<char> constSlots(numSlots, 0);
+    std::vector<int> constValues(numSlots + 1, 0);
+    const int unlinked = numSlots;
+    for (int k = 0; k < (int)instructions.size(); ++k) {
+        const SNode& instruction = instructions[k];
+        int slot = numInputs + k;
+        if (instruction.op == SNode::ValOp) {
+            constSlots[slot] = 1;
+            constValues[slot] = instruction.param[0];
+            continue;
+        }
+        int values[3];
+        bool constant = true;
+        for (int j = 0; j < 3; ++j) {
+            int p = j < instruction.getNumLinks() ? instruction.param[j]
+                                                  : unlinked;
+            constant = constant && (p == unlinked || constSlots[p]);
+            values[j] = constValues[p];
+        }
+        if (constant) {
+            constSlots[slot] = 1;
+            constValues[slot] = evalNode(instruction.op, values[0],
+                                         values[1], values[2]);
+        }
+    }
+    if (outputSlot >= numInputs && constSlots[outputSlot]) {
+        std::fill(outResults, outResults + numRows, constValues[outputSlot]);
+        return;
+    }
+
+    // The results of every slot for a block of rows
+    std::vector<int> columns(numSlots * ProgramBlockRows);
+    for (int row = 0; row < numRows; row += ProgramBlockRows) {
+        int blockRows = std::min<int>(ProgramBlockRows, numRows - row);
+
+        // Transpose the input rows into columns
+        const int* blockInputs = inputs + (size_t)row * numInputs;
+        for (int i = 0; i < blockRows; ++i) {
+            for (int j = 0; j < numInputs; ++j) {
+                columns[j * ProgramBlockRows + i] =
+                        blockInputs[i * numInputs + j];
+            }
+        }
+
+        for (int k = 0; k < (int)instructions.size(); ++k) {
+            int slot = numInputs + k;
+            if (constSlots[slot]) {
+                continue;
+            }
+            const SNode& instruction = instructions[k];
+            const int* values[3];
+            int constMask = 0;
+            for (int j = 0; j < 3; ++j) {
+                int p = j < instruction.getNumLinks() ? instruction.param[j]
+                                                      : unlinked;
+                if (p == unlinked || constSlots[p]) {
+                    values[j] = &constValues[p];
+                    constMask |= 1 << j;
+                } else {
+                    values[j] = &columns[p * ProgramBlockRows];
+                }
+            }
+            int* results = &columns[slot * ProgramBlockRows];
+            // Instructions with only constant params were folded above
+            _evaluateOp<evalNode, _noFitness>(instruction.op, values,
+                    constMask, NULL, results, 0, blockRows);
+        }
+
+        const int* output = &columns[outputSlot * ProgramBlockRows];
+        std::copy(output, output + blockRows, outResults + row);
     }
 }
 
@@ -70,49 +727,141 @@ int ProblemCalcFitness(int value, int expectedOutput)
 
 template<Problem::EvalNodeFunc evalNode,
          Problem::CalcFitnessFunc calcFitness>
-void Problem::_evaluate(const std::vector<SNode>& nodes,
+void Problem::_evaluate(const SEvalEngine &engine,
                         const SortedArray<int>& changedNodes,
                         std::vector<int>& outFitness)
 {
-    int numTestCases = _testCases.size();
-    int result = 0;
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    bool hashing = _semanticHashing && _numDistinctOutputs > 0;
+    // Without semantic hashing no row is ever shared
+    bool sharing = hashing || !_hashRows.empty();
 
     // Calculate fitness values for all test cases
     int* nodeIndices = changedNodes.data();
     for (int k = 0; k < changedNodes.size(); ++k) {
         int j = nodeIndices[k];
-        int fitness = 0;
-        const SNode& node = nodes[j];
-        SNode::Op op = node.op;
-        int p1 = node.param[0];
-        int p2 = node.param[1];
-        int p3 = node.param[2];
-        for (int i = 0; i < numTestCases; ++i) {
-            std::vector<int>& results = _testCaseResults[i];
-            int expectedOutput = getOutput(i);
-            result = evalNode(op, p1, p2, p3, results);
-            fitness += calcFitness(result, expectedOutput);
-            results[j] = result;
+        if (sharing) {
+            unshareRow(engine, j);
+        }
+        if (canonNodes[j] != j) {
+            // Duplicate node, share the results of the original
+            outFitness[j] = outFitness[canonNodes[j]];
+            _results.release(j);
+        } else {
+            outFitness[j] = _evaluateNode<evalNode, calcFitness>(engine, j);
+        }
+        if (hashing) {
+            updateOutputHash(engine, j, true);
+            if (canonNodes[j] == j && !constNodes[j]) {
+                shareRow(engine, j);
+            }
         }
-        outFitness[j] = fitness;
+    }
+    _results.trim();
+    if (_results.isBounded() && --_hotRefreshCountdown <= 0) {
+        refreshHotNodes(engine);
     }
 }
 
-ProblemMultiplexer::ProblemMultiplexer()
-{
-    init();
-}
-
-bool ProblemMultiplexer::hitTargetFitness(const std::vector<int> &values)
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+bool ProblemT<Derived, evalNode, calcFitness>::hitTargetFitness(
+        const std::vector<int> &values)
 {
+    Derived* problem = static_cast<Derived*>(this);
     for (size_t i = _numInputs; i < values.size(); ++i) {
-        if (values[i] >= (1 << _numInputs)) {
+        if (problem->isTargetFitness(values[i])) {
             return true;
         }
     }
     return false;
 }
 
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+int ProblemT<Derived, evalNode, calcFitness>::getResultsFitness(
+        const std::vector<int>& results, bool* outHit)
+{
+    int fitness = 0;
+    for (size_t i = 0; i < results.size() && i < _outputs.size(); ++i) {
+        fitness += calcFitness(results[i], _outputs[i]);
+    }
+    if (outHit) {
+        *outHit = results.size() == _outputs.size() &&
+                  static_cast<Derived*>(this)->isTargetFitness(fitness);
+    }
+    return fitness;
+}
+
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+void ProblemT<Derived, evalNode, calcFitness>::evaluate(
+        const SEvalEngine& engine,
+        std::vector<int>& outFitness)
+{
+    evaluateAllNodes(engine, outFitness);
+}
+
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+void ProblemT<Derived, evalNode, calcFitness>::evaluate(
+        const SEvalEngine& engine,
+        const SortedArray<int>& changedNodes,
+        std::vector<int>& outFitness)
+{
+    evaluateChangedNodes(engine, changedNodes, outFitness);
+}
+
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+void ProblemT<Derived, evalNode, calcFitness>::evaluateProgram(
+        const SProgram& program,
+        const int* inputs,
+        int numRows,
+        int* outResults) const
+{
+    _evaluateProgram<evalNode>(program, inputs, numRows, outResults);
+}
+
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+SRunResult ProblemT<Derived, evalNode, calcFitness>::runGenerations(
+        SEvalEngine &engine,
+        std::vector<int> &fitness,
+        SNodeStats &stats,
+        SAcceptance *acceptance,
+        int maxGenerations,
+        int count,
+        const SDeadline *deadline)
+{
+    return SRunLoop<Derived>::run(*static_cast<Derived*>(this), engine,
+                                  fitness, stats, acceptance,
+                                  maxGenerations, count, deadline);
+}
+
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+void ProblemT<Derived, evalNode, calcFitness>::runLaneGenerations(
+        SLaneRun& lanes,
+        int count)
+{
+    SLaneRunLoop<Derived>::run(*static_cast<Derived*>(this), lanes, count);
+}
+
+ProblemMultiplexer::ProblemMultiplexer()
+{
+    _name = "multiplexer6";
+    init();
+}
+
 void ProblemMultiplexer::init()
 {
     _ops.push_back(SNode::AndOp);
@@ -121,24 +870,17 @@ void ProblemMultiplexer::init()
     _ops.push_back(SNode::IfOp);
     _numInputs = 6;
     for (int i = 0; i < 64; ++i) {
-        TestCase t;
-        t.inputs = new int[_numInputs];
+        int* inputs = addTestCase();
         for (int j = 0; j < _numInputs; ++j) {
-            t.inputs[j] = ((1 << (_numInputs - 1 - j)) & i) ? 1 : 0;
+            inputs[j] = ((1 << (_numInputs - 1 - j)) & i) ? 1 : 0;
         }
-        _outputs.push_back(t.inputs[((t.inputs[0] << 1) | t.inputs[1]) + 2]);
-        _testCases.push_back(t);
+        _outputs.push_back(inputs[((inputs[0] << 1) | inputs[1]) + 2]);
     }
-    _testCaseResults.resize(_testCases.size());
 }
 
 int ProblemMultiplexerEvalNode(SNode::Op op,
-                               int p1, int p2, int p3,
-                               const std::vector<int> &values)
+                               int val0, int val1, int val2)
 {
-    int val0 = values[p1];
-    int val1 = values[p2];
-    int val2 = values[p3];
     switch (op) {
     case SNode::NotOp:
         if (val0) {
@@ -171,23 +913,26 @@ int ProblemMultiplexerEvalNode(SNode::Op op,
     return 0;
 }
 
-void ProblemMultiplexer::evaluate(const std::vector<SNode>& nodes,
-                                  std::vector<int>& outFitness)
-{
-    _evaluateAll<ProblemMultiplexerEvalNode,
-                 ProblemCalcFitness>(nodes, outFitness);
-}
-
-void ProblemMultiplexer::evaluate(const std::vector<SNode>& nodes,
-                                  const SortedArray<int>& changedNodes,
-                                  std::vector<int>& outFitness)
+Problem::OpKernel ProblemMultiplexer::getOpKernel(SNode::Op op) const
 {
-    _evaluate<ProblemMultiplexerEvalNode,
-              ProblemCalcFitness>(nodes, changedNodes, outFitness);
+    // As ProblemMultiplexerEvalNode(), Not returns its param's truth
+    switch (op) {
+    case SNode::NotOp:
+        return TruthKernel;
+    case SNode::OrOp:
+        return OrKernel;
+    case SNode::AndOp:
+        return AndKernel;
+    case SNode::IfOp:
+        return IfKernel;
+    default:
+        return ZeroKernel;
+    }
 }
 
 ProblemEvenParity::ProblemEvenParity(int inputs)
 {
+    _name = QString("parity%1").arg(inputs);
     _numInputs = inputs;
     init();
 }
@@ -200,36 +945,20 @@ void ProblemEvenParity::init()
     _ops.push_back(SNode::NorOp);
 
     for (int i = 0; i < (1 << _numInputs); ++i) {
-        TestCase t;
-        t.inputs = new int[_numInputs];
+        int* inputs = addTestCase();
         int bitsSet = 0;
         for (int j = 0; j < _numInputs; ++j) {
-            t.inputs[j] = ((1 << (_numInputs - 1 - j)) & i) ? 1 : 0;
-            if (t.inputs[j]) bitsSet+= 1;
+            inputs[j] = ((1 << (_numInputs - 1 - j)) & i) ? 1 : 0;
+            if (inputs[j]) bitsSet+= 1;
         }
 
         _outputs.push_back(bitsSet & 1);
-        _testCases.push_back(t);
-    }
-    _testCaseResults.resize(_testCases.size());
-}
-
-bool ProblemEvenParity::hitTargetFitness(const std::vector<int> &values)
-{
-    for (size_t i = _numInputs; i < values.size(); ++i) {
-         if (values[i] >= (1 << _numInputs)) {
-             return true;
-         }
     }
-    return false;
 }
 
 int ProblemEvenParityEvalNode(SNode::Op op,
-                              int p1, int p2, int,
-                              const std::vector<int> &values)
+                              int val0, int val1, int)
 {
-    int val0 = values[p1];
-    int val1 = values[p2];
     switch (op) {
     case SNode::OrOp:
         if (val0 || val1) {
@@ -262,57 +991,63 @@ int ProblemEvenParityEvalNode(SNode::Op op,
     return 0;
 }
 
-void ProblemEvenParity::evaluate(const std::vector<SNode>& nodes,
-                                 std::vector<int>& outFitness)
+Problem::OpKernel ProblemEvenParity::getOpKernel(SNode::Op op) const
 {
-    _evaluateAll<ProblemEvenParityEvalNode,
-                 ProblemCalcFitness>(nodes, outFitness);
+    // As ProblemEvenParityEvalNode()
+    switch (op) {
+    case SNode::OrOp:
+        return OrKernel;
+    case SNode::NorOp:
+        return NorKernel;
+    case SNode::AndOp:
+        return AndKernel;
+    case SNode::NandOp:
+        return NandKernel;
+    default:
+        return ZeroKernel;
+    }
 }
 
-void ProblemEvenParity::evaluate(const std::vector<SNode>& nodes,
-                                 const SortedArray<int>& changedNodes,
-                                 std::vector<int>& outFitness)
+// 4x^4 - 3x^3 + 2x^2 - x
+static int samplePolynomial(int x)
 {
-    _evaluate<ProblemEvenParityEvalNode,
-              ProblemCalcFitness>(nodes, changedNodes, outFitness);
+    int x2 = x * x;
+    int x3 = x * x2;
+    int x4 = x * x3;
+    return (4 * x4) - (3 * x3) + (2 * x2) - x;
 }
 
-ProblemSymbolicRegression::ProblemSymbolicRegression()
+ProblemSymbolicRegression::ProblemSymbolicRegression(bool constants)
 {
-    init();
+    _name = constants ? "regression-constants" : "regression";
+    init(constants, samplePolynomial, 0, 9);
 }
 
-bool ProblemSymbolicRegression::hitTargetFitness(const std::vector<int> &values)
+ProblemSymbolicRegression::ProblemSymbolicRegression(const QString& name,
+                                                     TargetFunc target,
+                                                     int minX, int maxX)
 {
-    for (size_t i = _numInputs; i < values.size(); ++i) {
-        if (values[i] >= 0) {
-            return true;
-        }
-    }
-    return false;
+    _name = name;
+    init(false, target, minX, maxX);
 }
 
-void ProblemSymbolicRegression::init()
+void ProblemSymbolicRegression::init(bool constants, TargetFunc target,
+                                     int minX, int maxX)
 {
     _ops.push_back(SNode::AddOp);
     _ops.push_back(SNode::SubOp);
     _ops.push_back(SNode::MultOp);
     _ops.push_back(SNode::DivOp);
+    if (constants) {
+        _ops.push_back(SNode::ValOp);
+    }
 
     _numInputs = 1;
-    for (int i = 0; i < 10; ++i) {
-        TestCase t;
-        t.inputs = new int[_numInputs];
-        t.inputs[0] = i;
-        int x = i;
-        int x2 = x * x;
-        int x3 = x * x2;
-        int x4 = x * x3;
-        int r = (4 * x4) - (3 * x3) + (2 * x2) - x;
-        _outputs.push_back(r);
-        _testCases.push_back(t);
+    for (int x = minX; x <= maxX; ++x) {
+        int* inputs = addTestCase();
+        inputs[0] = x;
+        _outputs.push_back(target(x));
     }
-    _testCaseResults.resize(_testCases.size());
 }
 
 int ProblemSymbolicRegressionGetFitness(int value, int expectedOutput)
@@ -328,11 +1063,8 @@ int ProblemSymbolicRegressionGetFitness(int value, int expectedOutput)
 }
 
 int ProblemSymbolicRegressionEvalNode(SNode::Op op,
-                                      int p1, int p2, int,
-                                      const std::vector<int> &values)
+                                      int val0, int val1, int)
 {
-    int val0 = values[p1];
-    int val1 = values[p2];
     switch (op) {
     case SNode::AddOp:
         return val0 + val0;
@@ -354,18 +1086,450 @@ int ProblemSymbolicRegressionEvalNode(SNode::Op op,
     return 0;
 }
 
-void ProblemSymbolicRegression::evaluate(const std::vector<SNode>& nodes,
-                                 std::vector<int>& outFitness)
+Problem::OpKernel ProblemSymbolicRegression::getOpKernel(
+        SNode::Op op) const
+{
+    // As ProblemSymbolicRegressionEvalNode()
+    switch (op) {
+    case SNode::AddOp:
+        return DoubleKernel;
+    case SNode::SubOp:
+        return SubKernel;
+    case SNode::MultOp:
+        return MultKernel;
+    case SNode::DivOp:
+        return DivKernel;
+    default:
+        return ZeroKernel;
+    }
+}
+
+ProblemTruthTable::ProblemTruthTable()
+  : _numTableCases(0)
 {
-    _evaluateAll<ProblemSymbolicRegressionEvalNode,
-                 ProblemSymbolicRegressionGetFitness> (nodes, outFitness);
 }
 
-void ProblemSymbolicRegression::evaluate(const std::vector<SNode>& nodes,
-                                 const SortedArray<int>& changedNodes,
-                                 std::vector<int>& outFitness)
+bool ProblemTruthTable::load(const QString& fileName, QString* outError)
 {
-    _evaluate<ProblemSymbolicRegressionEvalNode,
-              ProblemSymbolicRegressionGetFitness>
-                  (nodes, changedNodes, outFitness);
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (outError) {
+            *outError = QString("Can't open %1").arg(fileName);
+        }
+        return false;
+    }
+    QByteArray text = file.readAll();
+    QString error;
+    if (!parse(text.constData(), text.size(), &error)) {
+        if (outError) {
+            *outError = QString("%1: %2").arg(fileName).arg(error);
+        }
+        return false;
+    }
+    _name = QString(TablePrefix) + fileName;
+    return true;
 }
+
+bool ProblemTruthTable::parse(const char* text, int size, QString* outError)
+{
+    static const struct {
+        const char* name;
+        SNode::Op op;
+    } opNames[] = {
+        { "and", SNode::AndOp },
+        { "or", SNode::OrOp },
+        { "nand", SNode::NandOp },
+        { "nor", SNode::NorOp },
+        { "yes", SNode::YesOp },
+        { "not", SNode::NotOp },
+        { "equal", SNode::EqualOp },
+        { "if", SNode::IfOp }
+    };
+    static const int numOpNames = sizeof(opNames) / sizeof(opNames[0]);
+
+    int numInputs = 0;
+    std::vector<SNode::Op> ops;
+    // Output of each input combination, -1 if there's no row for it
+    std::vector<signed char> table;
+    const char* end = text + size;
+    int lineNumber = 0;
+    QString error;
+    for (const char* line = text; line < end && error.isEmpty(); ) {
+        const char* lineEnd =
+            static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        lineNumber++;
+
+        // Split into words, up to any comment
+        std::vector<std::string> words;
+        for (const char* p = line; p < lineEnd && *p != '#'; ) {
+            if (isspace(uchar(*p))) {
+                p++;
+                continue;
+            }
+            const char* word = p;
+            while (p < lineEnd && *p != '#' && !isspace(uchar(*p))) {
+                p++;
+            }
+            words.push_back(std::string(word, p));
+        }
+        line = lineEnd + 1;
+        if (words.empty()) {
+            continue;
+        }
+
+        const std::string& first = words[0];
+        if (first == ".e" || first == ".end") {
+            break;
+        } else if (first == ".i") {
+            numInputs = words.size() == 2 ? atoi(words[1].c_str()) : 0;
+            if (numInputs < 1 || numInputs > MaxInputs || !table.empty()) {
+                error = QString("Line %1: .i must come before the rows and "
+                                "be 1 to %2").arg(lineNumber).arg(MaxInputs);
+            }
+        } else if (first == ".o") {
+            if (words.size() != 2 || words[1] != "1") {
+                error = QString("Line %1: only one output is supported")
+                        .arg(lineNumber);
+            }
+        } else if (first == ".ops") {
+            for (size_t k = 1; k < words.size() && error.isEmpty(); ++k) {
+                std::string name = words[k];
+                std::transform(name.begin(), name.end(), name.begin(),
+                               ::tolower);
+                int j = 0;
+                while (j < numOpNames && name != opNames[j].name) {
+                    j++;
+                }
+                if (j == numOpNames) {
+                    error = QString("Line %1: unknown op %2")
+                            .arg(lineNumber).arg(words[k].c_str());
+                } else if (std::find(ops.begin(), ops.end(),
+                                     opNames[j].op) == ops.end()) {
+                    ops.push_back(opNames[j].op);
+                }
+            }
+        } else if (first[0] == '.') {
+            // .p, .ilb, .ob, .type and the like aren't needed
+        } else if (words.size() != 2 || words[1].size() != 1) {
+            error = QString("Line %1: expected the inputs and the output")
+                    .arg(lineNumber);
+        } else {
+            if (numInputs == 0) {
+                numInputs = first.size();
+                if (numInputs > MaxInputs) {
+                    error = QString("Line %1: more than %2 inputs")
+                            .arg(lineNumber).arg(MaxInputs);
+                    break;
+                }
+            }
+            if (int(first.size()) != numInputs) {
+                error = QString("Line %1: expected %2 inputs")
+                        .arg(lineNumber).arg(numInputs);
+                break;
+            }
+            char output = words[1][0];
+            if (output == '-' || output == '~') {
+                continue;
+            } else if (output != '0' && output != '1') {
+                error = QString("Line %1: the output must be 0, 1 or -")
+                        .arg(lineNumber);
+                break;
+            }
+
+            // The fixed bits and the don't care bits of the inputs
+            uint32_t fixed = 0;
+            uint32_t free = 0;
+            for (int j = 0; j < numInputs; ++j) {
+                uint32_t bit = 1u << (numInputs - 1 - j);
+                if (first[j] == '1') {
+                    fixed |= bit;
+                } else if (first[j] == '-') {
+                    free |= bit;
+                } else if (first[j] != '0') {
+                    error = QString("Line %1: the inputs must be 0, 1 or -")
+                            .arg(lineNumber);
+                    break;
+                }
+            }
+            if (!error.isEmpty()) {
+                break;
+            }
+            if (table.empty()) {
+                table.assign(size_t(1) << numInputs, -1);
+            }
+            // Every combination of the don't care bits
+            uint32_t bits = 0;
+            do {
+                signed char& value = table[fixed | bits];
+                if (value >= 0 && value != output - '0') {
+                    error = QString("Line %1: conflicts with an earlier row")
+                            .arg(lineNumber);
+                    break;
+                }
+                value = output - '0';
+                bits = (bits - free) & free;
+            } while (bits && error.isEmpty());
+        }
+    }
+
+    bool hasRows = std::find_if(table.begin(), table.end(),
+                                [](signed char value) {
+                                    return value >= 0;
+                                }) != table.end();
+    if (error.isEmpty() && !hasRows) {
+        error = "There are no rows";
+    }
+    if (!error.isEmpty()) {
+        if (outError) {
+            *outError = error;
+        }
+        return false;
+    }
+
+    if (ops.empty()) {
+        ops.push_back(SNode::AndOp);
+        ops.push_back(SNode::OrOp);
+        ops.push_back(SNode::NandOp);
+        ops.push_back(SNode::NorOp);
+    }
+    _ops = ops;
+    beginCases(numInputs);
+    for (size_t i = 0; i < table.size(); ++i) {
+        if (table[i] >= 0) {
+            addCase(i, table[i]);
+        }
+    }
+    endCases();
+    return true;
+}
+
+// Parse a benchmark name, see ProblemTruthTable::generate(), returns
+// the number of inputs or 0 if it isn't one
+static int getBenchmarkInputs(const QString& name, bool* outMultiplexer)
+{
+    static const char multiplexer[] = "multiplexer";
+    static const char parity[] = "parity";
+    *outMultiplexer = name.startsWith(multiplexer);
+    int prefixLength = *outMultiplexer ? strlen(multiplexer) : strlen(parity);
+    if (!*outMultiplexer && !name.startsWith(parity)) {
+        return 0;
+    }
+    bool ok = false;
+    int n = name.mid(prefixLength).toInt(&ok);
+    if (!ok || name.mid(prefixLength) != QString::number(n)) {
+        return 0;
+    }
+    if (*outMultiplexer) {
+        return (n == 11 || n == 20 || n == 37) ? n : 0;
+    }
+    return (n >= 8 && n <= ProblemTruthTable::MaxInputs) ? n : 0;
+}
+
+bool ProblemTruthTable::isBenchmarkName(const QString& name)
+{
+    bool multiplexer;
+    return getBenchmarkInputs(name, &multiplexer) > 0;
+}
+
+bool ProblemTruthTable::generate(const QString& name)
+{
+    bool multiplexer;
+    int numInputs = getBenchmarkInputs(name, &multiplexer);
+    if (numInputs == 0) {
+        return false;
+    }
+
+    _name = name;
+    if (multiplexer) {
+        // k = a + 2^a
+        int addressBits = 1;
+        while (addressBits + (1 << addressBits) < numInputs) {
+            addressBits++;
+        }
+        generateMultiplexer(addressBits);
+    } else {
+        generateEvenParity(numInputs);
+    }
+    return true;
+}
+
+void ProblemTruthTable::generateMultiplexer(int addressBits)
+{
+    // Cases scored, a sample of them when there are more
+    static const int MaxCases = 1 << 20;
+
+    _ops.clear();
+    _ops.push_back(SNode::AndOp);
+    _ops.push_back(SNode::OrOp);
+    _ops.push_back(SNode::NotOp);
+    _ops.push_back(SNode::IfOp);
+
+    int numInputs = addressBits + (1 << addressBits);
+    int64_t numCases = int64_t(1) << numInputs;
+    uint64_t randomState = 1;
+    beginCases(numInputs);
+    for (int64_t k = 0; k < std::min<int64_t>(numCases, MaxCases); ++k) {
+        uint64_t inputs = k;
+        if (numCases > MaxCases) {
+            // The same sample every time, apart from qrand()
+            randomState = randomState * 6364136223846793005ULL +
+                1442695040888963407ULL;
+            inputs = (randomState >> 11) & (numCases - 1);
+        }
+        // The address inputs come first, then the data inputs
+        int address = int(inputs >> (numInputs - addressBits));
+        int dataBit = numInputs - 1 - addressBits - address;
+        addCase(inputs, (inputs >> dataBit) & 1);
+    }
+    endCases();
+}
+
+void ProblemTruthTable::generateEvenParity(int numInputs)
+{
+    _ops.clear();
+    _ops.push_back(SNode::AndOp);
+    _ops.push_back(SNode::OrOp);
+    _ops.push_back(SNode::NandOp);
+    _ops.push_back(SNode::NorOp);
+
+    // A word at a time rather than with addCase(): case k is bit k % 32
+    // of word k / 32, so the inputs for the lowest 5 bits of k have the
+    // same pattern in every word and the others are all 0 or all 1
+    uint32_t lowInputs[5] = { 0, 0, 0, 0, 0 };
+    uint32_t lowParity = 0;
+    for (int k = 0; k < CasesPerWord; ++k) {
+        for (int b = 0; b < 5; ++b) {
+            if ((k >> b) & 1) {
+                lowInputs[b] |= 1u << k;
+            }
+        }
+        if (popCount(k) & 1) {
+            lowParity |= 1u << k;
+        }
+    }
+
+    beginCases(numInputs);
+    int numWords = 1 << (numInputs - 5);
+    for (int w = 0; w < numWords; ++w) {
+        int* words = addTestCase();
+        for (int j = 0; j < numInputs; ++j) {
+            int b = numInputs - 1 - j;
+            words[j] = b < 5 ? int(lowInputs[b]) : -((w >> (b - 5)) & 1);
+        }
+        _outputs.push_back(int(popCount(w) & 1 ? ~lowParity : lowParity));
+    }
+    _numTableCases = numWords * CasesPerWord;
+}
+
+void ProblemTruthTable::beginCases(int numInputs)
+{
+    _numInputs = numInputs;
+    _numTableCases = 0;
+    _inputs.clear();
+    _outputs.clear();
+}
+
+void ProblemTruthTable::addCase(uint64_t inputs, bool output)
+{
+    int bit = _numTableCases % CasesPerWord;
+    if (bit == 0) {
+        std::fill_n(addTestCase(), _numInputs, 0);
+        _outputs.push_back(0);
+    }
+    int* words = &_inputs[_inputs.size() - _numInputs];
+    for (int j = 0; j < _numInputs; ++j) {
+        if ((inputs >> (_numInputs - 1 - j)) & 1) {
+            words[j] |= int(1u << bit);
+        }
+    }
+    if (output) {
+        _outputs.back() |= int(1u << bit);
+    }
+    _numTableCases++;
+}
+
+void ProblemTruthTable::endCases()
+{
+    // The rest of the last word is filled with the first cases again,
+    // which are all in the first word
+    int numWords = _outputs.size();
+    for (int b = _numTableCases % CasesPerWord;
+         b > 0 && b < CasesPerWord; ++b) {
+        int k = ((numWords - 1) * CasesPerWord + b) % _numTableCases;
+        uint32_t from = 1u << k;
+        uint32_t to = 1u << b;
+        int* words = &_inputs[_inputs.size() - _numInputs];
+        for (int j = 0; j < _numInputs; ++j) {
+            if (uint32_t(_inputs[j]) & from) {
+                words[j] |= int(to);
+            }
+        }
+        if (uint32_t(_outputs[0]) & from) {
+            _outputs.back() |= int(to);
+        }
+    }
+}
+
+void ProblemTruthTable::evaluateProgram(const SProgram& program,
+                                        const int* inputs, int numRows,
+                                        int* outResults) const
+{
+    // The ops work on every bit, a row's case is in the lowest
+    ProblemT<ProblemTruthTable,
+             ProblemTruthTableEvalNode,
+             ProblemTruthTableCalcFitness>::evaluateProgram(
+        program, inputs, numRows, outResults);
+    for (int i = 0; i < numRows; ++i) {
+        outResults[i] &= 1;
+    }
+}
+
+int ProblemTruthTableCalcFitness(int value, int expectedOutput)
+{
+    // The number of the word's cases that match
+    return popCount(~uint32_t(value ^ expectedOutput));
+}
+
+int ProblemTruthTableEvalNode(SNode::Op op,
+                              int val0, int val1, int val2)
+{
+    switch (op) {
+    case SNode::OrOp:
+        return val0 | val1;
+    case SNode::NorOp:
+        return ~(val0 | val1);
+    case SNode::AndOp:
+        return val0 & val1;
+    case SNode::NandOp:
+        return ~(val0 & val1);
+    case SNode::YesOp:
+        return val0;
+    case SNode::NotOp:
+        return ~val0;
+    case SNode::EqualOp:
+        return ~(val0 ^ val1);
+    case SNode::IfOp:
+        return (val0 & val1) | (~val0 & val2);
+    default:
+        // do nothing
+        break;
+    }
+    return 0;
+}
+
+// Instantiate the evaluation functions and run loop of each problem
+template class ProblemT<ProblemMultiplexer,
+                        ProblemMultiplexerEvalNode,
+                        ProblemCalcFitness>;
+template class ProblemT<ProblemEvenParity,
+                        ProblemEvenParityEvalNode,
+                        ProblemCalcFitness>;
+template class ProblemT<ProblemSymbolicRegression,
+                        ProblemSymbolicRegressionEvalNode,
+                        ProblemSymbolicRegressionGetFitness>;
+template class ProblemT<ProblemTruthTable,
+                        ProblemTruthTableEvalNode,
+                        ProblemTruthTableCalcFitness>;
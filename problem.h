@@ -2,9 +2,17 @@
 #define PROBLEM_H
 
 #include <vector>
+#include <unordered_map>
+#include <QStringList>
 
 #include "snode.h"
 #include "sortedarray.h"
+#include "sevalengine.h"
+#include "sresultcache.h"
+#include "srunloop.h"
+
+class SLaneRun;
+class SProgram;
 
 /*
  * Sample GP test cases.
@@ -15,12 +23,43 @@ public:
     Problem();
     virtual ~Problem();
 
+    /*
+     * Create one of the sample problems by name, see
+     * getProblemNames(), or a truth table loaded from a file named
+     * "table:<file>", see ProblemTruthTable.  Returns NULL if the
+     * name is unknown or the table can't be loaded.
+     */
+    static Problem* create(const QString& name);
+
+    /*
+     * Get the names of the sample problems.
+     */
+    static QStringList getProblemNames();
+
+    /*
+     * Return true if create() can create the problem called 'name',
+     * otherwise sets 'outError'.  A table is loaded to check it.
+     */
+    static bool isProblemName(const QString& name, QString* outError = 0);
+
+    /*
+     * Get the names of the benchmarks for scaling tests: larger
+     * multiplexer and parity problems, parity8 up to parity24 (see
+     * ProblemTruthTable), and common regression functions.
+     */
+    static QStringList getBenchmarkNames();
+
+    /*
+     * Get the name the problem is created with, see create().
+     */
+    const QString& getName() const { return _name; }
+
     int getNumInputs() { return _numInputs; }
 
     /*
      * Get the number of test cases.
      */
-    int getNumFitnessCases() { return _testCases.size(); }
+    int getNumFitnessCases() { return _outputs.size(); }
 
     /*
      * Get the inputs for the given test case
@@ -35,9 +74,20 @@ public:
     int getOutput(int fitnessCase) { return _outputs[fitnessCase]; }
 
     /*
-     * Get the current set of results that were evaluate()d.
+     * Get the results of every test case for the given node, as
+     * they were last evaluate()d.  Not valid for constant nodes,
+     * see getConstantResult(), or for nodes that alias another
+     * node, see SEvalEngine::getCanonicalNodes().  The row may be
+     * shared with other nodes with the same results, see
+     * setSemanticHashing().  Returns NULL if the results have been
+     * evicted.
      */
-    std::vector<int>& getTestCaseResults(int i) { return _testCaseResults[i]; }
+    int* getNodeResults(int i) { return _results.find(_rowNodes[i]); }
+
+    /*
+     * Get the value of a constant node, as it was last evaluate()d.
+     */
+    int getConstantResult(int i) { return _constValues[i]; }
 
     /*
      * Get the operators allowed for solving the
@@ -52,46 +102,399 @@ public:
     virtual bool hitTargetFitness(
         const std::vector<int> &values) = 0;
 
+    /*
+     * Get the fitness of a program's results for every test case
+     * (see evaluateProgram()), as evaluate() scores a node.  Sets
+     * 'outHit' if the fitness hits the target.
+     */
+    virtual int getResultsFitness(const std::vector<int>& results,
+                                  bool* outHit = 0) = 0;
+
     /*
      * Optimized inner loop for evaluating all test cases.
      * Don't let that virtual fool you! :)
+     *
+     * Constant nodes (see SEvalEngine::getConstantNodes()) are
+     * evaluated once and their value is broadcast to the nodes
+     * that use them, no result row is stored for them.
      */
-    virtual void evaluate(const std::vector<SNode> &nodes,
+    virtual void evaluate(const SEvalEngine &engine,
                           std::vector<int> &outFitness) = 0;
-    virtual void evaluate(const std::vector<SNode> &nodes,
+    virtual void evaluate(const SEvalEngine &engine,
                           const SortedArray<int> &changedNodes,
                           std::vector<int> &outFitness) = 0;
 
-    void initTestCaseResults(int numNodes);
-
-protected:
-    class TestCase {
-    public:
-        TestCase() : inputs(0) { }
+    /*
+     * Evaluate 'program' over 'numRows' rows of inputs, the
+     * program's getNumInputs() values per row, writing one result
+     * per row to 'outResults'.  The program must be one found for
+     * this problem, see SProgram::getProblemName().
+     *
+     * The rows are evaluated in blocks, one instruction at a time
+     * over the block, with the same node function as evaluate().
+     * The problem isn't changed, so several threads can evaluate
+     * programs at once.
+     */
+    virtual void evaluateProgram(const SProgram& program,
+                                 const int* inputs, int numRows,
+                                 int* outResults) const = 0;
 
-        int* inputs; // each test case has _numInputs
-                     // number of inputs.
+    /*
+     * What an op computes, for the native code generator (see
+     * SProgramJit) and the bytecode (see SProgramVM).  'a', 'b' and
+     * 'c' are the op's params.
+     */
+    enum OpKernel {
+        // Can't be compiled
+        UnsupportedKernel,
+        // 0
+        ZeroKernel,
+        // a != 0
+        TruthKernel,
+        // a || b
+        OrKernel,
+        // !(a || b)
+        NorKernel,
+        // a && b
+        AndKernel,
+        // !(a && b)
+        NandKernel,
+        // a ? b : c
+        IfKernel,
+        // a + a
+        DoubleKernel,
+        // b - a
+        SubKernel,
+        // b * a
+        MultKernel,
+        // a ? b / a : 0
+        DivKernel
     };
 
-    typedef int(*EvalNodeFunc)(SNode::Op, int, int, int, const std::vector<int> &);
+    /*
+     * Get what 'op' computes in the problem's node function.  Must
+     * match evaluate(), though SProgramJit checks its code against
+     * evaluateProgram() before using it.
+     */
+    virtual OpKernel getOpKernel(SNode::Op) const {
+        return UnsupportedKernel;
+    }
+
+    /*
+     * Run up to 'count' generations of the GP engine, see
+     * SRunLoop.  The loop is instantiated for each problem so
+     * this is the only virtual call per batch of generations.
+     * 'acceptance' is NULL for the greedy rule and 'deadline' NULL
+     * for none.
+     */
+    virtual SRunResult runGenerations(SEvalEngine &engine,
+                                      std::vector<int> &fitness,
+                                      SNodeStats &stats,
+                                      SAcceptance *acceptance,
+                                      int maxGenerations,
+                                      int count,
+                                      const SDeadline *deadline) = 0;
+
+    /*
+     * Run up to 'count' generations of every lane of 'lanes', see
+     * SLaneRunLoop.  Instantiated for each problem as
+     * runGenerations() is.
+     */
+    virtual void runLaneGenerations(SLaneRun& lanes, int count) = 0;
+
+    typedef int(*EvalNodeFunc)(SNode::Op, int, int, int);
     typedef int(*CalcFitnessFunc)(int, int);
 
+    /*
+     * Set up the result store for 'numNodes' nodes.  The rows are
+     * allocated from 'arena' if given, see getArenaSize().
+     */
+    void initTestCaseResults(int numNodes, SArena* arena = 0);
+
+    /*
+     * Get the arena space initTestCaseResults() needs.
+     */
+    size_t getArenaSize(int numNodes);
+
+    /*
+     * Limit the number of node result rows kept in memory, zero
+     * (the default) keeps a row for every node.  Rows are evicted
+     * least recently used first and recomputed from their params
+     * when needed, nodes with many links to them are kept
+     * resident.  Takes effect on the next initTestCaseResults().
+     */
+    void setMaxResidentRows(int maxRows) { _maxResidentRows = maxRows; }
+
+    /*
+     * Get the number of result rows that have been evicted and
+     * recomputed since initTestCaseResults().
+     */
+    int64_t getNumRecomputedRows() { return _numRecomputedRows; }
+
+    /*
+     * Get the number of result rows evaluated since
+     * initTestCaseResults(), recomputed rows included.  Constant
+     * nodes and nodes that alias another don't have a row to
+     * evaluate.
+     */
+    int64_t getNumEvaluatedRows() { return _numEvaluatedRows; }
+
+    /*
+     * Turn on hashing of the results of every node when it is
+     * evaluated.  Used to count the number of nodes with distinct
+     * outputs, a measure of the population diversity.  Nodes with
+     * the same results as another then also share its row, so more
+     * distinct rows fit in a bounded cache.  Off by default, takes
+     * effect on the next full evaluate().
+     */
+    void setSemanticHashing(bool enable) { _semanticHashing = enable; }
+
+    /*
+     * Get the number of nodes, not counting inputs, that produce
+     * distinct results.  Zero if semantic hashing is off.
+     */
+    int getNumDistinctOutputs() { return _numDistinctOutputs; }
+
+    /*
+     * Restore the results of the node at 'i' without evaluating
+     * it, when resuming a run from a checkpoint.  Returns the row
+     * to fill in, the node must not be constant.
+     */
+    int* restoreNodeResults(const SEvalEngine &engine, int i);
+
+    /*
+     * Share the rows of nodes with the same results once they have
+     * been restored, see setSemanticHashing().
+     */
+    void shareRestoredRows(const SEvalEngine &engine);
+
+    /*
+     * Restore the value of a constant node.
+     */
+    void setConstantResult(int i, int value) { _constValues[i] = value; }
+
+    /*
+     * Get/restore the hash of the results of the node at 'i', see
+     * setSemanticHashing().  Restoring updates the number of
+     * distinct outputs.
+     */
+    uint64_t getOutputHash(int i) { return _outputHashes[i]; }
+    void restoreOutputHash(int i, uint64_t hash);
+
+protected:
+    /*
+     * Add a test case, returns the _numInputs inputs to fill in.
+     * The pointer is only valid until the next call.
+     */
+    int* addTestCase();
+
     template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness>
-    void _evaluateAll(const std::vector<SNode> &nodes,
+    void _evaluateAll(const SEvalEngine &engine,
                       std::vector<int> &outFitness);
 
     template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness>
-    void _evaluate(const std::vector<SNode>& nodes,
+    void _evaluate(const SEvalEngine &engine,
                    const SortedArray<int>& changedNodes,
                    std::vector<int>& outFitness);
 
+    /*
+     * Evaluate node 'i' for all test cases and return its fitness.
+     */
+    template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness>
+    int _evaluateNode(const SEvalEngine &engine, int i);
+
+    /*
+     * Evaluate an op for the rows [begin, end) into 'outResults'
+     * and return the fitness of the results against 'outputs'.
+     * Each bit set in 'constMask' marks a param that is constant,
+     * the value for that param is read once from the first element
+     * instead of once per row.  With _noFitness as 'calcFitness'
+     * only the results are computed, 'outputs' is unused and 0 is
+     * returned.  Shared by node and program evaluation.
+     */
+    template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness,
+             int constMask>
+    static int _evaluateRows(SNode::Op op,
+                             const int* values0, const int* values1,
+                             const int* values2, const int* outputs,
+                             int* outResults, int begin, int end);
+
+    /*
+     * Call _evaluateRows() specialised for 'constMask'.
+     */
+    template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness>
+    static int _evaluateOp(SNode::Op op, const int* const values[3],
+                           int constMask, const int* outputs,
+                           int* outResults, int begin, int end);
+
+    static int _noFitness(int, int) { return 0; }
+
+    // Rows evaluated at a time by evaluateProgram(), the results
+    // of every instruction for a block stay in the L1/L2 cache
+    enum { ProgramBlockRows = 256 };
+
+    template<EvalNodeFunc evalNode>
+    void _evaluateProgram(const SProgram& program, const int* inputs,
+                          int numRows, int* outResults) const;
+
+    /*
+     * Get the result row of a non constant node, recomputing it
+     * (and any evicted rows it needs) if it was evicted.
+     */
+    template<EvalNodeFunc evalNode, CalcFitnessFunc calcFitness>
+    int* _getResults(const SEvalEngine &engine, int i);
+
+    /*
+     * Hash the results of the node at 'i' and update the count of
+     * distinct outputs.  If 'replace' is true the previous hash
+     * of the node is removed first.
+     */
+    void updateOutputHash(const SEvalEngine &engine, int i, bool replace);
+
+    /*
+     * Give up the row of the node at 'i' to share that of a node
+     * with the same results, found by its output hash.  Rows are
+     * always held by the lowest of the nodes sharing them, so
+     * recomputing an evicted row never needs a higher node.
+     * unshareRow() must be called before the node is reevaluated:
+     * the node gets its own row back, or if it holds a shared row
+     * the row is handed on to the lowest of the other nodes.
+     */
+    void shareRow(const SEvalEngine &engine, int i);
+    void unshareRow(const SEvalEngine &engine, int i);
+
+    /*
+     * Add/remove the node at 'i' to/from the nodes sharing the row
+     * of 'holder'.  moveSharedRow() makes the node at 'from', and
+     * those sharing its row, share the row of 'to' instead.
+     */
+    void addSharedRow(int i, int holder);
+    void removeSharedRow(int i);
+    void moveSharedRow(int from, int to);
+
+    // Set the hot flags of the resident rows from the current fan-out
+    void refreshHotNodes(const SEvalEngine &engine);
+
+    QString _name;
     int _numInputs;
-    std::vector<TestCase> _testCases;
+    // The inputs of each test case, _numInputs per test case.  Not
+    // in the run's arena: they are made with the problem, before
+    // the arena is sized from it, and outlive it.  Evaluation reads
+    // the input rows, which initTestCaseResults() copies there.
+    std::vector<int> _inputs;
     std::vector<int> _outputs;
-    std::vector<std::vector<int> > _testCaseResults;
+
+    // For each node, the results of every test case
+    SResultCache _results;
+    int _maxResidentRows;
+    int64_t _numRecomputedRows;
+    int64_t _numEvaluatedRows;
+
+    // Nodes with at least this many links to them are not evicted
+    int _hotFanOut;
+    // Generations until the hot flags are next refreshed
+    int _hotRefreshCountdown;
+
+    // Scratch space used when recomputing evicted rows
+    std::vector<int> _recomputeStack;
+    std::vector<int> _recomputeNodes;
+    std::vector<int> _recomputePinned;
+    std::vector<char> _recomputeVisited;
+
+    // For each constant node, the value of the node
+    std::vector<int> _constValues;
+
+    // Value used for params that are not linked to a node
+    int _unlinkedValue;
+
+    // Semantic hashing of node results
+    bool _semanticHashing;
+    std::vector<uint64_t> _outputHashes;
+    std::unordered_map<uint64_t, int> _outputCounts;
+    int _numDistinctOutputs;
+
+    // For each node, the node that holds its row (itself unless the
+    // row is shared), and the lists of nodes sharing each row
+    std::vector<int> _rowNodes;
+    std::vector<int> _sharedHeads;
+    std::vector<int> _sharedNext;
+    std::vector<int> _sharedPrev;
+    // A node holding a row for each output hash, checked on use
+    std::unordered_map<uint64_t, int> _hashRows;
+
     std::vector<SNode::Op> _ops;
 };
 
+/*
+ * Base class for problems, instantiates the evaluation functions
+ * and the run loop for the problem's node and fitness functions
+ * so they are statically dispatched.
+ *
+ * 'Derived' must provide isTargetFitness(int fitness), returning
+ * true if an individual with that fitness is a solution.
+ */
+template<class Derived,
+         Problem::EvalNodeFunc evalNode,
+         Problem::CalcFitnessFunc calcFitness>
+class ProblemT : public Problem {
+public:
+    virtual bool hitTargetFitness(
+        const std::vector<int>& values);
+
+    virtual int getResultsFitness(const std::vector<int>& results,
+                                  bool* outHit = 0);
+
+    virtual void evaluate(const SEvalEngine &engine,
+                          const SortedArray<int> &changedNodes,
+                          std::vector<int> &outFitness);
+
+    virtual void evaluate(const SEvalEngine &engine,
+                          std::vector<int> &outFitness);
+
+    virtual void evaluateProgram(const SProgram& program,
+                                 const int* inputs, int numRows,
+                                 int* outResults) const;
+
+    virtual SRunResult runGenerations(SEvalEngine &engine,
+                                      std::vector<int> &fitness,
+                                      SNodeStats &stats,
+                                      SAcceptance *acceptance,
+                                      int maxGenerations,
+                                      int count,
+                                      const SDeadline *deadline);
+
+    virtual void runLaneGenerations(SLaneRun& lanes, int count);
+
+    /*
+     * Fitness of one test case, used by SLaneRunLoop.
+     */
+    static int caseFitness(int value, int expectedOutput) {
+        return calcFitness(value, expectedOutput);
+    }
+
+    /*
+     * Non virtual versions of evaluate(), used by SRunLoop.
+     */
+    void evaluateAllNodes(const SEvalEngine &engine,
+                          std::vector<int> &outFitness) {
+        _evaluateAll<evalNode, calcFitness>(engine, outFitness);
+    }
+    void evaluateChangedNodes(const SEvalEngine &engine,
+                              const SortedArray<int> &changedNodes,
+                              std::vector<int> &outFitness) {
+        _evaluate<evalNode, calcFitness>(engine, changedNodes, outFitness);
+    }
+};
+
+int ProblemCalcFitness(int value, int expectedOutput);
+int ProblemMultiplexerEvalNode(SNode::Op op, int val0, int val1, int val2);
+int ProblemEvenParityEvalNode(SNode::Op op, int val0, int val1, int val2);
+int ProblemSymbolicRegressionGetFitness(int value, int expectedOutput);
+int ProblemTruthTableCalcFitness(int value, int expectedOutput);
+int ProblemTruthTableEvalNode(SNode::Op op, int val0, int val1, int val2);
+int ProblemSymbolicRegressionEvalNode(SNode::Op op,
+                                      int val0, int val1, int val2);
+
 /*
  * The 6-mux problem.
  * Two address inputs select one of four data inputs.
@@ -100,19 +503,18 @@ protected:
  * individuals fitness equal to the number of matches with
  * the expected results.
  */
-class ProblemMultiplexer : public Problem {
+class ProblemMultiplexer
+  : public ProblemT<ProblemMultiplexer,
+                    ProblemMultiplexerEvalNode,
+                    ProblemCalcFitness> {
 public:
     ProblemMultiplexer();
 
-    virtual bool hitTargetFitness(
-        const std::vector<int>& values);
+    virtual OpKernel getOpKernel(SNode::Op op) const;
 
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          const SortedArray<int> &changedNodes,
-                          std::vector<int> &outFitness);
-
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          std::vector<int> &outFitness);
+    bool isTargetFitness(int fitness) {
+        return fitness >= (1 << _numInputs);
+    }
 
 protected:
     void init();
@@ -127,19 +529,18 @@ protected:
  * individuals fitness equal to the number of matches with
  * the expected results.
  */
-class ProblemEvenParity : public Problem {
+class ProblemEvenParity
+  : public ProblemT<ProblemEvenParity,
+                    ProblemEvenParityEvalNode,
+                    ProblemCalcFitness> {
 public:
     ProblemEvenParity(int inputs);
 
-    virtual bool hitTargetFitness(
-        const std::vector<int>& values);
+    virtual OpKernel getOpKernel(SNode::Op op) const;
 
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          const SortedArray<int> &changedNodes,
-                          std::vector<int> &outFitness);
-
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          std::vector<int> &outFitness);
+    bool isTargetFitness(int fitness) {
+        return fitness >= (1 << _numInputs);
+    }
 
 protected:
     void init();
@@ -154,24 +555,143 @@ protected:
  * difference between it's value and the expected value.
  * Differences are always expressed as negative values.
  *
- * The function set is {ADD, SUB, MULT, DIV},
+ * The function set is {ADD, SUB, MULT, DIV}, optionally with
+ * random constants (VALUE) in the range 0 to 1000.
+ *
+ * Also used for the regression benchmarks, with other targets, see
+ * Problem::getBenchmarkNames().
  */
-class ProblemSymbolicRegression : public Problem {
+class ProblemSymbolicRegression
+  : public ProblemT<ProblemSymbolicRegression,
+                    ProblemSymbolicRegressionEvalNode,
+                    ProblemSymbolicRegressionGetFitness> {
 public:
-    ProblemSymbolicRegression();
+    typedef int(*TargetFunc)(int x);
 
-    virtual bool hitTargetFitness(
-        const std::vector<int>& values);
+    ProblemSymbolicRegression(bool constants = false);
 
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          const SortedArray<int> &changedNodes,
-                          std::vector<int> &outFitness);
+    /*
+     * Regression of 'target' over the integers from 'minX' to 'maxX',
+     * called 'name', with the function set of the sample.
+     */
+    ProblemSymbolicRegression(const QString& name, TargetFunc target,
+                              int minX, int maxX);
 
-    virtual void evaluate(const std::vector<SNode> &nodes,
-                          std::vector<int> &outFitness);
+    virtual OpKernel getOpKernel(SNode::Op op) const;
+
+    bool isTargetFitness(int fitness) { return fitness >= 0; }
 
 protected:
-    void init();
+    void init(bool constants, TargetFunc target, int minX, int maxX);
+};
+
+/*
+ * Boolean problem of any truth table, loaded from a file in the PLA
+ * form of espresso:
+ *
+ *     # Two bit comparator, a1 a0 > b1 b0
+ *     .i 4
+ *     .o 1
+ *     .ops and or not if
+ *     1-0- 1
+ *     0-1- 0
+ *     1110 1
+ *     ...
+ *     .e
+ *
+ * Each row is the inputs, the first input on the left, and the
+ * output.  A '-' input stands for both 0 and 1, and a row with a '-'
+ * output is left out.  Inputs that aren't covered by any row are
+ * don't cares, they aren't fitness cases.  .i defaults to the
+ * length of the first row, .o must be 1, and .ops takes any of
+ * and, or, nand, nor, yes, not, equal and if (the default is and,
+ * or, nand and nor).  Other directives are ignored, as is anything
+ * after a '#'.
+ *
+ * The cases are bit-sliced: each test case of the engine packs 32
+ * of the table's cases into the bits of its ints, and the ops work
+ * on every bit at once, so a node is evaluated over 32 cases with
+ * one instruction.  The fitness of a node is the number of cases it
+ * matches.  When the number of cases isn't a multiple of 32 the last
+ * word is filled with the first cases again, so those count more
+ * than once; that never happens with a full table of 5 or more
+ * inputs, and a smaller full table is repeated evenly.
+ *
+ * Ops have no kernels (see getOpKernel()), the kernels work on a case
+ * per int, so runs don't use lanes and programs are evaluated with
+ * evaluateProgram().
+ */
+class ProblemTruthTable
+  : public ProblemT<ProblemTruthTable,
+                    ProblemTruthTableEvalNode,
+                    ProblemTruthTableCalcFitness> {
+public:
+    enum { MaxInputs = 24, CasesPerWord = 32 };
+
+    ProblemTruthTable();
+
+    /*
+     * Load the table from 'fileName', the problem is then called
+     * "table:<fileName>".  Returns false and sets 'outError' if the
+     * file can't be read or isn't a table.
+     */
+    bool load(const QString& fileName, QString* outError = 0);
+
+    /*
+     * Programs are evaluated over rows of 0 and 1 inputs, each result
+     * is 0 or 1.
+     */
+    virtual void evaluateProgram(const SProgram& program,
+                                 const int* inputs, int numRows,
+                                 int* outResults) const;
+
+    /*
+     * Generate the benchmark called 'name': multiplexerK for K = 11,
+     * 20 or 37 (a address inputs and 2^a data inputs, the function
+     * set of multiplexer6 but with a true Not) or parityN for N = 8
+     * to MaxInputs (as ProblemEvenParity).  Returns false if there is
+     * no such benchmark.  multiplexer37 has too many cases to score
+     * them all, it uses a fixed sample of 2^20 of them.
+     *
+     * Each problem generates its own table rather than sharing a
+     * cached one, which would double the memory (parity24 is 48MB of
+     * cases); even the largest takes a fraction of a second.
+     */
+    bool generate(const QString& name);
+
+    /*
+     * Return true if generate() knows 'name'.
+     */
+    static bool isBenchmarkName(const QString& name);
+
+    /*
+     * Get the number of cases in the table, the fitness of a
+     * solution is at least this.
+     */
+    int getNumTableCases() const { return _numTableCases; }
+
+    bool isTargetFitness(int fitness) {
+        return fitness >= int(_outputs.size()) * CasesPerWord;
+    }
+
+protected:
+    // Parse the table, see load()
+    bool parse(const char* text, int size, QString* outError);
+
+    // Generate the table of a benchmark, see generate()
+    void generateMultiplexer(int addressBits);
+    void generateEvenParity(int numInputs);
+
+    /*
+     * Pack the cases of a table with 'numInputs' inputs into the test
+     * cases: call beginCases(), addCase() for each case, with the
+     * first input in the highest bit of 'inputs', then endCases().
+     */
+    void beginCases(int numInputs);
+    void addCase(uint64_t inputs, bool output);
+    void endCases();
+
+    int _numTableCases;
 };
 
 #endif // PROBLEM_H
@@ -0,0 +1,284 @@
+#include "sacceptance.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#include "scheckpoint.h"
+
+// Generations without a new best population before the rules that
+// wander go back to it
+static const int DefaultPatience = 20000;
+
+SAcceptance::SAcceptance()
+  : _patience(0),
+    _randomState(0),
+    _score(0),
+    _bestScore(std::numeric_limits<int64_t>::min()),
+    _generation(0),
+    _bestGeneration(0),
+    _keptSinceBest(0)
+{
+}
+
+SAcceptance::~SAcceptance()
+{
+}
+
+QStringList SAcceptance::getAcceptanceNames()
+{
+    QStringList names;
+    names << "greedy" << "annealing" << "threshold" << "late";
+    return names;
+}
+
+SAcceptance* SAcceptance::create(const QString& name)
+{
+    if (name == "greedy") {
+        return new SGreedyAcceptance();
+    } else if (name == "annealing") {
+        return new SAnnealingAcceptance();
+    } else if (name == "threshold") {
+        return new SThresholdAcceptance();
+    } else if (name == "late") {
+        return new SLateAcceptance();
+    }
+    return NULL;
+}
+
+void SAcceptance::reset(uint64_t seed)
+{
+    // Apart from the engine's sequence, which uses the same generator
+    _randomState = seed ^ 0x9e3779b97f4a7c15ULL;
+    _score = 0;
+    _bestScore = std::numeric_limits<int64_t>::min();
+    _generation = 0;
+    _bestGeneration = 0;
+    _keptSinceBest = 0;
+    resetRule();
+}
+
+void SAcceptance::rebase(int64_t score)
+{
+    _score = score;
+    _bestScore = score;
+    _bestGeneration = _generation;
+    _keptSinceBest = 0;
+}
+
+bool SAcceptance::accept(int64_t score, int64_t lastScore)
+{
+    bool keep = decide(score, lastScore);
+    _generation++;
+    _score = keep ? score : lastScore;
+    if (keep) {
+        _keptSinceBest++;
+    }
+    if (_score > _bestScore) {
+        _bestScore = _score;
+        _bestGeneration = _generation;
+        _keptSinceBest = 0;
+    }
+    return keep;
+}
+
+int SAcceptance::getRollback(int journalLength, int64_t& outScore)
+{
+    if (_patience <= 0 || _generation - _bestGeneration < _patience) {
+        return 0;
+    }
+    // Wait as long again before the next time
+    _bestGeneration = _generation;
+    int count = _keptSinceBest;
+    if (count == 0 || count > journalLength) {
+        // Already there, or too far back to go, carry on from here
+        rebase(_score);
+        return 0;
+    }
+    _keptSinceBest = 0;
+    _score = _bestScore;
+    outScore = _bestScore;
+    return count;
+}
+
+void SAcceptance::save(SCheckpointWriter& writer) const
+{
+    writer.write<uint64_t>(_randomState);
+    writer.write<int64_t>(_score);
+    writer.write<int64_t>(_bestScore);
+    writer.write<int32_t>(_generation);
+    writer.write<int32_t>(_bestGeneration);
+    writer.write<int32_t>(_keptSinceBest);
+}
+
+bool SAcceptance::load(SCheckpointReader& reader)
+{
+    _randomState = reader.read<uint64_t>();
+    _score = reader.read<int64_t>();
+    _bestScore = reader.read<int64_t>();
+    _generation = reader.read<int32_t>();
+    _bestGeneration = reader.read<int32_t>();
+    _keptSinceBest = reader.read<int32_t>();
+    return reader.isOk() && _keptSinceBest >= 0;
+}
+
+double SAcceptance::random()
+{
+    // As SEvalEngine::random()
+    _randomState = _randomState * 6364136223846793005ULL +
+        1442695040888963407ULL;
+    return (_randomState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+SGreedyAcceptance::SGreedyAcceptance()
+{
+    _name = "greedy";
+}
+
+bool SGreedyAcceptance::decide(int64_t score, int64_t lastScore)
+{
+    return score >= lastScore;
+}
+
+SCalibratedAcceptance::SCalibratedAcceptance()
+  : _cooling(0.99995),
+    _scale(0),
+    _lossTotal(0),
+    _numLosses(0),
+    _numCalibrations(0)
+{
+    setPatience(DefaultPatience);
+}
+
+void SCalibratedAcceptance::resetRule()
+{
+    _scale = 0;
+    _lossTotal = 0;
+    _numLosses = 0;
+    _numCalibrations = 0;
+}
+
+void SCalibratedAcceptance::save(SCheckpointWriter& writer) const
+{
+    SAcceptance::save(writer);
+    writer.write<double>(_scale);
+    writer.write<double>(_lossTotal);
+    writer.write<int32_t>(_numLosses);
+    writer.write<int32_t>(_numCalibrations);
+}
+
+bool SCalibratedAcceptance::load(SCheckpointReader& reader)
+{
+    if (!SAcceptance::load(reader)) {
+        return false;
+    }
+    _scale = reader.read<double>();
+    _lossTotal = reader.read<double>();
+    _numLosses = reader.read<int32_t>();
+    _numCalibrations = reader.read<int32_t>();
+    return reader.isOk();
+}
+
+bool SCalibratedAcceptance::decide(int64_t score, int64_t lastScore)
+{
+    if (_numCalibrations < CalibrationGenerations) {
+        // Greedy while the losses are measured
+        _numCalibrations++;
+        if (score < lastScore) {
+            _lossTotal += double(lastScore - score);
+            _numLosses++;
+        }
+        if (_numCalibrations == CalibrationGenerations && _numLosses) {
+            _scale = _lossTotal / _numLosses;
+        }
+        return score >= lastScore;
+    }
+    _scale *= _cooling;
+    if (score >= lastScore) {
+        return true;
+    }
+    return _scale > 0 && acceptLoss(double(lastScore - score), _scale);
+}
+
+SAnnealingAcceptance::SAnnealingAcceptance()
+{
+    _name = "annealing";
+}
+
+bool SAnnealingAcceptance::acceptLoss(double loss, double scale)
+{
+    // T is set so the mean loss is kept half the time at the start
+    double temperature = scale / M_LN2;
+    return random() < exp(-loss / temperature);
+}
+
+SThresholdAcceptance::SThresholdAcceptance()
+{
+    _name = "threshold";
+}
+
+bool SThresholdAcceptance::acceptLoss(double loss, double scale)
+{
+    return loss <= scale;
+}
+
+SLateAcceptance::SLateAcceptance()
+  : _historyLength(100),
+    _historyIndex(0)
+{
+    _name = "late";
+    setPatience(DefaultPatience);
+}
+
+void SLateAcceptance::resetRule()
+{
+    _history.clear();
+    _historyIndex = 0;
+}
+
+void SLateAcceptance::save(SCheckpointWriter& writer) const
+{
+    SAcceptance::save(writer);
+    writer.write<int32_t>(_history.size());
+    writer.write<int32_t>(_historyIndex);
+    writer.write(_history.data(), _history.size());
+}
+
+bool SLateAcceptance::load(SCheckpointReader& reader)
+{
+    if (!SAcceptance::load(reader)) {
+        return false;
+    }
+    int size = reader.read<int32_t>();
+    int index = reader.read<int32_t>();
+    // Empty until the first generation after the start of a run
+    if (size < 0 || (size > 0 && (index < 0 || index >= size)) ||
+        (size == 0 && index != 0)) {
+        return false;
+    }
+    // Check it's all there before making room for it
+    const uchar* history = reader.take(sizeof(int64_t) * size);
+    if (!history) {
+        return false;
+    }
+    _history.resize(size);
+    if (size > 0) {
+        memcpy(_history.data(), history, sizeof(int64_t) * size);
+    }
+    _historyIndex = index;
+    return true;
+}
+
+bool SLateAcceptance::decide(int64_t score, int64_t lastScore)
+{
+    if (_history.empty()) {
+        _history.assign(std::max(_historyLength, 1), lastScore);
+    }
+    int64_t& lateScore = _history[_historyIndex];
+    bool keep = score >= lastScore || score >= lateScore;
+    // Only raised, so the total can't drift down over the history
+    lateScore = std::max(lateScore, keep ? score : lastScore);
+    _historyIndex = (_historyIndex + 1) % _history.size();
+    return keep;
+}
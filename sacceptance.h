@@ -0,0 +1,235 @@
+#ifndef SACCEPTANCE_H
+#define SACCEPTANCE_H
+
+#include <stdint.h>
+#include <vector>
+#include <QString>
+#include <QStringList>
+
+class SCheckpointReader;
+class SCheckpointWriter;
+
+/*
+ * Rule for keeping or undoing a mutation, from the total score of
+ * the population before and after it, see SRunLoop.  The greedy
+ * rule of the paper undoes any mutation that lowers the total; the
+ * others also keep some that lower it, to get off a plateau.
+ *
+ * A rule that wanders can also go back to the best population it
+ * has seen: after 'patience' generations without beating it the
+ * mutations kept since then are rolled back with the engine's
+ * journal (see SEvalEngine::rollback()), if it still holds them.
+ *
+ * The state of the rule is saved in checkpoints with the journal,
+ * so a resumed run carries on as the saved run does.
+ */
+class SAcceptance
+{
+public:
+    SAcceptance();
+    virtual ~SAcceptance();
+
+    /*
+     * Get the names of the rules, for create().
+     */
+    static QStringList getAcceptanceNames();
+
+    /*
+     * Create the rule called 'name', with its default settings.
+     * Returns NULL if there is no such rule.
+     */
+    static SAcceptance* create(const QString& name);
+
+    const QString& getName() const { return _name; }
+
+    /*
+     * Generations without a new best population before going back
+     * to it, 0 for never.
+     */
+    void setPatience(int generations) { _patience = generations; }
+
+    /*
+     * Get the number of mutations the engine's journal needs to
+     * hold, see SEvalEngine::setJournalSize().
+     */
+    int getJournalSize() const { return _patience; }
+
+    /*
+     * Get the number of mutations kept since the best population,
+     * the most getRollback() goes back, so the rest of the journal
+     * can be dropped (see SEvalEngine::trimJournal()).
+     */
+    int getKeptSinceBest() const { return _keptSinceBest; }
+
+    /*
+     * Start of a run, 'seed' seeds any random choices.
+     */
+    void reset(uint64_t seed);
+
+    /*
+     * Forget the populations before this one, of total 'score', as
+     * when nodes were replaced (see SRun::addMigrant()) and the
+     * journal cleared.
+     */
+    void rebase(int64_t score);
+
+    /*
+     * Return true to keep the last mutation, which took the total
+     * score of the population from 'lastScore' to 'score'.  Called
+     * once a generation.
+     */
+    bool accept(int64_t score, int64_t lastScore);
+
+    /*
+     * Called after accept(), returns the number of kept mutations
+     * to roll back to go back to the best population, 0 for none,
+     * and sets 'outScore' to its total.  'journalLength' is the
+     * number the journal holds.
+     */
+    int getRollback(int journalLength, int64_t& outScore);
+
+    /*
+     * Save the state of the rule, where it is in its schedule, see
+     * SRun::saveCheckpoint().  load() reads it back into a rule of
+     * the same name and settings, and returns false if the state is
+     * corrupt.  Rules with state of their own extend both.
+     */
+    virtual void save(SCheckpointWriter& writer) const;
+    virtual bool load(SCheckpointReader& reader);
+
+protected:
+    /*
+     * The rule, called by accept().
+     */
+    virtual bool decide(int64_t score, int64_t lastScore) = 0;
+
+    /*
+     * Reset the rule's own state.
+     */
+    virtual void resetRule() {}
+
+    /*
+     * Get a random number in [0, 1).
+     */
+    double random();
+
+    QString _name;
+
+private:
+    int _patience;
+    uint64_t _randomState;
+
+    int64_t _score;
+    int64_t _bestScore;
+    int _generation;
+    int _bestGeneration;
+    // Mutations kept since the best population
+    int _keptSinceBest;
+};
+
+/*
+ * Keep a mutation unless it lowers the total score, the rule of the
+ * paper.
+ */
+class SGreedyAcceptance : public SAcceptance
+{
+public:
+    SGreedyAcceptance();
+
+protected:
+    virtual bool decide(int64_t score, int64_t lastScore);
+};
+
+/*
+ * Scale of the worse mutations, measured over the first generations
+ * of a run, for the rules that accept some of them.  The total
+ * score's range depends on the problem and population, so the rules
+ * are set relative to it.
+ */
+class SCalibratedAcceptance : public SAcceptance
+{
+public:
+    SCalibratedAcceptance();
+
+    virtual void save(SCheckpointWriter& writer) const;
+    virtual bool load(SCheckpointReader& reader);
+
+    /*
+     * Set the factor the scale shrinks by each generation, after
+     * the first CalibrationGenerations.
+     */
+    void setCooling(double cooling) { _cooling = cooling; }
+
+protected:
+    enum { CalibrationGenerations = 100 };
+
+    virtual bool decide(int64_t score, int64_t lastScore);
+    virtual void resetRule();
+
+    /*
+     * Decide on a worse mutation, 'loss' is how much lower the
+     * total is and 'scale' the current scale.
+     */
+    virtual bool acceptLoss(double loss, double scale) = 0;
+
+private:
+    double _cooling;
+    double _scale;
+    double _lossTotal;
+    int _numLosses;
+    int _numCalibrations;
+};
+
+/*
+ * Simulated annealing: keep a mutation that lowers the total by
+ * 'loss' with probability exp(-loss / T).  T starts so that the mean
+ * loss is kept half the time and cools each generation.
+ */
+class SAnnealingAcceptance : public SCalibratedAcceptance
+{
+public:
+    SAnnealingAcceptance();
+
+protected:
+    virtual bool acceptLoss(double loss, double scale);
+};
+
+/*
+ * Threshold accepting: keep a mutation that lowers the total by up
+ * to a threshold, which starts at the mean loss and shrinks each
+ * generation.
+ */
+class SThresholdAcceptance : public SCalibratedAcceptance
+{
+public:
+    SThresholdAcceptance();
+
+protected:
+    virtual bool acceptLoss(double loss, double scale);
+};
+
+/*
+ * Late acceptance hill climbing: keep a mutation unless the total is
+ * lower than both the last one and the one 'length' generations ago.
+ */
+class SLateAcceptance : public SAcceptance
+{
+public:
+    SLateAcceptance();
+
+    void setHistoryLength(int length) { _historyLength = length; }
+
+    virtual void save(SCheckpointWriter& writer) const;
+    virtual bool load(SCheckpointReader& reader);
+
+protected:
+    virtual bool decide(int64_t score, int64_t lastScore);
+    virtual void resetRule();
+
+private:
+    int _historyLength;
+    std::vector<int64_t> _history;
+    int _historyIndex;
+};
+
+#endif // SACCEPTANCE_H
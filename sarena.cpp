@@ -0,0 +1,116 @@
+#include "sarena.h"
+
+#include <stdlib.h>
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+static const size_t HugePageSize = 2 * 1024 * 1024;
+
+SArena::SArena()
+  : _block(0),
+    _capacity(0),
+    _mappedSize(0),
+    _used(0),
+    _hugePages(NoHugePages)
+{
+}
+
+SArena::~SArena()
+{
+    reset();
+    release();
+}
+
+void SArena::reserve(size_t size, HugePages hugePages)
+{
+    reset();
+    if (size <= _capacity && hugePages == _hugePages) {
+        return;
+    }
+    release();
+
+    size = align(size);
+    _hugePages = hugePages;
+#if defined(Q_OS_LINUX)
+    void* p = MAP_FAILED;
+    size_t mappedSize = size;
+    if (hugePages != NoHugePages) {
+        mappedSize = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+    }
+    if (hugePages == ExplicitHugePages) {
+        p = mmap(0, mappedSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        p = mmap(0, mappedSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED && hugePages != NoHugePages) {
+            madvise(p, mappedSize, MADV_HUGEPAGE);
+        }
+    }
+    if (p == MAP_FAILED) {
+        return;
+    }
+    _block = static_cast<char*>(p);
+    _mappedSize = mappedSize;
+#else
+    // Over allocate so the block can be aligned
+    _mappedSize = size + Alignment;
+    _block = static_cast<char*>(malloc(_mappedSize));
+    if (!_block) {
+        return;
+    }
+#endif
+    _capacity = size;
+}
+
+void SArena::reset()
+{
+    _used = 0;
+    for (size_t i = 0; i < _overflow.size(); ++i) {
+        free(_overflow[i]);
+    }
+    _overflow.clear();
+}
+
+void SArena::release()
+{
+    if (_block) {
+#if defined(Q_OS_LINUX)
+        munmap(_block, _mappedSize);
+#else
+        free(_block);
+#endif
+    }
+    _block = 0;
+    _capacity = 0;
+    _mappedSize = 0;
+}
+
+void* SArena::allocBytes(size_t size)
+{
+    size = align(size);
+    if (_used + size <= _capacity) {
+        // mmap returns page aligned memory, malloc may not
+        char* base = _block;
+        size_t misalign = (size_t)base & (Alignment - 1);
+        if (misalign) {
+            base += Alignment - misalign;
+        }
+        void* p = base + _used;
+        _used += size;
+        return p;
+    }
+
+    // Didn't fit, fall back to the heap
+    char* p = static_cast<char*>(malloc(size + Alignment));
+    _overflow.push_back(p);
+    size_t misalign = (size_t)p & (Alignment - 1);
+    if (misalign) {
+        p += Alignment - misalign;
+    }
+    return p;
+}
@@ -0,0 +1,94 @@
+#ifndef SARENA_H
+#define SARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Single block of memory that per-run buffers are carved from.
+ *
+ * Reserve the total size up-front, then alloc() the buffers.
+ * reset() makes the whole block available again without going
+ * back to the OS, so the same memory is reused between runs.
+ * Allocations beyond the reserved size still succeed, they fall
+ * back to the heap until the next reset().
+ */
+class SArena
+{
+public:
+    enum HugePages {
+        NoHugePages,
+        // Ask the kernel to back the block with transparent huge
+        // pages (Linux only).
+        TransparentHugePages,
+        // Map the block from the huge page pool, falls back to
+        // transparent huge pages if the pool is too small (Linux
+        // only).
+        ExplicitHugePages
+    };
+
+    SArena();
+    ~SArena();
+
+    /*
+     * Make sure at least 'size' bytes are available.  Existing
+     * allocations are invalidated if the block has to be replaced.
+     * Also resets the arena.
+     */
+    void reserve(size_t size, HugePages hugePages = NoHugePages);
+
+    /*
+     * Make the whole block available again.  Invalidates all
+     * allocations.
+     */
+    void reset();
+
+    /*
+     * Allocate space for 'count' objects of type T, aligned to a
+     * cache line.  The memory is not initialised.
+     */
+    template <typename T>
+    T* alloc(size_t count) {
+        return static_cast<T*>(allocBytes(count * sizeof(T)));
+    }
+
+    /*
+     * Get the space used by 'count' objects of type T once they are
+     * aligned, for working out the size to reserve().
+     */
+    template <typename T>
+    static size_t alignedSize(size_t count) {
+        return align(count * sizeof(T));
+    }
+
+    size_t getCapacity() const { return _capacity; }
+    size_t getUsed() const { return _used; }
+
+    /*
+     * Return true if the block is backed by huge pages (explicitly
+     * mapped, or transparent huge pages were requested).
+     */
+    bool isHugePages() const { return _hugePages != NoHugePages; }
+
+    // Alignment of each allocation
+    static const size_t Alignment = 64;
+
+private:
+    static size_t align(size_t size) {
+        return (size + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    void* allocBytes(size_t size);
+    void release();
+
+    char* _block;
+    size_t _capacity;
+    size_t _mappedSize;
+    size_t _used;
+    HugePages _hugePages;
+
+    // Allocations that did not fit in the block
+    std::vector<void*> _overflow;
+};
+
+#endif // SARENA_H
@@ -0,0 +1,179 @@
+#include "scheckpoint.h"
+
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include "strace.h"
+
+void SCheckpointWriter::begin()
+{
+    _data.clear();
+    _data.append(SCheckpoint::Magic, sizeof(SCheckpoint::Magic));
+    write<uint32_t>(SCheckpoint::Version);
+    write<uint32_t>(SCheckpoint::ByteOrderMark);
+}
+
+void SCheckpointWriter::writeString(const QString& text)
+{
+    QByteArray utf8 = text.toUtf8();
+    write<uint32_t>(utf8.size());
+    _data.append(utf8);
+    align(sizeof(uint32_t));
+}
+
+void SCheckpointWriter::align(int alignment)
+{
+    while (_data.size() % alignment) {
+        _data.append('\0');
+    }
+}
+
+bool SCheckpointReader::begin()
+{
+    const uchar* magic = 0;
+    if (_size >= sizeof(SCheckpoint::Magic)) {
+        magic = take(sizeof(SCheckpoint::Magic));
+    }
+    if (!magic || memcmp(magic, SCheckpoint::Magic,
+                         sizeof(SCheckpoint::Magic))) {
+        setError("Not a checkpoint");
+        return false;
+    }
+    uint32_t version = read<uint32_t>();
+    if (version != SCheckpoint::Version) {
+        setError(QString("Unsupported checkpoint version %1").arg(version));
+        return false;
+    }
+    if (read<uint32_t>() != SCheckpoint::ByteOrderMark) {
+        setError("Checkpoint written on a machine with another byte order");
+        return false;
+    }
+    return true;
+}
+
+QString SCheckpointReader::readString()
+{
+    uint32_t size = read<uint32_t>();
+    const uchar* p = take(size);
+    align(sizeof(uint32_t));
+    if (!p) {
+        return QString();
+    }
+    return QString::fromUtf8(reinterpret_cast<const char*>(p), size);
+}
+
+const uchar* SCheckpointReader::take(size_t size)
+{
+    if (!_ok || size > _size - _pos) {
+        setError("Checkpoint is truncated");
+        return 0;
+    }
+    const uchar* p = _data + _pos;
+    _pos += size;
+    return p;
+}
+
+void SCheckpointReader::align(int alignment)
+{
+    size_t pos = (_pos + alignment - 1) / alignment * alignment;
+    if (pos > _size) {
+        setError("Checkpoint is truncated");
+        return;
+    }
+    _pos = pos;
+}
+
+void SCheckpointReader::setError(const QString& error)
+{
+    // Keep the first error, it's the cause of the others
+    if (_ok) {
+        _error = error;
+    }
+    _ok = false;
+}
+
+SCheckpointFileWriter::SCheckpointFileWriter()
+  : _pending(false),
+    _writing(false),
+    _failed(false),
+    _quit(false)
+{
+}
+
+SCheckpointFileWriter::~SCheckpointFileWriter()
+{
+    flush();
+    {
+        QMutexLocker lock(&_mutex);
+        _quit = true;
+        _posted.wakeAll();
+    }
+    wait();
+}
+
+void SCheckpointFileWriter::post(const QString& fileName,
+                                 const QByteArray& data)
+{
+    QMutexLocker lock(&_mutex);
+    _fileName = fileName;
+    _data = data;
+    _pending = true;
+    _posted.wakeAll();
+    if (!isRunning()) {
+        start(QThread::LowPriority);
+    }
+}
+
+bool SCheckpointFileWriter::flush()
+{
+    QMutexLocker lock(&_mutex);
+    while (_pending || _writing) {
+        _written.wait(&_mutex);
+    }
+    bool ok = !_failed;
+    _failed = false;
+    return ok;
+}
+
+bool SCheckpointFileWriter::writeFile(const QString& fileName,
+                                      const QByteArray& data)
+{
+    STraceSpan span("checkpoint.write");
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+void SCheckpointFileWriter::run()
+{
+    QMutexLocker lock(&_mutex);
+    for (;;) {
+        while (!_pending && !_quit) {
+            _posted.wait(&_mutex);
+        }
+        if (!_pending) {
+            break;
+        }
+        QString fileName = _fileName;
+        QByteArray data = _data;
+        _data.clear();
+        _pending = false;
+        _writing = true;
+
+        lock.unlock();
+        bool ok = writeFile(fileName, data);
+        lock.relock();
+
+        _writing = false;
+        if (!ok) {
+            _failed = true;
+        }
+        _written.wakeAll();
+    }
+}
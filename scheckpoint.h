@@ -0,0 +1,176 @@
+#ifndef SCHECKPOINT_H
+#define SCHECKPOINT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+/*
+ * Checkpoint file format, see SRun::saveCheckpoint().
+ *
+ * A checkpoint is the magic, the version and a byte order mark,
+ * followed by the sections written by SRun.  Values are stored in
+ * the byte order of the machine that wrote them, a checkpoint is
+ * only loaded on a machine with the same byte order.  Bump Version
+ * whenever the layout changes, older versions are rejected.
+ */
+namespace SCheckpoint
+{
+    static const char Magic[8] = { 'S', 'N', 'G', 'P', 'C', 'K', 'P', 'T' };
+    enum {
+        Version = 2,
+        ByteOrderMark = 0x01020304,
+        // Alignment of the result rows in the file, so they can be
+        // copied straight out of the mapped file
+        RowAlignment = 64
+    };
+}
+
+/*
+ * Appends values to a checkpoint.
+ */
+class SCheckpointWriter
+{
+public:
+    SCheckpointWriter() {}
+
+    /*
+     * Start a checkpoint, writes the header.
+     */
+    void begin();
+
+    template<typename T>
+    void write(const T& value) {
+        _data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    template<typename T>
+    void write(const T* values, size_t count) {
+        _data.append(reinterpret_cast<const char*>(values),
+                     int(sizeof(T) * count));
+    }
+    void writeString(const QString& text);
+
+    /*
+     * Pad with zeros to a multiple of 'alignment' bytes.
+     */
+    void align(int alignment);
+
+    QByteArray& getData() { return _data; }
+
+private:
+    QByteArray _data;
+};
+
+/*
+ * Reads values from a checkpoint, usually a mapped file.  Reading
+ * past the end fails and leaves the values zeroed, check isOk()
+ * once done.
+ */
+class SCheckpointReader
+{
+public:
+    SCheckpointReader(const uchar* data, size_t size)
+      : _data(data), _size(size), _pos(0), _ok(true) {}
+
+    /*
+     * Read and check the header, sets the error if it doesn't
+     * match.
+     */
+    bool begin();
+
+    template<typename T>
+    T read() {
+        T value;
+        read(&value, 1);
+        return value;
+    }
+    template<typename T>
+    void read(T* values, size_t count) {
+        const uchar* p = take(sizeof(T) * count);
+        if (p) {
+            memcpy(values, p, sizeof(T) * count);
+        } else {
+            std::fill_n(values, count, T());
+        }
+    }
+    QString readString();
+
+    /*
+     * Get 'size' bytes in place, NULL if there aren't enough.
+     */
+    const uchar* take(size_t size);
+
+    /*
+     * Skip to a multiple of 'alignment' bytes.
+     */
+    void align(int alignment);
+
+    bool isOk() const { return _ok; }
+
+    /*
+     * Fail the read with 'error'.
+     */
+    void setError(const QString& error);
+    const QString& getError() const { return _error; }
+
+private:
+    const uchar* _data;
+    size_t _size;
+    size_t _pos;
+    bool _ok;
+    QString _error;
+};
+
+/*
+ * Writes checkpoints to disk in the background, so a run only
+ * stalls while its state is copied, not while it's written.
+ *
+ * Only the newest checkpoint is kept if they are posted faster than
+ * they can be written.  Files are replaced atomically, an
+ * interrupted write leaves the previous checkpoint in place.
+ */
+class SCheckpointFileWriter : public QThread
+{
+public:
+    SCheckpointFileWriter();
+    virtual ~SCheckpointFileWriter();
+
+    /*
+     * Queue 'data' to be written to 'fileName', starts the thread
+     * if needed.
+     */
+    void post(const QString& fileName, const QByteArray& data);
+
+    /*
+     * Wait for any queued checkpoint to be written.  Returns false
+     * if a write failed since the last call.
+     */
+    bool flush();
+
+    /*
+     * Write 'data' to 'fileName' now.
+     */
+    static bool writeFile(const QString& fileName, const QByteArray& data);
+
+protected:
+    virtual void run();
+
+private:
+    QMutex _mutex;
+    QWaitCondition _posted;
+    QWaitCondition _written;
+    QString _fileName;
+    QByteArray _data;
+    bool _pending;
+    bool _writing;
+    bool _failed;
+    bool _quit;
+};
+
+#endif // SCHECKPOINT_H
@@ -0,0 +1,125 @@
+#include "scounters.h"
+
+SCounters::SCounters()
+  : perfCounters(NULL)
+{
+    reset();
+}
+
+void SCounters::reset()
+{
+    generations = 0;
+    nodesEvaluated = 0;
+    caseEvaluations = 0;
+    accepted = 0;
+    rejected = 0;
+    restores = 0;
+    coneSizes.reset();
+    generationNsecs.reset();
+    for (int i = 0; i < NumPhases; ++i) {
+        phaseNsecs[i] = 0;
+        for (int j = 0; j < SPerfCounters::NumEvents; ++j) {
+            phaseEvents[i][j] = 0;
+        }
+    }
+}
+
+void SCounters::add(const SCounters& other)
+{
+    generations += other.generations;
+    nodesEvaluated += other.nodesEvaluated;
+    caseEvaluations += other.caseEvaluations;
+    accepted += other.accepted;
+    rejected += other.rejected;
+    restores += other.restores;
+    coneSizes.add(other.coneSizes);
+    generationNsecs.add(other.generationNsecs);
+    for (int i = 0; i < NumPhases; ++i) {
+        phaseNsecs[i] += other.phaseNsecs[i];
+        for (int j = 0; j < SPerfCounters::NumEvents; ++j) {
+            phaseEvents[i][j] += other.phaseEvents[i][j];
+        }
+    }
+}
+
+bool SCounters::hasPerfCounts() const
+{
+    for (int i = 0; i < NumPhases; ++i) {
+        if (phaseEvents[i][SPerfCounters::Cycles] ||
+            phaseEvents[i][SPerfCounters::Instructions]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QJsonObject SCounters::toJson() const
+{
+    QJsonObject result;
+    result["generations"] = double(generations);
+    result["nodesEvaluated"] = double(nodesEvaluated);
+    result["caseEvaluations"] = double(caseEvaluations);
+    result["accepted"] = double(accepted);
+    result["rejected"] = double(rejected);
+    result["restores"] = double(restores);
+    result["coneSizes"] = coneSizes.toJson();
+    result["generationNsecs"] = generationNsecs.toJson();
+    QJsonObject phases;
+    for (int i = 0; i < NumPhases; ++i) {
+        phases[getPhaseName(Phase(i))] = phaseNsecs[i] / 1e9;
+    }
+    result["phaseSeconds"] = phases;
+
+    if (hasPerfCounts()) {
+        // Misses are per node evaluated over a fitness case, whatever
+        // the phase, so the phases can be compared
+        double nodeCases = caseEvaluations > 0 ? caseEvaluations : 1;
+        QJsonObject perf;
+        for (int i = 0; i < NumPhases; ++i) {
+            const int64_t* events = phaseEvents[i];
+            QJsonObject phase;
+            for (int j = 0; j < SPerfCounters::NumEvents; ++j) {
+                phase[SPerfCounters::getEventName(SPerfCounters::Event(j))] =
+                    double(events[j]);
+            }
+            int64_t cycles = events[SPerfCounters::Cycles];
+            phase["ipc"] = cycles ?
+                double(events[SPerfCounters::Instructions]) / cycles : 0.0;
+            phase["l1dMissesPerNodeCase"] =
+                events[SPerfCounters::L1DMisses] / nodeCases;
+            phase["llcMissesPerNodeCase"] =
+                events[SPerfCounters::LLCMisses] / nodeCases;
+            phase["branchMissesPerNodeCase"] =
+                events[SPerfCounters::BranchMisses] / nodeCases;
+            perf[getPhaseName(Phase(i))] = phase;
+        }
+        result["perf"] = perf;
+    }
+    return result;
+}
+
+bool SCounters::isEnabled()
+{
+#ifdef SNGP_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* SCounters::getPhaseName(Phase phase)
+{
+    switch (phase) {
+    case MutatePhase:
+        return "mutate";
+    case MarkPhase:
+        return "mark";
+    case EvaluatePhase:
+        return "evaluate";
+    case ReducePhase:
+        return "reduce";
+    default:
+        break;
+    }
+    return "";
+}
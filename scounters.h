@@ -0,0 +1,213 @@
+#ifndef SCOUNTERS_H
+#define SCOUNTERS_H
+
+#include <stdint.h>
+#include <QJsonObject>
+
+#include "shistogram.h"
+#include "sperfcounters.h"
+
+#ifdef SNGP_COUNTERS
+#include <QElapsedTimer>
+#endif
+
+/*
+ * Hot path counters of a run, see SRunLoop.
+ *
+ * Only collected when built with SNGP_COUNTERS defined (qmake
+ * CONFIG+=counters), otherwise the count functions are empty and
+ * the counters stay zero.  Each run has its own counters, so there
+ * is no sharing between threads.
+ *
+ * Hardware counters are also read for each phase when
+ * 'perfCounters' is set, see SPerfCounters.
+ */
+class SCounters
+{
+public:
+    enum Phase {
+        // Mutating a node, or restoring the previous mutation
+        MutatePhase,
+        // Marking the nodes that depend on the mutated node
+        MarkPhase,
+        // Evaluating the changed nodes
+        EvaluatePhase,
+        // Totalling the scores and checking for a hit
+        ReducePhase,
+        NumPhases
+    };
+
+    SCounters();
+
+    /*
+     * Reset values (to zero).
+     */
+    void reset();
+
+    /*
+     * Add the counts of 'other', to total the counters of
+     * several runs.
+     */
+    void add(const SCounters& other);
+
+    /*
+     * Return true if the counters are collected.
+     */
+    static bool isEnabled();
+
+    /*
+     * Count the acceptance of the previous mutation.  Rejected
+     * mutations are restored, 'restored' is false if restoring
+     * didn't change the node.
+     */
+    void countMutation(bool accepted, bool restored);
+
+    /*
+     * Count the evaluation of 'nodes' result rows over 'cases'
+     * fitness cases in a generation.
+     */
+    void countEvaluation(int nodes, int cases);
+
+    /*
+     * Get the counters as JSON, with the hardware counts per phase
+     * when they were collected.
+     */
+    QJsonObject toJson() const;
+
+    /*
+     * Return true if hardware counts were collected.
+     */
+    bool hasPerfCounts() const;
+
+    static const char* getPhaseName(Phase phase);
+
+    // Number of generations counted
+    int64_t generations;
+
+    // Number of result rows re-evaluated, constant and duplicate
+    // nodes have none
+    int64_t nodesEvaluated;
+
+    // Number of node evaluations over a fitness case
+    int64_t caseEvaluations;
+
+    // Number of mutations kept and rejected
+    int64_t accepted;
+    int64_t rejected;
+
+    // Number of rejected mutations that were restored
+    int64_t restores;
+
+    // Number of nodes re-evaluated in each generation
+    SHistogram coneSizes;
+
+    // Time taken by each generation
+    SHistogram generationNsecs;
+
+    // Time spent in each phase
+    int64_t phaseNsecs[NumPhases];
+
+    // Hardware counts of each phase
+    int64_t phaseEvents[NumPhases][SPerfCounters::NumEvents];
+
+    // Hardware counters to read each phase, opened by the thread
+    // running the generations, NULL to not read them.  Not changed
+    // by reset() or add().
+    SPerfCounters* perfCounters;
+};
+
+/*
+ * Times consecutive phases of a generation into SCounters.
+ */
+class SPhaseTimer
+{
+public:
+    SPhaseTimer(SCounters& counters);
+
+    /*
+     * Add the time since the previous phase ended (or the timer
+     * was created) to 'phase'.
+     */
+    void endPhase(SCounters::Phase phase);
+
+    /*
+     * Record the time since the timer was created as the time
+     * taken by the generation.
+     */
+    void endGeneration();
+
+#ifdef SNGP_COUNTERS
+private:
+    SCounters& _counters;
+    QElapsedTimer _timer;
+    int64_t _lastNsecs;
+    SPerfCounters* _perfCounters;
+    int64_t _lastEvents[SPerfCounters::NumEvents];
+#endif
+};
+
+#ifdef SNGP_COUNTERS
+
+inline void SCounters::countMutation(bool accepted, bool restored)
+{
+    if (accepted) {
+        this->accepted++;
+    } else {
+        rejected++;
+        if (restored) {
+            restores++;
+        }
+    }
+}
+
+inline void SCounters::countEvaluation(int nodes, int cases)
+{
+    generations++;
+    nodesEvaluated += nodes;
+    caseEvaluations += int64_t(nodes) * cases;
+    coneSizes.record(nodes);
+}
+
+inline SPhaseTimer::SPhaseTimer(SCounters& counters)
+  : _counters(counters),
+    _lastNsecs(0),
+    _perfCounters(counters.perfCounters)
+{
+    _timer.start();
+    if (_perfCounters) {
+        _perfCounters->read(_lastEvents);
+    }
+}
+
+inline void SPhaseTimer::endPhase(SCounters::Phase phase)
+{
+    int64_t nsecs = _timer.nsecsElapsed();
+    _counters.phaseNsecs[phase] += nsecs - _lastNsecs;
+    _lastNsecs = nsecs;
+    if (_perfCounters) {
+        int64_t events[SPerfCounters::NumEvents];
+        _perfCounters->read(events);
+        int64_t* phaseEvents = _counters.phaseEvents[phase];
+        for (int i = 0; i < SPerfCounters::NumEvents; ++i) {
+            phaseEvents[i] += events[i] - _lastEvents[i];
+            _lastEvents[i] = events[i];
+        }
+    }
+}
+
+inline void SPhaseTimer::endGeneration()
+{
+    _counters.generationNsecs.record(_lastNsecs);
+}
+
+#else
+
+inline void SCounters::countMutation(bool, bool) {}
+inline void SCounters::countEvaluation(int, int) {}
+inline SPhaseTimer::SPhaseTimer(SCounters&) {}
+inline void SPhaseTimer::endPhase(SCounters::Phase) {}
+inline void SPhaseTimer::endGeneration() {}
+
+#endif // SNGP_COUNTERS
+
+#endif // SCOUNTERS_H
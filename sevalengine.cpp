@@ -1,27 +1,28 @@
 #include "sevalengine.h"
 
-#include <stdlib.h>
-
-static int Rand(int range)
-{
-    // Modding the value returned by rand() is not strictly
-    // correct as it affects the distribution, by oversampling
-    // the values returned by RAND_MAX % range.  The effect is
-    // slight here as we only request small ranges from rand()
-    // but worth noting in case you want a larger range.
-#ifdef BETTER_RAND_DISTRIBUTION
-    double f = (1.0 / (RAND_MAX + 1.0));
-    return int(qrand() * f * range);
-#else
-    return qrand() % range;
-#endif
-}
+#include <algorithm>
 
 SEvalEngine::SEvalEngine()
   : _numInputs(0),
     _size(0),
+    _linkHeads(0),
+    _linkNext(0),
+    _linkPrev(0),
+    _fanOut(0),
+    _arena(&_ownArena),
+    _linksSize(0),
+    _aliasHeads(0),
+    _aliasNext(0),
+    _aliasPrev(0),
+    _numDistinctNodes(0),
+    _deduplicate(true),
     _changedNodes(100),
-    _oldNodeIndex(0)
+    _oldNodeIndex(0),
+    _markPending(false),
+    _journalMaxEntries(0),
+    _journalStart(0),
+    _journalLength(0),
+    _randomState(0)
 {
 }
 
@@ -36,11 +37,6 @@ void SEvalEngine::evalAll(std::vector<int> &values)
     }
 }
 
-void SEvalEngine::clearChanged()
-{
-    _changedNodes.clear();
-}
-
 int SEvalEngine::evalNode(int i, const std::vector<int> &values)
 {
     SNode& node = _nodes[i];
@@ -158,40 +154,156 @@ int SEvalEngine::evalNode(const SNode &node, const std::vector<int> &values)
     return 0;
 }
 
-void SEvalEngine::mutate()
+void SEvalEngine::restore()
 {
-    int nodeIndex = _numInputs + Rand(_size - _numInputs);
-    _oldNode = _nodes[nodeIndex];
-    _oldNodeIndex = nodeIndex;
-    smut(nodeIndex);
+    restoreNode();
+    markMutation();
 }
 
-void SEvalEngine::restore()
+bool SEvalEngine::restoreNode()
 {
     SNode& currentNode = _nodes[_oldNodeIndex];
-    for(int i = 0; i < _oldNode.getNumParams(); ++i) {
+    if (currentNode.op == SNode::ValOp) {
+        if (currentNode.param[0] != _oldNode.param[0]) {
+            _nodes[_oldNodeIndex] = _oldNode;
+            _markPending = true;
+        }
+        return _markPending;
+    }
+    for(int i = 0; i < _oldNode.getNumLinks(); ++i) {
         int newLink = _oldNode.param[i];
         int oldLink = currentNode.param[i];
         if (oldLink != newLink) {
             _nodes[_oldNodeIndex] = _oldNode;
-            switchLink(_oldNodeIndex, oldLink, newLink);
-            markChanged(_oldNodeIndex);
-            return;
+            switchLink(_oldNodeIndex, i, oldLink, newLink);
+            _markPending = true;
+            return true;
         }
     }
+    return false;
 }
 
-void SEvalEngine::smut(int i)
+void SEvalEngine::setJournalSize(int maxEntries)
+{
+    _journalMaxEntries = std::max(maxEntries, 0);
+    _journal.clear();
+    _journalStart = 0;
+    _journalLength = 0;
+}
+
+void SEvalEngine::journalMutation()
+{
+    if (_journalMaxEntries == 0) {
+        return;
+    }
+    int size = _journal.size();
+    if (_journalLength == size && size < _journalMaxEntries) {
+        // Grow the ring as it fills, so it's only as big as needed
+        std::rotate(_journal.begin(), _journal.begin() + _journalStart,
+                    _journal.end());
+        _journalStart = 0;
+        _journal.push_back(JournalEntry());
+        size++;
+    }
+    // When full the oldest entry is dropped
+    JournalEntry& entry = _journal[(_journalStart + _journalLength) % size];
+    entry.index = _oldNodeIndex;
+    entry.oldNode = _oldNode;
+    if (_journalLength < size) {
+        _journalLength++;
+    } else {
+        _journalStart = (_journalStart + 1) % size;
+    }
+}
+
+void SEvalEngine::trimJournal(int length)
+{
+    length = std::max(length, 0);
+    if (_journalLength > length) {
+        int size = _journal.size();
+        _journalStart = (_journalStart + _journalLength - length) % size;
+        _journalLength = length;
+    }
+}
+
+void SEvalEngine::getJournal(std::vector<int>& outIndices,
+                             std::vector<SNode>& outNodes) const
+{
+    int size = _journal.size();
+    outIndices.resize(_journalLength);
+    outNodes.resize(_journalLength);
+    for (int k = 0; k < _journalLength; ++k) {
+        const JournalEntry& entry = _journal[(_journalStart + k) % size];
+        outIndices[k] = entry.index;
+        outNodes[k] = entry.oldNode;
+    }
+}
+
+void SEvalEngine::setJournal(const std::vector<int>& indices,
+                             const std::vector<SNode>& nodes)
+{
+    int count = std::min(indices.size(), nodes.size());
+    int first = std::max(0, count - _journalMaxEntries);
+    _journal.resize(count - first);
+    _journalStart = 0;
+    _journalLength = count - first;
+    for (int k = 0; k < _journalLength; ++k) {
+        _journal[k].index = indices[first + k];
+        _journal[k].oldNode = nodes[first + k];
+    }
+}
+
+void SEvalEngine::rollback(int count)
+{
+    int size = _journal.size();
+    count = std::min(count, _journalLength);
+    for (int k = 0; k < count; ++k) {
+        _journalLength--;
+        // There's no mutation to undo after init() or embed()
+        const JournalEntry& entry =
+            _journal[(_journalStart + _journalLength) % size];
+        if (entry.index >= _numInputs) {
+            setNodeParams(entry.index, entry.oldNode);
+        }
+    }
+    updateChanged();
+
+    // Nothing to restore() until the next mutate()
+    _oldNodeIndex = 0;
+    _oldNode = _nodes[0];
+    _markPending = false;
+}
+
+void SEvalEngine::setNodeParams(int i, const SNode& node)
+{
+    SNode& currentNode = _nodes[i];
+    if (currentNode.op == SNode::ValOp) {
+        currentNode.param[0] = node.param[0];
+    } else {
+        for (int j = 0; j < node.getNumLinks(); ++j) {
+            int oldLink = currentNode.param[j];
+            int newLink = node.param[j];
+            if (oldLink != newLink) {
+                currentNode.param[j] = newLink;
+                switchLink(i, j, oldLink, newLink);
+            }
+        }
+    }
+    markChanged(i);
+}
+
+bool SEvalEngine::smut(int i)
 {
     SNode& node = _nodes[i];
 
     if (i > 1) {
         if (node.op == SNode::ValOp) {
-            node.param[0] = Rand(1001);
+            node.param[0] = random(1001);
+            return true;
         } else {
             if (node.getNumParams()) {
                 int it = i - 1;
-                int j = Rand(node.getNumParams() * it);
+                int j = random(node.getNumParams() * it);
                 int jdiv = j / it;
                 int jrem = j % it;
                 int oldLink = node.param[jdiv];
@@ -200,81 +312,250 @@ void SEvalEngine::smut(int i)
                 }
                 int newLink = jrem;
                 node.param[jdiv] = newLink;
-                switchLink(i, oldLink, newLink);
-                markChanged(i);
+                switchLink(i, jdiv, oldLink, newLink);
+                return true;
             }
         }
     }
+    return false;
 }
 
-void SEvalEngine::switchLink(int i, int oldLink, int newLink)
+void SEvalEngine::switchLink(int i, int param, int oldLink, int newLink)
 {
     if (oldLink == newLink) {
         return;
     }
 
+    int slot = i * 3 + param;
     if (oldLink >= _numInputs) {
-        NodeLinks& link = _nodeLinks[oldLink];
-        for (size_t j = 0; j < link.size(); ++j) {
-            if (link[j] == i) {
-                link.erase(link.begin() + j);
-                break;
-            }
-        }
+        removeLink(slot, oldLink);
     }
 
     if (newLink >= _numInputs) {
-        NodeLinks& link = _nodeLinks[newLink];
-        link.push_back(i);
+        addLink(slot, newLink);
+    }
+}
+
+void SEvalEngine::addLink(int slot, int link)
+{
+    int head = _linkHeads[link];
+    _linkNext[slot] = head;
+    _linkPrev[slot] = -1;
+    if (head >= 0) {
+        _linkPrev[head] = slot;
+    }
+    _linkHeads[link] = slot;
+    _fanOut[link]++;
+}
+
+void SEvalEngine::removeLink(int slot, int link)
+{
+    int next = _linkNext[slot];
+    int prev = _linkPrev[slot];
+    if (prev >= 0) {
+        _linkNext[prev] = next;
+    } else {
+        _linkHeads[link] = next;
+    }
+    if (next >= 0) {
+        _linkPrev[next] = prev;
+    }
+    _fanOut[link]--;
+}
+
+void SEvalEngine::addAlias(int i, int canon)
+{
+    int head = _aliasHeads[canon];
+    _aliasNext[i] = head;
+    _aliasPrev[i] = -1;
+    if (head >= 0) {
+        _aliasPrev[head] = i;
+    }
+    _aliasHeads[canon] = i;
+}
+
+void SEvalEngine::removeAlias(int i, int canon)
+{
+    int next = _aliasNext[i];
+    int prev = _aliasPrev[i];
+    if (prev >= 0) {
+        _aliasNext[prev] = next;
+    } else {
+        _aliasHeads[canon] = next;
+    }
+    if (next >= 0) {
+        _aliasPrev[next] = prev;
     }
 }
 
 void SEvalEngine::markChanged(int index)
 {
-    if (_changedNodes.add(index)) {
-        NodeLinks& links = _nodeLinks[index];
-        for (size_t i = 0; i < links.size(); ++i) {
-            markChanged(links[i]);
+    if (!_markedNodes[index]) {
+        _markedNodes[index] = 1;
+        _changedNodes.add(index);
+        for (int slot = _linkHeads[index]; slot >= 0;
+             slot = _linkNext[slot]) {
+            markChanged(slot / 3);
         }
     }
 }
 
 void SEvalEngine::generateLinks()
 {
-    for (int i = _numInputs; i < _size; ++i) {
-        NodeLinks& links = _nodeLinks[i];
-        links.clear();
+    for (int i = 0; i < _size; ++i) {
+        _linkHeads[i] = -1;
+        _fanOut[i] = 0;
     }
     for (int i = _numInputs; i < _size; ++i) {
         SNode& node = _nodes[i];
-        for (int j = 0; j < node.getNumParams(); ++j) {
+        for (int j = 0; j < node.getNumLinks(); ++j) {
             int k = node.param[j];
-            NodeLinks& links = _nodeLinks[k];
-            if (i >= _numInputs) {
-                links.push_back(i);
+            if (k >= _numInputs) {
+                addLink(i * 3 + j, k);
+            }
+        }
+    }
+}
+
+size_t SEvalEngine::getArenaSize(int size)
+{
+    return SArena::alignedSize<int>(size) * 5 +
+           SArena::alignedSize<int>(size * 3) * 2;
+}
+
+void SEvalEngine::setArena(SArena* arena)
+{
+    _arena = arena ? arena : &_ownArena;
+    _linksSize = 0;
+}
+
+void SEvalEngine::allocateLinks()
+{
+    if (_arena == &_ownArena) {
+        _ownArena.reserve(getArenaSize(_size));
+    }
+    _linkHeads = _arena->alloc<int>(_size);
+    _fanOut = _arena->alloc<int>(_size);
+    _aliasHeads = _arena->alloc<int>(_size);
+    _aliasNext = _arena->alloc<int>(_size);
+    _aliasPrev = _arena->alloc<int>(_size);
+    _linkNext = _arena->alloc<int>(_size * 3);
+    _linkPrev = _arena->alloc<int>(_size * 3);
+    _linksSize = _size;
+}
+
+bool SEvalEngine::isConstant(int i) const
+{
+    if (i < _numInputs) {
+        return false;
+    }
+    const SNode& node = _nodes[i];
+    for (int j = 0; j < node.getNumLinks(); ++j) {
+        if (!_constNodes[node.param[j]]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SEvalEngine::updateChanged()
+{
+    if (!_deduplicate) {
+        return;
+    }
+    // Nodes found to need a new look up are added as we go, they
+    // always have higher indices than the node being updated
+    int* nodeIndices = _changedNodes.data();
+    for (int k = 0; k < _changedNodes.size(); ++k) {
+        int i = nodeIndices[k];
+        int oldCanon = _canonNodes[i];
+        _constNodes[i] = isConstant(i);
+        removeCanonical(i);
+        updateCanonical(i);
+        if (_canonNodes[i] != oldCanon) {
+            // The keys of the nodes linking to it have changed
+            for (int slot = _linkHeads[i]; slot >= 0;
+                 slot = _linkNext[slot]) {
+                _changedNodes.add(slot / 3);
             }
         }
     }
 }
 
+SNode SEvalEngine::makeKey(int i) const
+{
+    const SNode& node = _nodes[i];
+    SNode key;
+    key.op = node.op;
+    int numParams = node.getNumParams();
+    int numLinks = node.getNumLinks();
+    for (int j = 0; j < numParams; ++j) {
+        key.param[j] = j < numLinks ? _canonNodes[node.param[j]]
+                                    : node.param[j];
+    }
+    if (node.isCommutative() && key.param[0] > key.param[1]) {
+        std::swap(key.param[0], key.param[1]);
+    }
+    return key;
+}
+
+void SEvalEngine::updateCanonical(int i)
+{
+    _canonNodes[i] = i;
+    if (i < _numInputs) {
+        return;
+    }
+
+    SNode key = makeKey(i);
+    _nodeKeys[i] = key;
+    NodeTable::iterator it = _nodeTable.find(key);
+    if (it == _nodeTable.end()) {
+        _nodeTable[key] = i;
+        _numDistinctNodes++;
+    } else if (it->second < i) {
+        _canonNodes[i] = it->second;
+        addAlias(i, it->second);
+    } else {
+        // The table entry is a higher node, either identical or
+        // about to be updated itself.  This one takes its place, the
+        // higher node (and its aliases) are looked up again.
+        _changedNodes.add(it->second);
+        it->second = i;
+        _numDistinctNodes++;
+    }
+}
+
+void SEvalEngine::removeCanonical(int i)
+{
+    if (i < _numInputs) {
+        return;
+    }
+
+    int canon = _canonNodes[i];
+    if (canon != i) {
+        removeAlias(i, canon);
+    } else {
+        // Its aliases may now have another canonical node
+        for (int alias = _aliasHeads[i]; alias >= 0;
+             alias = _aliasNext[alias]) {
+            _changedNodes.add(alias);
+        }
+        NodeTable::iterator it = _nodeTable.find(_nodeKeys[i]);
+        if (it != _nodeTable.end() && it->second == i) {
+            _nodeTable.erase(it);
+        }
+        _numDistinctNodes--;
+    }
+}
+
 bool SEvalEngine::verifyLinksExist()
 {
     // Used for debugging purposes only
     for (int i = _numInputs; i < _size; ++i) {
-        NodeLinks& links = _nodeLinks[i];
-        for (NodeLinksIterator it = links.begin();
-             it != links.end(); ++it)
-        {
-            bool bFound = false;
-            int j = *it;
-            SNode& node  = _nodes[j];
-            for (int k = 0; k < node.getNumParams(); ++k) {
-                if (node.param[k] == i) {
-                    bFound = true;
-                    break;
-                }
-            }
-            if (!bFound) {
+        for (int slot = _linkHeads[i]; slot >= 0; slot = _linkNext[slot]) {
+            SNode& node  = _nodes[slot / 3];
+            int k = slot % 3;
+            if (k >= node.getNumLinks() || node.param[k] != i) {
                 return false;
             }
         }
@@ -285,58 +566,45 @@ bool SEvalEngine::verifyLinksExist()
 bool SEvalEngine::verifyAllLinks()
 {
     // Used for debugging purposes only
-    std::vector<NodeLinks > nodeLinks(_size);
+    std::vector<int> numLinks(_size, 0);
     for (int i = _numInputs; i < _size; ++i) {
         SNode& node = _nodes[i];
-        for (int j = 0; j < node.getNumParams(); ++j) {
+        for (int j = 0; j < node.getNumLinks(); ++j) {
             int k = node.param[j];
-            NodeLinks& links = nodeLinks[k];
-            if (i >= _numInputs) {
-                links.push_back(i);
+            if (k >= _numInputs) {
+                numLinks[k]++;
             }
         }
     }
 
-    bool bNotEqual = false;
     for (int i = _numInputs; i < _size; ++i) {
-        NodeLinks& linksReal = nodeLinks[i];
-        NodeLinks& linksCached = _nodeLinks[i];
-        for (size_t j = 0; j < linksCached.size(); ++j) {
-            int val = linksCached[j];
-            size_t k = 0;
-            for (; k < linksReal.size(); ++k) {
-                if (linksReal[k] == val) {
-                    linksReal.erase(linksReal.begin() + k);
-                    break;
-                }
-            }
-            if (k == linksReal.size()) {
-                bNotEqual = true;
-            }
+        int count = 0;
+        for (int slot = _linkHeads[i]; slot >= 0; slot = _linkNext[slot]) {
+            count++;
         }
-        if (linksReal.size() > 0) {
-            bNotEqual = true;
+        if (count != numLinks[i] || count != _fanOut[i]) {
+            return false;
         }
     }
 
-    return !bNotEqual;
+    return verifyLinksExist();
 }
 
 void SEvalEngine::randomise(int i)
 {
     SNode& node = _nodes[i];
 
-    int val = Rand(_ops.size());
+    int val = random(_ops.size());
     node.op = _ops[val];
 
     if (i > 1) {
         if (node.op == SNode::ValOp) {
-            node.param[0] = Rand(1001);
+            node.param[0] = random(1001);
             node.param[1] = 0;
             node.param[2] = 0;
         } else {
             for (int j = 0; j < node.getNumParams(); ++j) {
-                node.param[j] = Rand(i);
+                node.param[j] = random(i);
             }
         }
     } else {
@@ -348,8 +616,8 @@ void SEvalEngine::randomise(int i)
 
 void SEvalEngine::init()
 {
-    _nodes.resize(_size);
-    _nodeLinks.resize(_size);
+    resize();
+    _randomState = qrand();
 
     for (int i = 0; i < _numInputs; ++i) {
         _nodes[i].op = SNode::InputOp;
@@ -359,7 +627,89 @@ void SEvalEngine::init()
         randomise(i);
     }
 
+    rebuild();
+    _journalLength = 0;
+
+    // Nothing to restore() until the next mutate()
+    _oldNodeIndex = 0;
+    _oldNode = _nodes[0];
+}
+
+void SEvalEngine::setNodes(const SNode* nodes, int oldNodeIndex,
+                           const SNode& oldNode)
+{
+    resize();
+    _nodes.assign(nodes, nodes + _size);
+    rebuild();
+    _journalLength = 0;
+    _oldNodeIndex = oldNodeIndex;
+    _oldNode = oldNode;
+}
+
+bool SEvalEngine::embed(const SNode* instructions, int count, int at)
+{
+    if (at < _numInputs || count < 0 || at + count > _size) {
+        return false;
+    }
+    for (int k = 0; k < count; ++k) {
+        const SNode& node = instructions[k];
+        for (int j = 0; j < node.getNumLinks(); ++j) {
+            if (node.param[j] < 0 || node.param[j] >= _numInputs + k) {
+                return false;
+            }
+        }
+    }
+    for (int k = 0; k < count; ++k) {
+        SNode& node = _nodes[at + k];
+        node = instructions[k];
+        for (int j = 0; j < node.getNumLinks(); ++j) {
+            if (node.param[j] >= _numInputs) {
+                node.param[j] += at - _numInputs;
+            }
+        }
+    }
+    rebuild();
+    _journalLength = 0;
+
+    // Nothing to restore() until the next mutate()
+    _oldNodeIndex = 0;
+    _oldNode = _nodes[0];
+    return true;
+}
+
+void SEvalEngine::resize()
+{
+    _nodes.resize(_size);
+    _constNodes.resize(_size);
+    _nodeKeys.resize(_size);
+    _canonNodes.resize(_size);
+    _changedNodes.reserve(_size);
+    _markedNodes.assign(_size, 0);
+    if (_linksSize != _size) {
+        allocateLinks();
+    }
+}
+
+void SEvalEngine::rebuild()
+{
     generateLinks();
+
+    _nodeTable.clear();
+    _numDistinctNodes = 0;
+    for (int i = 0; i < _size; ++i) {
+        _aliasHeads[i] = -1;
+    }
+    for (int i = 0; i < _size; ++i) {
+        if (_deduplicate) {
+            _constNodes[i] = isConstant(i);
+            updateCanonical(i);
+        } else {
+            _constNodes[i] = 0;
+            _canonNodes[i] = i;
+        }
+    }
+    clearChanged();
+    _markPending = false;
 }
 
 void SEvalEngine::setAvailableOps(const std::vector<SNode::Op> &ops)
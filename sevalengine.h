@@ -2,8 +2,12 @@
 #define SEVALENGINE_H
 
 #include "snode.h"
+#include <stdint.h>
+#include <stdlib.h>
 #include <vector>
+#include <unordered_map>
 #include "sortedarray.h"
+#include "sarena.h"
 
 /*
  * Stores and evaluates a graph of SNodes.
@@ -31,6 +35,55 @@ public:
      */
     void init();
 
+    /*
+     * Replace the nodes, as when resuming a run from a checkpoint,
+     * and rebuild the links, constant flags and canonical nodes.
+     * There must be getSize() 'nodes'.  'oldNodeIndex' and
+     * 'oldNode' are the node changed by the last mutate() and its
+     * previous value, so the mutation can still be restore()d.
+     */
+    void setNodes(const SNode* nodes, int oldNodeIndex,
+                  const SNode& oldNode);
+
+    /*
+     * Replace the 'count' nodes from 'at' with 'instructions', as
+     * when a program migrates from another run.  The params of the
+     * instructions are slots, as in SProgram: below getNumInputs()
+     * an input, else the instruction (slot - getNumInputs()).  The
+     * links, constant flags and canonical nodes are rebuilt, and the
+     * last mutation can no longer be restore()d.  Returns false if
+     * the instructions don't fit after the inputs.
+     */
+    bool embed(const SNode* instructions, int count, int at);
+
+    /*
+     * Get the node changed by the last mutate(), and its value
+     * before the mutation.
+     */
+    int getOldNodeIndex() const { return _oldNodeIndex; }
+    const SNode& getOldNode() const { return _oldNode; }
+
+    /*
+     * State of the random number generator used to mutate the
+     * nodes, seeded from qrand() by init().  Saved with the nodes so
+     * a restored run makes the same mutations.
+     */
+    uint64_t getRandomState() const { return _randomState; }
+    void setRandomState(uint64_t state) { _randomState = state; }
+
+    /*
+     * Set the arena the link lists are allocated from, NULL to use
+     * an arena owned by the engine.  The lists are allocated by the
+     * next init(), the arena must not be reset while they are in
+     * use.
+     */
+    void setArena(SArena* arena);
+
+    /*
+     * Get the arena space init() needs for 'size' nodes.
+     */
+    static size_t getArenaSize(int size);
+
     /*
      * Set the number of nodes to act as inputs
      */
@@ -42,7 +95,47 @@ public:
      */
     void setAvailableOps(const std::vector<SNode::Op>& ops);
 
-    const std::vector<SNode>& getNodes() { return _nodes; }
+    const std::vector<SNode>& getNodes() const { return _nodes; }
+
+    /*
+     * Get the constant flag of each node.  A node is constant when
+     * it is a ValOp or when none of the nodes it links to
+     * (transitively) is an input, so it produces the same value for
+     * every fitness case.  Kept up to date by mutate() and restore().
+     */
+    const std::vector<char>& getConstantNodes() const { return _constNodes; }
+
+    /*
+     * Get the canonical node of each node.  Nodes with the same op
+     * and links with the same canonical nodes (in either order for
+     * commutative ops) always produce the same results, so only
+     * the lowest indexed of them is evaluated and the rest alias
+     * its results.  A node that is not a duplicate is its own
+     * canonical node.
+     */
+    const std::vector<int>& getCanonicalNodes() const { return _canonNodes; }
+
+    /*
+     * Turn off the constant flags and canonical nodes, for callers
+     * that evaluate every changed node from its params (see
+     * SLaneRun) and don't want to pay for keeping them up to date.
+     * No node is then constant, each is its own canonical node and
+     * getNumDistinctNodes() is zero, so Problem::evaluate() gives a
+     * row to every node, values included, and runs slower.  Takes
+     * effect on the next init().
+     */
+    void setDeduplication(bool enable) { _deduplicate = enable; }
+
+    /*
+     * Get the number of nodes that link to the node at 'i'.
+     */
+    int getFanOut(int i) const { return _fanOut[i]; }
+
+    /*
+     * Get the number of structurally distinct nodes, not counting
+     * inputs.
+     */
+    int getNumDistinctNodes() const { return _numDistinctNodes; }
 
     /*
      * Evaluates all nodes.
@@ -64,6 +157,50 @@ public:
      */
     void restore();
 
+    /*
+     * mutate() and restore() in two steps, so the steps can be
+     * timed separately (see SCounters).  mutateNode() and
+     * restoreNode() change the node, markMutation() then marks the
+     * nodes that have to be reevaluated.  markMutation() must be
+     * called before the next change.  restoreNode() returns false
+     * if there was nothing to restore.
+     */
+    void mutateNode();
+    bool restoreNode();
+    void markMutation();
+
+    /*
+     * Journal of accepted mutations, so a run can go back several
+     * generations (see SAcceptance).  journalMutation() records the
+     * last mutate(), call it once the mutation is kept.  rollback()
+     * undoes the last 'count' recorded mutations, newest first, and
+     * marks the nodes to reevaluate as restore() does, after which
+     * the last mutation can't be restore()d.  Only the node changed
+     * by each mutation is kept, the results are reevaluated.  The
+     * journal keeps the last 'maxEntries' mutations, 0 (the
+     * default) turns it off, and is cleared by init(), setNodes()
+     * and embed().  trimJournal() drops all but the last 'length'
+     * entries, those that can still be rolled back.  The journal
+     * grows as it fills, an entry takes sizeof(int) + sizeof(SNode)
+     * bytes.
+     */
+    void setJournalSize(int maxEntries);
+    void journalMutation();
+    void trimJournal(int length);
+    int getJournalLength() const { return _journalLength; }
+    void rollback(int count);
+
+    /*
+     * Get the journal, oldest first: the index of the node each
+     * mutation changed and the node before it, to save it in a
+     * checkpoint.  setJournal() replaces it, after setNodes(),
+     * dropping the oldest entries if there are more than it holds.
+     */
+    void getJournal(std::vector<int>& outIndices,
+                    std::vector<SNode>& outNodes) const;
+    void setJournal(const std::vector<int>& indices,
+                    const std::vector<SNode>& nodes);
+
     /*
      * Clear list of changed nodes, should only call after
      * evalAll() or evalChanged().
@@ -89,6 +226,11 @@ public:
     SortedArray<int>& getChangedNodes() { return _changedNodes; }
 
 private:
+    /*
+     * Get a random number in the range [0, range).
+     */
+    int random(int range);
+
     /*
      * Useful during debugging.
      * Verify that all links in the link list are real.
@@ -111,14 +253,34 @@ private:
 
     /*
      * Mutate one of the links for the given node at
-     * index 'i'.  The node operation stays the same.
+     * index 'i'.  The node operation stays the same.  Returns
+     * false if the node can't be mutated.
+     */
+    bool smut(int i);
+
+    /*
+     * Switch the link of param 'param' of the node at 'i'.
+     */
+    void switchLink(int i, int param, int oldLink, int newLink);
+
+    /*
+     * Add/remove link slot 'slot' to/from the list of the node
+     * at 'link'.
+     */
+    void addLink(int slot, int link);
+    void removeLink(int slot, int link);
+
+    /*
+     * Add/remove the node at 'i' to/from the alias list of the
+     * node at 'canon'.
      */
-    void smut(int i);
+    void addAlias(int i, int canon);
+    void removeAlias(int i, int canon);
 
     /*
-     * Switch a link in the link list for the given node.
+     * Allocate the link lists from the arena.
      */
-    void switchLink(int i, int oldLink, int newLink);
+    void allocateLinks();
 
     /*
      * Mark that a node has to be reevaluated.  Any nodes that
@@ -131,6 +293,57 @@ private:
      */
     void generateLinks();
 
+    /*
+     * Allocate the per node state and build it from the nodes.
+     */
+    void resize();
+    void rebuild();
+
+    /*
+     * Set the params of the node at 'i' to those of 'node', which
+     * must have the same op, and mark it changed.  updateChanged()
+     * must be called after.
+     */
+    void setNodeParams(int i, const SNode& node);
+
+    /*
+     * Work out if the node at 'i' is constant from the constant
+     * flags of the nodes it links to.
+     */
+    bool isConstant(int i) const;
+
+    /*
+     * Recalculate the constant flags and canonical nodes of the
+     * changed nodes.  Nodes only link to lower indices so walking
+     * the sorted changed list updates links before the nodes that
+     * depend on them.  Nodes whose key changes because a link got
+     * another canonical node are added to the list as it's walked,
+     * so the results are the same as rebuilding the table.
+     */
+    void updateChanged();
+
+    /*
+     * Get the structural key of the node at 'i': the links are
+     * replaced by their canonical nodes, unused params are cleared
+     * and commutative params are ordered.
+     */
+    SNode makeKey(int i) const;
+
+    /*
+     * Look up the node at 'i' in the structure table and alias it
+     * to an identical node with a lower index if there is one.  If
+     * the table has a higher node it's replaced by this one, and
+     * added to the changed list to be looked up again.
+     */
+    void updateCanonical(int i);
+
+    /*
+     * Remove the node at 'i' from the structure table or from the
+     * alias list of its canonical node.  The aliases of a canonical
+     * node are added to the changed list to be looked up again.
+     */
+    void removeCanonical(int i);
+
     int _numInputs;
     int _size;
     std::vector<SNode> _nodes;
@@ -138,17 +351,135 @@ private:
     // Available operators
     std::vector<SNode::Op> _ops;
 
-    // For each node, the set of nodes that refer back to that node
-    typedef std::vector<int> NodeLinks;
-    typedef NodeLinks::iterator NodeLinksIterator;
-    std::vector<NodeLinks> _nodeLinks;
+    // For each node, the list of link slots that refer back to that
+    // node.  Slot (i * 3 + k) is param k of node i.  Links to inputs
+    // are not recorded.
+    int* _linkHeads;
+    int* _linkNext;
+    int* _linkPrev;
+    int* _fanOut;
+
+    SArena* _arena;
+    SArena _ownArena;
+
+    // Number of nodes the link lists were allocated for
+    int _linksSize;
+
+    // For each node, non zero if the node is constant
+    std::vector<char> _constNodes;
+
+    struct SNodeHash {
+        size_t operator()(const SNode& node) const {
+            size_t h = node.op;
+            h = h * 1000003u ^ node.param[0];
+            h = h * 1000003u ^ node.param[1];
+            h = h * 1000003u ^ node.param[2];
+            return h;
+        }
+    };
+
+    // Structural key of each canonical node to its index
+    typedef std::unordered_map<SNode, int, SNodeHash> NodeTable;
+    NodeTable _nodeTable;
+
+    // For each node, the key it was last looked up with
+    std::vector<SNode> _nodeKeys;
+
+    // For each node, the lowest index node that is identical
+    std::vector<int> _canonNodes;
+
+    // For each canonical node, the list of nodes that alias it
+    int* _aliasHeads;
+    int* _aliasNext;
+    int* _aliasPrev;
+
+    int _numDistinctNodes;
+
+    // False if the constant flags and canonical nodes are not kept,
+    // see setDeduplication()
+    bool _deduplicate;
 
     // Ordered list of nodes that were changed by smut() and/or restore()
     SortedArray<int> _changedNodes;
 
+    // Nodes marked by markChanged(), whose dependents are in the
+    // changed list too.  Nodes added to be looked up again by
+    // updateChanged() are not marked.
+    std::vector<char> _markedNodes;
+
     // The last node that was changed by smut()
     SNode _oldNode;
     int _oldNodeIndex;
+
+    // True if the node at _oldNodeIndex was changed and has not
+    // been marked yet
+    bool _markPending;
+
+    // Ring of the nodes changed by the accepted mutations, and
+    // their previous values, see journalMutation()
+    struct JournalEntry {
+        int index;
+        SNode oldNode;
+    };
+    std::vector<JournalEntry> _journal;
+    int _journalMaxEntries;
+    int _journalStart;
+    int _journalLength;
+
+    uint64_t _randomState;
 };
 
+// Called once per generation, defined here so it can be inlined
+// into the run loop (see SRunLoop).
+
+inline int SEvalEngine::random(int range)
+{
+    // 64 bit LCG (Knuth's MMIX constants), the top 31 bits are used
+    // as they are the most random.  Modding the value is not strictly
+    // correct as it affects the distribution, by oversampling the
+    // low values.  The effect is slight here as we only request
+    // small ranges but worth noting in case you want a larger range.
+    _randomState = _randomState * 6364136223846793005ULL +
+        1442695040888963407ULL;
+    int value = int(_randomState >> 33);
+#ifdef BETTER_RAND_DISTRIBUTION
+    double f = (1.0 / 2147483648.0);
+    return int(value * f * range);
+#else
+    return value % range;
+#endif
+}
+
+inline void SEvalEngine::mutate()
+{
+    mutateNode();
+    markMutation();
+}
+
+inline void SEvalEngine::mutateNode()
+{
+    int nodeIndex = _numInputs + random(_size - _numInputs);
+    _oldNode = _nodes[nodeIndex];
+    _oldNodeIndex = nodeIndex;
+    _markPending = smut(nodeIndex);
+}
+
+inline void SEvalEngine::clearChanged()
+{
+    int* nodeIndices = _changedNodes.data();
+    for (int k = 0; k < _changedNodes.size(); ++k) {
+        _markedNodes[nodeIndices[k]] = 0;
+    }
+    _changedNodes.clear();
+}
+
+inline void SEvalEngine::markMutation()
+{
+    if (_markPending) {
+        _markPending = false;
+        markChanged(_oldNodeIndex);
+    }
+    updateChanged();
+}
+
 #endif // SEVALENGINE_H
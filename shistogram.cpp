@@ -0,0 +1,92 @@
+#include "shistogram.h"
+
+#include <math.h>
+#include <algorithm>
+#include <QString>
+
+SHistogram::SHistogram()
+{
+    reset();
+}
+
+void SHistogram::reset()
+{
+    // Keep the buckets, a reset histogram is usually recorded again
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _max = 0;
+}
+
+void SHistogram::add(const SHistogram& other)
+{
+    if (!other._counts.empty()) {
+        if (_counts.empty()) {
+            _counts.resize(NumBuckets);
+        }
+        for (int i = 0; i < NumBuckets; ++i) {
+            _counts[i] += other._counts[i];
+        }
+    }
+    _count += other._count;
+    if (other._max > _max) {
+        _max = other._max;
+    }
+}
+
+int64_t SHistogram::getBucketValue(int bucket)
+{
+    if (bucket < 2 * SubBucketHalf) {
+        return bucket;
+    }
+    int shift = bucket / SubBucketHalf - 1;
+    int64_t subBucket = bucket - SubBucketHalf * shift;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+int64_t SHistogram::getValueAtPercentile(double percentile) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+    int64_t target = int64_t(ceil(percentile / 100 * _count));
+    if (target < 1) {
+        target = 1;
+    }
+    int64_t total = 0;
+    for (int i = 0; i < NumBuckets; ++i) {
+        total += _counts[i];
+        if (total >= target) {
+            // The top of the bucket, but never more than was seen
+            int64_t value = getBucketValue(i);
+            return value < _max ? value : _max;
+        }
+    }
+    return _max;
+}
+
+QJsonObject SHistogram::toJson() const
+{
+    QJsonObject result;
+    result["count"] = double(_count);
+    result["p50"] = double(getValueAtPercentile(50));
+    result["p99"] = double(getValueAtPercentile(99));
+    result["p99.9"] = double(getValueAtPercentile(99.9));
+    result["max"] = double(_max);
+    return result;
+}
+
+QString SHistogram::toString(double scale, const char* unit) const
+{
+    double values[] = {
+        getValueAtPercentile(50) / scale,
+        getValueAtPercentile(99) / scale,
+        getValueAtPercentile(99.9) / scale,
+        _max / scale
+    };
+    QString text[4];
+    for (int i = 0; i < 4; ++i) {
+        text[i] = QString::number(values[i], 'g', 4) + unit;
+    }
+    return QString("p50 %1, p99 %2, p99.9 %3, max %4").
+        arg(text[0]).arg(text[1]).arg(text[2]).arg(text[3]);
+}
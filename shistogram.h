@@ -0,0 +1,111 @@
+#ifndef SHISTOGRAM_H
+#define SHISTOGRAM_H
+
+#include <stdint.h>
+#include <vector>
+#include <QJsonObject>
+
+/*
+ * Histogram of non negative values with a fixed relative precision,
+ * in the style of HdrHistogram.
+ *
+ * Values below 64 are counted exactly.  Above that, each power of
+ * two range is split into 32 buckets, so a value is reported to
+ * within about 3%.  Recording is a few instructions, so it can be
+ * used in the run loop.  The buckets (about 15KB) are allocated by
+ * the first record(), so a histogram that is never recorded, as in
+ * a build without the counters, is cheap to copy.
+ */
+class SHistogram
+{
+public:
+    enum {
+        SubBucketBits = 5,
+        SubBucketHalf = 1 << SubBucketBits,
+        NumBuckets = (64 - SubBucketBits) * SubBucketHalf
+    };
+
+    SHistogram();
+
+    /*
+     * Reset values (to zero).
+     */
+    void reset();
+
+    /*
+     * Count 'value', negative values are counted as zero.
+     */
+    void record(int64_t value);
+
+    /*
+     * Add the counts of 'other'.
+     */
+    void add(const SHistogram& other);
+
+    int64_t getCount() const { return _count; }
+    int64_t getMax() const { return _max; }
+
+    /*
+     * Get the value that 'percentile' percent of the values are
+     * less than or equal to, within the precision of the histogram.
+     * Returns 0 if there are no values.
+     */
+    int64_t getValueAtPercentile(double percentile) const;
+
+    /*
+     * Get the count, p50, p99, p99.9 and max as JSON.
+     */
+    QJsonObject toJson() const;
+
+    /*
+     * Get the p50, p99, p99.9 and max as text, 'scale' divides the
+     * values and 'unit' is appended to them.
+     */
+    QString toString(double scale = 1, const char* unit = "") const;
+
+private:
+    static int getBucket(int64_t value);
+
+    // Highest value counted by 'bucket'
+    static int64_t getBucketValue(int bucket);
+
+    // Empty until a value is recorded
+    std::vector<int64_t> _counts;
+    int64_t _count;
+    int64_t _max;
+};
+
+inline int SHistogram::getBucket(int64_t value)
+{
+    if (value < 2 * SubBucketHalf) {
+        return int(value);
+    }
+    // Position of the highest set bit
+#if defined(__GNUC__)
+    int msb = 63 - __builtin_clzll(uint64_t(value));
+#else
+    int msb = 0;
+    for (uint64_t v = uint64_t(value); v > 1; v >>= 1) {
+        msb++;
+    }
+#endif
+    int shift = msb - SubBucketBits;
+    return SubBucketHalf * shift + int(value >> shift);
+}
+
+inline void SHistogram::record(int64_t value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+    if (_counts.empty()) {
+        _counts.resize(NumBuckets);
+    }
+    _counts[getBucket(value)]++;
+    _count++;
+    if (value > _max) {
+        _max = value;
+    }
+}
+
+#endif // SHISTOGRAM_H
@@ -0,0 +1,169 @@
+#include "slanerun.h"
+#include "problem.h"
+
+#include <algorithm>
+
+SLaneRun::SLaneRun()
+  : _problem(NULL),
+    _numLanes(DefaultLanes),
+    _populationSize(100),
+    _maxGenerations(25000),
+    _numInputs(0),
+    _numCases(0),
+    _activeLanes(0),
+    _newLanes(0)
+{
+}
+
+SLaneRun::~SLaneRun()
+{
+    for (size_t i = 0; i < _engines.size(); ++i) {
+        delete _engines[i];
+    }
+    delete _problem;
+}
+
+void SLaneRun::setNumLanes(int lanes)
+{
+    _numLanes = std::max(1, std::min<int>(lanes, MaxLanes));
+}
+
+void SLaneRun::setPopulationSize(int size)
+{
+    _populationSize = size;
+}
+
+void SLaneRun::setNumMaxGenerations(int maxGenerations)
+{
+    _maxGenerations = maxGenerations;
+}
+
+bool SLaneRun::isSupported(Problem& problem)
+{
+    const std::vector<SNode::Op>& ops = problem.getOps();
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (ops[i] != SNode::ValOp &&
+            problem.getOpKernel(ops[i]) == Problem::UnsupportedKernel) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SLaneRun::setProblem(Problem* problem)
+{
+    delete _problem;
+    _problem = problem;
+    _numInputs = problem->getNumInputs();
+    _numCases = problem->getNumFitnessCases();
+
+    for (size_t i = 0; i < _engines.size(); ++i) {
+        delete _engines[i];
+    }
+    _engines.clear();
+    for (int lane = 0; lane < _numLanes; ++lane) {
+        SEvalEngine* engine = new SEvalEngine();
+        engine->setNumInputs(_numInputs);
+        engine->setAvailableOps(problem->getOps());
+        engine->setSize(_populationSize);
+        engine->setDeduplication(false);
+        _engines.push_back(engine);
+    }
+    _stats.assign(_numLanes, SNodeStats());
+    _runIds.assign(_numLanes, -1);
+    _activeLanes = 0;
+    _newLanes = 0;
+    _outcomes.clear();
+
+    _opKernels.assign(SNode::NumOps, Problem::ZeroKernel);
+    for (int op = 0; op < SNode::NumOps; ++op) {
+        _opKernels[op] = problem->getOpKernel(SNode::Op(op));
+    }
+
+    // The input rows are the same for every lane, only lane 0's
+    // are used
+    size_t rowSize = _numCases;
+    size_t numRows = size_t(_populationSize) * _numLanes;
+    _results.assign((numRows + 1) * rowSize, 0);
+    for (int i = 0; i < _numInputs; ++i) {
+        int* row = &_results[i * _numLanes * rowSize];
+        for (int j = 0; j < _numCases; ++j) {
+            row[j] = problem->getInputs(j)[i];
+        }
+    }
+    _fitness.assign(numRows, 0);
+    _kernels.assign(numRows, Problem::ZeroKernel);
+    _values.assign(numRows, 0);
+    for (int k = 0; k < 3; ++k) {
+        _paramOffsets[k].assign(numRows, numRows * rowSize);
+    }
+    _changedLanes.assign(_populationSize, 0);
+}
+
+int SLaneRun::startRun(int id, uint seed)
+{
+    for (int lane = 0; lane < _numLanes; ++lane) {
+        if (_activeLanes & (1u << lane)) {
+            continue;
+        }
+        // As SRunLoop initialises a run, seeded from qrand()
+        qsrand(seed);
+        _engines[lane]->init();
+        _engines[lane]->clearChanged();
+        for (int i = _numInputs; i < _populationSize; ++i) {
+            decodeNode(lane, i);
+        }
+        SNodeStats& stats = _stats[lane];
+        stats.generation = 0;
+        stats.runs = 0;
+        _runIds[lane] = id;
+        _activeLanes |= 1u << lane;
+        _newLanes |= 1u << lane;
+        return lane;
+    }
+    return -1;
+}
+
+int SLaneRun::getNumActiveLanes() const
+{
+    int count = 0;
+    for (int lane = 0; lane < _numLanes; ++lane) {
+        count += (_activeLanes >> lane) & 1;
+    }
+    return count;
+}
+
+int SLaneRun::run(int count)
+{
+    size_t numOutcomes = _outcomes.size();
+    _problem->runLaneGenerations(*this, count);
+    return _outcomes.size() - numOutcomes;
+}
+
+void SLaneRun::takeOutcomes(std::vector<Outcome>& outOutcomes)
+{
+    outOutcomes.clear();
+    outOutcomes.swap(_outcomes);
+}
+
+void SLaneRun::decodeNode(int lane, int i)
+{
+    const SNode& node = _engines[lane]->getNodes()[i];
+    size_t k = size_t(i) * _numLanes + lane;
+    int numLinks = node.getNumLinks();
+    if (node.op == SNode::ValOp) {
+        _kernels[k] = ValueKernel;
+        _values[k] = node.param[0];
+    } else {
+        _kernels[k] = _opKernels[node.op];
+        _values[k] = 0;
+    }
+    for (int j = 0; j < 3; ++j) {
+        size_t row = size_t(_populationSize) * _numLanes;
+        if (j < numLinks) {
+            int p = node.param[j];
+            row = size_t(p) * _numLanes + (p < _numInputs ? 0 : lane);
+        }
+        _paramOffsets[j][k] = row * _numCases;
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef SLANERUN_H
+#define SLANERUN_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "snode.h"
+#include "sevalengine.h"
+#include "srunloop.h"
+
+class Problem;
+
+/*
+ * Several independent runs of one problem made in lockstep, one per
+ * "lane", for experiments of many runs of a small problem where a
+ * single run spends much of its time outside the evaluation.
+ *
+ * Each lane has its own nodes and mutates and restores them as an
+ * SRun does, then the nodes changed in any lane are evaluated in
+ * index order, each lane's rows with a loop specialised for the op's
+ * kernel so it vectorises over the test cases.  The rows of all the
+ * lanes for a node are next to each other: row (i, lane) is at
+ * (i * lanes + lane) * cases.  Nodes are evaluated from their params
+ * without deduplication (see SEvalEngine::setDeduplication()), which
+ * would cost more than it saves for populations this small.  See
+ * SLaneRunLoop.
+ *
+ * A lane started with a seed makes exactly the run an SRun makes
+ * after qsrand() with that seed.  Needs a problem whose ops all have
+ * a kernel, see Problem::getOpKernel().  Not thread safe.
+ */
+class SLaneRun
+{
+public:
+    SLaneRun();
+    ~SLaneRun();
+
+    // Most lanes, one bit each in a mask
+    enum { DefaultLanes = 8, MaxLanes = 32 };
+
+    // Kernel of ValOp nodes, after the Problem::OpKernel values,
+    // the result is the node's value
+    enum { ValueKernel = 0x40 };
+
+    /*
+     * Set the problem.  Ownership is passed to this class, as for
+     * SRun::setProblem().  Any runs in progress are dropped.
+     */
+    void setProblem(Problem* problem);
+
+    Problem* getProblem() { return _problem; }
+
+    /*
+     * Set the number of lanes, up to MaxLanes, and the number of
+     * nodes in each lane's population, including the inputs.  Take
+     * effect on the next setProblem().
+     */
+    void setNumLanes(int lanes);
+    void setPopulationSize(int size);
+
+    int getNumLanes() const { return _numLanes; }
+
+    /*
+     * Set the max number of generations of a run.
+     */
+    void setNumMaxGenerations(int maxGenerations);
+
+    /*
+     * Return true if the problem's ops can all be run in lanes.
+     */
+    static bool isSupported(Problem& problem);
+
+    /*
+     * Start a run in a free lane, seeded as by qsrand(seed).  'id'
+     * is returned with the outcome.  Returns the lane, or -1 if
+     * there is no free lane.
+     */
+    int startRun(int id, uint seed);
+
+    /*
+     * Get the number of lanes with a run in progress.
+     */
+    int getNumActiveLanes() const;
+
+    /*
+     * Run up to 'count' generations of every lane.  A lane whose run
+     * finishes stops and is free for the next startRun().  Returns
+     * the number of runs that finished.
+     */
+    int run(int count);
+
+    struct Outcome {
+        int id;
+        int lane;
+        bool hit;
+        // Generations taken, as SNodeStats::generation
+        int generations;
+        int64_t bestIndividualScore;
+    };
+
+    /*
+     * Take the outcomes of the runs that finished since the last
+     * call.
+     */
+    void takeOutcomes(std::vector<Outcome>& outOutcomes);
+
+    /*
+     * Get the stats of the run in 'lane'.
+     */
+    const SNodeStats& getStats(int lane) const { return _stats[lane]; }
+
+    /*
+     * Get the result of node 'i' of 'lane' for 'fitnessCase', and
+     * its fitness, as of the last generation.
+     */
+    int getNodeResult(int lane, int i, int fitnessCase) const {
+        size_t row = size_t(i) * _numLanes + (i < _numInputs ? 0 : lane);
+        return _results[row * _numCases + fitnessCase];
+    }
+    int getNodeFitness(int lane, int i) const {
+        return _fitness[size_t(i) * _numLanes + lane];
+    }
+
+private:
+    template<class P> friend class SLaneRunLoop;
+
+    /*
+     * Decode node 'i' of 'lane' into the kernel, param offsets and
+     * value tables.
+     */
+    void decodeNode(int lane, int i);
+
+    Problem* _problem;
+    int _numLanes;
+    int _populationSize;
+    int _maxGenerations;
+    int _numInputs;
+    int _numCases;
+
+    // For each lane, its nodes and stats
+    std::vector<SEvalEngine*> _engines;
+    std::vector<SNodeStats> _stats;
+    std::vector<int> _runIds;
+    // Bit per lane with a run in progress, and per lane that needs
+    // every node evaluated (just started)
+    uint32_t _activeLanes;
+    uint32_t _newLanes;
+
+    // Problem::OpKernel of each op
+    std::vector<uint8_t> _opKernels;
+
+    // Result rows of the nodes, the lanes of a node next to each
+    // other, plus a row of zeros for unlinked params.  Inputs only
+    // use the row of lane 0.
+    std::vector<int> _results;
+    // Fitness, kernel and value (of a ValOp) of each (node, lane)
+    std::vector<int> _fitness;
+    std::vector<int> _kernels;
+    std::vector<int> _values;
+    // Offset of the row of each param of each (node, lane)
+    std::vector<size_t> _paramOffsets[3];
+    // Lanes that changed each node this generation
+    std::vector<uint32_t> _changedLanes;
+
+    std::vector<Outcome> _outcomes;
+};
+
+#endif // SLANERUN_H
@@ -0,0 +1,276 @@
+#ifndef SLANERUNLOOP_H
+#define SLANERUNLOOP_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "problem.h"
+#include "slanerun.h"
+
+/*
+ * The SNGP generation loop of SRunLoop, for all the lanes of an
+ * SLaneRun at once: each lane mutates (or restores) its own nodes,
+ * the nodes changed in any lane are evaluated for the lanes that
+ * changed them, then each lane totals its scores and checks for a
+ * hit.
+ *
+ * Templated on the concrete problem type so the fitness function
+ * and the termination check are inlined into the row loops.  'P'
+ * must provide, as well as what SRunLoop needs:
+ *   caseFitness(int value, int expectedOutput)
+ * See ProblemT.
+ */
+template<class P>
+class SLaneRunLoop
+{
+public:
+    /*
+     * Run up to 'count' generations of the lanes, stopping early
+     * once no lane has a run in progress.
+     */
+    static void run(P& problem, SLaneRun& lanes, int count);
+
+private:
+    static void generation(P& problem, SLaneRun& lanes);
+
+    /*
+     * Evaluate row (i, lane) and return its fitness.
+     */
+    static int evaluateRow(SLaneRun& lanes, const int* outputs,
+                           int i, int lane);
+
+    /*
+     * Evaluate a row with the kernel's loop, so the loop is branch
+     * free and vectorises.  As Problem::OpKernel, arithmetic wraps.
+     */
+    template<int kernel>
+    static int evaluateKernel(const int* values0, const int* values1,
+                              const int* values2, int value,
+                              const int* outputs, int* outResults,
+                              int numCases);
+};
+
+template<class P>
+void SLaneRunLoop<P>::run(P& problem, SLaneRun& lanes, int count)
+{
+    for (int i = 0; i < count && lanes._activeLanes; ++i) {
+        generation(problem, lanes);
+    }
+}
+
+template<class P>
+template<int kernel>
+inline int SLaneRunLoop<P>::evaluateKernel(const int* values0,
+                                           const int* values1,
+                                           const int* values2, int value,
+                                           const int* outputs,
+                                           int* outResults, int numCases)
+{
+    int fitness = 0;
+    for (int j = 0; j < numCases; ++j) {
+        int a = values0[j];
+        int b = values1[j];
+        unsigned ua = a;
+        unsigned ub = b;
+        int result = 0;
+        switch (kernel) {
+        case Problem::TruthKernel:
+            result = a != 0;
+            break;
+        case Problem::OrKernel:
+            result = (a | b) != 0;
+            break;
+        case Problem::NorKernel:
+            result = (a | b) == 0;
+            break;
+        case Problem::AndKernel:
+            result = (a != 0) & (b != 0);
+            break;
+        case Problem::NandKernel:
+            result = (a == 0) | (b == 0);
+            break;
+        case Problem::IfKernel:
+            result = a ? b : values2[j];
+            break;
+        case Problem::DoubleKernel:
+            result = int(ua + ua);
+            break;
+        case Problem::SubKernel:
+            result = int(ub - ua);
+            break;
+        case Problem::MultKernel:
+            result = int(ub * ua);
+            break;
+        case Problem::DivKernel:
+            // b / -1 overflows for the most negative b, negate instead
+            result = a == 0 ? 0 : a == -1 ? int(0u - ub) : b / a;
+            break;
+        case SLaneRun::ValueKernel:
+            result = value;
+            break;
+        default:
+            break;
+        }
+        outResults[j] = result;
+        fitness += P::caseFitness(result, outputs[j]);
+    }
+    return fitness;
+}
+
+template<class P>
+int SLaneRunLoop<P>::evaluateRow(SLaneRun& lanes, const int* outputs,
+                                 int i, int lane)
+{
+    size_t k = size_t(i) * lanes._numLanes + lane;
+    int numCases = lanes._numCases;
+    int* rows = lanes._results.data();
+    const int* values0 = rows + lanes._paramOffsets[0][k];
+    const int* values1 = rows + lanes._paramOffsets[1][k];
+    const int* values2 = rows + lanes._paramOffsets[2][k];
+    int value = lanes._values[k];
+    int* results = rows + k * numCases;
+
+    switch (lanes._kernels[k]) {
+    case Problem::TruthKernel:
+        return evaluateKernel<Problem::TruthKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::OrKernel:
+        return evaluateKernel<Problem::OrKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::NorKernel:
+        return evaluateKernel<Problem::NorKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::AndKernel:
+        return evaluateKernel<Problem::AndKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::NandKernel:
+        return evaluateKernel<Problem::NandKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::IfKernel:
+        return evaluateKernel<Problem::IfKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::DoubleKernel:
+        return evaluateKernel<Problem::DoubleKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::SubKernel:
+        return evaluateKernel<Problem::SubKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::MultKernel:
+        return evaluateKernel<Problem::MultKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case Problem::DivKernel:
+        return evaluateKernel<Problem::DivKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    case SLaneRun::ValueKernel:
+        return evaluateKernel<SLaneRun::ValueKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    default:
+        return evaluateKernel<Problem::ZeroKernel>(
+            values0, values1, values2, value, outputs, results, numCases);
+    }
+}
+
+template<class P>
+void SLaneRunLoop<P>::generation(P& problem, SLaneRun& lanes)
+{
+    int numLanes = lanes._numLanes;
+    uint32_t active = lanes._activeLanes;
+    uint32_t fresh = lanes._newLanes;
+    uint32_t* changedLanes = lanes._changedLanes.data();
+
+    // Mutate or restore each lane, as SRunLoop does, and collect
+    // the nodes to evaluate.  New lanes were initialised by
+    // startRun() and need every node evaluated.
+    for (int lane = 0; lane < numLanes; ++lane) {
+        uint32_t bit = 1u << lane;
+        if (!(active & bit) || (fresh & bit)) {
+            continue;
+        }
+        SEvalEngine& engine = *lanes._engines[lane];
+        SNodeStats& stats = lanes._stats[lane];
+        if (stats.avgScore < stats.lastAvgScore) {
+            engine.restoreNode();
+            lanes.decodeNode(lane, engine.getOldNodeIndex());
+            engine.markMutation();
+            stats.avgScore = stats.lastAvgScore;
+        }
+        engine.mutateNode();
+        lanes.decodeNode(lane, engine.getOldNodeIndex());
+        engine.markMutation();
+        const SortedArray<int>& changed = engine.getChangedNodes();
+        const int* nodeIndices = changed.data();
+        for (int j = 0; j < changed.size(); ++j) {
+            changedLanes[nodeIndices[j]] |= bit;
+        }
+        engine.clearChanged();
+    }
+
+    // Params link to lower nodes, so evaluate in index order
+    int numInputs = problem.getNumInputs();
+    int numNodes = lanes._populationSize;
+    const int* outputs = problem.getOutputs().data();
+    int* fitness = lanes._fitness.data();
+    for (int i = numInputs; i < numNodes; ++i) {
+        uint32_t evaluate = changedLanes[i] | fresh;
+        changedLanes[i] = 0;
+        while (evaluate) {
+            int lane = __builtin_ctz(evaluate);
+            evaluate &= evaluate - 1;
+            fitness[i * numLanes + lane] =
+                evaluateRow(lanes, outputs, i, lane);
+        }
+    }
+
+    // Total the scores of each lane and check for a hit
+    for (int lane = 0; lane < numLanes; ++lane) {
+        uint32_t bit = 1u << lane;
+        if (!(active & bit)) {
+            continue;
+        }
+        const int* values = fitness + lane;
+        int64_t totalScore = 0;
+        int bestScore = values[numInputs * numLanes];
+        bool hit = false;
+        for (int i = numInputs; i < numNodes; ++i) {
+            int value = values[i * numLanes];
+            totalScore += value;
+            bestScore = std::max(bestScore, value);
+            hit |= problem.isTargetFitness(value);
+        }
+
+        SNodeStats& stats = lanes._stats[lane];
+        if (stats.generation == 0) {
+            stats.lastAvgScore = totalScore;
+            stats.avgScore = totalScore;
+            stats.bestScoreEver = totalScore;
+            stats.bestIndividualScore = bestScore;
+            stats.bestIndividualScoreEver = bestScore;
+        } else {
+            stats.lastAvgScore = stats.avgScore;
+            stats.avgScore = totalScore;
+            if (stats.bestScoreEver < totalScore) {
+                stats.bestScoreEver = totalScore;
+            }
+            stats.bestIndividualScore = bestScore;
+            if (stats.bestIndividualScoreEver < bestScore) {
+                stats.bestIndividualScoreEver = bestScore;
+            }
+        }
+        stats.generation++;
+
+        if (hit || stats.generation >= lanes._maxGenerations) {
+            SLaneRun::Outcome outcome;
+            outcome.id = lanes._runIds[lane];
+            outcome.lane = lane;
+            outcome.hit = hit;
+            outcome.generations = stats.generation;
+            outcome.bestIndividualScore = stats.bestIndividualScoreEver;
+            lanes._outcomes.push_back(outcome);
+            lanes._activeLanes &= ~bit;
+        }
+    }
+    lanes._newLanes = 0;
+}
+
+#endif // SLANERUNLOOP_H
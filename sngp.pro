@@ -11,21 +11,18 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = sngp
 TEMPLATE = app
 
+include(engine.pri)
+
 SOURCES += main.cpp\
     mainwindow.cpp \
-    problem.cpp \
     navlistview.cpp \
-    sngpworker.cpp \
-    snode.cpp \
-    sevalengine.cpp
+    nodelistmodel.cpp \
+    sngpworker.cpp
 
 HEADERS += mainwindow.h \
-    problem.h \
     navlistview.h \
-    sngpworker.h \
-    snode.h \
-    sevalengine.h \
-    sortedarray.h
+    nodelistmodel.h \
+    sngpworker.h
 
 FORMS += mainwindow.ui
 
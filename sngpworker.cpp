@@ -1,4 +1,5 @@
 #include "sngpworker.h"
+#include "strace.h"
 
 #include <map>
 #include <QVector>
@@ -8,9 +9,8 @@
 
 SNGPWorker::SNGPWorker()
   : _bRunning(false),
-    _problem(NULL),
     _times(0),
-    _maxGenerations(25000)
+    _checkpointInterval(0)
 {
 }
 
@@ -18,22 +18,37 @@ SNGPWorker::~SNGPWorker()
 {
     // Exit the other thread before cleaning up
     pause();
-    delete _problem;
 }
 
 void SNGPWorker::setProblem(Problem *problem)
 {
-    // Delete the old problem
-    delete _problem;
+    _run.setProblem(problem);
+}
+
+void SNGPWorker::setPopulationSize(int size)
+{
+    _run.setPopulationSize(size);
+}
+
+void SNGPWorker::setMaxResidentRows(int maxRows)
+{
+    _run.setMaxResidentRows(maxRows);
+}
+
+void SNGPWorker::setHugePages(SArena::HugePages hugePages)
+{
+    _run.setHugePages(hugePages);
+}
 
-    // Setup the eval engine according to the problem
-    _problem = problem;
-    _evalEngine.setNumInputs(_problem->getNumInputs());
-    _evalEngine.setAvailableOps(_problem->getOps());
-    _evalEngine.setSize(100);
-    _evalEngine.setNumInputs(_problem->getNumInputs());
-    _problem->initTestCaseResults(_evalEngine.getSize());
-    _fitness.resize(_evalEngine.getSize());
+void SNGPWorker::setSemanticHashing(bool enable)
+{
+    _run.setSemanticHashing(enable);
+}
+
+bool SNGPWorker::getSemanticHashing()
+{
+    QMutexLocker lock(&_mutex);
+    return _run.getSemanticHashing();
 }
 
 void SNGPWorker::setNumTimesToRun(int times)
@@ -43,15 +58,46 @@ void SNGPWorker::setNumTimesToRun(int times)
 
 void SNGPWorker::setNumMaxGenerations(int maxGenerations)
 {
-    _maxGenerations = maxGenerations;
+    _run.setNumMaxGenerations(maxGenerations);
 }
 
 void SNGPWorker::reset()
 {
     QMutexLocker lock(&_mutex);
-    _stats.reset();
-    _evalEngine.init();
-    resetFitness();
+    _run.reset();
+}
+
+QString SNGPWorker::getProblemName()
+{
+    QMutexLocker lock(&_mutex);
+    return _run.getProblem() ? _run.getProblem()->getName() : QString();
+}
+
+void SNGPWorker::setCheckpointFile(const QString& fileName,
+                                   int intervalSeconds)
+{
+    QMutexLocker lock(&_mutex);
+    _checkpointFile = fileName;
+    _checkpointInterval = intervalSeconds;
+}
+
+bool SNGPWorker::saveCheckpoint(const QString& fileName)
+{
+    if (_bRunning) {
+        return false;
+    }
+    QMutexLocker lock(&_mutex);
+    QByteArray data = _run.saveCheckpoint();
+    return SCheckpointFileWriter::writeFile(fileName, data);
+}
+
+bool SNGPWorker::loadCheckpoint(const QString& fileName, QString* outError)
+{
+    if (_bRunning) {
+        return false;
+    }
+    QMutexLocker lock(&_mutex);
+    return _run.loadCheckpoint(fileName, outError);
 }
 
 void SNGPWorker::pause()
@@ -78,78 +124,7 @@ bool SNGPWorker::isRunning()
 void SNGPWorker::step()
 {
     QMutexLocker lock(&_mutex);
-    runGeneration();
-}
-
-void SNGPWorker::runGeneration()
-{
-    // Apply a new mutation or revert the previous
-    if (_stats.generation == 0) {
-        // Calculate fitness values for all test cases
-        resetFitness();
-        _evalEngine.init();
-
-        _problem->evaluate(_evalEngine.getNodes(), _fitness);
-
-        // Calculate total scores
-        int totalScore = 0;
-        int bestScore = _fitness[_problem->getNumInputs()];
-        for (size_t i = _problem->getNumInputs(); i < _fitness.size(); ++i) {
-            totalScore += _fitness[i];
-            if (_fitness[i] > bestScore) {
-                bestScore = _fitness[i];
-            }
-        }
-
-        // First time just record the stats, this handles the case
-        // where the test is retuning negative values.
-        _stats.lastAvgScore = totalScore;
-        _stats.avgScore = totalScore;
-        _stats.bestScoreEver = totalScore;
-        if (_stats.runs == 0) {
-            _stats.bestIndividualScore = bestScore;
-            _stats.bestIndividualScoreEver = bestScore;
-        }
-    } else {
-        if (_stats.avgScore < _stats.lastAvgScore) {
-            _evalEngine.restore();
-            _stats.avgScore = _stats.lastAvgScore;
-        }
-        _evalEngine.mutate();
-
-        _problem->evaluate(_evalEngine.getNodes(),
-                           _evalEngine.getChangedNodes(), _fitness);
-
-        _evalEngine.clearChanged();
-
-        // Calculate total scores
-        int64_t totalScore = 0;
-        int bestScore = _fitness[_problem->getNumInputs()];
-        for (size_t i = _problem->getNumInputs(); i < _fitness.size(); ++i) {
-            totalScore += _fitness[i];
-            if (_fitness[i] > bestScore) {
-                bestScore = _fitness[i];
-            }
-        }
-
-        _stats.lastAvgScore = _stats.avgScore;
-        _stats.avgScore = totalScore;
-        if (_stats.bestScoreEver < totalScore) {
-            _stats.bestScoreEver = totalScore;
-        }
-        _stats.bestIndividualScore = bestScore;
-        if (_stats.bestIndividualScoreEver < bestScore) {
-            _stats.bestIndividualScoreEver = bestScore;
-        }
-    }
-    _stats.generation++;
-}
-
-void SNGPWorker::resetFitness()
-{
-    for (size_t i = 0; i < _fitness.size(); ++i) {
-         _fitness[i] = 0.0;
-    }
+    _run.run(1);
 }
 
 QString SNGPWorker::getProgramAsText(int i)
@@ -202,50 +177,87 @@ QString SNGPWorker::getProgramAsText(int i)
     return text;
 }
 
+SProgram SNGPWorker::getProgram(int i)
+{
+    if (_bRunning) {
+        return SProgram();
+    }
+    QMutexLocker lock(&_mutex);
+    if (i < 0 || i >= (int)_run.getEngine().getNodes().size()) {
+        return SProgram();
+    }
+    return _run.getProgram(i);
+}
+
 void SNGPWorker::run()
 {
     // qsrand(1);// Set the seed to a fixed value when testing.
     qsrand((uint)QDateTime::currentMSecsSinceEpoch());
 
-    _stats.startTimeMilliseconds = QDateTime::currentMSecsSinceEpoch();
+    SNodeStats& stats = _run.getStats();
+    stats.startTimeMilliseconds = QDateTime::currentMSecsSinceEpoch();
+    qint64 lastCheckpoint = stats.startTimeMilliseconds;
 
     while (_bRunning) {
+        STraceSpan waitSpan("worker.lockWait", STraceSpan::Sampled);
         QMutexLocker lock(&_mutex);
-        runGeneration();
-        bool doneRun = false;
-        if (_problem->hitTargetFitness(_fitness)) {
-            _stats.hits++;
-            doneRun = true;
-        } else if (_stats.generation >= _maxGenerations) {
-            doneRun = true;
+        waitSpan.end();
+        SRunResult result = _run.run(GenerationsPerBatch);
+        if (result != SRunContinue && _times <= stats.runs) {
+            _bRunning = false;
         }
-        if (doneRun) {
-            _stats.runs++;
-            if (_times <= _stats.runs) {
-                _bRunning = false;
-            } else {
-                _evalEngine.init();
-                _stats.generation = 0;
-            }
+
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        if (!_checkpointFile.isEmpty() && _bRunning &&
+            now - lastCheckpoint >= _checkpointInterval * 1000) {
+            _checkpointWriter.post(_checkpointFile, _run.saveCheckpoint());
+            lastCheckpoint = now;
         }
     }
 
-    _stats.timeTakenMilliseconds +=
-        QDateTime::currentMSecsSinceEpoch() - _stats.startTimeMilliseconds;
+    QMutexLocker lock(&_mutex);
+    if (!_checkpointFile.isEmpty()) {
+        _checkpointWriter.post(_checkpointFile, _run.saveCheckpoint());
+    }
+    stats.timeTakenMilliseconds +=
+        QDateTime::currentMSecsSinceEpoch() - stats.startTimeMilliseconds;
 }
 
-const std::vector<SNode> &SNGPWorker::getNodes()
+bool SNGPWorker::getNodeDelta(SNodeDelta& outDelta)
 {
-   if (!_bRunning) {
-       _nodesCopy = _evalEngine.getNodes();
-   }
-   return _nodesCopy;
-}
+    outDelta = SNodeDelta();
+    if (_bRunning) {
+        return false;
+    }
+    QMutexLocker lock(&_mutex);
+    const std::vector<SNode>& nodes = _run.getEngine().getNodes();
+    const std::vector<int>& fitness = _run.getFitness();
+    outDelta.size = nodes.size();
+    if (nodes.size() != _nodesCopy.size() ||
+        fitness.size() != _fitnessCopy.size()) {
+        _nodesCopy = nodes;
+        _fitnessCopy = fitness;
+        outDelta.reset = true;
+        outDelta.nodes = nodes;
+        outDelta.fitness = fitness;
+        return true;
+    }
 
-const std::vector<int> &SNGPWorker::getFitness()
-{
-   if (!_bRunning) {
-       _fitnessCopy = _fitness;
-   }
-   return _fitnessCopy;
+    // Only a few nodes change a generation, so compare in place
+    // rather than copying the population
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        int value = i < fitness.size() ? fitness[i] : 0;
+        int oldValue = i < _fitnessCopy.size() ? _fitnessCopy[i] : 0;
+        if (nodes[i] == _nodesCopy[i] && value == oldValue) {
+            continue;
+        }
+        _nodesCopy[i] = nodes[i];
+        if (i < _fitnessCopy.size()) {
+            _fitnessCopy[i] = value;
+        }
+        outDelta.indices.push_back(i);
+        outDelta.nodes.push_back(nodes[i]);
+        outDelta.fitness.push_back(value);
+    }
+    return !outDelta.indices.empty();
 }
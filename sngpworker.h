@@ -9,6 +9,27 @@
 #include "snode.h"
 #include "sevalengine.h"
 #include "problem.h"
+#include "scheckpoint.h"
+#include "srun.h"
+
+/*
+ * The nodes and fitness values that changed since the last
+ * SNGPWorker::getNodeDelta(), see NodeListModel.
+ */
+struct SNodeDelta
+{
+    SNodeDelta() : reset(false), size(0) {}
+
+    // True if the whole population was replaced, 'nodes' and
+    // 'fitness' are then every node's and 'indices' is empty
+    bool reset;
+    // Number of nodes in the population
+    int size;
+    // The changed nodes, in increasing order
+    std::vector<int> indices;
+    std::vector<SNode> nodes;
+    std::vector<int> fitness;
+};
 
 /*
  * Worker thread and interface to the Single Node GP engine.
@@ -41,6 +62,33 @@ public:
      */
     void setNumMaxGenerations(int maxGenerations);
 
+    /*
+     * Set the number of nodes in the population, including the
+     * inputs.  Takes effect on the next setProblem().
+     */
+    void setPopulationSize(int size);
+
+    /*
+     * Limit the number of node result rows kept in memory, see
+     * Problem::setMaxResidentRows().  Takes effect on the next
+     * setProblem().
+     */
+    void setMaxResidentRows(int maxRows);
+
+    /*
+     * Back the per-run buffers with huge pages.  Takes effect on
+     * the next setProblem().
+     */
+    void setHugePages(SArena::HugePages hugePages);
+
+    /*
+     * Turn on hashing of node outputs so the number of distinct
+     * outputs is recorded in the stats, see
+     * Problem::setSemanticHashing().
+     */
+    void setSemanticHashing(bool enable);
+    bool getSemanticHashing();
+
     /*
      * Reset the current stats.
      */
@@ -68,20 +116,37 @@ public:
     void step();
 
     /*
-     * Get the stats for the current gp run.
+     * Get the name of the problem, see Problem::create().
+     */
+    QString getProblemName();
+
+    /*
+     * Save a checkpoint of the run to 'fileName' every
+     * 'intervalSeconds' while running, and when paused.  The
+     * checkpoints are written in the background.  An empty name
+     * turns checkpoints off.
+     */
+    void setCheckpointFile(const QString& fileName, int intervalSeconds);
+
+    /*
+     * Save/load a checkpoint of the run, only when stopped.  See
+     * SRun::saveCheckpoint().
      */
-    const SNodeStats& getStats() { return _stats; }
+    bool saveCheckpoint(const QString& fileName);
+    bool loadCheckpoint(const QString& fileName, QString* outError = 0);
 
     /*
-     * Get the list of nodes, only updated when stopped.
+     * Get the stats for the current gp run.
      */
-    const std::vector<SNode>& getNodes();
+    const SNodeStats& getStats() { return _run.getStats(); }
 
     /*
-     * Get the fitness of all individual nodes, only
-     * update when stopped.
+     * Get the nodes and fitness values that changed since the last
+     * call, only when stopped.  Returns false if there are no
+     * changes.  Only the changed nodes are copied, so refreshing a
+     * large population between steps is cheap.
      */
-    const std::vector<int> &getFitness();
+    bool getNodeDelta(SNodeDelta& outDelta);
 
     /*
      * Get a somewhat readable output of the
@@ -89,6 +154,12 @@ public:
      */
     QString getProgramAsText(int i);
 
+    /*
+     * Extract the program for the given node, only when stopped.
+     * See SProgram::extract().
+     */
+    SProgram getProgram(int i);
+
 
 private:
     /*
@@ -96,44 +167,35 @@ private:
      */
     virtual void run();
 
-    void runGeneration();
-
-    void resetFitness();
+    // Number of generations run between checks for a pause
+    enum { GenerationsPerBatch = 64 };
 
     // True when running, false when stopped.
     // Note: that the thread may still be running, but it won't
     // muck with private member variables.
     bool _bRunning;
 
-    // The GP evaluation engine
-    SEvalEngine _evalEngine;
+    // The GP engine, problem and stats
+    SRun _run;
 
-    // Copy of the nodes, updates only when stopped.
+    // Copy of the nodes as of the last getNodeDelta(), updates
+    // only when stopped.
     std::vector<SNode> _nodesCopy;
 
-    // Current fitness values
-    std::vector<int> _fitness;
-
-    // Copy of the fitness values, updates only when
-    // stopped
+    // Copy of the fitness values, as _nodesCopy
     std::vector<int> _fitnessCopy;
 
     // Memory barrier and lock for communication between
     // UI and worker thread.
     QMutex _mutex;
 
-    // Current stats, updated during execution.
-    SNodeStats _stats;
-
-    // The current problem set
-    Problem* _problem;
-
     // Number of times to run to completion
     int _times;
 
-    // The max number of generations to allow before
-    // terminating the current run.
-    int _maxGenerations;
+    // Periodic checkpoints, see setCheckpointFile()
+    QString _checkpointFile;
+    int _checkpointInterval;
+    SCheckpointFileWriter _checkpointWriter;
 };
 
 #endif // SNGPWORKER_H
@@ -40,11 +40,42 @@ int SNode::getNumParams() const
     }
 }
 
+int SNode::getNumLinks() const
+{
+    if (op == ValOp) {
+        return 0;
+    }
+    return getNumParams();
+}
+
 bool SNode::isValue() const
 {
     return (op == InputOp || op == ValOp);
 }
 
+bool SNode::isCommutative() const
+{
+    switch(op) {
+    case MultOp:
+    case OrOp:
+    case NorOp:
+    case AndOp:
+    case NandOp:
+    case EqualOp:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool SNode::operator==(const SNode& other) const
+{
+    return op == other.op &&
+           param[0] == other.param[0] &&
+           param[1] == other.param[1] &&
+           param[2] == other.param[2];
+}
+
 QString SNode::asString() const
 {
     QString str;
@@ -124,5 +155,8 @@ void SNodeStats::reset()
     timeTakenMilliseconds = 0;
     hits = 0;
     runs = 0;
+    distinctNodes = 0;
+    distinctOutputs = 0;
+    counters.reset();
 }
 
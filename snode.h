@@ -3,6 +3,8 @@
 
 #include <QString>
 
+#include "scounters.h"
+
 /*
  * Lightweight class to represent a GP node.
  */
@@ -37,11 +39,26 @@ public:
      */
     int getNumParams() const;
 
+    /*
+     * Get the number of params that link to other nodes.  This is
+     * the same as getNumParams() except for ValOp, whose param is
+     * the value itself.
+     */
+    int getNumLinks() const;
+
     /*
      * Return true if this node is a value type (InputOp/ValueOp)
      */
     bool isValue() const;
 
+    /*
+     * Return true if swapping the first two params gives the
+     * same result.
+     */
+    bool isCommutative() const;
+
+    bool operator==(const SNode& other) const;
+
     /*
      * Get the node as a human readable string
      */
@@ -98,6 +115,16 @@ public:
 
     // Number of runs
     int runs;
+
+    // Number of structurally distinct nodes in the population
+    int distinctNodes;
+
+    // Number of nodes with distinct outputs in the population, zero
+    // unless semantic hashing is turned on.
+    int distinctOutputs;
+
+    // Hot path counters, see SCounters
+    SCounters counters;
 };
 
 #endif // SNODECONSTANTS_H
@@ -24,6 +24,16 @@ public:
     T* data() const { return _p; }
     int size() const { return _size; }
 
+    // Grow the max size, clears the array.
+    void reserve(int maxSize) {
+        _size = 0;
+        if (maxSize > _maxSize) {
+            delete [] _p;
+            _p = new T[maxSize]();
+            _maxSize = maxSize;
+        }
+    }
+
     bool add(T val) {
         int i = 0;
         for (; i < _size; ++i) {
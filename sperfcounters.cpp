@@ -0,0 +1,132 @@
+#include "sperfcounters.h"
+
+#include <string.h>
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int perfEventOpen(uint32_t type, uint64_t config, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // The group is started as a whole once all the events are added
+    attr.disabled = (groupFd < 0);
+    return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+SPerfCounters::SPerfCounters()
+  : _groupFd(-1),
+    _numCounted(0)
+{
+    for (int i = 0; i < NumEvents; ++i) {
+        _fds[i] = -1;
+        _slots[i] = -1;
+    }
+}
+
+SPerfCounters::~SPerfCounters()
+{
+    close();
+}
+
+bool SPerfCounters::open()
+{
+    close();
+#if defined(Q_OS_LINUX)
+    static const uint32_t Types[NumEvents] = {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE
+    };
+    static const uint64_t Configs[NumEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < NumEvents; ++i) {
+        int fd = perfEventOpen(Types[i], Configs[i], _groupFd);
+        if (fd < 0) {
+            continue;
+        }
+        if (_groupFd < 0) {
+            _groupFd = fd;
+        }
+        _fds[i] = fd;
+        _slots[i] = _numCounted++;
+    }
+    if (_groupFd < 0) {
+        return false;
+    }
+    ioctl(_groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SPerfCounters::close()
+{
+    for (int i = 0; i < NumEvents; ++i) {
+#if defined(Q_OS_LINUX)
+        if (_fds[i] >= 0) {
+            ::close(_fds[i]);
+        }
+#endif
+        _fds[i] = -1;
+        _slots[i] = -1;
+    }
+    _groupFd = -1;
+    _numCounted = 0;
+}
+
+void SPerfCounters::read(int64_t values[NumEvents])
+{
+    // Group read format: the number of events, then their values
+    uint64_t buffer[1 + NumEvents];
+    memset(buffer, 0, sizeof(buffer));
+#if defined(Q_OS_LINUX)
+    if (_groupFd >= 0 && ::read(_groupFd, buffer, sizeof(buffer)) < 0) {
+        memset(buffer, 0, sizeof(buffer));
+    }
+#endif
+    for (int i = 0; i < NumEvents; ++i) {
+        values[i] = _slots[i] >= 0 ? int64_t(buffer[1 + _slots[i]]) : 0;
+    }
+}
+
+const char* SPerfCounters::getEventName(Event event)
+{
+    switch (event) {
+    case Cycles:
+        return "cycles";
+    case Instructions:
+        return "instructions";
+    case L1DMisses:
+        return "l1dMisses";
+    case LLCMisses:
+        return "llcMisses";
+    case BranchMisses:
+        return "branchMisses";
+    default:
+        break;
+    }
+    return "";
+}
@@ -0,0 +1,69 @@
+#ifndef SPERFCOUNTERS_H
+#define SPERFCOUNTERS_H
+
+#include <stdint.h>
+
+/*
+ * Hardware performance counters of the calling thread, from
+ * perf_event_open() on Linux.
+ *
+ * Only user space is counted, so the cost of reading the counters
+ * (a system call) doesn't show up in the counts.  The events are
+ * opened as one group so they are always counted over the same
+ * period.  Not available on other platforms, or when
+ * /proc/sys/kernel/perf_event_paranoid doesn't allow it.
+ */
+class SPerfCounters
+{
+public:
+    enum Event {
+        Cycles,
+        Instructions,
+        // L1 data cache read misses
+        L1DMisses,
+        // Last level cache misses
+        LLCMisses,
+        BranchMisses,
+        NumEvents
+    };
+
+    SPerfCounters();
+    ~SPerfCounters();
+
+    /*
+     * Open and start the counters for the calling thread, they
+     * must only be read from that thread.  Events the CPU doesn't
+     * support are left out and read as zero.  Returns false if no
+     * counters could be opened.
+     */
+    bool open();
+
+    /*
+     * Stop and close the counters.
+     */
+    void close();
+
+    bool isOpen() const { return _groupFd >= 0; }
+
+    /*
+     * Return true if 'event' is being counted.
+     */
+    bool isCounted(Event event) const { return _slots[event] >= 0; }
+
+    /*
+     * Read the counts since open() into 'values'.
+     */
+    void read(int64_t values[NumEvents]);
+
+    static const char* getEventName(Event event);
+
+private:
+    // Group leader, all events are read through it
+    int _groupFd;
+    int _fds[NumEvents];
+    // Position of each event in a group read, -1 if not counted
+    int _slots[NumEvents];
+    int _numCounted;
+};
+
+#endif // SPERFCOUNTERS_H
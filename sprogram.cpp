@@ -0,0 +1,222 @@
+#include "sprogram.h"
+#include "problem.h"
+
+#include <string.h>
+#include <QTextStream>
+
+/*
+ * Serialised form: the magic and version, then the problem name,
+ * the number of inputs, the number of instructions and the output
+ * slot.  Each instruction is its op in a byte, followed by its
+ * value for ValOp, else by the slot of each of its links.  Numbers
+ * are LEB128 varints (values zigzag encoded) so the form doesn't
+ * depend on the byte order and small programs stay small.
+ */
+static const char ProgramMagic[8] = { 'S', 'N', 'G', 'P', 'P', 'R', 'O', 'G' };
+enum { ProgramVersion = 1, MaxInputs = 1 << 16 };
+
+static void writeVarint(QByteArray& data, uint32_t value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+static bool readVarint(const QByteArray& data, int& pos, uint32_t& outValue)
+{
+    outValue = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        uchar byte = uchar(data[pos++]);
+        outValue |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SProgram::SProgram()
+  : _numInputs(0),
+    _outputSlot(-1)
+{
+}
+
+SProgram SProgram::extract(const SEvalEngine& engine, Problem& problem, int i)
+{
+    const std::vector<SNode>& nodes = engine.getNodes();
+    const std::vector<char>& constNodes = engine.getConstantNodes();
+    const std::vector<int>& canonNodes = engine.getCanonicalNodes();
+    int numInputs = problem.getNumInputs();
+
+    SProgram program;
+    program._problemName = problem.getName();
+    program._numInputs = numInputs;
+
+    // Find the nodes used, duplicates are replaced by their
+    // canonical node and constants don't need their params
+    int root = canonNodes[i];
+    std::vector<char> used(root + 1, 0);
+    used[root] = 1;
+    for (int j = root; j >= numInputs; --j) {
+        if (!used[j] || constNodes[j]) {
+            continue;
+        }
+        const SNode& node = nodes[j];
+        for (int k = 0; k < node.getNumLinks(); ++k) {
+            used[canonNodes[node.param[k]]] = 1;
+        }
+    }
+
+    // Renumber the used nodes, inputs keep their index
+    std::vector<int> nodeSlots(root + 1, 0);
+    for (int j = 0; j < numInputs && j <= root; ++j) {
+        nodeSlots[j] = j;
+    }
+    for (int j = numInputs; j <= root; ++j) {
+        if (!used[j]) {
+            continue;
+        }
+        SNode instruction;
+        if (constNodes[j]) {
+            instruction.op = SNode::ValOp;
+            instruction.param[0] = problem.getConstantResult(j);
+        } else {
+            const SNode& node = nodes[j];
+            instruction.op = node.op;
+            for (int k = 0; k < node.getNumLinks(); ++k) {
+                instruction.param[k] = nodeSlots[canonNodes[node.param[k]]];
+            }
+        }
+        nodeSlots[j] = numInputs + program._instructions.size();
+        program._instructions.push_back(instruction);
+    }
+    program._outputSlot = nodeSlots[root];
+    return program;
+}
+
+QByteArray SProgram::save() const
+{
+    QByteArray data;
+    data.append(ProgramMagic, sizeof(ProgramMagic));
+    writeVarint(data, ProgramVersion);
+    QByteArray name = _problemName.toUtf8();
+    writeVarint(data, name.size());
+    data.append(name);
+    writeVarint(data, _numInputs);
+    writeVarint(data, _instructions.size());
+    writeVarint(data, _outputSlot);
+    for (size_t k = 0; k < _instructions.size(); ++k) {
+        const SNode& instruction = _instructions[k];
+        data.append(char(instruction.op));
+        if (instruction.op == SNode::ValOp) {
+            int32_t value = instruction.param[0];
+            writeVarint(data, (uint32_t(value) << 1) ^ uint32_t(value >> 31));
+        } else {
+            for (int j = 0; j < instruction.getNumLinks(); ++j) {
+                writeVarint(data, instruction.param[j]);
+            }
+        }
+    }
+    return data;
+}
+
+bool SProgram::load(const QByteArray& data, QString* outError)
+{
+    *this = SProgram();
+    QString error;
+    int pos = sizeof(ProgramMagic);
+    uint32_t version = 0;
+    uint32_t nameSize = 0;
+    uint32_t numInputs = 0;
+    uint32_t numInstructions = 0;
+    uint32_t outputSlot = 0;
+    std::vector<SNode> instructions;
+    if (data.size() < pos ||
+        memcmp(data.constData(), ProgramMagic, sizeof(ProgramMagic))) {
+        error = "Not a program";
+    } else if (!readVarint(data, pos, version) || version != ProgramVersion) {
+        error = QString("Unsupported program version %1").arg(version);
+    } else if (!readVarint(data, pos, nameSize) ||
+               nameSize > uint32_t(data.size() - pos)) {
+        error = "Program is truncated";
+    } else {
+        QString name = QString::fromUtf8(data.constData() + pos, nameSize);
+        pos += nameSize;
+        // Every instruction takes at least a byte
+        bool ok = readVarint(data, pos, numInputs) &&
+                  readVarint(data, pos, numInstructions) &&
+                  readVarint(data, pos, outputSlot) &&
+                  numInputs <= MaxInputs &&
+                  numInstructions <= uint32_t(data.size() - pos);
+        for (uint32_t k = 0; ok && k < numInstructions; ++k) {
+            uint32_t slot = numInputs + k;
+            SNode instruction;
+            ok = pos < data.size();
+            if (ok) {
+                instruction.op = SNode::Op(uchar(data[pos++]));
+                ok = instruction.op > SNode::InputOp &&
+                     instruction.op < SNode::NumOps;
+            }
+            if (ok && instruction.op == SNode::ValOp) {
+                uint32_t value = 0;
+                ok = readVarint(data, pos, value);
+                instruction.param[0] =
+                    int32_t((value >> 1) ^ (0 - (value & 1)));
+            } else {
+                // Params may only refer to earlier slots
+                for (int j = 0; ok && j < instruction.getNumLinks(); ++j) {
+                    uint32_t param = 0;
+                    ok = readVarint(data, pos, param) && param < slot;
+                    instruction.param[j] = param;
+                }
+            }
+            instructions.push_back(instruction);
+        }
+        if (!ok || pos != data.size() ||
+            outputSlot >= numInputs + numInstructions) {
+            error = "Program is corrupt";
+        } else {
+            _problemName = name;
+            _numInputs = numInputs;
+            _outputSlot = outputSlot;
+            _instructions.swap(instructions);
+            return true;
+        }
+    }
+    if (outError) {
+        *outError = error;
+    }
+    return false;
+}
+
+QString SProgram::toString() const
+{
+    QString text;
+    QTextStream stream(&text);
+    stream << _problemName << ", " << _numInputs << " inputs" << endl;
+    for (size_t k = 0; k < _instructions.size(); ++k) {
+        const SNode& instruction = _instructions[k];
+        stream << _numInputs + int(k) << ": ";
+        stream << SNode::OpAsString(instruction.op);
+        if (instruction.op == SNode::ValOp) {
+            stream << " " << instruction.param[0];
+        } else {
+            stream << " (";
+            for (int j = 0; j < instruction.getNumLinks(); ++j) {
+                stream << instruction.param[j];
+                if (j < instruction.getNumLinks() - 1) {
+                    stream << ", ";
+                }
+            }
+            stream << ")";
+        }
+        stream << endl;
+    }
+    stream << "output: " << _outputSlot << endl;
+    return text;
+}
@@ -0,0 +1,82 @@
+#ifndef SPROGRAM_H
+#define SPROGRAM_H
+
+#include <vector>
+#include <QByteArray>
+#include <QString>
+
+#include "snode.h"
+
+class Problem;
+class SEvalEngine;
+
+/*
+ * A program found by a run, extracted from the population so it
+ * can be saved and evaluated on its own, see
+ * Problem::evaluateProgram().
+ *
+ * The program is the nodes the extracted node depends on, in
+ * evaluation order.  Each is an instruction whose params refer to
+ * slots: slots [0, getNumInputs()) are the inputs, slot
+ * getNumInputs() + k is the result of instruction k.  Nodes that
+ * aren't used are dropped, duplicates are evaluated once and
+ * constant nodes are folded into values (ValOp).
+ */
+class SProgram
+{
+public:
+    SProgram();
+
+    /*
+     * Extract the program of node 'i' of a run.  The constants are
+     * folded using the results of the last evaluate(), so only
+     * extract between generations.
+     */
+    static SProgram extract(const SEvalEngine& engine, Problem& problem,
+                            int i);
+
+    /*
+     * Get the name of the problem the program was found for, see
+     * Problem::create().  The problem defines what the ops do.
+     */
+    const QString& getProblemName() const { return _problemName; }
+
+    int getNumInputs() const { return _numInputs; }
+
+    const std::vector<SNode>& getInstructions() const {
+        return _instructions;
+    }
+
+    /*
+     * Get the slot holding the result of the program, the last
+     * instruction unless the program is just an input.
+     */
+    int getOutputSlot() const { return _outputSlot; }
+
+    bool isEmpty() const { return _outputSlot < 0; }
+
+    /*
+     * Get the program in its compact serialised form.
+     */
+    QByteArray save() const;
+
+    /*
+     * Load a program from its serialised form.  Returns false and
+     * sets 'outError' if the data isn't a valid program, the
+     * program is left empty.
+     */
+    bool load(const QByteArray& data, QString* outError = 0);
+
+    /*
+     * Get a somewhat readable listing of the program.
+     */
+    QString toString() const;
+
+private:
+    QString _problemName;
+    int _numInputs;
+    int _outputSlot;
+    std::vector<SNode> _instructions;
+};
+
+#endif // SPROGRAM_H
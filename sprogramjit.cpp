@@ -0,0 +1,572 @@
+#include "sprogramjit.h"
+#include "problem.h"
+#include "sprogram.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <QtGlobal>
+
+#if defined(Q_PROCESSOR_X86_64) && defined(Q_OS_UNIX) && defined(__GNUC__)
+#define SNGP_JIT_X86_64
+#include <cpuid.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(SNGP_JIT_X86_64)
+
+// General purpose registers
+enum {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RSI = 6,
+    RDI = 7
+};
+
+// Arguments of SProgramJit::GroupFunc, System V calling convention
+enum {
+    InputsReg = RDI,
+    NumGroupsReg = RSI,
+    OutputsReg = RDX,
+    ScratchReg = RCX
+};
+
+// xmm registers.  Values are allocated from the first NumValueRegs,
+// the rest are reserved.  All are caller saved so nothing needs
+// saving in the prologue.
+enum {
+    NumValueRegs = 11,
+    TempReg2 = 11,
+    TempReg1 = 12,
+    ResultReg = 13,
+    OnesReg = 14,
+    ZeroReg = 15
+};
+
+// SSE opcodes, after the 0x0f escape.  Two byte opcodes are
+// 0x38xx and 0x3axx.
+enum {
+    MovdOp = 0x6e,
+    MovdqaLoadOp = 0x6f,
+    MovdqaStoreOp = 0x7f,
+    PadddOp = 0xfe,
+    PsubdOp = 0xfa,
+    PandOp = 0xdb,
+    PandnOp = 0xdf,
+    PorOp = 0xeb,
+    PxorOp = 0xef,
+    PcmpeqdOp = 0x76,
+    PshufdOp = 0x70,
+    PunpcklqdqOp = 0x6c,
+    DivpdOp = 0x5e,
+    // cvttpd2dq with 0x66, cvtdq2pd with 0xf3
+    CvtOp = 0xe6,
+    PmulldOp = 0x3840,
+    PinsrdOp = 0x3a22
+};
+
+/*
+ * Encodes the few x86-64 instructions the generated code needs.
+ */
+class SX86Emitter
+{
+public:
+    std::vector<uchar>& getCode() { return _code; }
+    int getPos() const { return _code.size(); }
+
+    void byte(int b) { _code.push_back(uchar(b)); }
+    void dword(int32_t d) {
+        for (int i = 0; i < 4; ++i) {
+            byte((uint32_t(d) >> (8 * i)) & 0xff);
+        }
+    }
+    void patchDword(int pos, int32_t d) {
+        for (int i = 0; i < 4; ++i) {
+            _code[pos + i] = uchar((uint32_t(d) >> (8 * i)) & 0xff);
+        }
+    }
+
+    /*
+     * SSE op 'reg, rm', both registers.  'rm' is a general purpose
+     * register for movd.
+     */
+    void sse(int prefix, int opcode, int reg, int rm) {
+        op(prefix, opcode, reg, rm);
+        byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    /*
+     * SSE op 'reg, [base + disp]'.  'base' can't be rsp or r12.
+     */
+    void sseMem(int prefix, int opcode, int reg, int base, int32_t disp) {
+        op(prefix, opcode, reg, base);
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        dword(disp);
+    }
+
+    void movdqa(int dst, int src) { sse(0x66, MovdqaLoadOp, dst, src); }
+
+private:
+    void op(int prefix, int opcode, int reg, int rm) {
+        byte(prefix);
+        int rex = (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+        if (rex) {
+            byte(0x40 | rex);
+        }
+        byte(0x0f);
+        if (opcode > 0xff) {
+            byte(opcode >> 8);
+        }
+        byte(opcode & 0xff);
+    }
+
+    std::vector<uchar> _code;
+};
+
+/*
+ * Generates the code for a program.  The loop body is straight line
+ * code, so registers are allocated in one pass over the
+ * instructions.  When none are free the value whose last use is
+ * furthest away is evicted: inputs and constants are reloaded when
+ * needed again, computed values are spilled to the scratch area.
+ */
+class SJitCompiler
+{
+public:
+    SJitCompiler(const SProgram& program, const Problem& problem);
+
+    bool compile(QString* outError);
+
+    std::vector<uchar>& getCode() { return _x86.getCode(); }
+
+    size_t getScratchSize() const { return _numSlots * 16; }
+
+private:
+    // Get a register holding the value of 'slot', pinned until the
+    // end of the instruction
+    int ensure(int slot);
+
+    // Get a free register, evicting a value if needed
+    int allocate();
+
+    void bind(int slot, int reg);
+    void unbind(int reg);
+
+    // Compute 'kernel' of the params in 'regs' into ResultReg
+    void emitKernel(Problem::OpKernel kernel, const int* regs);
+
+    const SProgram& _program;
+    const Problem& _problem;
+    const std::vector<SNode>& _instructions;
+    SX86Emitter _x86;
+    int _numInputs;
+    int _numSlots;
+    // Bytes between input rows
+    int _rowBytes;
+
+    // The last instruction that uses each slot
+    std::vector<int> _lastUse;
+    // The register holding each slot, -1 if none
+    std::vector<int> _slotRegs;
+    // True for computed slots that have been stored to the scratch
+    // area
+    std::vector<char> _spilled;
+    // The slot held by each register, -1 if free
+    int _regSlots[NumValueRegs];
+    // Registers used by the current instruction
+    int _pinned;
+    int _current;
+};
+
+SJitCompiler::SJitCompiler(const SProgram& program, const Problem& problem)
+  : _program(program),
+    _problem(problem),
+    _instructions(program.getInstructions()),
+    _numInputs(program.getNumInputs()),
+    _numSlots(program.getNumInputs() + program.getInstructions().size()),
+    _rowBytes(program.getNumInputs() * sizeof(int32_t)),
+    _pinned(0),
+    _current(0)
+{
+    for (int r = 0; r < NumValueRegs; ++r) {
+        _regSlots[r] = -1;
+    }
+}
+
+bool SJitCompiler::compile(QString* outError)
+{
+    int numInstructions = _instructions.size();
+    _lastUse.assign(_numSlots, -1);
+    _slotRegs.assign(_numSlots, -1);
+    _spilled.assign(_numSlots, 0);
+    for (int k = 0; k < numInstructions; ++k) {
+        const SNode& instruction = _instructions[k];
+        if (instruction.op != SNode::ValOp &&
+            _problem.getOpKernel(instruction.op) ==
+                Problem::UnsupportedKernel) {
+            if (outError) {
+                *outError = QString("%1 can't be compiled").
+                    arg(SNode::OpAsString(instruction.op));
+            }
+            return false;
+        }
+        for (int j = 0; j < instruction.getNumLinks(); ++j) {
+            _lastUse[instruction.param[j]] = k;
+        }
+    }
+    _lastUse[_program.getOutputSlot()] = numInstructions;
+
+    // Skip everything if there are no groups
+    _x86.byte(0x48);
+    _x86.byte(0x85);
+    _x86.byte(0xc0 | (NumGroupsReg << 3) | NumGroupsReg);
+    _x86.byte(0x0f);
+    _x86.byte(0x84);
+    int exitJump = _x86.getPos();
+    _x86.dword(0);
+
+    // Constant registers
+    _x86.sse(0x66, PxorOp, ZeroReg, ZeroReg);
+    _x86.byte(0xb8 + RAX);
+    _x86.dword(1);
+    _x86.sse(0x66, MovdOp, OnesReg, RAX);
+    _x86.sse(0x66, PshufdOp, OnesReg, OnesReg);
+    _x86.byte(0);
+
+    int loop = _x86.getPos();
+    for (_current = 0; _current < numInstructions; ++_current) {
+        const SNode& instruction = _instructions[_current];
+        if (instruction.op == SNode::ValOp ||
+            _lastUse[_numInputs + _current] < 0) {
+            // Values are loaded where they're used, unused results
+            // aren't computed
+            continue;
+        }
+        _pinned = 0;
+        int regs[3];
+        for (int j = 0; j < 3; ++j) {
+            regs[j] = j < instruction.getNumLinks() ?
+                ensure(instruction.param[j]) : int(ZeroReg);
+        }
+        emitKernel(_problem.getOpKernel(instruction.op), regs);
+
+        // Free the params that aren't used again
+        for (int j = 0; j < instruction.getNumLinks(); ++j) {
+            int p = instruction.param[j];
+            if (_lastUse[p] <= _current && _slotRegs[p] >= 0) {
+                unbind(_slotRegs[p]);
+            }
+        }
+        _pinned = 0;
+        int reg = allocate();
+        _x86.movdqa(reg, ResultReg);
+        bind(_numInputs + _current, reg);
+    }
+
+    // Store the four results, then on to the next group
+    _pinned = 0;
+    int output = ensure(_program.getOutputSlot());
+    _x86.sseMem(0xf3, MovdqaStoreOp, output, OutputsReg, 0);
+    // add rdi, 4 * rowBytes
+    _x86.byte(0x48);
+    _x86.byte(0x81);
+    _x86.byte(0xc0 | InputsReg);
+    _x86.dword(4 * _rowBytes);
+    // add rdx, 16
+    _x86.byte(0x48);
+    _x86.byte(0x83);
+    _x86.byte(0xc0 | OutputsReg);
+    _x86.byte(16);
+    // dec rsi
+    _x86.byte(0x48);
+    _x86.byte(0xff);
+    _x86.byte(0xc8 | NumGroupsReg);
+    // jnz loop
+    _x86.byte(0x0f);
+    _x86.byte(0x85);
+    _x86.dword(loop - (_x86.getPos() + 4));
+
+    _x86.patchDword(exitJump, _x86.getPos() - (exitJump + 4));
+    _x86.byte(0xc3);
+    return true;
+}
+
+int SJitCompiler::ensure(int slot)
+{
+    int reg = _slotRegs[slot];
+    if (reg < 0) {
+        reg = allocate();
+        if (slot < _numInputs) {
+            // Gather the input from each of the four rows
+            int offset = slot * sizeof(int32_t);
+            _x86.sseMem(0x66, MovdOp, reg, InputsReg, offset);
+            for (int i = 1; i < 4; ++i) {
+                _x86.sseMem(0x66, PinsrdOp, reg, InputsReg,
+                            offset + i * _rowBytes);
+                _x86.byte(i);
+            }
+        } else if (_instructions[slot - _numInputs].op == SNode::ValOp) {
+            _x86.byte(0xb8 + RAX);
+            _x86.dword(_instructions[slot - _numInputs].param[0]);
+            _x86.sse(0x66, MovdOp, reg, RAX);
+            _x86.sse(0x66, PshufdOp, reg, reg);
+            _x86.byte(0);
+        } else {
+            _x86.sseMem(0x66, MovdqaLoadOp, reg, ScratchReg, slot * 16);
+        }
+        bind(slot, reg);
+    }
+    _pinned |= 1 << reg;
+    return reg;
+}
+
+int SJitCompiler::allocate()
+{
+    int best = -1;
+    for (int r = 0; r < NumValueRegs; ++r) {
+        if (_regSlots[r] < 0) {
+            return r;
+        }
+        if (!(_pinned & (1 << r)) &&
+            (best < 0 || _lastUse[_regSlots[r]] > _lastUse[_regSlots[best]])) {
+            best = r;
+        }
+    }
+
+    // At most three registers are pinned, so there is always one
+    int slot = _regSlots[best];
+    bool computed = slot >= _numInputs &&
+                    _instructions[slot - _numInputs].op != SNode::ValOp;
+    if (computed && !_spilled[slot] && _lastUse[slot] > _current) {
+        _x86.sseMem(0x66, MovdqaStoreOp, best, ScratchReg, slot * 16);
+        _spilled[slot] = 1;
+    }
+    unbind(best);
+    return best;
+}
+
+void SJitCompiler::bind(int slot, int reg)
+{
+    _regSlots[reg] = slot;
+    _slotRegs[slot] = reg;
+}
+
+void SJitCompiler::unbind(int reg)
+{
+    _slotRegs[_regSlots[reg]] = -1;
+    _regSlots[reg] = -1;
+}
+
+void SJitCompiler::emitKernel(Problem::OpKernel kernel, const int* regs)
+{
+    int a = regs[0];
+    int b = regs[1];
+    int c = regs[2];
+    switch (kernel) {
+    case Problem::TruthKernel:
+        _x86.movdqa(ResultReg, a);
+        _x86.sse(0x66, PcmpeqdOp, ResultReg, ZeroReg);
+        _x86.sse(0x66, PandnOp, ResultReg, OnesReg);
+        break;
+    case Problem::OrKernel:
+    case Problem::NorKernel:
+        _x86.movdqa(ResultReg, a);
+        _x86.sse(0x66, PorOp, ResultReg, b);
+        _x86.sse(0x66, PcmpeqdOp, ResultReg, ZeroReg);
+        _x86.sse(0x66, kernel == Problem::OrKernel ? PandnOp : PandOp,
+                 ResultReg, OnesReg);
+        break;
+    case Problem::AndKernel:
+    case Problem::NandKernel:
+        _x86.movdqa(ResultReg, a);
+        _x86.sse(0x66, PcmpeqdOp, ResultReg, ZeroReg);
+        _x86.movdqa(TempReg1, b);
+        _x86.sse(0x66, PcmpeqdOp, TempReg1, ZeroReg);
+        _x86.sse(0x66, PorOp, ResultReg, TempReg1);
+        _x86.sse(0x66, kernel == Problem::AndKernel ? PandnOp : PandOp,
+                 ResultReg, OnesReg);
+        break;
+    case Problem::IfKernel:
+        // (a == 0 & c) | (a != 0 & b)
+        _x86.movdqa(TempReg1, a);
+        _x86.sse(0x66, PcmpeqdOp, TempReg1, ZeroReg);
+        _x86.movdqa(ResultReg, TempReg1);
+        _x86.sse(0x66, PandOp, ResultReg, c);
+        _x86.sse(0x66, PandnOp, TempReg1, b);
+        _x86.sse(0x66, PorOp, ResultReg, TempReg1);
+        break;
+    case Problem::DoubleKernel:
+        _x86.movdqa(ResultReg, a);
+        _x86.sse(0x66, PadddOp, ResultReg, a);
+        break;
+    case Problem::SubKernel:
+        _x86.movdqa(ResultReg, b);
+        _x86.sse(0x66, PsubdOp, ResultReg, a);
+        break;
+    case Problem::MultKernel:
+        _x86.movdqa(ResultReg, b);
+        _x86.sse(0x66, PmulldOp, ResultReg, a);
+        break;
+    case Problem::DivKernel:
+        // There is no integer divide, but an int32 quotient is
+        // exact in double precision.  Two lanes at a time, then
+        // zero where dividing by zero.
+        _x86.sse(0xf3, CvtOp, ResultReg, b);
+        _x86.sse(0xf3, CvtOp, TempReg1, a);
+        _x86.sse(0x66, DivpdOp, ResultReg, TempReg1);
+        _x86.sse(0x66, CvtOp, ResultReg, ResultReg);
+        _x86.sse(0x66, PshufdOp, TempReg1, b);
+        _x86.byte(0xee);
+        _x86.sse(0xf3, CvtOp, TempReg1, TempReg1);
+        _x86.sse(0x66, PshufdOp, TempReg2, a);
+        _x86.byte(0xee);
+        _x86.sse(0xf3, CvtOp, TempReg2, TempReg2);
+        _x86.sse(0x66, DivpdOp, TempReg1, TempReg2);
+        _x86.sse(0x66, CvtOp, TempReg1, TempReg1);
+        _x86.sse(0x66, PunpcklqdqOp, ResultReg, TempReg1);
+        _x86.movdqa(TempReg1, a);
+        _x86.sse(0x66, PcmpeqdOp, TempReg1, ZeroReg);
+        _x86.sse(0x66, PandnOp, TempReg1, ResultReg);
+        _x86.movdqa(ResultReg, TempReg1);
+        break;
+    case Problem::ZeroKernel:
+    default:
+        _x86.sse(0x66, PxorOp, ResultReg, ResultReg);
+        break;
+    }
+}
+
+#endif // SNGP_JIT_X86_64
+
+SProgramJit::SProgramJit()
+  : _code(0),
+    _codeSize(0),
+    _mappedSize(0),
+    _numInputs(0),
+    _scratchSize(0)
+{
+}
+
+SProgramJit::~SProgramJit()
+{
+    clear();
+}
+
+bool SProgramJit::isSupported()
+{
+#if defined(SNGP_JIT_X86_64)
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_1);
+#else
+    return false;
+#endif
+}
+
+bool SProgramJit::compile(const SProgram& program, const Problem& problem,
+                          QString* outError)
+{
+    clear();
+    if (!isSupported()) {
+        if (outError) {
+            *outError = "Native code isn't supported on this machine";
+        }
+        return false;
+    }
+    if (program.isEmpty()) {
+        if (outError) {
+            *outError = "The program is empty";
+        }
+        return false;
+    }
+#if defined(SNGP_JIT_X86_64)
+    SJitCompiler compiler(program, problem);
+    if (!compiler.compile(outError)) {
+        return false;
+    }
+
+    // Written then made executable, never both at once
+    std::vector<uchar>& code = compiler.getCode();
+    void* p = mmap(0, code.size(), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        if (outError) {
+            *outError = "Can't allocate memory for the code";
+        }
+        return false;
+    }
+    memcpy(p, code.data(), code.size());
+    if (mprotect(p, code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(p, code.size());
+        if (outError) {
+            *outError = "Can't make the code executable";
+        }
+        return false;
+    }
+    _code = p;
+    _codeSize = code.size();
+    _mappedSize = code.size();
+    _numInputs = program.getNumInputs();
+    _scratchSize = compiler.getScratchSize();
+
+    // Check the code against the interpreter, on small values
+    // that exercise zeros and signs
+    enum { ProbeRows = 67 };
+    std::vector<int> rows(ProbeRows * _numInputs);
+    uint32_t state = 1;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        state = state * 1103515245 + 12345;
+        rows[i] = int((state >> 16) % 9) - 4;
+    }
+    std::vector<int> expected(ProbeRows);
+    std::vector<int> actual(ProbeRows);
+    problem.evaluateProgram(program, rows.data(), ProbeRows, expected.data());
+    evaluate(rows.data(), ProbeRows, actual.data());
+    if (actual != expected) {
+        clear();
+        if (outError) {
+            *outError = "The native code doesn't match the interpreter";
+        }
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(problem);
+    return false;
+#endif
+}
+
+void SProgramJit::evaluate(const int* inputs, int numRows,
+                           int* outResults) const
+{
+    // Scratch space for spilled values, aligned for movdqa
+    std::vector<char> scratch(_scratchSize + 16);
+    void* alignedScratch = scratch.data() + (-(size_t)scratch.data() & 15);
+    GroupFunc func = reinterpret_cast<GroupFunc>(_code);
+    size_t numGroups = numRows / 4;
+    func(inputs, numGroups, outResults, alignedScratch);
+
+    // Pad the last rows out to a group
+    int done = numGroups * 4;
+    if (done < numRows) {
+        std::vector<int> rows(4 * _numInputs, 0);
+        int results[4];
+        std::copy(inputs + (size_t)done * _numInputs,
+                  inputs + (size_t)numRows * _numInputs, rows.begin());
+        func(rows.data(), 1, results, alignedScratch);
+        std::copy(results, results + (numRows - done), outResults + done);
+    }
+}
+
+void SProgramJit::clear()
+{
+#if defined(SNGP_JIT_X86_64)
+    if (_code) {
+        munmap(_code, _mappedSize);
+    }
+#endif
+    _code = 0;
+    _codeSize = 0;
+    _mappedSize = 0;
+    _scratchSize = 0;
+}
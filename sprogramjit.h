@@ -0,0 +1,80 @@
+#ifndef SPROGRAMJIT_H
+#define SPROGRAMJIT_H
+
+#include <stddef.h>
+#include <vector>
+#include <QString>
+
+class Problem;
+class SProgram;
+
+/*
+ * Compiles a program (see SProgram) to native code, so it can be
+ * evaluated over large numbers of rows without interpreting each op.
+ *
+ * The code evaluates four rows at a time in SSE registers, with the
+ * intermediate values kept in registers and spilled to a scratch
+ * area only when the program needs more than there are.  Only
+ * x86-64 with SSE4.1 on Unix (System V calling convention) is
+ * supported.  Elsewhere, or if the problem has an op the generator
+ * doesn't know (see Problem::getOpKernel()), compile() fails and
+ * Problem::evaluateProgram() should be used instead.
+ *
+ * The compiled code is checked against Problem::evaluateProgram()
+ * on a sample of rows before it's used.
+ */
+class SProgramJit
+{
+public:
+    SProgramJit();
+    ~SProgramJit();
+
+    /*
+     * Return true if native code can be generated on this machine.
+     */
+    static bool isSupported();
+
+    /*
+     * Compile 'program' with the op semantics of 'problem', which
+     * must be the program's problem.  Returns false and sets
+     * 'outError' if the program can't be compiled.
+     */
+    bool compile(const SProgram& program, const Problem& problem,
+                 QString* outError = 0);
+
+    bool isCompiled() const { return _code != 0; }
+
+    /*
+     * Get the size of the generated code in bytes.
+     */
+    size_t getCodeSize() const { return _codeSize; }
+
+    /*
+     * Evaluate the compiled program over 'numRows' rows of inputs,
+     * as Problem::evaluateProgram().  Can be called from several
+     * threads at once.
+     */
+    void evaluate(const int* inputs, int numRows, int* outResults) const;
+
+    /*
+     * Free the generated code.
+     */
+    void clear();
+
+private:
+    // Generated function, evaluates 'numGroups' groups of four rows
+    typedef void (*GroupFunc)(const int* inputs, size_t numGroups,
+                              int* outResults, void* scratch);
+
+    SProgramJit(const SProgramJit&);
+    SProgramJit& operator=(const SProgramJit&);
+
+    void* _code;
+    size_t _codeSize;
+    size_t _mappedSize;
+    int _numInputs;
+    // Bytes of scratch space for spilled values
+    size_t _scratchSize;
+};
+
+#endif // SPROGRAMJIT_H
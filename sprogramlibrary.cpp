@@ -0,0 +1,91 @@
+#include "sprogramlibrary.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
+#include <ctype.h>
+#include <algorithm>
+
+#include "scheckpoint.h"
+
+// Smaller programs first, leaving more of the population to evolve
+static bool isSmaller(const SProgram& a, const SProgram& b)
+{
+    return a.getInstructions().size() < b.getInstructions().size();
+}
+
+SProgramLibrary::SProgramLibrary()
+{
+}
+
+void SProgramLibrary::setPath(const QString& path)
+{
+    _path = path;
+}
+
+QString SProgramLibrary::getProblemPath(const QString& problemName) const
+{
+    // Names of tables hold a path, keep them in one directory
+    QByteArray name = problemName.toUtf8();
+    for (int i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        if (!isalnum(uchar(c)) && c != '-' && c != '.' && c != '_') {
+            name[i] = '_';
+        }
+    }
+    return QDir(_path).filePath(QString::fromUtf8(name.constData(), name.size()));
+}
+
+bool SProgramLibrary::add(const SProgram& program, QString* outError)
+{
+    if (program.isEmpty()) {
+        if (outError) {
+            *outError = "The program is empty";
+        }
+        return false;
+    }
+    QString problemPath = getProblemPath(program.getProblemName());
+    if (!QDir().mkpath(problemPath)) {
+        if (outError) {
+            *outError = QString("Can't create %1").arg(problemPath);
+        }
+        return false;
+    }
+    QByteArray data = program.save();
+    QString fileName = QDir(problemPath).filePath(
+        QString::fromLatin1(
+            QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex()) +
+        ".prog");
+    if (QFile::exists(fileName)) {
+        return true;
+    }
+    if (!SCheckpointFileWriter::writeFile(fileName, data)) {
+        if (outError) {
+            *outError = QString("Can't write %1").arg(fileName);
+        }
+        return false;
+    }
+    return true;
+}
+
+void SProgramLibrary::load(const QString& problemName,
+                           std::vector<SProgram>& outPrograms) const
+{
+    outPrograms.clear();
+    QDir dir(getProblemPath(problemName));
+    QStringList fileNames = dir.entryList(QStringList() << "*.prog",
+                                          QDir::Files, QDir::Name);
+    for (int i = 0; i < fileNames.size(); ++i) {
+        QFile file(dir.filePath(fileNames.at(i)));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        SProgram program;
+        if (program.load(file.readAll()) &&
+            program.getProblemName() == problemName) {
+            outPrograms.push_back(program);
+        }
+    }
+    std::stable_sort(outPrograms.begin(), outPrograms.end(), isSmaller);
+}
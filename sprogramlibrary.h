@@ -0,0 +1,54 @@
+#ifndef SPROGRAMLIBRARY_H
+#define SPROGRAMLIBRARY_H
+
+#include <vector>
+#include <QString>
+
+#include "sprogram.h"
+
+/*
+ * A library of programs found by earlier runs, kept on disk and
+ * keyed by problem, to warm start new runs of a problem that comes
+ * up again, see SRun::setWarmStart().
+ *
+ * Each problem has a directory under the library's, holding each
+ * program in its serialised form (see SProgram::save()), named by
+ * the hash of that so the same program is only kept once.  Files are
+ * written atomically, so several processes can share a library.
+ */
+class SProgramLibrary
+{
+public:
+    SProgramLibrary();
+
+    /*
+     * Set the directory of the library, created when the first
+     * program is added.
+     */
+    void setPath(const QString& path);
+
+    const QString& getPath() const { return _path; }
+
+    /*
+     * Add 'program' to the library of its problem.  Returns false
+     * and sets 'outError' if it can't be written, true if it was
+     * added or was already there.
+     */
+    bool add(const SProgram& program, QString* outError = 0);
+
+    /*
+     * Load the programs of 'problemName', the smallest first.  Files
+     * that aren't programs of the problem are skipped.  A problem
+     * without programs isn't an error.
+     */
+    void load(const QString& problemName,
+              std::vector<SProgram>& outPrograms) const;
+
+private:
+    // Directory of the programs of 'problemName'
+    QString getProblemPath(const QString& problemName) const;
+
+    QString _path;
+};
+
+#endif // SPROGRAMLIBRARY_H
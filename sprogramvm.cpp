@@ -0,0 +1,233 @@
+#include "sprogramvm.h"
+#include "problem.h"
+#include "sprogram.h"
+
+#include <algorithm>
+
+// Threaded dispatch jumps straight from one instruction's handler
+// to the next, rather than back through a switch
+#if defined(__GNUC__)
+#define SNGP_VM_THREADED
+#endif
+
+enum {
+    // Ends the row, 'a' is the result.  Never a real kernel.
+    EndOp = Problem::UnsupportedKernel,
+    MaxRegisters = 0xffff
+};
+
+SProgramVM::SProgramVM()
+  : _numInputs(0),
+    _numRegisters(0)
+{
+}
+
+bool SProgramVM::compile(const SProgram& program, const Problem& problem,
+                         QString* outError)
+{
+    clear();
+    if (program.isEmpty()) {
+        if (outError) {
+            *outError = "The program is empty";
+        }
+        return false;
+    }
+    const std::vector<SNode>& instructions = program.getInstructions();
+    int numInputs = program.getNumInputs();
+    int numInstructions = instructions.size();
+    int numSlots = numInputs + numInstructions;
+    int outputSlot = program.getOutputSlot();
+
+    // Find the live instructions, and the last use of each slot
+    std::vector<char> live(numSlots, 0);
+    std::vector<int> lastUse(numSlots, -1);
+    live[outputSlot] = 1;
+    lastUse[outputSlot] = numInstructions;
+    for (int k = numInstructions - 1; k >= 0; --k) {
+        const SNode& instruction = instructions[k];
+        if (!live[numInputs + k] || instruction.op == SNode::ValOp) {
+            continue;
+        }
+        if (problem.getOpKernel(instruction.op) == Problem::UnsupportedKernel) {
+            if (outError) {
+                *outError = QString("%1 can't be compiled").
+                    arg(SNode::OpAsString(instruction.op));
+            }
+            return false;
+        }
+        for (int j = 0; j < instruction.getNumLinks(); ++j) {
+            int p = instruction.param[j];
+            live[p] = 1;
+            lastUse[p] = std::max(lastUse[p], k);
+        }
+    }
+
+    // Registers are reused once their value is dead, inputs and
+    // constants are allocated first
+    std::vector<int> slotRegs(numSlots, -1);
+    std::vector<int> freeRegs;
+    int numRegisters = 0;
+    for (int i = 0; i < numInputs; ++i) {
+        if (live[i]) {
+            InputLoad load = { i, numRegisters };
+            _inputLoads.push_back(load);
+            slotRegs[i] = numRegisters++;
+        }
+    }
+    for (int k = 0; k < numInstructions; ++k) {
+        if (live[numInputs + k] && instructions[k].op == SNode::ValOp) {
+            ConstLoad load = { instructions[k].param[0], numRegisters };
+            _constLoads.push_back(load);
+            slotRegs[numInputs + k] = numRegisters++;
+        }
+    }
+    for (int k = 0; k < numInstructions; ++k) {
+        const SNode& instruction = instructions[k];
+        int slot = numInputs + k;
+        if (!live[slot] || instruction.op == SNode::ValOp) {
+            continue;
+        }
+        // Unlinked params aren't read by the kernel
+        int regs[3] = { 0, 0, 0 };
+        for (int j = 0; j < instruction.getNumLinks(); ++j) {
+            regs[j] = slotRegs[instruction.param[j]];
+        }
+        for (int j = 0; j < instruction.getNumLinks(); ++j) {
+            int p = instruction.param[j];
+            bool constant = p >= numInputs &&
+                            instructions[p - numInputs].op == SNode::ValOp;
+            if (lastUse[p] == k && !constant && slotRegs[p] >= 0) {
+                freeRegs.push_back(slotRegs[p]);
+                slotRegs[p] = -1;
+            }
+        }
+        // The kernel reads its params before writing, so the result
+        // can reuse a param's register
+        int dst;
+        if (!freeRegs.empty()) {
+            dst = freeRegs.back();
+            freeRegs.pop_back();
+        } else {
+            dst = numRegisters++;
+        }
+        slotRegs[slot] = dst;
+        Instruction code = { uint16_t(problem.getOpKernel(instruction.op)),
+                             uint16_t(dst), uint16_t(regs[0]),
+                             uint16_t(regs[1]), uint16_t(regs[2]) };
+        _code.push_back(code);
+        if (numRegisters > MaxRegisters) {
+            break;
+        }
+    }
+    if (numRegisters > MaxRegisters) {
+        clear();
+        if (outError) {
+            *outError = "The program needs too many registers";
+        }
+        return false;
+    }
+    Instruction end = { EndOp, 0, uint16_t(slotRegs[outputSlot]), 0, 0 };
+    _code.push_back(end);
+    _numInputs = numInputs;
+    _numRegisters = std::max(numRegisters, 1);
+    return true;
+}
+
+void SProgramVM::evaluate(const int* inputs, int numRows,
+                          int* outResults) const
+{
+    if (_code.empty()) {
+        return;
+    }
+    std::vector<int> frame(_numRegisters, 0);
+    int* r = frame.data();
+    for (size_t i = 0; i < _constLoads.size(); ++i) {
+        r[_constLoads[i].reg] = _constLoads[i].value;
+    }
+    const InputLoad* loads = _inputLoads.data();
+    const InputLoad* loadsEnd = loads + _inputLoads.size();
+
+#if defined(SNGP_VM_THREADED)
+    // In Problem::OpKernel order
+    static void* const handlers[] = {
+        &&EndLabel, &&ZeroLabel, &&TruthLabel, &&OrLabel, &&NorLabel,
+        &&AndLabel, &&NandLabel, &&IfLabel, &&DoubleLabel, &&SubLabel,
+        &&MultLabel, &&DivLabel
+    };
+#define VM_CASE(name, kernel) name##Label:
+#define VM_NEXT() ++pc; goto *handlers[pc->op]
+#else
+#define VM_CASE(name, kernel) case kernel:
+#define VM_NEXT() ++pc; continue
+#endif
+
+    for (int row = 0; row < numRows; ++row) {
+        const int* rowInputs = inputs + (size_t)row * _numInputs;
+        for (const InputLoad* load = loads; load != loadsEnd; ++load) {
+            r[load->reg] = rowInputs[load->input];
+        }
+        const Instruction* pc = _code.data();
+#if defined(SNGP_VM_THREADED)
+        goto *handlers[pc->op];
+#else
+        for (;;) switch (pc->op) {
+#endif
+        VM_CASE(Zero, Problem::ZeroKernel)
+            r[pc->dst] = 0;
+            VM_NEXT();
+        VM_CASE(Truth, Problem::TruthKernel)
+            r[pc->dst] = r[pc->a] != 0;
+            VM_NEXT();
+        VM_CASE(Or, Problem::OrKernel)
+            r[pc->dst] = r[pc->a] || r[pc->b];
+            VM_NEXT();
+        VM_CASE(Nor, Problem::NorKernel)
+            r[pc->dst] = !(r[pc->a] || r[pc->b]);
+            VM_NEXT();
+        VM_CASE(And, Problem::AndKernel)
+            r[pc->dst] = r[pc->a] && r[pc->b];
+            VM_NEXT();
+        VM_CASE(Nand, Problem::NandKernel)
+            r[pc->dst] = !(r[pc->a] && r[pc->b]);
+            VM_NEXT();
+        VM_CASE(If, Problem::IfKernel)
+            r[pc->dst] = r[pc->a] ? r[pc->b] : r[pc->c];
+            VM_NEXT();
+        // Integer arithmetic wraps, as it does in SProgramJit
+        VM_CASE(Double, Problem::DoubleKernel)
+            r[pc->dst] = int(uint32_t(r[pc->a]) * 2);
+            VM_NEXT();
+        VM_CASE(Sub, Problem::SubKernel)
+            r[pc->dst] = int(uint32_t(r[pc->b]) - uint32_t(r[pc->a]));
+            VM_NEXT();
+        VM_CASE(Mult, Problem::MultKernel)
+            r[pc->dst] = int(uint32_t(r[pc->b]) * uint32_t(r[pc->a]));
+            VM_NEXT();
+        VM_CASE(Div, Problem::DivKernel) {
+            int a = r[pc->a];
+            int b = r[pc->b];
+            r[pc->dst] = a == 0 ? 0 :
+                         a == -1 ? int(0 - uint32_t(b)) : b / a;
+            VM_NEXT();
+        }
+        VM_CASE(End, EndOp)
+            outResults[row] = r[pc->a];
+#if !defined(SNGP_VM_THREADED)
+            goto rowDone;
+        }
+    rowDone:
+        ;
+#endif
+    }
+#undef VM_CASE
+#undef VM_NEXT
+}
+
+void SProgramVM::clear()
+{
+    _numInputs = 0;
+    _numRegisters = 0;
+    _code.clear();
+    _inputLoads.clear();
+    _constLoads.clear();
+}
@@ -0,0 +1,94 @@
+#ifndef SPROGRAMVM_H
+#define SPROGRAMVM_H
+
+#include <stdint.h>
+#include <vector>
+#include <QString>
+
+class Problem;
+class SProgram;
+
+/*
+ * Evaluates a program (see SProgram) a row at a time, from a compact
+ * register bytecode.
+ *
+ * The bytecode is the program's live instructions with the ops
+ * replaced by what they compute (see Problem::getOpKernel()) and the
+ * slots by registers, reused once a value is dead, so a row's values
+ * stay in a few hundred bytes whatever the size of the program.
+ * Dispatch is threaded (computed goto) with GCC and Clang.
+ *
+ * Unlike Problem::evaluateProgram() there is no per block set up,
+ * so it suits evaluating a few rows at a time, such as checking a
+ * program on held-out cases, and it doesn't need native code like
+ * SProgramJit.
+ *
+ * It isn't used by the search itself.  With a bound on the resident
+ * rows (see Problem::setMaxResidentRows()) an evicted row is
+ * recomputed from its cone a node at a time over every test case,
+ * which reuses the rows still resident; evaluating the node's
+ * program a row at a time would recompute the whole cone instead.
+ */
+class SProgramVM
+{
+public:
+    SProgramVM();
+
+    /*
+     * Compile 'program' with the op semantics of 'problem', which
+     * must be the program's problem.  Returns false and sets
+     * 'outError' if the program can't be compiled.
+     */
+    bool compile(const SProgram& program, const Problem& problem,
+                 QString* outError = 0);
+
+    bool isCompiled() const { return !_code.empty(); }
+
+    /*
+     * Get the number of bytecode instructions and registers.
+     */
+    int getNumInstructions() const { return _code.size(); }
+    int getNumRegisters() const { return _numRegisters; }
+
+    /*
+     * Evaluate the compiled program over 'numRows' rows of inputs,
+     * as Problem::evaluateProgram().  Can be called from several
+     * threads at once.
+     */
+    void evaluate(const int* inputs, int numRows, int* outResults) const;
+
+    /*
+     * Free the bytecode.
+     */
+    void clear();
+
+private:
+    // The op is a Problem::OpKernel, the rest are registers
+    struct Instruction {
+        uint16_t op;
+        uint16_t dst;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+    };
+
+    // An input copied to a register at the start of each row
+    struct InputLoad {
+        int input;
+        int reg;
+    };
+
+    // A register holding a constant, set once per evaluate()
+    struct ConstLoad {
+        int value;
+        int reg;
+    };
+
+    int _numInputs;
+    int _numRegisters;
+    std::vector<Instruction> _code;
+    std::vector<InputLoad> _inputLoads;
+    std::vector<ConstLoad> _constLoads;
+};
+
+#endif // SPROGRAMVM_H
@@ -0,0 +1,107 @@
+#include "srace.h"
+
+#include <QMutexLocker>
+
+#include <limits.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+SRace::SRace()
+  : _firstRung(1000),
+    _eta(3),
+    _patience(0)
+{
+}
+
+void SRace::setRungs(int firstRung, int eta)
+{
+    QMutexLocker lock(&_mutex);
+    _firstRung = std::max(1, firstRung);
+    _eta = eta < 2 ? 0 : eta;
+    _rungScores.clear();
+}
+
+void SRace::setPatience(int generations)
+{
+    _patience = std::max(0, generations);
+}
+
+void SRace::startRun(Progress& progress) const
+{
+    progress.nextRung = _eta > 0 ? _firstRung : INT_MAX;
+    progress.bestScore = std::numeric_limits<int64_t>::min();
+    progress.improvedGeneration = 0;
+    progress.bestTotalScore = std::numeric_limits<int64_t>::min();
+}
+
+int SRace::getGenerationsToCheck(const Progress& progress,
+                                 const SNodeStats& stats, int count) const
+{
+    int generations = count;
+    if (progress.nextRung != INT_MAX) {
+        generations = std::min(generations,
+                               progress.nextRung - stats.generation);
+    }
+    if (_patience > 0) {
+        generations = std::min(generations, progress.improvedGeneration +
+                               _patience - stats.generation);
+    }
+    return std::max(1, generations);
+}
+
+bool SRace::check(Progress& progress, const SNodeStats& stats)
+{
+    if (stats.bestIndividualScoreEver > progress.bestScore) {
+        progress.bestScore = stats.bestIndividualScoreEver;
+        progress.improvedGeneration = stats.generation;
+    }
+    progress.bestTotalScore = stats.bestScoreEver;
+    if (_patience > 0 &&
+        stats.generation - progress.improvedGeneration >= _patience) {
+        return false;
+    }
+    if (stats.generation < progress.nextRung) {
+        return true;
+    }
+
+    // Rung r is at firstRung * eta^r
+    int rung = 0;
+    int64_t rungGeneration = _firstRung;
+    while (rungGeneration < progress.nextRung) {
+        rungGeneration *= _eta;
+        rung++;
+    }
+    rungGeneration *= _eta;
+    progress.nextRung = rungGeneration > INT_MAX ? INT_MAX
+                                                 : int(rungGeneration);
+
+    QMutexLocker lock(&_mutex);
+    if (int(_rungScores.size()) <= rung) {
+        _rungScores.resize(rung + 1);
+    }
+    std::vector<Score>& scores = _rungScores[rung];
+    Score score(progress.bestScore, progress.bestTotalScore);
+    std::vector<Score>::iterator it =
+        std::lower_bound(scores.begin(), scores.end(), score,
+                         std::greater<Score>());
+    int better = it - scores.begin();
+    scores.insert(it, score);
+
+    // Until eta runs have reached the rung there's nothing to go by
+    int numScores = scores.size();
+    if (numScores < _eta) {
+        return true;
+    }
+    return better < numScores / _eta;
+}
+
+std::vector<int> SRace::getRungCounts()
+{
+    QMutexLocker lock(&_mutex);
+    std::vector<int> counts;
+    for (size_t i = 0; i < _rungScores.size(); ++i) {
+        counts.push_back(_rungScores[i].size());
+    }
+    return counts;
+}
@@ -0,0 +1,95 @@
+#ifndef SRACE_H
+#define SRACE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <QMutex>
+
+#include "snode.h"
+
+/*
+ * Racing rules for a batch of runs of one problem made concurrently,
+ * to stop runs that stopped making progress and restart in their
+ * place, for more hits in the same CPU time.
+ *
+ * Asynchronous successive halving: the runs are compared at rungs,
+ * after firstRung * eta^r generations.  A run that reaches a rung
+ * carries on only if its bestIndividualScoreEver is in the top 1 / eta
+ * of the scores that the runs reaching that rung so far had, so no
+ * run waits for the others.  The best individual scores of the runs
+ * are often tied, the ties are broken by bestScoreEver.  Optionally
+ * a run is also stopped when its best individual hasn't improved for
+ * a number of generations.
+ *
+ * The runs that are stopped depend on the order they reach the
+ * rungs, so on the timing of the threads.  Thread safe.
+ */
+class SRace
+{
+public:
+    SRace();
+
+    /*
+     * Set the generation of the first rung and the fraction (1 / eta)
+     * of the runs kept at each rung.  An eta below 2 turns the rungs
+     * off.
+     */
+    void setRungs(int firstRung, int eta);
+
+    /*
+     * Stop a run when its best individual hasn't improved for
+     * 'generations', 0 (the default) for never.
+     */
+    void setPatience(int generations);
+
+    /*
+     * Progress of one run, kept by the caller.
+     */
+    struct Progress {
+        // Generation of the next rung to check
+        int nextRung;
+        // Best individual score so far and when it was reached
+        int64_t bestScore;
+        int improvedGeneration;
+        // Best total score of the population, breaks ties
+        int64_t bestTotalScore;
+    };
+
+    /*
+     * Reset 'progress' for a run that is starting.
+     */
+    void startRun(Progress& progress) const;
+
+    /*
+     * Get the max number of generations to run before the next
+     * check of the run, capped to 'count'.
+     */
+    int getGenerationsToCheck(const Progress& progress,
+                              const SNodeStats& stats, int count) const;
+
+    /*
+     * Check the run after a batch of generations, returns false if
+     * it should be stopped.
+     */
+    bool check(Progress& progress, const SNodeStats& stats);
+
+    /*
+     * Get the number of runs that reached each rung.
+     */
+    std::vector<int> getRungCounts();
+
+private:
+    int _firstRung;
+    int _eta;
+    int _patience;
+
+    QMutex _mutex;
+    // Best individual and total scores of the runs that reached each
+    // rung, in decreasing order
+    typedef std::pair<int64_t, int64_t> Score;
+    std::vector<std::vector<Score> > _rungScores;
+};
+
+#endif // SRACE_H
@@ -0,0 +1,188 @@
+#include "sresultcache.h"
+
+SResultCache::SResultCache()
+  : _numNodes(0),
+    _rowSize(0),
+    _maxRows(0),
+    _numHot(0),
+    _clockHand(0),
+    _numEvicted(0)
+{
+}
+
+SResultCache::~SResultCache()
+{
+    freeOverflowRows();
+}
+
+int SResultCache::getMaxRows(int numNodes, int maxRows)
+{
+    if (maxRows > 0 && maxRows < numNodes) {
+        return maxRows;
+    }
+    return numNodes;
+}
+
+int SResultCache::getRowStride(int rowSize)
+{
+    return SArena::alignedSize<int>(rowSize) / sizeof(int);
+}
+
+size_t SResultCache::getArenaSize(int numNodes, int rowSize, int maxRows)
+{
+    return SArena::alignedSize<int>(
+        (size_t)getRowStride(rowSize) * getMaxRows(numNodes, maxRows));
+}
+
+void SResultCache::freeOverflowRows()
+{
+    for (size_t i = _maxRows; i < _slotRows.size(); ++i) {
+        delete [] _slotRows[i];
+    }
+}
+
+void SResultCache::init(int numNodes, int rowSize, int maxRows, SArena* arena)
+{
+    freeOverflowRows();
+
+    _numNodes = numNodes;
+    _rowSize = rowSize;
+    _maxRows = getMaxRows(numNodes, maxRows);
+
+    if (!arena) {
+        arena = &_ownArena;
+        arena->reserve(getArenaSize(numNodes, rowSize, maxRows));
+    }
+    int stride = getRowStride(rowSize);
+    int* rows = arena->alloc<int>((size_t)stride * _maxRows);
+    _slotRows.resize(_maxRows);
+    for (int i = 0; i < _maxRows; ++i) {
+        _slotRows[i] = rows + (size_t)stride * i;
+    }
+
+    _nodeSlots.assign(numNodes, -1);
+    _pinCounts.assign(numNodes, 0);
+    _hotNodes.assign(numNodes, 0);
+    _numHot = 0;
+    _slotNodes.assign(_maxRows, -1);
+    _slotReferenced.assign(_maxRows, 0);
+    _freeSlots.clear();
+    for (int i = _maxRows - 1; i >= 0; --i) {
+        _freeSlots.push_back(i);
+    }
+    _clockHand = 0;
+    _numEvicted = 0;
+}
+
+int* SResultCache::allocate(int node)
+{
+    int slot = _nodeSlots[node];
+    if (slot >= 0) {
+        _slotReferenced[slot] = 1;
+        return _slotRows[slot];
+    }
+
+    if (!_freeSlots.empty()) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else if ((slot = evictSlot()) < 0) {
+        slot = _slotRows.size();
+        _slotRows.push_back(new int[_rowSize]());
+        _slotNodes.push_back(-1);
+        _slotReferenced.push_back(0);
+    }
+
+    _slotNodes[slot] = node;
+    _slotReferenced[slot] = 1;
+    _nodeSlots[node] = slot;
+    return _slotRows[slot];
+}
+
+void SResultCache::release(int node)
+{
+    int slot = _nodeSlots[node];
+    if (slot >= 0) {
+        _nodeSlots[node] = -1;
+        _slotNodes[slot] = -1;
+        _freeSlots.push_back(slot);
+    }
+    // A released row doesn't count against the hot rows
+    setHot(node, false);
+}
+
+bool SResultCache::setHot(int node, bool hot)
+{
+    if (_hotNodes[node] == hot) {
+        return true;
+    }
+    if (hot && _numHot >= _maxRows / 2) {
+        return false;
+    }
+    _hotNodes[node] = hot;
+    _numHot += hot ? 1 : -1;
+    return true;
+}
+
+void SResultCache::trim()
+{
+    int numSlots = _slotRows.size();
+    int last = numSlots - 1;
+    for (; last >= _maxRows; --last) {
+        int node = _slotNodes[last];
+        if (node >= 0 && (_pinCounts[node] || _hotNodes[node])) {
+            break;
+        }
+    }
+    if (last == numSlots - 1) {
+        return;
+    }
+
+    // Drop the free slots that are about to be removed
+    for (size_t i = 0; i < _freeSlots.size(); ) {
+        if (_freeSlots[i] > last) {
+            _freeSlots[i] = _freeSlots.back();
+            _freeSlots.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    for (int i = numSlots - 1; i > last; --i) {
+        if (_slotNodes[i] >= 0) {
+            _nodeSlots[_slotNodes[i]] = -1;
+            _numEvicted++;
+        }
+        delete [] _slotRows[i];
+    }
+    _slotRows.resize(last + 1);
+    _slotNodes.resize(last + 1);
+    _slotReferenced.resize(last + 1);
+    if (_clockHand > last) {
+        _clockHand = 0;
+    }
+}
+
+int SResultCache::evictSlot()
+{
+    // Two passes, the first clears reference bits
+    int numSlots = _slotRows.size();
+    for (int i = 0; i < numSlots * 2; ++i) {
+        int slot = _clockHand;
+        _clockHand = (_clockHand + 1) % numSlots;
+        int node = _slotNodes[slot];
+        if (node < 0) {
+            return slot;
+        }
+        if (_pinCounts[node] || _hotNodes[node]) {
+            continue;
+        }
+        if (_slotReferenced[slot]) {
+            _slotReferenced[slot] = 0;
+            continue;
+        }
+        _nodeSlots[node] = -1;
+        _slotNodes[slot] = -1;
+        _numEvicted++;
+        return slot;
+    }
+    return -1;
+}
@@ -0,0 +1,150 @@
+#ifndef SRESULTCACHE_H
+#define SRESULTCACHE_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sarena.h"
+
+/*
+ * Store for the result rows of each node (one int per test case).
+ * Rows are carved from an SArena as one block, each row starting
+ * on a cache line.
+ *
+ * By default every node has a resident row.  When a limit is set
+ * only that many rows are kept, rows are evicted with the CLOCK
+ * algorithm and the owner recomputes evicted rows from their
+ * params when they are needed again.  Rows can be pinned while in
+ * use, and nodes can be marked as hot so they are never evicted.
+ */
+class SResultCache
+{
+public:
+    SResultCache();
+    ~SResultCache();
+
+    /*
+     * Set up the cache for 'numNodes' rows of 'rowSize' ints.  At
+     * most 'maxRows' rows are kept resident, zero keeps them all.
+     * All nodes start without a row.  The rows are allocated from
+     * 'arena', or from an arena owned by the cache if NULL.
+     */
+    void init(int numNodes, int rowSize, int maxRows, SArena* arena = 0);
+
+    /*
+     * Get the arena space needed by init().
+     */
+    static size_t getArenaSize(int numNodes, int rowSize, int maxRows);
+
+    /*
+     * Return true if rows can be evicted.
+     */
+    bool isBounded() const { return _maxRows < _numNodes; }
+
+    /*
+     * Get the row of the given node or NULL if it is not
+     * resident.
+     */
+    int* find(int node) {
+        int slot = _nodeSlots[node];
+        if (slot < 0) {
+            return 0;
+        }
+        _slotReferenced[slot] = 1;
+        return _slotRows[slot];
+    }
+
+    /*
+     * Return true if the given node has a row, without marking it
+     * as used.
+     */
+    bool isResident(int node) const { return _nodeSlots[node] >= 0; }
+
+    /*
+     * Get a row for the given node, evicting another row if
+     * needed.  The contents are undefined if the node was not
+     * resident.
+     */
+    int* allocate(int node);
+
+    /*
+     * Drop the row of the given node, if it has one, and clear its
+     * hot flag.
+     */
+    void release(int node);
+
+    /*
+     * Stop the given node from being evicted until unpin() is
+     * called, pins are counted.
+     */
+    void pin(int node) { _pinCounts[node]++; }
+    void unpin(int node) { _pinCounts[node]--; }
+
+    /*
+     * Mark a node as hot, hot nodes are never evicted.  At most
+     * half of the rows can be hot, returns false if the node could
+     * not be marked.
+     */
+    bool setHot(int node, bool hot);
+    bool isHot(int node) const { return _hotNodes[node]; }
+
+    /*
+     * Free any rows allocated beyond the limit, which happens when
+     * more rows are pinned at once than the limit allows.
+     */
+    void trim();
+
+    /*
+     * Number of rows currently allocated.
+     */
+    int getNumRows() const { return _slotRows.size(); }
+
+    /*
+     * Number of rows evicted since init().
+     */
+    int64_t getNumEvicted() const { return _numEvicted; }
+
+private:
+    static int getMaxRows(int numNodes, int maxRows);
+    static int getRowStride(int rowSize);
+
+    /*
+     * Free the rows allocated beyond the limit.
+     */
+    void freeOverflowRows();
+
+    /*
+     * Find a slot to reuse with the CLOCK algorithm, returns -1 if
+     * every row is pinned.
+     */
+    int evictSlot();
+
+    int _numNodes;
+    int _rowSize;
+    int _maxRows;
+
+    // Used when no arena is given to init()
+    SArena _ownArena;
+
+    // The slot holding the row of each node, or -1
+    std::vector<int> _nodeSlots;
+    std::vector<int> _pinCounts;
+    std::vector<char> _hotNodes;
+    int _numHot;
+
+    // For each slot, the row, the node using it (or -1) and the
+    // CLOCK reference bit.  The first _maxRows rows are in the
+    // arena, the rest are allocated on the heap.
+    std::vector<int*> _slotRows;
+    std::vector<int> _slotNodes;
+    std::vector<char> _slotReferenced;
+
+    // Slots without a node
+    std::vector<int> _freeSlots;
+
+    int _clockHand;
+    int64_t _numEvicted;
+};
+
+#endif // SRESULTCACHE_H
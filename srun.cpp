@@ -0,0 +1,604 @@
+#include "srun.h"
+#include "scheckpoint.h"
+#include "strace.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <limits>
+
+SRun::SRun()
+  : _problem(NULL),
+    _finished(false),
+    _maxGenerations(25000),
+    _semanticHashing(false),
+    _acceptance(NULL),
+    _bestProgramFitness(0),
+    _bestProgramPending(false),
+    _populationSize(100),
+    _maxResidentRows(0),
+    _hugePages(SArena::NoHugePages)
+{
+}
+
+SRun::~SRun()
+{
+    delete _problem;
+    delete _acceptance;
+}
+
+void SRun::setProblem(Problem *problem)
+{
+    // Delete the old problem
+    delete _problem;
+
+    // Setup the eval engine according to the problem
+    _problem = problem;
+    _evalEngine.setNumInputs(_problem->getNumInputs());
+    _evalEngine.setAvailableOps(_problem->getOps());
+    _evalEngine.setSize(_populationSize);
+    _problem->setMaxResidentRows(_maxResidentRows);
+
+    // Carve the per-run buffers from one block
+    _arena.reserve(_problem->getArenaSize(_populationSize) +
+                   SEvalEngine::getArenaSize(_populationSize),
+                   _hugePages);
+    _problem->initTestCaseResults(_evalEngine.getSize(), &_arena);
+    _evalEngine.setArena(&_arena);
+    _problem->setSemanticHashing(_semanticHashing);
+    _fitness.resize(_evalEngine.getSize());
+    _bestProgramPending = false;
+}
+
+void SRun::setNumMaxGenerations(int maxGenerations)
+{
+    _maxGenerations = maxGenerations;
+}
+
+void SRun::setDeadline(int64_t nsecs)
+{
+    _deadline.nsecs = std::max<int64_t>(nsecs, 0);
+    _deadline.timer.start();
+}
+
+void SRun::setAcceptance(SAcceptance* acceptance)
+{
+    delete _acceptance;
+    _acceptance = acceptance;
+    _evalEngine.setJournalSize(acceptance ? acceptance->getJournalSize() : 0);
+}
+
+void SRun::setPopulationSize(int size)
+{
+    _populationSize = size;
+}
+
+void SRun::setMaxResidentRows(int maxRows)
+{
+    _maxResidentRows = maxRows;
+}
+
+void SRun::setHugePages(SArena::HugePages hugePages)
+{
+    _hugePages = hugePages;
+}
+
+void SRun::setSemanticHashing(bool enable)
+{
+    _semanticHashing = enable;
+    if (_problem) {
+        _problem->setSemanticHashing(enable);
+    }
+}
+
+void SRun::reset()
+{
+    _stats.reset();
+    _evalEngine.init();
+    std::fill(_fitness.begin(), _fitness.end(), 0);
+    _finished = false;
+    _bestProgram = SProgram();
+    _bestProgramPending = false;
+}
+
+void SRun::restart()
+{
+    _stats.generation = 0;
+    _finished = false;
+    _bestProgram = SProgram();
+    _bestProgramPending = false;
+}
+
+SRunResult SRun::run(int count)
+{
+    if (_finished) {
+        restart();
+    }
+    // The population is about to change
+    updateBestProgram();
+    STraceSpan span("generations", STraceSpan::Sampled);
+    SRunResult result = SRunContinue;
+    if (_stats.generation == 0 && !_warmStart.empty() && count > 0) {
+        // The initial generation randomises every node, then the
+        // programs take the place of the first ones
+        result = _problem->runGenerations(
+            _evalEngine, _fitness, _stats, _acceptance, _maxGenerations,
+            1, NULL);
+        if (result == SRunContinue && embedWarmStart() &&
+            _problem->hitTargetFitness(_fitness)) {
+            result = SRunHit;
+        }
+        _bestProgramPending = true;
+        count--;
+    }
+    SDeadline* deadline = _deadline.nsecs > 0 ? &_deadline : NULL;
+    while (result == SRunContinue && count > 0) {
+        if (deadline) {
+            // The loop returns on a new best individual, keep it
+            // before the next generations lose it
+            updateBestProgram();
+            deadline->bestFitness = _bestProgram.isEmpty() ?
+                std::numeric_limits<int64_t>::min() : _bestProgramFitness;
+        }
+        int start = _stats.generation;
+        result = _problem->runGenerations(
+            _evalEngine, _fitness, _stats, _acceptance, _maxGenerations,
+            count, deadline);
+        count -= _stats.generation - start;
+        _bestProgramPending = true;
+    }
+    if (result == SRunDeadline) {
+        return result;
+    }
+    if (result != SRunContinue) {
+        if (result == SRunHit) {
+            _stats.hits++;
+        }
+        _stats.runs++;
+        _finished = true;
+    }
+    return result;
+}
+
+int SRun::getBestNode()
+{
+    int best = -1;
+    int numInputs = _problem ? _problem->getNumInputs() : 0;
+    for (int i = numInputs; i < (int)_fitness.size(); ++i) {
+        if (best < 0 || _fitness[i] > _fitness[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+SProgram SRun::getProgram(int i)
+{
+    return SProgram::extract(_evalEngine, *_problem, i);
+}
+
+const SProgram& SRun::getBestProgram()
+{
+    updateBestProgram();
+    return _bestProgram;
+}
+
+int64_t SRun::getBestProgramFitness()
+{
+    updateBestProgram();
+    return _bestProgramFitness;
+}
+
+void SRun::updateBestProgram()
+{
+    if (!_bestProgramPending) {
+        return;
+    }
+    _bestProgramPending = false;
+    if (_stats.generation == 0) {
+        return;
+    }
+    // The stats only have the best score of the generation once the
+    // run has been through a generation after the initial one
+    if (!_bestProgram.isEmpty() && _stats.generation > 1 &&
+        _stats.bestIndividualScore <= _bestProgramFitness) {
+        return;
+    }
+    int best = getBestNode();
+    if (best >= 0 &&
+        (_bestProgram.isEmpty() || _fitness[best] > _bestProgramFitness)) {
+        _bestProgram = getProgram(best);
+        _bestProgramFitness = _fitness[best];
+    }
+}
+
+bool SRun::addMigrant(const SProgram& program)
+{
+    if (!_problem || _finished || _stats.generation == 0 ||
+        program.isEmpty() || program.getProblemName() != _problem->getName()) {
+        return false;
+    }
+    // The population is about to change
+    updateBestProgram();
+    STraceSpan span("migration.embed");
+    int numInputs = _problem->getNumInputs();
+    int numNodes = _fitness.size();
+    int count = program.getInstructions().size();
+    if (count == 0 || numInputs + count > numNodes) {
+        return false;
+    }
+
+    // Slide a window over the nodes to find the least fit one
+    int64_t windowScore = 0;
+    for (int i = numInputs; i < numInputs + count; ++i) {
+        windowScore += _fitness[i];
+    }
+    int64_t lowestScore = windowScore;
+    int at = numInputs;
+    for (int i = numInputs + count; i < numNodes; ++i) {
+        windowScore += _fitness[i] - _fitness[i - count];
+        if (windowScore < lowestScore) {
+            lowestScore = windowScore;
+            at = i - count + 1;
+        }
+    }
+    if (!_evalEngine.embed(program.getInstructions().data(), count, at)) {
+        return false;
+    }
+    acceptEmbedded();
+    return true;
+}
+
+void SRun::setWarmStart(const std::vector<SProgram>& programs)
+{
+    _warmStart = programs;
+}
+
+bool SRun::embedWarmStart()
+{
+    STraceSpan span("warmStart.embed");
+    int numInputs = _problem->getNumInputs();
+    int numNodes = _fitness.size();
+    int limit = numInputs + (numNodes - numInputs) / 2;
+    int at = numInputs;
+    for (size_t i = 0; i < _warmStart.size(); ++i) {
+        const SProgram& program = _warmStart[i];
+        int count = program.getInstructions().size();
+        if (program.getProblemName() != _problem->getName() ||
+            program.getNumInputs() != numInputs ||
+            count == 0 || at + count > limit) {
+            continue;
+        }
+        if (_evalEngine.embed(program.getInstructions().data(), count, at)) {
+            at += count;
+        }
+    }
+    if (at == numInputs) {
+        return false;
+    }
+    acceptEmbedded();
+    return true;
+}
+
+void SRun::acceptEmbedded()
+{
+    _evalEngine.clearChanged();
+    _problem->evaluate(_evalEngine, _fitness);
+
+    // Accept the new population, the next generation compares
+    // against it rather than restoring the last mutation
+    int numInputs = _problem->getNumInputs();
+    int numNodes = _fitness.size();
+    int64_t totalScore = 0;
+    int bestScore = _fitness[numInputs];
+    for (int i = numInputs; i < numNodes; ++i) {
+        totalScore += _fitness[i];
+        bestScore = std::max(bestScore, _fitness[i]);
+    }
+    _stats.avgScore = totalScore;
+    _stats.lastAvgScore = totalScore;
+    _stats.bestScoreEver = std::max(_stats.bestScoreEver, totalScore);
+    _stats.bestIndividualScore = bestScore;
+    _stats.bestIndividualScoreEver =
+        std::max(_stats.bestIndividualScoreEver, int64_t(bestScore));
+    _stats.distinctNodes = _evalEngine.getNumDistinctNodes();
+    _stats.distinctOutputs = _problem->getNumDistinctOutputs();
+    if (_acceptance) {
+        _acceptance->rebase(totalScore);
+    }
+    _bestProgramPending = true;
+}
+
+QByteArray SRun::saveCheckpoint()
+{
+    STraceSpan span("checkpoint.save");
+    SCheckpointWriter writer;
+    writer.begin();
+
+    int numNodes = _evalEngine.getSize();
+    int numCases = _problem->getNumFitnessCases();
+    writer.writeString(_problem->getName());
+    writer.write<int32_t>(_problem->getNumInputs());
+    writer.write<int32_t>(numCases);
+    writer.write<int32_t>(numNodes);
+    writer.write<int32_t>(_maxGenerations);
+
+    writer.write<uint64_t>(_evalEngine.getRandomState());
+    writer.write<int32_t>(_finished);
+
+    writer.write<int64_t>(_stats.bestScoreEver);
+    writer.write<int64_t>(_stats.avgScore);
+    writer.write<int64_t>(_stats.lastAvgScore);
+    writer.write<int64_t>(_stats.bestIndividualScore);
+    writer.write<int64_t>(_stats.bestIndividualScoreEver);
+    writer.write<int64_t>(_stats.timeTakenMilliseconds);
+    writer.write<int32_t>(_stats.generation);
+    writer.write<int32_t>(_stats.hits);
+    writer.write<int32_t>(_stats.runs);
+    writer.write<int32_t>(_stats.distinctNodes);
+    writer.write<int32_t>(_stats.distinctOutputs);
+
+    // Only the nodes are saved, the links, constant flags and
+    // canonical nodes are rebuilt from them
+    writer.write<int32_t>(_evalEngine.getOldNodeIndex());
+    writer.write(_evalEngine.getOldNode());
+    writer.write(_evalEngine.getNodes().data(), numNodes);
+    writer.write(_fitness.data(), numNodes);
+
+    const std::vector<char>& constNodes = _evalEngine.getConstantNodes();
+    const std::vector<int>& canonNodes = _evalEngine.getCanonicalNodes();
+    std::vector<int32_t> constValues(numNodes, 0);
+    std::vector<uint64_t> outputHashes(numNodes, 0);
+    std::vector<int32_t> rowNodes;
+    for (int i = 0; i < numNodes; ++i) {
+        if (constNodes[i]) {
+            constValues[i] = _problem->getConstantResult(i);
+        } else if (i >= _problem->getNumInputs() && canonNodes[i] == i &&
+                   _problem->getNodeResults(i)) {
+            rowNodes.push_back(i);
+        }
+        outputHashes[i] = _problem->getOutputHash(i);
+    }
+    writer.write(constValues.data(), numNodes);
+    writer.write<int32_t>(_semanticHashing);
+    writer.write(outputHashes.data(), numNodes);
+
+    // The state of the acceptance rule and the journal it goes back
+    // with, see SAcceptance::save()
+    SCheckpointWriter acceptanceWriter;
+    if (_acceptance) {
+        _acceptance->save(acceptanceWriter);
+    }
+    const QByteArray& acceptanceState = acceptanceWriter.getData();
+    writer.writeString(_acceptance ? _acceptance->getName() : QString());
+    writer.write<int32_t>(acceptanceState.size());
+    writer.write(acceptanceState.constData(), acceptanceState.size());
+    writer.align(sizeof(uint32_t));
+    std::vector<int> journalIndices;
+    std::vector<SNode> journalNodes;
+    _evalEngine.getJournal(journalIndices, journalNodes);
+    writer.write<int32_t>(journalIndices.size());
+    writer.write(journalIndices.data(), journalIndices.size());
+    writer.write(journalNodes.data(), journalNodes.size());
+
+    // The resident rows, evicted rows are recomputed when needed
+    writer.write<int32_t>(rowNodes.size());
+    writer.write(rowNodes.data(), rowNodes.size());
+    for (size_t k = 0; k < rowNodes.size(); ++k) {
+        writer.align(SCheckpoint::RowAlignment);
+        writer.write(_problem->getNodeResults(rowNodes[k]), numCases);
+    }
+    return writer.getData();
+}
+
+bool SRun::loadCheckpoint(const QString& fileName, QString* outError)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (outError) {
+            *outError = QString("Can't open %1").arg(fileName);
+        }
+        return false;
+    }
+    const uchar* data = file.map(0, file.size());
+    if (!data) {
+        if (outError) {
+            *outError = QString("Can't map %1").arg(fileName);
+        }
+        return false;
+    }
+
+    SCheckpointReader reader(data, file.size());
+    if (!reader.begin()) {
+        if (outError) {
+            *outError = reader.getError();
+        }
+        return false;
+    }
+
+    QString problemName = reader.readString();
+    int numInputs = reader.read<int32_t>();
+    int numCases = reader.read<int32_t>();
+    int numNodes = reader.read<int32_t>();
+    int maxGenerations = reader.read<int32_t>();
+    Problem* problem = _problem;
+    if (!problem || problem->getName() != problemName ||
+        _populationSize != numNodes) {
+        problem = Problem::create(problemName);
+        if (!problem) {
+            if (outError) {
+                *outError = QString("Unknown problem %1").arg(problemName);
+            }
+            return false;
+        }
+    }
+    if (!reader.isOk() || numInputs != problem->getNumInputs() ||
+        numCases != problem->getNumFitnessCases() ||
+        numNodes <= numInputs ||
+        qint64(numNodes) * qint64(sizeof(SNode)) > file.size()) {
+        if (outError) {
+            *outError = reader.isOk() ?
+                QString("Checkpoint doesn't match %1").arg(problemName) :
+                reader.getError();
+        }
+        if (problem != _problem) {
+            delete problem;
+        }
+        return false;
+    }
+
+    // Read everything before changing any state, so a bad file
+    // leaves a consistent run behind
+    uint64_t randomState = reader.read<uint64_t>();
+    bool finished = reader.read<int32_t>();
+    SNodeStats stats;
+    stats.bestScoreEver = reader.read<int64_t>();
+    stats.avgScore = reader.read<int64_t>();
+    stats.lastAvgScore = reader.read<int64_t>();
+    stats.bestIndividualScore = reader.read<int64_t>();
+    stats.bestIndividualScoreEver = reader.read<int64_t>();
+    stats.timeTakenMilliseconds = reader.read<int64_t>();
+    stats.generation = reader.read<int32_t>();
+    stats.hits = reader.read<int32_t>();
+    stats.runs = reader.read<int32_t>();
+    stats.distinctNodes = reader.read<int32_t>();
+    stats.distinctOutputs = reader.read<int32_t>();
+
+    int oldNodeIndex = reader.read<int32_t>();
+    SNode oldNode = reader.read<SNode>();
+    std::vector<SNode> nodes(numNodes);
+    reader.read(nodes.data(), numNodes);
+    std::vector<int> fitness(numNodes);
+    reader.read(fitness.data(), numNodes);
+    std::vector<int32_t> constValues(numNodes);
+    reader.read(constValues.data(), numNodes);
+    bool semanticHashing = reader.read<int32_t>();
+    std::vector<uint64_t> outputHashes(numNodes);
+    reader.read(outputHashes.data(), numNodes);
+    QString acceptanceName = reader.readString();
+    int acceptanceSize = reader.read<int32_t>();
+    const uchar* acceptanceState = 0;
+    if (acceptanceSize >= 0) {
+        acceptanceState = reader.take(acceptanceSize);
+    }
+    reader.align(sizeof(uint32_t));
+    int journalLength = reader.read<int32_t>();
+    if (journalLength < 0 ||
+        qint64(journalLength) * qint64(sizeof(SNode)) > file.size()) {
+        journalLength = 0;
+        reader.setError("Checkpoint is corrupt");
+    }
+    std::vector<int> journalIndices(journalLength);
+    reader.read(journalIndices.data(), journalLength);
+    std::vector<SNode> journalNodes(journalLength);
+    reader.read(journalNodes.data(), journalLength);
+    int numRows = reader.read<int32_t>();
+    std::vector<int32_t> rowNodes(std::max(0, std::min(numRows, numNodes)));
+    reader.read(rowNodes.data(), rowNodes.size());
+    if (reader.isOk() && (numRows != int(rowNodes.size()) ||
+                          oldNodeIndex < 0 || oldNodeIndex >= numNodes ||
+                          acceptanceSize < 0)) {
+        reader.setError("Checkpoint is corrupt");
+    }
+
+    // Nodes may only link to lower indexed nodes
+    for (int i = 0; i < numNodes && reader.isOk(); ++i) {
+        const SNode& node = nodes[i];
+        bool ok = (node.op == SNode::InputOp) == (i < numInputs) &&
+                  node.op > SNode::NoOp && node.op < SNode::NumOps;
+        for (int k = 0; ok && k < node.getNumLinks(); ++k) {
+            ok = node.param[k] >= 0 && node.param[k] < i;
+        }
+        if (!ok) {
+            reader.setError("Checkpoint is corrupt");
+        }
+    }
+
+    // Rolling back a journal entry only changes the node's params
+    for (int k = 0; k < journalLength && reader.isOk(); ++k) {
+        int i = journalIndices[k];
+        const SNode& node = journalNodes[k];
+        bool ok = i >= 0 && i < numNodes;
+        if (ok && i >= numInputs) {
+            ok = node.op == nodes[i].op;
+            for (int j = 0; ok && j < node.getNumLinks(); ++j) {
+                ok = node.param[j] >= 0 && node.param[j] < i;
+            }
+        }
+        if (!ok) {
+            reader.setError("Checkpoint is corrupt");
+        }
+    }
+    if (!reader.isOk()) {
+        if (outError) {
+            *outError = reader.getError();
+        }
+        if (problem != _problem) {
+            delete problem;
+        }
+        return false;
+    }
+
+    if (problem != _problem) {
+        _populationSize = numNodes;
+        setProblem(problem);
+    }
+    _maxGenerations = maxGenerations;
+    _evalEngine.setNodes(nodes.data(), oldNodeIndex, oldNode);
+    _evalEngine.setRandomState(randomState);
+    _problem->initTestCaseResults(numNodes, &_arena);
+    _problem->setSemanticHashing(semanticHashing);
+    _semanticHashing = semanticHashing;
+    const std::vector<char>& constNodes = _evalEngine.getConstantNodes();
+    for (int i = 0; i < numNodes; ++i) {
+        if (constNodes[i]) {
+            _problem->setConstantResult(i, constValues[i]);
+        }
+        if (semanticHashing && i >= numInputs) {
+            _problem->restoreOutputHash(i, outputHashes[i]);
+        }
+    }
+    for (int k = 0; k < numRows && reader.isOk(); ++k) {
+        reader.align(SCheckpoint::RowAlignment);
+        const uchar* row = reader.take(sizeof(int32_t) * numCases);
+        int i = rowNodes[k];
+        if (row && i >= numInputs && i < numNodes && !constNodes[i]) {
+            memcpy(_problem->restoreNodeResults(_evalEngine, i), row,
+                   sizeof(int32_t) * numCases);
+        }
+    }
+    if (!reader.isOk()) {
+        // The engine is already replaced, start again
+        if (outError) {
+            *outError = reader.getError();
+        }
+        reset();
+        return false;
+    }
+    _problem->shareRestoredRows(_evalEngine);
+
+    if (_acceptance && acceptanceName == _acceptance->getName()) {
+        SCheckpointReader acceptanceReader(acceptanceState, acceptanceSize);
+        if (!_acceptance->load(acceptanceReader)) {
+            if (outError) {
+                *outError = "Checkpoint is corrupt";
+            }
+            reset();
+            return false;
+        }
+        _evalEngine.setJournal(journalIndices, journalNodes);
+    }
+
+    _fitness = fitness;
+    stats.counters.perfCounters = _stats.counters.perfCounters;
+    _stats = stats;
+    _finished = finished;
+    if (_acceptance && acceptanceName != _acceptance->getName()) {
+        // Saved with another rule, start this one's schedule from
+        // this population
+        _acceptance->rebase(_stats.avgScore);
+    }
+    _bestProgram = SProgram();
+    _bestProgramPending = true;
+    return true;
+}
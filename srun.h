@@ -0,0 +1,263 @@
+#ifndef SRUN_H
+#define SRUN_H
+
+#include <stdint.h>
+#include <vector>
+#include <QByteArray>
+
+#include "snode.h"
+#include "sevalengine.h"
+#include "sarena.h"
+#include "problem.h"
+#include "sprogram.h"
+#include "sacceptance.h"
+
+/*
+ * State of a series of GP runs on one problem: the eval engine, the
+ * fitness of each node and the stats.
+ *
+ * Not thread safe, see SNGPWorker for running in the background.
+ */
+class SRun
+{
+public:
+    SRun();
+    ~SRun();
+
+    /*
+     * Set the problem.  Ownership is passed to this class.
+     * Object is deleted next time setProblem is called.
+     * Also called when SRun is destroyed.
+     */
+    void setProblem(Problem* problem);
+
+    Problem* getProblem() { return _problem; }
+
+    /*
+     * Set the max number of generations to run the GP engine
+     * before a run is terminated.
+     */
+    void setNumMaxGenerations(int maxGenerations);
+
+    /*
+     * Stop run() with SRunDeadline once 'nsecs' have passed from now,
+     * 0 for no deadline (the default).  The run isn't finished, a
+     * later run() carries on with it.  The clock is read every
+     * SRunLoop::DeadlineCheckInterval generations, so run() returns
+     * at most that many generations after the deadline.  That is
+     * usually tens of microseconds, but a mutation near the inputs
+     * that changes most of the population can take longer than
+     * evaluating every node.
+     */
+    void setDeadline(int64_t nsecs);
+
+    /*
+     * Set the number of nodes in the population, including the
+     * inputs.  Takes effect on the next setProblem().
+     */
+    void setPopulationSize(int size);
+
+    /*
+     * Limit the number of node result rows kept in memory, see
+     * Problem::setMaxResidentRows().  Takes effect on the next
+     * setProblem().
+     */
+    void setMaxResidentRows(int maxRows);
+
+    /*
+     * Back the per-run buffers with huge pages.  Takes effect on
+     * the next setProblem().
+     */
+    void setHugePages(SArena::HugePages hugePages);
+
+    /*
+     * Turn on hashing of node outputs so the number of distinct
+     * outputs is recorded in the stats, see
+     * Problem::setSemanticHashing().  A loaded checkpoint keeps the
+     * setting of the run that saved it.
+     */
+    void setSemanticHashing(bool enable);
+    bool getSemanticHashing() const { return _semanticHashing; }
+
+    /*
+     * Reset the stats and start a new run.
+     */
+    void reset();
+
+    /*
+     * Run up to 'count' generations of the current run.  When the
+     * run finishes (an individual hit the target fitness or the max
+     * number of generations was reached) the hits and runs in the
+     * stats are updated, stats.generation is left at the number of
+     * generations the run took, and the next call starts a new run.
+     * Returns SRunDeadline, with the run still in progress, if the
+     * deadline passed first.
+     */
+    SRunResult run(int count);
+
+    /*
+     * Start a new run on the next call to run().
+     */
+    void restart();
+
+    /*
+     * Return true if the current run has finished, the next call
+     * to run() starts a new run.
+     */
+    bool isFinished() const { return _finished; }
+
+    /*
+     * Save the state of the run: the nodes, result rows, fitness,
+     * stats, the state of the engine's random number generator and
+     * that of the acceptance rule with its journal, so a run
+     * resumed from the checkpoint carries on exactly as the saved
+     * run does.  Copying the state is all that is done here, write
+     * it out with SCheckpointFileWriter.  Must be called from the
+     * thread running the generations, between batches.
+     */
+    QByteArray saveCheckpoint();
+
+    /*
+     * Resume a run saved by saveCheckpoint().  The file is mapped
+     * and the result rows are copied from it, so nothing is
+     * reevaluated.  The problem is replaced if the checkpoint is
+     * of another problem, and the population size is set to that
+     * of the checkpoint.  Returns false and sets 'outError' if the
+     * file can't be loaded.  The run is left as it was, unless the
+     * file turns out to be bad after the nodes were replaced, when
+     * the run is reset instead.  A checkpoint saved with another
+     * acceptance rule starts the current rule's schedule over.
+     */
+    bool loadCheckpoint(const QString& fileName, QString* outError = 0);
+
+    SEvalEngine& getEngine() { return _evalEngine; }
+
+    /*
+     * Get the fitness of all individual nodes.
+     */
+    const std::vector<int>& getFitness() { return _fitness; }
+
+    /*
+     * Get the node with the best fitness, the first if several
+     * share it.  Returns -1 before the first run.
+     */
+    int getBestNode();
+
+    /*
+     * Extract the program of node 'i', see SProgram::extract().
+     * Only valid between calls to run().
+     */
+    SProgram getProgram(int i);
+
+    /*
+     * Get the program of the best individual found so far in the
+     * current run, and its fitness, even if it has since been lost
+     * from the population.  With a deadline every new best individual
+     * is kept, otherwise the population is checked after every call
+     * to run().  The program is extracted when it's asked for or
+     * before the population changes, not after every run().  Empty
+     * before the first generation.
+     */
+    const SProgram& getBestProgram();
+    int64_t getBestProgramFitness();
+
+    /*
+     * Copy 'program', found by another run of the same problem, over
+     * the least fit nodes of the current run, as an island model
+     * does with migrants.  The program takes the place of the window
+     * of nodes with the lowest total fitness, the population is
+     * reevaluated and the run carries on from there.  Returns false
+     * if the program is of another problem, doesn't fit or no run is
+     * in progress.  Only valid between calls to run().
+     */
+    bool addMigrant(const SProgram& program);
+
+    /*
+     * Warm start every new run from 'programs', found by earlier
+     * runs of the problem (see SProgramLibrary).  After the initial
+     * generation the programs are copied, one after the other, over
+     * the nodes after the inputs, as many as fit in half of the
+     * population, so the rest of the nodes stay random and can link
+     * to them.  The population is then reevaluated.  Programs of
+     * another problem are skipped.  An empty list turns it off.
+     */
+    void setWarmStart(const std::vector<SProgram>& programs);
+
+    /*
+     * Set the rule for keeping mutations, NULL (the default) for
+     * the greedy rule of the paper.  Ownership is passed to this
+     * class.  The engine's journal is sized for the rule's
+     * patience.  Set it before a run starts.
+     */
+    void setAcceptance(SAcceptance* acceptance);
+
+    SAcceptance* getAcceptance() { return _acceptance; }
+
+    /*
+     * Get the stats for the current run.
+     */
+    SNodeStats& getStats() { return _stats; }
+
+private:
+    // Keep the program of the best node if it's the fittest so far,
+    // if the population changed since the last call
+    void updateBestProgram();
+
+    // Copy the warm start programs over the population, returns
+    // false if none fit
+    bool embedWarmStart();
+
+    // Reevaluate the population after nodes were embedded and make
+    // it the one the next generation is compared against
+    void acceptEmbedded();
+
+    // The GP evaluation engine
+    SEvalEngine _evalEngine;
+
+    // Current fitness values
+    std::vector<int> _fitness;
+
+    // Current stats, updated during execution.
+    SNodeStats _stats;
+
+    // The current problem set
+    Problem* _problem;
+
+    // True when the current run has finished
+    bool _finished;
+
+    // The max number of generations to allow before
+    // terminating the current run.
+    int _maxGenerations;
+
+    // True if node outputs are hashed to measure diversity
+    bool _semanticHashing;
+
+    // Deadline of run(), see setDeadline()
+    SDeadline _deadline;
+
+    // Rule for keeping mutations, NULL for greedy
+    SAcceptance* _acceptance;
+
+    // Programs copied into every new run, see setWarmStart()
+    std::vector<SProgram> _warmStart;
+
+    // Best individual found in the current run, see getBestProgram()
+    SProgram _bestProgram;
+    int64_t _bestProgramFitness;
+    // The population changed since _bestProgram was updated
+    bool _bestProgramPending;
+
+    // Number of nodes in the population
+    int _populationSize;
+
+    // Max number of result rows to keep in memory, 0 for all
+    int _maxResidentRows;
+
+    // Memory for the node link lists and result rows, reused
+    // between runs
+    SArena _arena;
+    SArena::HugePages _hugePages;
+};
+
+#endif // SRUN_H
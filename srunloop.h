@@ -0,0 +1,251 @@
+#ifndef SRUNLOOP_H
+#define SRUNLOOP_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <QElapsedTimer>
+
+#include "snode.h"
+#include "sevalengine.h"
+#include "strace.h"
+#include "sacceptance.h"
+
+/*
+ * Result of running a batch of generations.
+ */
+enum SRunResult {
+    // The run has not finished yet
+    SRunContinue,
+    // An individual hit the target fitness
+    SRunHit,
+    // The max number of generations was reached
+    SRunMaxGenerations,
+    // The deadline passed before the run finished, see
+    // SRun::setDeadline()
+    SRunDeadline
+};
+
+/*
+ * Deadline of a batch of generations, see SRunLoop::run().
+ */
+struct SDeadline
+{
+    SDeadline() : nsecs(0), bestFitness(0) {}
+
+    // Started when the deadline was set
+    QElapsedTimer timer;
+    // Nanoseconds from the start of 'timer', 0 for no deadline
+    int64_t nsecs;
+    // Fitness of the best individual the caller has kept
+    int64_t bestFitness;
+};
+
+/*
+ * The SNGP generation loop: mutate (or restore the previous
+ * mutation if it made things worse), evaluate the changed nodes,
+ * total up the scores and check for a hit.
+ *
+ * Templated on the concrete problem type so that evaluation and
+ * the termination check are inlined into the loop.  'P' must
+ * provide:
+ *   getNumInputs()
+ *   getNumFitnessCases()
+ *   evaluateAllNodes(const SEvalEngine&, std::vector<int>&)
+ *   evaluateChangedNodes(const SEvalEngine&,
+ *                        const SortedArray<int>&, std::vector<int>&)
+ *   getNumDistinctOutputs()
+ *   getNumEvaluatedRows()
+ *   isTargetFitness(int fitness)
+ * See ProblemT.
+ *
+ * 'acceptance' decides whether to keep each mutation (see
+ * SAcceptance), NULL for the greedy rule of the paper, which is
+ * inlined.
+ */
+template<class P>
+class SRunLoop
+{
+public:
+    /*
+     * Run up to 'count' generations, stopping early when the run
+     * finishes.  A run starts (the engine is initialised) when
+     * stats.generation is zero.
+     *
+     * With a 'deadline' the clock is read every
+     * DeadlineCheckInterval generations, returning SRunDeadline
+     * once it has passed.  The batch also returns SRunContinue
+     * after the initial generation and as soon as an individual
+     * beats deadline->bestFitness, so the caller can keep it before
+     * the population loses it.
+     */
+    static SRunResult run(P& problem, SEvalEngine& engine,
+                          std::vector<int>& fitness, SNodeStats& stats,
+                          SAcceptance* acceptance,
+                          int maxGenerations, int count,
+                          const SDeadline* deadline);
+
+    /*
+     * Run a single generation, returns true if an individual hit
+     * the target fitness.
+     */
+    static bool generation(P& problem, SEvalEngine& engine,
+                           std::vector<int>& fitness, SNodeStats& stats,
+                           SAcceptance* acceptance);
+
+    // Generations between reads of the deadline's clock
+    enum { DeadlineCheckInterval = 16 };
+};
+
+template<class P>
+SRunResult SRunLoop<P>::run(P& problem, SEvalEngine& engine,
+                            std::vector<int>& fitness, SNodeStats& stats,
+                            SAcceptance* acceptance,
+                            int maxGenerations, int count,
+                            const SDeadline* deadline)
+{
+    for (int i = 0; i < count; ++i) {
+        if (generation(problem, engine, fitness, stats, acceptance)) {
+            return SRunHit;
+        }
+        if (stats.generation >= maxGenerations) {
+            return SRunMaxGenerations;
+        }
+        if (deadline) {
+            // The initial generation's best score isn't in the stats
+            if (stats.generation == 1 ||
+                stats.bestIndividualScore > deadline->bestFitness) {
+                return SRunContinue;
+            }
+            if (stats.generation % DeadlineCheckInterval == 0 &&
+                deadline->timer.nsecsElapsed() >= deadline->nsecs) {
+                return SRunDeadline;
+            }
+        }
+    }
+    return SRunContinue;
+}
+
+template<class P>
+inline bool SRunLoop<P>::generation(P& problem, SEvalEngine& engine,
+                                    std::vector<int>& fitness,
+                                    SNodeStats& stats,
+                                    SAcceptance* acceptance)
+{
+    SCounters& counters = stats.counters;
+    SPhaseTimer timer(counters);
+    // Only rows that were evaluated are counted, constant and
+    // duplicate nodes are changed without evaluating a row
+    int64_t evaluatedRows = problem.getNumEvaluatedRows();
+
+    // Apply a new mutation or revert the previous
+    if (stats.generation == 0) {
+        // Calculate fitness values for all test cases
+        std::fill(fitness.begin(), fitness.end(), 0);
+        STraceSpan initSpan("init");
+        engine.init();
+        if (acceptance) {
+            acceptance->reset(engine.getRandomState());
+        }
+        initSpan.end();
+        timer.endPhase(SCounters::MutatePhase);
+        STraceSpan evaluateSpan("evaluateAll");
+        problem.evaluateAllNodes(engine, fitness);
+        evaluateSpan.end();
+        counters.countEvaluation(
+                problem.getNumEvaluatedRows() - evaluatedRows,
+                problem.getNumFitnessCases());
+    } else {
+        bool rejected;
+        if (acceptance) {
+            rejected = !acceptance->accept(stats.avgScore,
+                                           stats.lastAvgScore);
+        } else {
+            rejected = stats.avgScore < stats.lastAvgScore;
+        }
+        bool restored = false;
+        if (rejected) {
+            restored = engine.restoreNode();
+            timer.endPhase(SCounters::MutatePhase);
+            engine.markMutation();
+            timer.endPhase(SCounters::MarkPhase);
+            stats.avgScore = stats.lastAvgScore;
+        } else if (acceptance) {
+            engine.journalMutation();
+            engine.trimJournal(acceptance->getKeptSinceBest());
+        }
+        // There's no mutation before the first generation after init
+        if (stats.generation > 1) {
+            counters.countMutation(!rejected, restored);
+        }
+        if (acceptance) {
+            // Go back to the best population, its nodes are
+            // reevaluated with the new mutation's
+            int64_t bestScore;
+            int count = acceptance->getRollback(engine.getJournalLength(),
+                                                bestScore);
+            if (count > 0) {
+                engine.rollback(count);
+                timer.endPhase(SCounters::MarkPhase);
+                stats.avgScore = bestScore;
+            }
+        }
+        engine.mutateNode();
+        timer.endPhase(SCounters::MutatePhase);
+        engine.markMutation();
+        timer.endPhase(SCounters::MarkPhase);
+        const SortedArray<int>& changed = engine.getChangedNodes();
+        problem.evaluateChangedNodes(engine, changed, fitness);
+        counters.countEvaluation(
+                problem.getNumEvaluatedRows() - evaluatedRows,
+                problem.getNumFitnessCases());
+        engine.clearChanged();
+    }
+    timer.endPhase(SCounters::EvaluatePhase);
+
+    // Calculate total scores and check for a hit
+    int numInputs = problem.getNumInputs();
+    int numNodes = fitness.size();
+    const int* values = fitness.data();
+    int64_t totalScore = 0;
+    int bestScore = values[numInputs];
+    bool hit = false;
+    for (int i = numInputs; i < numNodes; ++i) {
+        int value = values[i];
+        totalScore += value;
+        if (value > bestScore) {
+            bestScore = value;
+        }
+        hit |= problem.isTargetFitness(value);
+    }
+
+    if (stats.generation == 0) {
+        // First time just record the stats, this handles the case
+        // where the test is retuning negative values.
+        stats.lastAvgScore = totalScore;
+        stats.avgScore = totalScore;
+        stats.bestScoreEver = totalScore;
+        if (stats.runs == 0) {
+            stats.bestIndividualScore = bestScore;
+            stats.bestIndividualScoreEver = bestScore;
+        }
+    } else {
+        stats.lastAvgScore = stats.avgScore;
+        stats.avgScore = totalScore;
+        if (stats.bestScoreEver < totalScore) {
+            stats.bestScoreEver = totalScore;
+        }
+        stats.bestIndividualScore = bestScore;
+        if (stats.bestIndividualScoreEver < bestScore) {
+            stats.bestIndividualScoreEver = bestScore;
+        }
+    }
+    stats.distinctNodes = engine.getNumDistinctNodes();
+    stats.distinctOutputs = problem.getNumDistinctOutputs();
+    stats.generation++;
+    timer.endPhase(SCounters::ReducePhase);
+    timer.endGeneration();
+    return hit;
+}
+
+#endif // SRUNLOOP_H
@@ -0,0 +1,178 @@
+#include "strace.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <atomic>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    int64_t end;
+};
+
+// Events of one thread, written only by that thread
+struct ThreadBuffer {
+    // Power of two so the position wraps with a mask
+    enum { Capacity = 1 << 16 };
+
+    ThreadBuffer(int id) : id(id), count(0), sampleCount(0) {
+        events.resize(Capacity);
+    }
+
+    int id;
+    QString name;
+    std::vector<TraceEvent> events;
+    // Number of events ever written, the newest are kept
+    std::atomic<uint64_t> count;
+    int sampleCount;
+};
+
+std::atomic<int> s_sampleInterval(64);
+
+// Buffers of every thread that has recorded, kept after the thread
+// exits so its events can still be written
+QMutex s_buffersMutex;
+std::vector<ThreadBuffer*> s_buffers;
+
+thread_local ThreadBuffer* t_buffer = 0;
+
+ThreadBuffer* getThreadBuffer()
+{
+    if (!t_buffer) {
+        QMutexLocker lock(&s_buffersMutex);
+        t_buffer = new ThreadBuffer(s_buffers.size() + 1);
+        s_buffers.push_back(t_buffer);
+    }
+    return t_buffer;
+}
+
+struct TraceClock {
+    TraceClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+
+QElapsedTimer& getClock()
+{
+    static TraceClock clock;
+    return clock.timer;
+}
+
+}
+
+std::atomic<bool> STrace::_enabled(false);
+
+void STrace::setEnabled(bool enable)
+{
+    // Start the clock before any span reads it
+    getClock();
+    _enabled.store(enable, std::memory_order_relaxed);
+}
+
+void STrace::setSampleInterval(int interval)
+{
+    s_sampleInterval.store(interval < 1 ? 1 : interval,
+                           std::memory_order_relaxed);
+}
+
+void STrace::setThreadName(const QString& name)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    QMutexLocker lock(&s_buffersMutex);
+    buffer->name = name;
+}
+
+int64_t STrace::now()
+{
+    return getClock().nsecsElapsed();
+}
+
+bool STrace::sample()
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    if (++buffer->sampleCount >=
+        s_sampleInterval.load(std::memory_order_relaxed)) {
+        buffer->sampleCount = 0;
+        return true;
+    }
+    return false;
+}
+
+void STrace::addSpan(const char* name, int64_t start, int64_t end)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    uint64_t count = buffer->count.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[count & (ThreadBuffer::Capacity - 1)];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+bool STrace::write(const QString& fileName)
+{
+    QJsonArray events;
+    {
+        QMutexLocker lock(&s_buffersMutex);
+        for (size_t i = 0; i < s_buffers.size(); ++i) {
+            const ThreadBuffer* buffer = s_buffers[i];
+            if (!buffer->name.isEmpty()) {
+                QJsonObject args;
+                args["name"] = buffer->name;
+                QJsonObject meta;
+                meta["name"] = QString("thread_name");
+                meta["ph"] = QString("M");
+                meta["pid"] = 1;
+                meta["tid"] = buffer->id;
+                meta["args"] = args;
+                events.append(meta);
+            }
+
+            uint64_t count = buffer->count.load(std::memory_order_acquire);
+            uint64_t first = 0;
+            if (count > uint64_t(ThreadBuffer::Capacity)) {
+                first = count - ThreadBuffer::Capacity;
+            }
+            for (uint64_t k = first; k < count; ++k) {
+                const TraceEvent& event =
+                    buffer->events[k & (ThreadBuffer::Capacity - 1)];
+                // Complete events, times in microseconds
+                QJsonObject span;
+                span["name"] = QString(event.name);
+                span["ph"] = QString("X");
+                span["pid"] = 1;
+                span["tid"] = buffer->id;
+                span["ts"] = event.start / 1e3;
+                span["dur"] = (event.end - event.start) / 1e3;
+                events.append(span);
+            }
+        }
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = QString("ns");
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+void STrace::clear()
+{
+    QMutexLocker lock(&s_buffersMutex);
+    for (size_t i = 0; i < s_buffers.size(); ++i) {
+        s_buffers[i]->count.store(0, std::memory_order_relaxed);
+        s_buffers[i]->sampleCount = 0;
+    }
+}
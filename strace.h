@@ -0,0 +1,123 @@
+#ifndef STRACE_H
+#define STRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <QString>
+
+/*
+ * Records spans of time (run phases, batches of generations, lock
+ * waits) on each thread, and writes them in the Chrome trace event
+ * format, loadable in chrome://tracing or ui.perfetto.dev.
+ *
+ * Off by default, a disabled span costs a load and a branch.  Each
+ * thread writes to its own ring buffer, so recording needs no locks,
+ * and only the most recent events of each thread are kept.  Frequent
+ * spans (batches of generations, lock waits) are sampled, only one in
+ * every setSampleInterval() of them is recorded, so tracing doesn't
+ * distort fast runs.
+ *
+ * Span names must be string literals, only the pointer is stored.
+ */
+class STrace
+{
+public:
+    /*
+     * Start or stop recording, on all threads.
+     */
+    static void setEnabled(bool enable);
+    static bool isEnabled() {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Record one in every 'interval' sampled spans on each thread,
+     * 1 to record them all.
+     */
+    static void setSampleInterval(int interval);
+
+    /*
+     * Name the calling thread in the trace.  Allocates the thread's
+     * buffer, so only call it when tracing.
+     */
+    static void setThreadName(const QString& name);
+
+    /*
+     * Get the time in nanoseconds since the trace clock started.
+     */
+    static int64_t now();
+
+    /*
+     * Record a span on the calling thread.
+     */
+    static void addSpan(const char* name, int64_t start, int64_t end);
+
+    /*
+     * Return true if the next sampled span of the calling thread
+     * should be recorded.
+     */
+    static bool sample();
+
+    /*
+     * Write the recorded events to 'fileName'.  Events recorded
+     * while writing may be torn, so stop the threads (or disable
+     * recording) first.  Returns false if the file can't be written.
+     */
+    static bool write(const QString& fileName);
+
+    /*
+     * Discard the recorded events.  No thread may be recording.
+     */
+    static void clear();
+
+private:
+    // Read by every span, so isEnabled() is inline
+    static std::atomic<bool> _enabled;
+};
+
+/*
+ * Records a span from its construction until end() or its
+ * destruction, if tracing is enabled.
+ */
+class STraceSpan
+{
+public:
+    enum Sampling {
+        // Always recorded
+        Always,
+        // Recorded one in every STrace::setSampleInterval()
+        Sampled
+    };
+
+    STraceSpan(const char* name, Sampling sampling = Always);
+    ~STraceSpan() { end(); }
+
+    /*
+     * End the span early.
+     */
+    void end();
+
+private:
+    const char* _name;
+    // Start time, -1 if the span isn't recorded
+    int64_t _start;
+};
+
+inline STraceSpan::STraceSpan(const char* name, Sampling sampling)
+  : _name(name),
+    _start(-1)
+{
+    if (STrace::isEnabled() && (sampling == Always || STrace::sample())) {
+        _start = STrace::now();
+    }
+}
+
+inline void STraceSpan::end()
+{
+    if (_start >= 0) {
+        STrace::addSpan(_name, _start, STrace::now());
+        _start = -1;
+    }
+}
+
+#endif // STRACE_H